@@ -0,0 +1,702 @@
+/*
+ * fiwix/drivers/block/ahci.c
+ *
+ * Copyright 2021, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#include <fiwix/asm.h>
+#include <fiwix/kernel.h>
+#include <fiwix/ahci.h>
+#include <fiwix/buffer.h>
+#include <fiwix/ioctl.h>
+#include <fiwix/devices.h>
+#include <fiwix/sleep.h>
+#include <fiwix/timer.h>
+#include <fiwix/sched.h>
+#include <fiwix/fs.h>
+#include <fiwix/part.h>
+#include <fiwix/process.h>
+#include <fiwix/mm.h>
+#include <fiwix/errno.h>
+#include <fiwix/stdio.h>
+#include <fiwix/string.h>
+
+/*
+ * Every SATA disk attached to an AHCI controller has its own list of
+ * command slots. A request takes a free slot, fills the command table with
+ * the FIS and the scatter list of buffers, and sleeps until the interrupt
+ * reports the slot as completed. Other processes can issue their requests
+ * meanwhile, so if the disk supports NCQ up to 32 commands are queued in
+ * the disk and it's free to reorder them.
+ */
+
+static struct ahci ahci_table[NR_AHCI_CTRLS];
+static struct ahci_disk ahci_disks[NR_AHCI_DISKS];
+static int ahci_ctrls = 0;
+static int ahci_ndisks = 0;
+static unsigned int ahci_sizes[256];
+
+static struct fs_operations ahci_driver_fsop = {
+	0,
+	0,
+
+	ahci_open,
+	ahci_close,
+	NULL,			/* read */
+	NULL,			/* write */
+	ahci_ioctl,
+	NULL,			/* lseek */
+	NULL,			/* readdir */
+	NULL,			/* mmap */
+	NULL,			/* select */
+
+	NULL,			/* readlink */
+	NULL,			/* followlink */
+	NULL,			/* bmap */
+	NULL,			/* lockup */
+	NULL,			/* rmdir */
+	NULL,			/* link */
+	NULL,			/* unlink */
+	NULL,			/* symlink */
+	NULL,			/* mkdir */
+	NULL,			/* mknod */
+	NULL,			/* truncate */
+	NULL,			/* create */
+	NULL,			/* rename */
+
+	ahci_read,
+	ahci_write,
+
+	NULL,			/* read_inode */
+	NULL,			/* write_inode */
+	NULL,			/* ialloc */
+	NULL,			/* ifree */
+	NULL,			/* statfs */
+	NULL,			/* read_superblock */
+	NULL,			/* remount_fs */
+	NULL,			/* write_superblock */
+	NULL			/* release_superblock */
+};
+
+static struct device ahci_device = {
+	"sd",
+	AHCI_MAJOR,
+	{ 0, 0, 0, 0, 0, 0, 0, 0 },
+	BLKSIZE_1K,
+	&ahci_sizes,
+	&ahci_driver_fsop,
+	ahci_rw_blocks,
+	NULL,
+	NULL
+};
+
+static void ahci_delay(void)
+{
+	int n;
+
+	for(n = 0; n < 10000; n++) {
+		NOP();
+	}
+}
+
+static struct ahci_disk * get_ahci_disk(__dev_t dev)
+{
+	int n;
+
+	n = MINOR(dev) / AHCI_DISK_MINORS;
+	if(n < ahci_ndisks && TEST_MINOR(ahci_device.minors, MINOR(dev))) {
+		return &ahci_disks[n];
+	}
+	return NULL;
+}
+
+/* returns 1 if the bits in 'mask' didn't get cleared in time */
+static int wait_port_clear(volatile unsigned int *reg, unsigned int mask)
+{
+	int n;
+
+	for(n = 0; n < 1000; n++) {
+		if(!(*reg & mask)) {
+			return 0;
+		}
+		ahci_delay();
+	}
+	return 1;
+}
+
+static void stop_port(struct ahci_disk *disk)
+{
+	disk->regs->cmd &= ~AHCI_PxCMD_ST;
+	wait_port_clear(&disk->regs->cmd, AHCI_PxCMD_CR);
+	disk->regs->cmd &= ~AHCI_PxCMD_FRE;
+	wait_port_clear(&disk->regs->cmd, AHCI_PxCMD_FR);
+}
+
+static int start_port(struct ahci_disk *disk)
+{
+	disk->regs->cmd |= AHCI_PxCMD_FRE;
+	if(wait_port_clear(&disk->regs->tfd, AHCI_PxTFD_BSY | AHCI_PxTFD_DRQ)) {
+		return 1;
+	}
+	disk->regs->cmd |= AHCI_PxCMD_ST;
+	return 0;
+}
+
+/* the slots are given back to their requests with an error */
+static void complete_slots(struct ahci_disk *disk, unsigned int slots, int error)
+{
+	int slot;
+
+	for(slot = 0; slot < disk->depth; slot++) {
+		if(slots & (1 << slot)) {
+			disk->active &= ~(1 << slot);
+			if(error) {
+				disk->error |= (1 << slot);
+			}
+			wakeup(&disk->cmd_list[slot]);
+		}
+	}
+}
+
+/*
+ * Fails all the commands issued and restarts the port. A COMRESET is needed
+ * to get the disk out of the error state after an NCQ command failed, or if
+ * it still looks busy.
+ */
+static void restart_port(struct ahci_disk *disk)
+{
+	unsigned long int flags;
+	unsigned int failed;
+
+	SAVE_FLAGS(flags); CLI();
+	failed = disk->active;
+	stop_port(disk);
+	if((disk->flags & AHCI_DISK_NCQ) || (disk->regs->tfd & (AHCI_PxTFD_BSY | AHCI_PxTFD_DRQ))) {
+		disk->regs->sctl = (disk->regs->sctl & ~0x0F) | 1;
+		ahci_delay();
+		disk->regs->sctl &= ~0x0F;
+		ahci_delay();
+	}
+	disk->regs->serr = 0xFFFFFFFF;
+	disk->regs->is = 0xFFFFFFFF;
+	if(start_port(disk)) {
+		printk("WARNING: %s(): %s: unable to restart the port.\n", __FUNCTION__, disk->dev_name);
+	}
+	complete_slots(disk, failed, 1);
+	RESTORE_FLAGS(flags);
+}
+
+static void ahci_timer(unsigned int arg)
+{
+	struct ahci_disk *disk;
+
+	disk = &ahci_disks[arg >> 8];
+	if(disk->active & (1 << (arg & 0xFF))) {
+		printk("WARNING: %s(): %s: command timeout (tfd=0x%x, ci=0x%x, sact=0x%x).\n", __FUNCTION__, disk->dev_name, disk->regs->tfd, disk->regs->ci, disk->regs->sact);
+		restart_port(disk);
+	}
+}
+
+/* returns a free slot, or -1 if there is none and 'wait' is not set */
+static int get_slot(struct ahci_disk *disk, int wait)
+{
+	unsigned long int flags;
+	int slot;
+
+	SAVE_FLAGS(flags); CLI();
+	for(;;) {
+		for(slot = 0; slot < disk->depth; slot++) {
+			if(!(disk->busy & (1 << slot))) {
+				disk->busy |= (1 << slot);
+				RESTORE_FLAGS(flags);
+				return slot;
+			}
+		}
+		if(!wait) {
+			break;
+		}
+		sleep(&disk->busy, PROC_UNINTERRUPTIBLE);
+	}
+	RESTORE_FLAGS(flags);
+	return -1;
+}
+
+static void put_slot(struct ahci_disk *disk, int slot)
+{
+	unsigned long int flags;
+
+	SAVE_FLAGS(flags); CLI();
+	disk->busy &= ~(1 << slot);
+	RESTORE_FLAGS(flags);
+	wakeup(&disk->busy);
+}
+
+/* fills the command table of the slot with the FIS and the scatter list */
+static void setup_command(struct ahci_disk *disk, int slot, int cmd, unsigned int sector, int nsectors, char **buffers, int nbuffers, int size, int mode)
+{
+	struct ahci_cmd_header *header;
+	struct ahci_cmd_table *table;
+	struct ahci_fis_h2d *fis;
+	int n;
+
+	table = disk->cmd_table[slot];
+	memset_b(table->cfis, NULL, sizeof(table->cfis));
+	for(n = 0; n < nbuffers; n++) {
+		table->prd[n].dba = V2P((unsigned int)buffers[n]);
+		table->prd[n].dbau = 0;
+		table->prd[n].reserved = 0;
+		table->prd[n].dbc = size - 1;
+	}
+
+	fis = (struct ahci_fis_h2d *)table->cfis;
+	fis->type = AHCI_FIS_H2D;
+	fis->flags = AHCI_FIS_COMMAND;
+	fis->command = cmd;
+	if(cmd != ATA_IDENTIFY) {
+		fis->device = AHCI_FIS_LBA_MODE;
+		fis->lba0 = sector & 0xFF;
+		fis->lba1 = (sector >> 8) & 0xFF;
+		fis->lba2 = (sector >> 16) & 0xFF;
+		fis->lba3 = (sector >> 24) & 0xFF;
+	}
+	if(cmd == ATA_READ_FPDMA_QUEUED || cmd == ATA_WRITE_FPDMA_QUEUED) {
+		/* the sector count goes in the features and the tag in the count */
+		fis->features = nsectors & 0xFF;
+		fis->features_exp = (nsectors >> 8) & 0xFF;
+		fis->count = slot << 3;
+	} else {
+		fis->count = nsectors & 0xFF;
+		fis->count_exp = (nsectors >> 8) & 0xFF;
+	}
+
+	header = &disk->cmd_list[slot];
+	header->flags = sizeof(struct ahci_fis_h2d) / sizeof(unsigned int);
+	if(mode == FOR_WRITING) {
+		header->flags |= AHCI_CMD_WRITE;
+	}
+	header->prdtl = nbuffers;
+	header->prdbc = 0;
+}
+
+static void issue_command(struct ahci_disk *disk, int slot)
+{
+	unsigned long int flags;
+
+	SAVE_FLAGS(flags); CLI();
+	disk->active |= (1 << slot);
+	disk->error &= ~(1 << slot);
+	if(disk->flags & AHCI_DISK_NCQ) {
+		disk->regs->sact = (1 << slot);
+	}
+	disk->regs->ci = (1 << slot);
+	RESTORE_FLAGS(flags);
+}
+
+/* waits for the commands in the slots specified and returns the failed ones */
+static unsigned int wait_slots(struct ahci_disk *disk, unsigned int slots)
+{
+	unsigned long int flags;
+	unsigned int failed;
+	struct callout_req creq;
+	int slot;
+
+	failed = 0;
+	for(slot = 0; slot < disk->depth; slot++) {
+		if(!(slots & (1 << slot))) {
+			continue;
+		}
+		creq.fn = ahci_timer;
+		creq.arg = ((disk - ahci_disks) << 8) | slot;
+		add_callout(&creq, WAIT_FOR_AHCI);
+		SAVE_FLAGS(flags); CLI();
+		while(disk->active & (1 << slot)) {
+			sleep(&disk->cmd_list[slot], PROC_UNINTERRUPTIBLE);
+		}
+		RESTORE_FLAGS(flags);
+		del_callout(&creq);
+		if(disk->error & (1 << slot)) {
+			failed |= (1 << slot);
+		}
+		put_slot(disk, slot);
+	}
+	return failed;
+}
+
+static unsigned int get_part_size(struct ahci_disk *disk, int minor)
+{
+	if(minor) {
+		return disk->part_table[minor - 1].nr_sects;
+	}
+	return disk->nr_sects;
+}
+
+static void assign_minors(struct ahci_disk *disk)
+{
+	int n, minor;
+
+	for(n = 0; n < NR_PARTITIONS; n++) {
+		minor = ((disk - ahci_disks) * AHCI_DISK_MINORS) + n + 1;
+		CLEAR_MINOR(ahci_device.minors, minor);
+		if(disk->part_table[n].type) {
+			SET_MINOR(ahci_device.minors, minor);
+			ahci_sizes[minor] = disk->part_table[n].nr_sects / 2;
+		}
+	}
+}
+
+void irq_ahci(int num, struct sigcontext *sc)
+{
+	struct ahci *ahci;
+	struct ahci_disk *disk;
+	unsigned int is, port_is;
+	int n;
+
+	for(ahci = &ahci_table[0]; ahci < &ahci_table[ahci_ctrls]; ahci++) {
+		if(ahci->pci->irq != num || !(is = ahci->regs->is)) {
+			continue;
+		}
+		for(n = 0; n < ahci_ndisks; n++) {
+			disk = &ahci_disks[n];
+			if(disk->ahci != ahci || !(is & (1 << disk->port))) {
+				continue;
+			}
+			port_is = disk->regs->is;
+			disk->regs->is = port_is;
+			if(port_is & AHCI_PxIS_ERROR) {
+				printk("WARNING: %s(): %s: error (is=0x%x, tfd=0x%x, serr=0x%x).\n", __FUNCTION__, disk->dev_name, port_is, disk->regs->tfd, disk->regs->serr);
+				restart_port(disk);
+				continue;
+			}
+			/* the slots no longer in CI nor SACT are completed */
+			complete_slots(disk, disk->active & ~(disk->regs->ci | disk->regs->sact), 0);
+		}
+		ahci->regs->is = is;
+	}
+}
+
+int ahci_open(struct inode *i, struct fd *fd_table)
+{
+	if(!get_ahci_disk(i->rdev)) {
+		return -ENXIO;
+	}
+	return 0;
+}
+
+int ahci_close(struct inode *i, struct fd *fd_table)
+{
+	sync_buffers(i->rdev);
+	return 0;
+}
+
+int ahci_read(__dev_t dev, __blk_t block, char *buffer, int blksize)
+{
+	return ahci_rw_blocks(dev, block, &buffer, 1, blksize, FOR_READING);
+}
+
+int ahci_write(__dev_t dev, __blk_t block, char *buffer, int blksize)
+{
+	return ahci_rw_blocks(dev, block, &buffer, 1, blksize, FOR_WRITING);
+}
+
+/*
+ * The run of blocks is split in commands of AHCI_MAX_PRDS buffers which are
+ * all issued before waiting for any of them. If no slot is free, the ones
+ * already taken are waited for first, so a request never sleeps holding
+ * slots that other requests might need.
+ */
+int ahci_rw_blocks(__dev_t dev, __blk_t block, char **buffers, int nblocks, int blksize, int mode)
+{
+	struct ahci_disk *disk;
+	unsigned int sector, slots, failed;
+	int minor, n, count, spb, slot, cmd;
+
+	if(!(disk = get_ahci_disk(dev))) {
+		return -ENXIO;
+	}
+
+	minor = MINOR(dev) % AHCI_DISK_MINORS;
+	blksize = blksize ? blksize : BLKSIZE_1K;
+	spb = blksize / AHCI_SECTSIZE;
+	sector = block * spb;
+	if(block < 0 || sector + (nblocks * spb) > get_part_size(disk, minor)) {
+		printk("WARNING: %s(): %s: block %d is beyond the size of the device %d,%d.\n", __FUNCTION__, disk->dev_name, block, MAJOR(dev), MINOR(dev));
+		return -EIO;
+	}
+	if(minor) {
+		sector += disk->part_table[minor - 1].startsect;
+	}
+
+	if(disk->flags & AHCI_DISK_NCQ) {
+		cmd = mode == FOR_READING ? ATA_READ_FPDMA_QUEUED : ATA_WRITE_FPDMA_QUEUED;
+	} else {
+		cmd = mode == FOR_READING ? ATA_READ_DMA_EXT : ATA_WRITE_DMA_EXT;
+	}
+
+	slots = failed = 0;
+	for(n = 0; n < nblocks; n += count) {
+		count = MIN(nblocks - n, AHCI_MAX_PRDS);
+		if((slot = get_slot(disk, !slots)) < 0) {
+			failed |= wait_slots(disk, slots);
+			slots = 0;
+			slot = get_slot(disk, 1);
+		}
+		setup_command(disk, slot, cmd, sector + (n * spb), count * spb, buffers + n, count, blksize, mode);
+		issue_command(disk, slot);
+		slots |= (1 << slot);
+	}
+	failed |= wait_slots(disk, slots);
+
+	if(failed) {
+		printk("WARNING: %s(): %s: error on device %d,%d during %s at block %d.\n", __FUNCTION__, disk->dev_name, MAJOR(dev), MINOR(dev), mode == FOR_READING ? "read" : "write", block);
+		return -EIO;
+	}
+	return nblocks * blksize;
+}
+
+int ahci_ioctl(struct inode *i, int cmd, unsigned long int arg)
+{
+	struct ahci_disk *disk;
+	struct hd_geometry *geom;
+	int minor, errno;
+
+	if(!(disk = get_ahci_disk(i->rdev))) {
+		return -ENXIO;
+	}
+	minor = MINOR(i->rdev) % AHCI_DISK_MINORS;
+
+	switch(cmd) {
+		case HDIO_GETGEO:
+			if((errno = check_user_area(VERIFY_WRITE, (void *)arg, sizeof(struct hd_geometry)))) {
+				return errno;
+			}
+			geom = (struct hd_geometry *)arg;
+			geom->cylinders = disk->ident.logic_cyls;
+			geom->heads = (char)disk->ident.logic_heads;
+			geom->sectors = (char)disk->ident.logic_spt;
+			geom->start = 0;
+			if(minor) {
+				geom->start = disk->part_table[minor - 1].startsect;
+			}
+			break;
+		case BLKGETSIZE:
+			if((errno = check_user_area(VERIFY_WRITE, (void *)arg, sizeof(unsigned int)))) {
+				return errno;
+			}
+			*(int *)arg = get_part_size(disk, minor);
+			break;
+		case BLKFLSBUF:
+			sync_buffers(i->rdev);
+			invalidate_buffers(i->rdev);
+			break;
+		case BLKRRPART:
+			read_msdos_partition(MKDEV(AHCI_MAJOR, (disk - ahci_disks) * AHCI_DISK_MINORS), disk->part_table);
+			assign_minors(disk);
+			break;
+		default:
+			return -EINVAL;
+	}
+	return 0;
+}
+
+static int identify(struct ahci_disk *disk)
+{
+	char *buffer;
+	int slot;
+
+	if(!(buffer = (char *)kmalloc())) {
+		return 1;
+	}
+	slot = get_slot(disk, 1);
+	setup_command(disk, slot, ATA_IDENTIFY, 0, 0, &buffer, 1, sizeof(struct ide_drv_ident), FOR_READING);
+	issue_command(disk, slot);
+	if(wait_slots(disk, 1 << slot)) {
+		kfree((unsigned int)buffer);
+		return 1;
+	}
+	memcpy_b(&disk->ident, buffer, sizeof(struct ide_drv_ident));
+	kfree((unsigned int)buffer);
+	swap_asc_word(disk->ident.model_number, 40);
+
+	if(disk->ident.cmdset2 & 0x0400) {
+		/* sectors beyond 2TB are not reachable with 1KB blocks */
+		disk->nr_sects = disk->ident.lba48_sects[0] | (disk->ident.lba48_sects[1] << 16);
+		if(disk->ident.lba48_sects[2] || disk->ident.lba48_sects[3]) {
+			disk->nr_sects = 0xFFFFFFFF;
+		}
+	} else {
+		disk->nr_sects = disk->ident.tot_sectors | (disk->ident.tot_sectors2 << 16);
+	}
+	if((disk->ahci->regs->cap & AHCI_CAP_SNCQ) && (disk->ident.sata_cap & ATA_SATA_HAS_NCQ)) {
+		disk->flags |= AHCI_DISK_NCQ;
+		disk->depth = MIN(disk->depth, (disk->ident.queue_depth & 0x1F) + 1);
+	} else {
+		/* the commands are still queued in the HBA, one after another */
+		disk->flags &= ~AHCI_DISK_NCQ;
+	}
+	return 0;
+}
+
+/* allocates the command list, the FIS area and the command tables */
+static int alloc_port(struct ahci_disk *disk)
+{
+	char *page;
+	int slot;
+
+	if(!(page = (char *)kmalloc())) {
+		return 1;
+	}
+	memset_b(page, NULL, PAGE_SIZE);
+	disk->cmd_list = (struct ahci_cmd_header *)page;
+	disk->regs->clb = V2P((unsigned int)page);
+	disk->regs->clbu = 0;
+	disk->regs->fb = V2P((unsigned int)page + AHCI_FIS_OFFSET);
+	disk->regs->fbu = 0;
+
+	for(slot = 0; slot < disk->depth; slot++) {
+		if(!(slot % AHCI_CMD_TABLES)) {
+			if(!(page = (char *)kmalloc())) {
+				disk->depth = slot;
+				break;
+			}
+			memset_b(page, NULL, PAGE_SIZE);
+		}
+		disk->cmd_table[slot] = (struct ahci_cmd_table *)(page + ((slot % AHCI_CMD_TABLES) * sizeof(struct ahci_cmd_table)));
+		disk->cmd_list[slot].ctba = V2P((unsigned int)disk->cmd_table[slot]);
+		disk->cmd_list[slot].ctbau = 0;
+	}
+	return !disk->depth;
+}
+
+static void show_disk(struct ahci_disk *disk)
+{
+	int n;
+
+	printk("%s       0x%08X      %2d    ", disk->dev_name, (unsigned int)disk->regs, disk->ahci->pci->irq);
+	printk("AHCI port %d SATA DISK drive %dMB\n", disk->port, disk->nr_sects / 2048);
+	printk("                                model=%s\n", disk->ident.model_number);
+	printk("                                sectors=%d", disk->nr_sects);
+	if(disk->flags & AHCI_DISK_NCQ) {
+		printk(" NCQ(%d)", disk->depth);
+	}
+	printk("\n");
+	printk("                                partition summary: ");
+	for(n = 0; n < NR_PARTITIONS; n++) {
+		/* status values other than 0x00 and 0x80 are invalid */
+		if(disk->part_table[n].status && disk->part_table[n].status != 0x80) {
+			continue;
+		}
+		if(disk->part_table[n].type) {
+			printk("%s%d ", disk->dev_name, n + 1);
+		}
+	}
+	printk("\n");
+}
+
+static void port_init(struct ahci *ahci, int port)
+{
+	struct ahci_disk *disk;
+	volatile struct ahci_port_regs *regs;
+	int minor;
+
+	regs = &ahci->regs->port[port];
+	if(AHCI_PxSSTS_DET(regs->ssts) != AHCI_DET_PRESENT || regs->sig != AHCI_SIG_ATA) {
+		return;
+	}
+	if(ahci_ndisks >= NR_AHCI_DISKS) {
+		printk("WARNING: %s(): too many SATA disks, port %d ignored.\n", __FUNCTION__, port);
+		return;
+	}
+
+	disk = &ahci_disks[ahci_ndisks];
+	memset_b(disk, NULL, sizeof(struct ahci_disk));
+	disk->ahci = ahci;
+	disk->port = port;
+	disk->regs = regs;
+	disk->depth = ahci->nslots;
+	disk->dev_name[0] = 's';
+	disk->dev_name[1] = 'd';
+	disk->dev_name[2] = 'a' + ahci_ndisks;
+
+	stop_port(disk);
+	if(alloc_port(disk)) {
+		printk("WARNING: %s(): unable to allocate memory for port %d.\n", __FUNCTION__, port);
+		return;
+	}
+	regs->cmd |= AHCI_PxCMD_SUD | AHCI_PxCMD_POD;
+	regs->serr = 0xFFFFFFFF;
+	regs->is = 0xFFFFFFFF;
+	regs->ie = AHCI_PxIE_DEFAULT;
+	if(start_port(disk)) {
+		printk("WARNING: %s(): port %d is not ready.\n", __FUNCTION__, port);
+		return;
+	}
+
+	minor = ahci_ndisks * AHCI_DISK_MINORS;
+	ahci_ndisks++;
+	SET_MINOR(ahci_device.minors, minor);
+	if(identify(disk)) {
+		printk("WARNING: %s(): unable to identify the disk in port %d.\n", __FUNCTION__, port);
+		CLEAR_MINOR(ahci_device.minors, minor);
+		regs->ie = 0;
+		stop_port(disk);
+		ahci_ndisks--;
+		return;
+	}
+	ahci_sizes[minor] = disk->nr_sects / 2;
+	read_msdos_partition(MKDEV(AHCI_MAJOR, minor), disk->part_table);
+	assign_minors(disk);
+	show_disk(disk);
+}
+
+void ahci_init(void)
+{
+	struct pci_device *pci;
+	struct ahci *ahci;
+	unsigned int pi;
+	int n;
+
+	pci = NULL;
+	while((pci = pci_find_class(PCI_CLASS_STORAGE, PCI_SUBCLASS_SATA, pci))) {
+		if(pci->prog_if != AHCI_PCI_PROG_IF) {
+			continue;
+		}
+		if(ahci_ctrls >= NR_AHCI_CTRLS) {
+			printk("WARNING: %s(): too many AHCI controllers.\n", __FUNCTION__);
+			break;
+		}
+		if(!pci->size[AHCI_PCI_ABAR] || !pci->irq) {
+			printk("WARNING: %s(): AHCI controller %02d:%02d.%d is not usable.\n", __FUNCTION__, pci->bus, pci->slot, pci->func);
+			continue;
+		}
+		if(!ahci_ctrls) {
+			if(register_device(BLK_DEV, &ahci_device)) {
+				printk("ERROR: %s(): unable to register the SATA disks.\n", __FUNCTION__);
+				return;
+			}
+		}
+
+		ahci = &ahci_table[ahci_ctrls++];
+		ahci->pci = pci;
+		ahci->regs = (struct ahci_hba_regs *)(pci->bar[AHCI_PCI_ABAR] & PCI_BAR_MEM_MASK);
+		ahci->irq.ticks = 0;
+		ahci->irq.name = "ahci";
+		ahci->irq.handler = irq_ahci;
+		ahci->irq.next = NULL;
+		pci_enable_device(pci, PCI_COMMAND_MEMORY | PCI_COMMAND_MASTER);
+		ahci->regs->ghc |= AHCI_GHC_AE;
+		ahci->nslots = AHCI_CAP_NCS(ahci->regs->cap);
+		if(!register_irq(pci->irq, &ahci->irq)) {
+			enable_irq(pci->irq);
+		}
+		ahci->regs->is = 0xFFFFFFFF;
+		ahci->regs->ghc |= AHCI_GHC_IE;
+
+		pi = ahci->regs->pi;
+		for(n = 0; n < NR_AHCI_PORTS; n++) {
+			if(pi & (1 << n)) {
+				port_init(ahci, n);
+			}
+		}
+	}
+}
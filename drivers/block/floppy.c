@@ -57,16 +57,26 @@ static struct fddt fdd_type[] = {
 /* buffer area used for I/O operations (1KB) */
 char fdc_transfer_area[BPS * 2];
 
+/*
+ * A whole cylinder (both heads) is read at once into the track area of the
+ * drive, and the following blocks are copied from there until the disk is
+ * changed. The areas must not cross a 64KB boundary for the ISA DMA.
+ */
+#define FDC_TRACK_SIZE	(18 * 2 * FDC_SECTSIZE)	/* largest cylinder */
+static char fdc_track_area[2][FDC_TRACK_SIZE] __attribute__((aligned(0x10000)));
+
 struct fdd_status {
 	char type;		/* floppy disk drive type */
 	char motor;
 	char recalibrated;
 	char current_track;
+	char cached_track;	/* cylinder in the track area */
+	struct fddt *cached_type;	/* geometry used to read it */
 };
 
 static struct fdd_status fdd_status[] = {
-	{ 0, 0, 0, INVALID_TRACK },
-	{ 0, 0, 0, INVALID_TRACK },
+	{ 0, 0, 0, INVALID_TRACK, INVALID_TRACK, NULL },
+	{ 0, 0, 0, INVALID_TRACK, INVALID_TRACK, NULL },
 };
 
 static unsigned char current_fdd = 0;
@@ -122,6 +132,8 @@ static struct device floppy_device = {
 	BLKSIZE_1K,
 	&fdd_sizes,
 	&fdc_driver_fsop,
+	NULL,
+	NULL,
 	NULL
 };
 
@@ -521,36 +533,15 @@ int fdc_close(struct inode *i, struct fd *fd_table)
 	return 0;
 }
 
-int fdc_read(__dev_t dev, __blk_t block, char *buffer, int blksize)
+/* reads both heads of the cylinder into the track area of the drive */
+static int fdc_read_track(__dev_t dev, int cyl)
 {
-	unsigned char minor;
 	unsigned int sectors_read;
-	int cyl, head, sector;
-	int retries;
+	int retries, size;
 	struct callout_req creq;
-	struct device *d;
-
-	minor = MINOR(dev);
-	if(!TEST_MINOR(floppy_device.minors, minor)) {
-		return -ENXIO;
-	}
-
-	if(!blksize) {
-		if(!(d = get_device(BLK_DEV, dev))) {
-			return -EINVAL;
-		}
-		blksize = d->blksize;
-	}
-	blksize = blksize ? blksize : BLKSIZE_1K;
-
-	lock_resource(&floppy_resource);
-	set_current_fdd_type(minor);
 
-	if(fdc_block2chs(block, blksize, &cyl, &head, &sector)) {
-		printk("WARNING: %s(): fd%d: invalid block number %d on %s device %d,%d.\n", __FUNCTION__, current_fdd, block, floppy_device.name, MAJOR(dev), MINOR(dev));
-		unlock_resource(&floppy_resource);
-		return -EINVAL;
-	}
+	fdd_status[current_fdd].cached_track = INVALID_TRACK;
+	size = current_fdd_type->spt * current_fdd_type->heads * FDC_SECTSIZE;
 
 	for(retries = 0; retries < MAX_FDC_ERR; retries++) {
 		if(need_reset) {
@@ -562,20 +553,20 @@ int fdc_read(__dev_t dev, __blk_t block, char *buffer, int blksize)
 			fdd_status[current_fdd].recalibrated = 0;
 		}
 
-		if(fdc_seek(cyl, head)) {
+		if(fdc_seek(cyl, 0)) {
 			printk("WARNING: %s(): fd%d: seek error on %s device %d,%d during read operation.\n", __FUNCTION__, current_fdd, floppy_device.name, MAJOR(dev), MINOR(dev));
 			continue;
 		}
 
-		start_dma(FLOPPY_DMA, fdc_transfer_area, blksize, DMA_MODE_WRITE | DMA_MODE_SINGLE);
+		start_dma(FLOPPY_DMA, fdc_track_area[current_fdd], size, DMA_MODE_WRITE | DMA_MODE_SINGLE);
 
-		/* send READ command */
+		/* send READ command (multi-track, it continues on the head 1) */
 		fdc_wait_interrupt = FDC_READ;
 		fdc_out(FDC_READ);
-		fdc_out((head << 2) | current_fdd);
+		fdc_out(current_fdd);
 		fdc_out(cyl);
-		fdc_out(head);
-		fdc_out(sector);
+		fdc_out(0);
+		fdc_out(1);
 		fdc_out(2);	/* sector size is 512 bytes */
 		fdc_out(current_fdd_type->spt);
 		fdc_out(current_fdd_type->gpl1);
@@ -608,28 +599,96 @@ int fdc_read(__dev_t dev, __blk_t block, char *buffer, int blksize)
 
 	if(retries >= MAX_FDC_ERR) {
 		printk("WARNING: %s(): fd%d: error on %s device %d,%d during read operation,\n", __FUNCTION__, current_fdd, floppy_device.name, MAJOR(dev), MINOR(dev));
-		printk("\tblock=%d, sector=%d, cylinder/head=%d/%d\n", block, sector, cyl, head);
-		unlock_resource(&floppy_resource);
-		fdc_motor_off();
-		return -EIO;
+		printk("\tcylinder=%d\n", cyl);
+		return 1;
 	}
 
-	fdc_motor_off();
 	sectors_read = (fdc_results[ST_CYL] - cyl) * (current_fdd_type->heads * current_fdd_type->spt);
-	sectors_read += (fdc_results[ST_HEAD] - head) * current_fdd_type->spt;
-	sectors_read += fdc_results[ST_SECTOR] - sector;
-	if(sectors_read * BPS != blksize) {
+	sectors_read += fdc_results[ST_HEAD] * current_fdd_type->spt;
+	sectors_read += fdc_results[ST_SECTOR] - 1;
+	if(sectors_read * FDC_SECTSIZE != size) {
 		printk("WARNING: %s(): fd%d: read error on %s device %d,%d (%d sectors read).\n", __FUNCTION__, current_fdd, floppy_device.name, MAJOR(dev), MINOR(dev), sectors_read);
-		printk("\tblock=%d, sector=%d, cylinder/head=%d/%d\n", block, sector, cyl, head);
+		printk("\tcylinder=%d\n", cyl);
+		return 1;
+	}
+
+	fdd_status[current_fdd].cached_track = cyl;
+	fdd_status[current_fdd].cached_type = current_fdd_type;
+	return 0;
+}
+
+/* returns 1 if the cylinder is in the track area and the disk is the same */
+static int fdc_track_cached(__dev_t dev, int cyl)
+{
+	if(fdd_status[current_fdd].cached_track != cyl || fdd_status[current_fdd].cached_type != current_fdd_type) {
+		return 0;
+	}
+	/* the disk change line stays active until the next seek */
+	if(fdc_motor_on() || (inport_b(FDC_DIR) & 0x80)) {
+		printk("%s(): %s disk was changed in device %d,%d!\n", __FUNCTION__, floppy_device.name, MAJOR(dev), MINOR(dev));
+		invalidate_buffers(dev);
+		fdd_status[current_fdd].recalibrated = 0;
+		fdd_status[current_fdd].cached_track = INVALID_TRACK;
+		return 0;
+	}
+	return 1;
+}
+
+int fdc_read(__dev_t dev, __blk_t block, char *buffer, int blksize)
+{
+	unsigned char minor;
+	int cyl, head, sector;
+	int spc, lba, offset, bytes, total;
+	struct device *d;
+
+	minor = MINOR(dev);
+	if(!TEST_MINOR(floppy_device.minors, minor)) {
+		return -ENXIO;
+	}
+
+	if(!blksize) {
+		if(!(d = get_device(BLK_DEV, dev))) {
+			return -EINVAL;
+		}
+		blksize = d->blksize;
+	}
+	blksize = blksize ? blksize : BLKSIZE_1K;
+
+	lock_resource(&floppy_resource);
+	set_current_fdd_type(minor);
+
+	if(fdc_block2chs(block, blksize, &cyl, &head, &sector)) {
+		printk("WARNING: %s(): fd%d: invalid block number %d on %s device %d,%d.\n", __FUNCTION__, current_fdd, block, floppy_device.name, MAJOR(dev), MINOR(dev));
 		unlock_resource(&floppy_resource);
-		fdc_motor_off();
-		return -EIO;
+		return -EINVAL;
 	}
 
-	memcpy_b(buffer, (void *)fdc_transfer_area, blksize);
+	/* a block might continue in the next cylinder */
+	spc = current_fdd_type->spt * current_fdd_type->heads;
+	lba = block * (blksize / FDC_SECTSIZE);
+	for(total = 0; total < blksize; total += bytes) {
+		cyl = lba / spc;
+		offset = (lba % spc) * FDC_SECTSIZE;
+		if(cyl >= current_fdd_type->tracks) {
+			unlock_resource(&floppy_resource);
+			return -EINVAL;
+		}
+		if(!fdc_track_cached(dev, cyl)) {
+			if(fdc_read_track(dev, cyl)) {
+				printk("\tblock=%d\n", block);
+				unlock_resource(&floppy_resource);
+				fdc_motor_off();
+				return -EIO;
+			}
+		}
+		bytes = MIN(blksize - total, (spc * FDC_SECTSIZE) - offset);
+		memcpy_b(buffer + total, fdc_track_area[current_fdd] + offset, bytes);
+		lba += bytes / FDC_SECTSIZE;
+	}
 
+	fdc_motor_off();
 	unlock_resource(&floppy_resource);
-	return sectors_read * BPS;
+	return blksize;
 }
 
 int fdc_write(__dev_t dev, __blk_t block, char *buffer, int blksize)
@@ -637,6 +696,7 @@ int fdc_write(__dev_t dev, __blk_t block, char *buffer, int blksize)
 	unsigned char minor;
 	unsigned int sectors_written;
 	int cyl, head, sector;
+	int spc, lba, n;
 	int retries;
 	struct callout_req creq;
 	struct device *d;
@@ -671,6 +731,7 @@ int fdc_write(__dev_t dev, __blk_t block, char *buffer, int blksize)
 			printk("%s(): %s disk was changed in device %d,%d!\n", __FUNCTION__, floppy_device.name, MAJOR(dev), MINOR(dev));
 			invalidate_buffers(dev);
 			fdd_status[current_fdd].recalibrated = 0;
+			fdd_status[current_fdd].cached_track = INVALID_TRACK;
 		}
 
 		if(fdc_seek(cyl, head)) {
@@ -743,6 +804,17 @@ int fdc_write(__dev_t dev, __blk_t block, char *buffer, int blksize)
 		return -EIO;
 	}
 
+	/* the sectors written that are in the track area are updated too */
+	if(fdd_status[current_fdd].cached_type == current_fdd_type) {
+		spc = current_fdd_type->spt * current_fdd_type->heads;
+		lba = block * (blksize / FDC_SECTSIZE);
+		for(n = 0; n < sectors_written; n++, lba++) {
+			if(lba / spc == fdd_status[current_fdd].cached_track) {
+				memcpy_b(fdc_track_area[current_fdd] + ((lba % spc) * FDC_SECTSIZE), buffer + (n * FDC_SECTSIZE), FDC_SECTSIZE);
+			}
+		}
+	}
+
 	unlock_resource(&floppy_resource);
 	return sectors_written * BPS;
 }
@@ -15,6 +15,7 @@
 #include <fiwix/sched.h>
 #include <fiwix/cpu.h>
 #include <fiwix/pic.h>
+#include <fiwix/pci.h>
 #include <fiwix/fs.h>
 #include <fiwix/mm.h>
 #include <fiwix/errno.h>
@@ -29,16 +30,16 @@ int ide1_wait_interrupt = 0;
 int ide1_timeout = 0;
 
 struct ide ide_table[NR_IDE_CTRLS] = {
-	{ IDE_PRIMARY, IDE0_BASE, IDE0_CTRL, IDE0_IRQ, { NULL, NULL },
+	{ IDE_PRIMARY, IDE0_BASE, IDE0_CTRL, IDE0_IRQ, 0, NULL, { NULL, NULL },
 		{
-			{ IDE_MASTER, "hda", IDE0_MAJOR, 0, IDE_MASTER_MSF, NULL, NULL, NULL, NULL, NULL, { NULL }, {{ NULL }} },
-			{ IDE_SLAVE, "hdb", IDE0_MAJOR, 0, IDE_SLAVE_MSF, NULL, NULL, NULL, NULL, NULL, { NULL }, {{ NULL }} }
+			{ IDE_MASTER, "hda", IDE0_MAJOR, 0, IDE_MASTER_MSF, NULL, NULL, NULL, NULL, NULL, NULL, { NULL }, {{ NULL }} },
+			{ IDE_SLAVE, "hdb", IDE0_MAJOR, 0, IDE_SLAVE_MSF, NULL, NULL, NULL, NULL, NULL, NULL, { NULL }, {{ NULL }} }
 		}
 	},
-	{ IDE_SECONDARY, IDE1_BASE, IDE1_CTRL, IDE1_IRQ, {NULL, NULL },
+	{ IDE_SECONDARY, IDE1_BASE, IDE1_CTRL, IDE1_IRQ, 0, NULL, { NULL, NULL },
 		{
-			{ IDE_MASTER, "hdc", IDE1_MAJOR, 0, IDE_MASTER_MSF, NULL, NULL, NULL, NULL, NULL, { NULL }, {{ NULL }} },
-			{ IDE_SLAVE, "hdd", IDE1_MAJOR, 0, IDE_SLAVE_MSF, NULL, NULL, NULL, NULL, NULL, { NULL }, {{ NULL }} }
+			{ IDE_MASTER, "hdc", IDE1_MAJOR, 0, IDE_MASTER_MSF, NULL, NULL, NULL, NULL, NULL, NULL, { NULL }, {{ NULL }} },
+			{ IDE_SLAVE, "hdd", IDE1_MAJOR, 0, IDE_SLAVE_MSF, NULL, NULL, NULL, NULL, NULL, NULL, { NULL }, {{ NULL }} }
 		}
 	}
 };
@@ -100,6 +101,8 @@ static struct device ide0_device = {
 	0,
 	&ide0_sizes,
 	&ide_driver_fsop,
+	ide_rw_blocks,
+	NULL,
 	NULL
 };
 
@@ -110,6 +113,8 @@ static struct device ide1_device = {
 	0,
 	&ide1_sizes,
 	&ide_driver_fsop,
+	ide_rw_blocks,
+	NULL,
 	NULL
 };
 
@@ -259,6 +264,56 @@ static int get_udma(struct ide *ide, int drive)
 	return udma;
 }
 
+/*
+ * A transfer mode already selected in the drive is kept, since the BIOS
+ * also programmed the timings of the controller for it. Otherwise the best
+ * multiword DMA mode is selected, which works with the default timings.
+ */
+static int dma_init(struct ide *ide, int drive)
+{
+	struct ide_drv_ident *ident;
+	int n, mode, status, retries;
+
+	ident = &ide->drive[drive].ident;
+	if(!ide->bm_base || !(ident->capabilities & IDE_HAS_DMA)) {
+		return 1;
+	}
+
+	if(!((ident->fields_validity & IDE_HAS_UDMA) && (ident->ultradma & 0x3F00)) && !(ident->multiword_dma & 0x0700)) {
+		if(!(ident->multiword_dma & 0x07)) {
+			return 1;
+		}
+		for(mode = 2; mode > 0; mode--) {
+			if(ident->multiword_dma & (1 << mode)) {
+				break;
+			}
+		}
+		if(ide_drvsel(ide, drive, IDE_CHS_MODE, 0)) {
+			return 1;
+		}
+		SET_IDE_RDY_RETR(retries);
+		outport_b(ide->ctrl + IDE_DEV_CTRL, IDE_DEVCTR_NIEN);
+		outport_b(ide->base + IDE_FEATURES, ATA_SET_XFER_MODE);
+		outport_b(ide->base + IDE_SECCNT, ATA_XFER_MWDMA | mode);
+		outport_b(ide->base + IDE_COMMAND, ATA_SET_FEATURES);
+		ide_wait400ns(ide);
+		for(n = 0; n < retries; n++) {
+			status = inport_b(ide->base + IDE_STATUS);
+			if(!(status & IDE_STAT_BSY)) {
+				break;
+			}
+			ide_delay();
+		}
+		outport_b(ide->ctrl + IDE_DEV_CTRL, IDE_DEVCTR_DRQ);
+		if(status & (IDE_STAT_BSY | IDE_STAT_ERR)) {
+			return 1;
+		}
+	}
+
+	ide->drive[drive].flags |= DEVICE_HAS_DMA;
+	return 0;
+}
+
 static void ide_results(struct ide *ide, int drive)
 {
 	unsigned int cyl, hds, sect;
@@ -271,11 +326,6 @@ static void ide_results(struct ide *ide, int drive)
 	sect = ide->drive[drive].ident.logic_spt;
 
 	udma = get_udma(ide, drive);
-	/*
-	 * After knowing if the device is UDMA capable we could choose between
-	 * the PIO transfer mode or the UDMA transfer mode.
-	 * FIXME: Currently only PIO mode is supported.
-	 */
 
 	capacity = (__loff_t)ide->drive[drive].nr_sects * BPS;
 	capacity = capacity / 1024 / 1024;
@@ -315,6 +365,10 @@ static void ide_results(struct ide *ide, int drive)
 	if(udma >= 0) {
 		printk(" UDMA%d(%d)", udma, udma_speed[udma]);
 	}
+	/* disks use the bus master if the controller has one, PIO otherwise */
+	if((ide->drive[drive].flags & DEVICE_IS_DISK) && !dma_init(ide, drive)) {
+		printk(" DMA");
+	}
 	if(ide->drive[drive].ident.capabilities & IDE_HAS_LBA) {
 		ide->drive[drive].flags |= DEVICE_REQUIRES_LBA;
 		printk(" LBA");
@@ -372,7 +426,7 @@ static void ide_results(struct ide *ide, int drive)
 	printk("reserved73    = %d (%b)\n", ide->drive[drive].ident.reserved73, ide->drive[drive].ident.reserved73);
 	printk("reserved74    = %d (%b)\n", ide->drive[drive].ident.reserved74, ide->drive[drive].ident.reserved74);
 	printk("queue depth   = %d (%b)\n", ide->drive[drive].ident.queue_depth, ide->drive[drive].ident.queue_depth);
-	printk("reserved76    = %d (%b)\n", ide->drive[drive].ident.reserved76, ide->drive[drive].ident.reserved76);
+	printk("sata_cap      = %d (%b)\n", ide->drive[drive].ident.sata_cap, ide->drive[drive].ident.sata_cap);
 	printk("reserved77    = %d (%b)\n", ide->drive[drive].ident.reserved77, ide->drive[drive].ident.reserved77);
 	printk("reserved78    = %d (%b)\n", ide->drive[drive].ident.reserved78, ide->drive[drive].ident.reserved78);
 	printk("reserved79    = %d (%b)\n", ide->drive[drive].ident.reserved79, ide->drive[drive].ident.reserved79);
@@ -446,6 +500,42 @@ void ide1_timer(unsigned int arg)
 	wakeup(&irq_ide1);
 }
 
+/* the wait must be set before the drive can raise the interrupt */
+void ide_set_wait_interrupt(struct ide *ide, struct callout_req *creq)
+{
+	if(ide->channel == IDE_PRIMARY) {
+		ide0_wait_interrupt = ide->base;
+		creq->fn = ide0_timer;
+	} else {
+		ide1_wait_interrupt = ide->base;
+		creq->fn = ide1_timer;
+	}
+	creq->arg = 0;
+	add_callout(creq, WAIT_FOR_IDE);
+}
+
+/* returns 1 if the interrupt didn't arrive in time */
+int ide_wait_interrupt(struct ide *ide, struct callout_req *creq)
+{
+	int timeout;
+
+	if(ide->channel == IDE_PRIMARY) {
+		if(ide0_wait_interrupt) {
+			sleep(&irq_ide0, PROC_UNINTERRUPTIBLE);
+		}
+		timeout = ide0_timeout;
+	} else {
+		if(ide1_wait_interrupt) {
+			sleep(&irq_ide1, PROC_UNINTERRUPTIBLE);
+		}
+		timeout = ide1_timeout;
+	}
+	if(!timeout) {
+		del_callout(creq);
+	}
+	return timeout;
+}
+
 void ide_error(struct ide *ide, int status)
 {
 	int error;
@@ -613,6 +703,54 @@ int ide_softreset(struct ide *ide)
 	return error;
 }
 
+/*
+ * Builds the PRD table of the channel for a scatter list of buffers and sets
+ * the direction of the transfer.
+ */
+void ide_bm_setup(struct ide *ide, char **buffers, int nbuffers, int size, int mode)
+{
+	struct ide_prd *prd;
+	unsigned int addr;
+	int n, left, bytes;
+
+	prd = ide->prd_table;
+	for(n = 0; n < nbuffers; n++) {
+		addr = V2P((unsigned int)buffers[n]);
+		left = size;
+		while(left) {
+			bytes = MIN(left, IDE_PRD_BOUNDARY - (addr & (IDE_PRD_BOUNDARY - 1)));
+			prd->addr = addr;
+			prd->size = bytes & 0xFFFF;
+			prd->flags = 0;
+			addr += bytes;
+			left -= bytes;
+			prd++;
+		}
+	}
+	(prd - 1)->flags = IDE_PRD_EOT;
+
+	outport_l(ide->bm_base + IDE_BM_PRDT, V2P((unsigned int)ide->prd_table));
+	outport_b(ide->bm_base + IDE_BM_COMMAND, mode == FOR_READING ? IDE_BM_CMD_READ : 0);
+	/* the error and interrupt bits are cleared by writing them */
+	outport_b(ide->bm_base + IDE_BM_STATUS, inport_b(ide->bm_base + IDE_BM_STATUS) | IDE_BM_STAT_ERR | IDE_BM_STAT_INTR);
+}
+
+void ide_bm_start(struct ide *ide)
+{
+	outport_b(ide->bm_base + IDE_BM_COMMAND, inport_b(ide->bm_base + IDE_BM_COMMAND) | IDE_BM_CMD_START);
+}
+
+/* stops the bus master and returns its status */
+int ide_bm_stop(struct ide *ide)
+{
+	int status;
+
+	outport_b(ide->bm_base + IDE_BM_COMMAND, inport_b(ide->bm_base + IDE_BM_COMMAND) & ~IDE_BM_CMD_START);
+	status = inport_b(ide->bm_base + IDE_BM_STATUS);
+	outport_b(ide->bm_base + IDE_BM_STATUS, status | IDE_BM_STAT_ERR | IDE_BM_STAT_INTR);
+	return status;
+}
+
 struct ide * get_ide_controller(__dev_t dev)
 {
 	int controller;
@@ -728,6 +866,30 @@ int ide_write(__dev_t dev, __blk_t block, char *buffer, int blksize)
 	return -EINVAL;
 }
 
+int ide_rw_blocks(__dev_t dev, __blk_t block, char **buffers, int nblocks, int blksize, int mode)
+{
+	int drive;
+	struct ide *ide;
+
+	if(!(ide = get_ide_controller(dev))) {
+		printk("%s(): no ide controller!\n", __FUNCTION__);
+		return -EINVAL;
+	}
+
+	if(!get_device(BLK_DEV, dev)) {
+		return -ENXIO;
+	}
+
+	drive = get_ide_drive(dev);
+	if(ide->drive[drive].flags & DEVICE_IS_DISK) {
+		return ide_hd_rw_blocks(dev, block, buffers, nblocks, blksize, mode);
+	}
+	if(ide->drive[drive].flags & DEVICE_IS_CDROM) {
+		return ide_cd_rw_blocks(dev, block, buffers, nblocks, blksize, mode);
+	}
+	return -EINVAL;
+}
+
 int ide_ioctl(struct inode *i, int cmd, unsigned long int arg)
 {
 	int drive;
@@ -748,11 +910,46 @@ int ide_ioctl(struct inode *i, int cmd, unsigned long int arg)
 	return -EINVAL;
 }
 
+/* looks for a PCI IDE controller able to do the transfers by itself */
+static void ide_bm_init(void)
+{
+	struct pci_device *pci;
+	struct ide *ide;
+	unsigned int bm_base;
+	int n;
+
+	if(!(pci = pci_find_class(PCI_CLASS_STORAGE, PCI_SUBCLASS_IDE, NULL))) {
+		return;
+	}
+	if(!(pci->prog_if & IDE_PCI_BUS_MASTER) || !(pci->bar[4] & PCI_BAR_IO)) {
+		return;
+	}
+	if(!(bm_base = pci->bar[4] & PCI_BAR_IO_MASK)) {
+		return;
+	}
+	pci_enable_device(pci, PCI_COMMAND_IO | PCI_COMMAND_MASTER);
+
+	for(n = 0; n < NR_IDE_CTRLS; n++) {
+		ide = &ide_table[n];
+		/* a channel in native mode is not at the legacy addresses */
+		if(pci->prog_if & (IDE_PCI_NATIVE << (n * 2))) {
+			continue;
+		}
+		if(!(ide->prd_table = (struct ide_prd *)kmalloc())) {
+			printk("WARNING: %s(): unable to allocate the PRD table.\n", __FUNCTION__);
+			continue;
+		}
+		ide->bm_base = bm_base + (n * IDE_BM_CHANNEL_LEN);
+	}
+}
+
 void ide_init(void)
 {
 	int devices, errno;
 	struct ide *ide;
 
+	ide_bm_init();
+
 	if(!register_irq(IDE0_IRQ, &irq_config_ide0)) {
 		enable_irq(IDE0_IRQ);
 	}
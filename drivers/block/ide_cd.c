@@ -102,6 +102,8 @@ enum {
 	RS_RESERVED4
 };
 
+static struct ide_cd_ra ide_cd_ra[NR_IDE_CTRLS][NR_IDE_DRVS];
+
 static int send_packet_command(unsigned char *pkt, struct ide *ide, int drive, int blksize)
 {
 	int n, retries, status;
@@ -219,6 +221,87 @@ static int atapi_read_data(__dev_t dev, char *data, struct ide *ide, int blksize
 	return 0;
 }
 
+/*
+ * Reads a run of blocks with a single READ(10) packet. The drive interrupts
+ * each time it has a chunk of data ready (up to the byte count limit given
+ * to the PACKET command), and once more when the command completes.
+ */
+static int atapi_read_blocks(struct ide *ide, int drive, __blk_t block, char **buffers, int nblocks)
+{
+	unsigned char pkt[12];
+	int n, offset, bytes, count, status;
+	struct callout_req creq;
+
+	pkt[0] = ATAPI_READ10;
+	pkt[1] = NULL;
+	pkt[2] = (block >> 24) & 0xFF;
+	pkt[3] = (block >> 16) & 0xFF;
+	pkt[4] = (block >> 8) & 0xFF;
+	pkt[5] = block & 0xFF;
+	pkt[6] = NULL;
+	pkt[7] = (nblocks >> 8) & 0xFF;
+	pkt[8] = nblocks & 0xFF;
+	pkt[9] = NULL;
+	pkt[10] = NULL;
+	pkt[11] = NULL;
+
+	if(send_packet_command(pkt, ide, drive, IDE_CD_SECTSIZE * MIN(nblocks, IDE_CD_RA_BLOCKS))) {
+		return 1;
+	}
+
+	n = offset = 0;
+	ide_set_wait_interrupt(ide, &creq);
+	for(;;) {
+		if(ide_wait_interrupt(ide, &creq)) {
+			return 1;
+		}
+		status = inport_b(ide->base + IDE_STATUS);
+		if(status & IDE_STAT_ERR) {
+			return 1;
+		}
+		if(!(status & IDE_STAT_DRQ)) {
+			break;
+		}
+
+		/* the next interrupt comes once this chunk is transferred */
+		bytes = (inport_b(ide->base + IDE_HCYL) << 8) + inport_b(ide->base + IDE_LCYL);
+		ide_set_wait_interrupt(ide, &creq);
+		while(bytes > 0 && n < nblocks) {
+			count = MIN(bytes, IDE_CD_SECTSIZE - offset);
+			inport_sw(ide->base + IDE_DATA, (void *)(buffers[n] + offset), count / sizeof(short int));
+			bytes -= count;
+			if((offset += count) == IDE_CD_SECTSIZE) {
+				offset = 0;
+				n++;
+			}
+		}
+		for(; bytes > 0; bytes -= sizeof(short int)) {
+			inport_w(ide->base + IDE_DATA);
+		}
+	}
+	return n < nblocks;
+}
+
+static int read_blocks(__dev_t dev, struct ide *ide, int drive, __blk_t block, char **buffers, int nblocks)
+{
+	int errcode, sense_key;
+	int retries;
+
+	for(retries = 0; retries < MAX_CD_ERR; retries++) {
+		if(!atapi_read_blocks(ide, drive, block, buffers, nblocks)) {
+			return 0;
+		}
+		errcode = inport_b(ide->base + IDE_ERROR);
+		sense_key = (errcode & 0xF0) >> 4;
+		printk("WARNING: %s(): error on cdrom device %d,%d, status=0x%x error=0x%x,\n", __FUNCTION__, MAJOR(dev), MINOR(dev), inport_b(ide->base + IDE_STATUS), errcode);
+		printk("\tSense Key code indicates a '%s' condition.\n", sense_key_err[sense_key & 0xF]);
+		if(!sense_key) {
+			break;
+		}
+	}
+	return 1;
+}
+
 static int atapi_cmd_testunit(struct ide *ide, int drive)
 {
 	unsigned char pkt[12];
@@ -327,8 +410,9 @@ int ide_cd_open(struct inode *i, struct fd *fd_table)
 	char *buffer;
 	int errcode;
 	int sense_key, sense_asc;
-	int retries;
+	int retries, n, n2;
 	struct ide *ide;
+	struct ide_cd_ra *ra;
 
 	if(!(ide = get_ide_controller(i->rdev))) {
 		return -EINVAL;
@@ -388,6 +472,28 @@ int ide_cd_open(struct inode *i, struct fd *fd_table)
 	atapi_read_data(i->rdev, buffer, ide, BLKSIZE_2K, 0);
 	kfree((unsigned int)buffer);
 
+	/* the medium might have been changed */
+	ra = &ide_cd_ra[ide->channel][drive];
+	ra->count = 0;
+	if(!ra->buffers[0]) {
+		for(n = 0; n < IDE_CD_RA_BLOCKS; n += PAGE_SIZE / IDE_CD_SECTSIZE) {
+			if(!(buffer = (void *)kmalloc())) {
+				break;
+			}
+			for(n2 = 0; n2 < PAGE_SIZE / IDE_CD_SECTSIZE; n2++) {
+				ra->buffers[n + n2] = buffer + (n2 * IDE_CD_SECTSIZE);
+			}
+		}
+		if(n < IDE_CD_RA_BLOCKS) {
+			/* not enough memory, the drive is read without the window */
+			while(n > 0) {
+				n -= PAGE_SIZE / IDE_CD_SECTSIZE;
+				kfree((unsigned int)ra->buffers[n]);
+			}
+			ra->buffers[0] = NULL;
+		}
+	}
+
 	unlock_resource(&ide->resource);
 	return 0;
 }
@@ -410,6 +516,7 @@ int ide_cd_close(struct inode *i, struct fd *fd_table)
 
 	/* FIXME: only if device usage == 0 */
 	invalidate_buffers(i->rdev);
+	ide_cd_ra[ide->channel][drive].count = 0;
 
 	if(atapi_cmd_mediumrm(CD_UNLOCK_MEDIUM, ide, drive)) {
 		printk("WARNING: %s(): error on cdrom device %d,%d during 0x%x command.\n", __FUNCTION__, MAJOR(i->rdev), MINOR(i->rdev), ATAPI_MEDIUM_REMOVAL);
@@ -423,63 +530,65 @@ int ide_cd_close(struct inode *i, struct fd *fd_table)
 }
 
 int ide_cd_read(__dev_t dev, __blk_t block, char *buffer, int blksize)
+{
+	return ide_cd_rw_blocks(dev, block, &buffer, 1, BLKSIZE_2K, FOR_READING);
+}
+
+/*
+ * Reads a run of blocks from the drive, or from its read-ahead window. When
+ * the access is sequential the window is filled with the blocks that follow,
+ * so the next requests are served without sending a packet to the drive.
+ */
+int ide_cd_rw_blocks(__dev_t dev, __blk_t block, char **buffers, int nblocks, int blksize, int mode)
 {
 	int drive;
-	int sectors_to_read;
-	int n, retries;
-	unsigned char pkt[12];
+	int n, n2, count;
 	struct ide *ide;
+	struct ide_cd_ra *ra;
 
 	if(!(ide = get_ide_controller(dev))) {
 		return -EINVAL;
 	}
+	if(mode != FOR_READING) {
+		return -EROFS;
+	}
+	if(blksize != BLKSIZE_2K) {
+		return -EINVAL;
+	}
 
 	drive = get_ide_drive(dev);
-	blksize = BLKSIZE_2K;
-	sectors_to_read = blksize / IDE_CD_SECTSIZE;
-
-	pkt[0] = ATAPI_READ10;
-	pkt[1] = NULL;
-	pkt[2] = (block >> 24) & 0xFF;
-	pkt[3] = (block >> 16) & 0xFF;
-	pkt[4] = (block >> 8) & 0xFF;
-	pkt[5] = block & 0xFF;
-	pkt[6] = NULL;
-	pkt[7] = (sectors_to_read >> 8) & 0xFF;
-	pkt[8] = sectors_to_read & 0xFF;
-	pkt[9] = NULL;
-	pkt[10] = NULL;
-	pkt[11] = NULL;
+	ra = &ide_cd_ra[ide->channel][drive];
 
 	lock_resource(&ide->resource);
-	for(n = 0; n < sectors_to_read; n++, block++) {
-		for(retries = 0; retries < MAX_CD_ERR; retries++) {
-			if(send_packet_command(pkt, ide, drive, blksize)) {
-				printk("\tblock=%d, offset=%d\n", block, block * blksize);
-				unlock_resource(&ide->resource);
-				return -EIO;
+	for(n = 0; n < nblocks; n += count) {
+		if(ra->count && block + n >= ra->block && block + n < ra->block + ra->count) {
+			count = MIN(nblocks - n, ra->block + ra->count - (block + n));
+			for(n2 = 0; n2 < count; n2++) {
+				memcpy_b(buffers[n + n2], ra->buffers[block + n + n2 - ra->block], IDE_CD_SECTSIZE);
 			}
-			if(atapi_read_data(dev, buffer, ide, blksize, n * IDE_CD_SECTSIZE)) {
-				int errcode;
-				int sense_key;
-				errcode = inport_b(ide->base + IDE_ERROR);
-				sense_key = (errcode & 0xF0) >> 4;
-				printk("\tSense Key code indicates a '%s' condition.\n", sense_key_err[sense_key & 0xF]);
-				if(sense_key) {
-					continue;
-				}
+			ra->next = block + n + count;
+			continue;
+		}
+		if(ra->buffers[0] && block + n == ra->next && nblocks - n < IDE_CD_RA_BLOCKS) {
+			ra->count = 0;
+			if(!atapi_read_blocks(ide, drive, block + n, ra->buffers, IDE_CD_RA_BLOCKS)) {
+				ra->block = block + n;
+				ra->count = IDE_CD_RA_BLOCKS;
+				count = 0;
+				continue;
 			}
-			break;
+			/* probably beyond the end of the disc, read only what is asked */
 		}
-		if(retries == MAX_CD_ERR) {
-			printk("\tblock=%d, offset=%d\n", block, block * blksize);
+		count = nblocks - n;
+		if(read_blocks(dev, ide, drive, block + n, buffers + n, count)) {
+			printk("\tblock=%d, offset=%d\n", block + n, (block + n) * IDE_CD_SECTSIZE);
 			unlock_resource(&ide->resource);
 			return -EIO;
 		}
-
+		ra->next = block + n + count;
 	}
 	unlock_resource(&ide->resource);
-	return sectors_to_read * IDE_CD_SECTSIZE;
+	return nblocks * IDE_CD_SECTSIZE;
 }
 
 int ide_cd_ioctl(struct inode *i, int cmd, unsigned long int arg)
@@ -112,107 +112,114 @@ static void sector2chs(__off_t offset, int *cyl, int *head, int *sector, struct
 	*sector = (offset % ident->logic_spt) + 1;
 }
 
-int ide_hd_open(struct inode *i, struct fd *fd_table)
+/* sets the address of the first sector and selects the drive */
+static int select_sector(struct ide *ide, int drive, __off_t offset)
 {
-	return 0;
+	int cyl, head, sector;
+
+	if(ide->drive[drive].flags & DEVICE_REQUIRES_LBA) {
+		outport_b(ide->base + IDE_SECNUM, offset & 0xFF);
+		outport_b(ide->base + IDE_LCYL, (offset >> 8) & 0xFF);
+		outport_b(ide->base + IDE_HCYL, (offset >> 16) & 0xFF);
+		return ide_drvsel(ide, drive, IDE_LBA_MODE, (offset >> 24) & 0x0F);
+	}
+	sector2chs(offset, &cyl, &head, &sector, &ide->drive[drive].ident);
+	outport_b(ide->base + IDE_SECNUM, sector);
+	outport_b(ide->base + IDE_LCYL, cyl);
+	outport_b(ide->base + IDE_HCYL, (cyl >> 8));
+	return ide_drvsel(ide, drive, IDE_CHS_MODE, head);
 }
 
-int ide_hd_close(struct inode *i, struct fd *fd_table)
+/* moves 'count' sectors, starting at the sector 'n' of the scatter list */
+static void transfer_sectors(struct ide *ide, char **buffers, int spb, int n, int count, int mode)
 {
-	sync_buffers(i->rdev);
-	return 0;
+	char *buffer;
+	int chunk;
+
+	while(count) {
+		buffer = buffers[n / spb] + ((n % spb) * IDE_HD_SECTSIZE);
+		chunk = MIN(count, spb - (n % spb));
+		if(mode == FOR_READING) {
+			inport_sw(ide->base + IDE_DATA, (void *)buffer, (IDE_HD_SECTSIZE * chunk) / sizeof(short int));
+		} else {
+			outport_sw(ide->base + IDE_DATA, (void *)buffer, (IDE_HD_SECTSIZE * chunk) / sizeof(short int));
+		}
+		n += chunk;
+		count -= chunk;
+	}
 }
 
-int ide_hd_read(__dev_t dev, __blk_t block, char *buffer, int blksize)
+/*
+ * Transfers the sectors using the bus master of the controller, the CPU is
+ * free until the interrupt signals the end of the whole transfer. On error
+ * the DMA is disabled for the drive so the caller can retry using PIO.
+ */
+static int dma_transfer(struct ide *ide, int drive, __off_t offset, char **buffers, int nblocks, int spb, int mode)
 {
-	int minor;
-	int drive;
-	int sectors_to_read, cmd;
-	int n, status, r, retries;
-	int cyl, head, sector;
-	__off_t offset;
-	struct ide *ide;
-	struct ide_drv_ident *ident;
-	struct partition *part;
+	int status, bm_status, timeout;
 	struct callout_req creq;
 
-	if(!(ide = get_ide_controller(dev))) {
-		return -EINVAL;
+	ide_bm_setup(ide, buffers, nblocks, spb * IDE_HD_SECTSIZE, mode);
+	outport_b(ide->base + IDE_SECCNT, (nblocks * spb) & 0xFF);
+	if(select_sector(ide, drive, offset)) {
+		printk("WARNING: %s(): %s: drive not ready.\n", __FUNCTION__, ide->drive[drive].dev_name);
+		return -EIO;
 	}
 
-	minor = MINOR(dev);
-	if((drive = get_ide_drive(dev))) {
-		minor &= ~(1 << IDE_SLAVE_MSF);
+	ide_set_wait_interrupt(ide, &creq);
+	outport_b(ide->base + IDE_COMMAND, mode == FOR_READING ? ATA_READ_DMA : ATA_WRITE_DMA);
+	ide_bm_start(ide);
+	timeout = ide_wait_interrupt(ide, &creq);
+
+	bm_status = ide_bm_stop(ide);
+	status = inport_b(ide->base + IDE_STATUS);	/* clear any pending interrupt */
+	if(timeout || (bm_status & IDE_BM_STAT_ERR) || (status & (IDE_STAT_BSY | IDE_STAT_ERR | IDE_STAT_DWF))) {
+		printk("WARNING: %s(): %s: DMA %s error (status=0x%x, bm_status=0x%x), using PIO from now on.\n", __FUNCTION__, ide->drive[drive].dev_name, mode == FOR_READING ? "read" : "write", status, bm_status);
+		ide->drive[drive].flags &= ~DEVICE_HAS_DMA;
+		return -EIO;
 	}
+	return 0;
+}
 
-	SET_IDE_RDY_RETR(retries);
-
-	blksize = blksize ? blksize : BLKSIZE_1K;
-	sectors_to_read = MIN(blksize, PAGE_SIZE) / IDE_HD_SECTSIZE;
+/*
+ * Transfers the sectors using PIO with a single command. The drive raises
+ * an interrupt for each sector or, with READ/WRITE MULTIPLE, for each group
+ * of 'multiple' sectors.
+ */
+static int pio_transfer(struct ide *ide, int drive, __dev_t dev, __off_t offset, char **buffers, int nblocks, int spb, int mode)
+{
+	int n, count, sectors, multiple, cmd;
+	int status, r, retries;
+	struct callout_req creq;
 
-	ident = &ide->drive[drive].ident;
-	part = ide->drive[drive].part_table;
-	offset = block2sector(block, blksize, part, minor);
+	SET_IDE_RDY_RETR(retries);
 
-	lock_resource(&ide->resource);
+	sectors = nblocks * spb;
+	if(ide->drive[drive].flags & DEVICE_HAS_RW_MULTIPLE) {
+		multiple = ide->drive[drive].multiple;
+		cmd = mode == FOR_READING ? ATA_READ_MULTIPLE_PIO : ATA_WRITE_MULTIPLE_PIO;
+	} else {
+		multiple = 1;
+		cmd = mode == FOR_READING ? ATA_READ_PIO : ATA_WRITE_PIO;
+	}
 
-	n = 0;
+	outport_b(ide->base + IDE_SECCNT, sectors & 0xFF);
+	if(select_sector(ide, drive, offset)) {
+		printk("WARNING: %s(): %s: drive not ready.\n", __FUNCTION__, ide->drive[drive].dev_name);
+		return -EIO;
+	}
 
-	while(n < sectors_to_read) {
-		if(ide->drive[drive].flags & DEVICE_HAS_RW_MULTIPLE) {
-			outport_b(ide->base + IDE_SECCNT, sectors_to_read);
-			cmd = ATA_READ_MULTIPLE_PIO;
-		} else {
-			outport_b(ide->base + IDE_SECCNT, 1);
-			cmd = ATA_READ_PIO;
-		}
+	if(mode == FOR_READING) {
+		ide_set_wait_interrupt(ide, &creq);
+	}
+	outport_b(ide->base + IDE_COMMAND, cmd);
 
-		if(ide->drive[drive].flags & DEVICE_REQUIRES_LBA) {
-			outport_b(ide->base + IDE_SECNUM, offset & 0xFF);
-			outport_b(ide->base + IDE_LCYL, (offset >> 8) & 0xFF);
-			outport_b(ide->base + IDE_HCYL, (offset >> 16) & 0xFF);
-			if(ide_drvsel(ide, drive, IDE_LBA_MODE, (offset >> 24) & 0x0F)) {
-				printk("WARNING: %s(): %s: drive not ready.\n", __FUNCTION__, ide->drive[drive].dev_name);
-				unlock_resource(&ide->resource);
-				return -EIO;
-			}
-		} else {
-			sector2chs(offset, &cyl, &head, &sector, ident);
-			outport_b(ide->base + IDE_SECNUM, sector);
-			outport_b(ide->base + IDE_LCYL, cyl);
-			outport_b(ide->base + IDE_HCYL, (cyl >> 8));
-			if(ide_drvsel(ide, drive, IDE_CHS_MODE, head)) {
-				printk("WARNING: %s(): %s: drive not ready.\n", __FUNCTION__, ide->drive[drive].dev_name);
-				unlock_resource(&ide->resource);
-				return -EIO;
-			}
-		}
-		if(ide->channel == IDE_PRIMARY) {
-			ide0_wait_interrupt = ide->base;
-			creq.fn = ide0_timer;
-			creq.arg = 0;
-			add_callout(&creq, WAIT_FOR_IDE);
-			outport_b(ide->base + IDE_COMMAND, cmd);
-			if(ide0_wait_interrupt) {
-				sleep(&irq_ide0, PROC_UNINTERRUPTIBLE);
-			}
-			if(!ide0_timeout) {
-				del_callout(&creq);
-			}
-		}
-		if(ide->channel == IDE_SECONDARY) {
-			ide1_wait_interrupt = ide->base;
-			creq.fn = ide1_timer;
-			creq.arg = 0;
-			add_callout(&creq, WAIT_FOR_IDE);
-			outport_b(ide->base + IDE_COMMAND, cmd);
-			if(ide1_wait_interrupt) {
-				sleep(&irq_ide1, PROC_UNINTERRUPTIBLE);
-			}
-			if(!ide1_timeout) {
-				del_callout(&creq);
-			}
+	for(n = 0; n < sectors; n += count) {
+		count = MIN(multiple, sectors - n);
+		if(mode == FOR_READING) {
+			ide_wait_interrupt(ide, &creq);
 		}
+		status = 0;
 		for(r = 0; r < retries; r++) {
 			status = inport_b(ide->base + IDE_STATUS);
 			if(!(status & IDE_STAT_BSY) && (status & IDE_STAT_DRQ)) {
@@ -221,44 +228,62 @@ int ide_hd_read(__dev_t dev, __blk_t block, char *buffer, int blksize)
 			ide_delay();
 		}
 		if(status & IDE_STAT_ERR) {
-			printk("WARNING: %s(): %s: error on hard disk dev %d,%d during read.\n", __FUNCTION__, ide->drive[drive].dev_name, MAJOR(dev), MINOR(dev));
+			printk("WARNING: %s(): %s: error on hard disk dev %d,%d during %s.\n", __FUNCTION__, ide->drive[drive].dev_name, MAJOR(dev), MINOR(dev), mode == FOR_READING ? "read" : "write");
 			printk("\tstatus=0x%x ", status);
 			ide_error(ide, status);
-			printk("\tblock %d, sector %d.\n", block, offset);
+			printk("\tsector %d.\n", offset + n);
 			inport_b(ide->base + IDE_STATUS);	/* clear any pending interrupt */
-			unlock_resource(&ide->resource);
 			return -EIO;
 		}
 
-		if(cmd == ATA_READ_MULTIPLE_PIO) {
-			inport_sw(ide->base + IDE_DATA, (void *)buffer, (IDE_HD_SECTSIZE * sectors_to_read) / sizeof(short int));
-			break;
+		/* the next interrupt comes once these sectors are transferred */
+		if(mode == FOR_WRITING || n + count < sectors) {
+			ide_set_wait_interrupt(ide, &creq);
+		}
+		transfer_sectors(ide, buffers, spb, n, count, mode);
+		if(mode == FOR_WRITING) {
+			ide_wait_interrupt(ide, &creq);
 		}
-		inport_sw(ide->base + IDE_DATA, (void *)buffer, IDE_HD_SECTSIZE / sizeof(short int));
-		inport_b(ide->ctrl + IDE_ALT_STATUS);	/* ignore results */
-		inport_b(ide->base + IDE_STATUS);	/* clear any pending interrupt */
-		n++;
-		offset++;
-		buffer += IDE_HD_SECTSIZE;
 	}
 	inport_b(ide->ctrl + IDE_ALT_STATUS);	/* ignore results */
 	inport_b(ide->base + IDE_STATUS);	/* clear any pending interrupt */
-	unlock_resource(&ide->resource);
-	return sectors_to_read * IDE_HD_SECTSIZE;
+	return 0;
+}
+
+int ide_hd_open(struct inode *i, struct fd *fd_table)
+{
+	return 0;
+}
+
+int ide_hd_close(struct inode *i, struct fd *fd_table)
+{
+	sync_buffers(i->rdev);
+	return 0;
+}
+
+int ide_hd_read(__dev_t dev, __blk_t block, char *buffer, int blksize)
+{
+	return ide_hd_rw_blocks(dev, block, &buffer, 1, blksize, FOR_READING);
 }
 
 int ide_hd_write(__dev_t dev, __blk_t block, char *buffer, int blksize)
+{
+	return ide_hd_rw_blocks(dev, block, &buffer, 1, blksize, FOR_WRITING);
+}
+
+/*
+ * Transfers a run of consecutive blocks from or to a scatter list of buffers,
+ * issuing a command for every IDE_MAX_SECTORS sectors instead of one for each
+ * block.
+ */
+int ide_hd_rw_blocks(__dev_t dev, __blk_t block, char **buffers, int nblocks, int blksize, int mode)
 {
 	int minor;
 	int drive;
-	int sectors_to_write, cmd;
-	int n, status, r, retries;
-	int cyl, head, sector;
+	int n, count, spb, errno;
 	__off_t offset;
 	struct ide *ide;
-	struct ide_drv_ident *ident;
 	struct partition *part;
-	struct callout_req creq;
 
 	if(!(ide = get_ide_controller(dev))) {
 		return -EINVAL;
@@ -269,109 +294,32 @@ int ide_hd_write(__dev_t dev, __blk_t block, char *buffer, int blksize)
 		minor &= ~(1 << IDE_SLAVE_MSF);
 	}
 
-	SET_IDE_RDY_RETR(retries);
-
 	blksize = blksize ? blksize : BLKSIZE_1K;
-	sectors_to_write = MIN(blksize, PAGE_SIZE) / IDE_HD_SECTSIZE;
+	spb = MIN(blksize, PAGE_SIZE) / IDE_HD_SECTSIZE;
 
-	ident = &ide->drive[drive].ident;
 	part = ide->drive[drive].part_table;
 	offset = block2sector(block, blksize, part, minor);
 
 	lock_resource(&ide->resource);
 
-	n = 0;
-
-	while(n < sectors_to_write) {
-		if(ide->drive[drive].flags & DEVICE_HAS_RW_MULTIPLE) {
-			outport_b(ide->base + IDE_SECCNT, sectors_to_write);
-			cmd = ATA_WRITE_MULTIPLE_PIO;
-		} else {
-			outport_b(ide->base + IDE_SECCNT, 1);
-			cmd = ATA_WRITE_PIO;
+	for(n = 0; n < nblocks; n += count) {
+		count = MIN(nblocks - n, IDE_MAX_SECTORS / spb);
+		errno = -EIO;
+		if(ide->drive[drive].flags & DEVICE_HAS_DMA) {
+			errno = dma_transfer(ide, drive, offset, buffers + n, count, spb, mode);
 		}
-
-		if(ide->drive[drive].flags & DEVICE_REQUIRES_LBA) {
-			outport_b(ide->base + IDE_SECNUM, offset & 0xFF);
-			outport_b(ide->base + IDE_LCYL, (offset >> 8) & 0xFF);
-			outport_b(ide->base + IDE_HCYL, (offset >> 16) & 0xFF);
-			if(ide_drvsel(ide, drive, IDE_LBA_MODE, (offset >> 24) & 0x0F)) {
-				printk("WARNING: %s(): %s: drive not ready.\n", __FUNCTION__, ide->drive[drive].dev_name);
-				unlock_resource(&ide->resource);
-				return -EIO;
-			}
-		} else {
-			sector2chs(offset, &cyl, &head, &sector, ident);
-			outport_b(ide->base + IDE_SECNUM, sector);
-			outport_b(ide->base + IDE_LCYL, cyl);
-			outport_b(ide->base + IDE_HCYL, (cyl >> 8));
-			if(ide_drvsel(ide, drive, IDE_CHS_MODE, head)) {
-				printk("WARNING: %s(): %s: drive not ready.\n", __FUNCTION__, ide->drive[drive].dev_name);
+		if(errno < 0) {
+			if((errno = pio_transfer(ide, drive, dev, offset, buffers + n, count, spb, mode)) < 0) {
+				printk("\tblock %d.\n", block + n);
 				unlock_resource(&ide->resource);
-				return -EIO;
-			}
-		}
-		outport_b(ide->base + IDE_COMMAND, cmd);
-		for(r = 0; r < retries; r++) {
-			status = inport_b(ide->base + IDE_STATUS);
-			if(!(status & IDE_STAT_BSY) && (status & IDE_STAT_DRQ)) {
-				break;
-			}
-			ide_delay();
-		}
-		if(status & IDE_STAT_ERR) {
-			printk("WARNING: %s(): %s: error on hard disk dev %d,%d during write.\n", __FUNCTION__, ide->drive[drive].dev_name, MAJOR(dev), MINOR(dev));
-			printk("\tstatus=0x%x ", status);
-			ide_error(ide, status);
-			printk("\tblock %d, sector %d.\n", block, offset);
-			inport_b(ide->base + IDE_STATUS);	/* clear any pending interrupt */
-			unlock_resource(&ide->resource);
-			return -EIO;
-		}
-
-		if(cmd == ATA_WRITE_MULTIPLE_PIO) {
-			outport_sw(ide->base + IDE_DATA, (void *)buffer, (IDE_HD_SECTSIZE * sectors_to_write) / sizeof(short int));
-		} else {
-			outport_sw(ide->base + IDE_DATA, (void *)buffer, IDE_HD_SECTSIZE / sizeof(short int));
-		}
-		if(ide->channel == IDE_PRIMARY) {
-			ide0_wait_interrupt = ide->base;
-			creq.fn = ide0_timer;
-			creq.arg = 0;
-			add_callout(&creq, WAIT_FOR_IDE);
-			if(ide0_wait_interrupt) {
-				sleep(&irq_ide0, PROC_UNINTERRUPTIBLE);
-			}
-			if(!ide0_timeout) {
-				del_callout(&creq);
-			}
-		}
-		if(ide->channel == IDE_SECONDARY) {
-			ide1_wait_interrupt = ide->base;
-			creq.fn = ide1_timer;
-			creq.arg = 0;
-			add_callout(&creq, WAIT_FOR_IDE);
-			if(ide1_wait_interrupt) {
-				sleep(&irq_ide1, PROC_UNINTERRUPTIBLE);
-			}
-			if(!ide1_timeout) {
-				del_callout(&creq);
+				return errno;
 			}
 		}
-
-		inport_b(ide->ctrl + IDE_ALT_STATUS);	/* ignore results */
-		inport_b(ide->base + IDE_STATUS);	/* clear any pending interrupt */
-		if(cmd == ATA_WRITE_MULTIPLE_PIO) {
-			break;
-		}
-		n++;
-		offset++;
-		buffer += IDE_HD_SECTSIZE;
+		offset += count * spb;
 	}
-	inport_b(ide->ctrl + IDE_ALT_STATUS);	/* ignore results */
-	inport_b(ide->base + IDE_STATUS);	/* clear any pending interrupt */
+
 	unlock_resource(&ide->resource);
-	return sectors_to_write * IDE_HD_SECTSIZE;
+	return nblocks * spb * IDE_HD_SECTSIZE;
 }
 
 int ide_hd_ioctl(struct inode *i, int cmd, unsigned long int arg)
@@ -501,11 +449,16 @@ int ide_hd_init(struct ide *ide, int drive)
 
 	outport_b(ide->ctrl + IDE_DEV_CTRL, IDE_DEVCTR_NIEN);
 	if(ide->drive[drive].flags & DEVICE_HAS_RW_MULTIPLE) {
-		/* read/write in 4KB blocks (8 sectors) by default */
-		outport_b(ide->base + IDE_SECCNT, PAGE_SIZE / IDE_HD_SECTSIZE);
+		/* use the largest number of sectors per interrupt of the drive */
+		ide->drive[drive].multiple = ide->drive[drive].ident.rw_multiple;
+		ide_drvsel(ide, drive, IDE_CHS_MODE, 0);
+		outport_b(ide->base + IDE_SECCNT, ide->drive[drive].multiple);
 		outport_b(ide->base + IDE_COMMAND, ATA_SET_MULTIPLE_MODE);
 		ide_wait400ns(ide);
 		while(inport_b(ide->base + IDE_STATUS) & IDE_STAT_BSY);
+		if(inport_b(ide->base + IDE_STATUS) & IDE_STAT_ERR) {
+			ide->drive[drive].flags &= ~DEVICE_HAS_RW_MULTIPLE;
+		}
 	}
 	outport_b(ide->ctrl + IDE_DEV_CTRL, IDE_DEVCTR_DRQ);
 
@@ -0,0 +1,404 @@
+/*
+ * fiwix/drivers/block/loop.c
+ *
+ * Copyright 2021, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#include <fiwix/kernel.h>
+#include <fiwix/loop.h>
+#include <fiwix/ioctl.h>
+#include <fiwix/devices.h>
+#include <fiwix/buffer.h>
+#include <fiwix/diskstats.h>
+#include <fiwix/fs.h>
+#include <fiwix/fcntl.h>
+#include <fiwix/stat.h>
+#include <fiwix/process.h>
+#include <fiwix/sched.h>
+#include <fiwix/errno.h>
+#include <fiwix/mm.h>
+#include <fiwix/stdio.h>
+#include <fiwix/string.h>
+
+/*
+ * The loop device makes a regular file accessible as a block device, so a
+ * filesystem image can be mounted in place. The blocks of the file are
+ * located with bmap() and transferred directly from or to the device that
+ * holds the file, without being cached twice. The buffers of that device
+ * that are already in the cache are used instead to stay coherent with it.
+ */
+
+static struct loop loop_table[LOOP_MINORS];
+static unsigned int loop_sizes[256];
+
+static struct fs_operations loop_driver_fsop = {
+	0,
+	0,
+
+	loop_open,
+	loop_close,
+	NULL,			/* read */
+	NULL,			/* write */
+	loop_ioctl,
+	loop_lseek,
+	NULL,			/* readdir */
+	NULL,			/* mmap */
+	NULL,			/* select */
+
+	NULL,			/* readlink */
+	NULL,			/* followlink */
+	NULL,			/* bmap */
+	NULL,			/* lockup */
+	NULL,			/* rmdir */
+	NULL,			/* link */
+	NULL,			/* unlink */
+	NULL,			/* symlink */
+	NULL,			/* mkdir */
+	NULL,			/* mknod */
+	NULL,			/* truncate */
+	NULL,			/* create */
+	NULL,			/* rename */
+
+	loop_read,
+	loop_write,
+
+	NULL,			/* read_inode */
+	NULL,			/* write_inode */
+	NULL,			/* ialloc */
+	NULL,			/* ifree */
+	NULL,			/* statfs */
+	NULL,			/* read_superblock */
+	NULL,			/* remount_fs */
+	NULL,			/* write_superblock */
+	NULL			/* release_superblock */
+};
+
+static struct device loop_device = {
+	"loop",
+	LOOP_MAJOR,
+	{ 0, 0, 0, 0, 0, 0, 0, 0 },
+	BLKSIZE_1K,
+	&loop_sizes,
+	&loop_driver_fsop,
+	NULL,
+	NULL,
+	NULL
+};
+
+static struct loop * get_loop(int minor)
+{
+	if(TEST_MINOR(loop_device.minors, minor)) {
+		return &loop_table[minor];
+	}
+	return NULL;
+}
+
+/* used when the filesystem of the backing file has no bmap() method */
+static int file_transfer(struct inode *i, __off_t offset, char *buffer, int count, int mode)
+{
+	struct fd fd_table;
+
+	fd_table.inode = i;
+	fd_table.flags = 0;
+	fd_table.count = 0;
+	fd_table.offset = offset;
+	if(mode == FOR_READING) {
+		if(i->fsop && i->fsop->read) {
+			return i->fsop->read(i, &fd_table, buffer, count);
+		}
+	} else {
+		if(i->fsop && i->fsop->write) {
+			return i->fsop->write(i, &fd_table, buffer, count);
+		}
+	}
+	return -EIO;
+}
+
+/* transfers 'count' bytes located at 'offset' in the backing file */
+static int loop_transfer(struct inode *i, __off_t offset, char *buffer, int count, int mode)
+{
+	struct device *d;
+	struct buffer *buf;
+	char *tmp;
+	int block, blksize, boffset, bytes, total, errno;
+
+	if(!i->fsop || !i->fsop->bmap) {
+		return file_transfer(i, offset, buffer, count, mode);
+	}
+	if(!(d = get_device(BLK_DEV, i->dev)) || !d->fsop) {
+		return -ENXIO;
+	}
+	if(!d->fsop->read_block || (mode == FOR_WRITING && !d->fsop->write_block)) {
+		return -EIO;
+	}
+
+	blksize = i->sb->s_blocksize;
+	tmp = NULL;
+	total = errno = 0;
+	while(total < count) {
+		boffset = offset % blksize;
+		bytes = MIN(blksize - boffset, count - total);
+		if((block = bmap(i, offset, mode)) < 0) {
+			errno = block;
+			break;
+		}
+		if(!block) {
+			if(mode == FOR_WRITING) {
+				errno = -EIO;
+				break;
+			}
+			/* a hole in the file */
+			memset_b(buffer + total, NULL, bytes);
+		} else if((buf = get_cached_buffer(i->dev, block, blksize))) {
+			if(mode == FOR_READING) {
+				memcpy_b(buffer + total, buf->data + boffset, bytes);
+				brelse(buf);
+			} else {
+				memcpy_b(buf->data + boffset, buffer + total, bytes);
+				bwrite(buf);
+			}
+		} else if(!boffset && bytes == blksize) {
+			if((errno = disk_transfer(d, i->dev, block, buffer + total, blksize, mode)) < 0) {
+				break;
+			}
+		} else {
+			/* partial blocks need a read-modify-write */
+			if(!tmp && !(tmp = (char *)kmalloc())) {
+				errno = -ENOMEM;
+				break;
+			}
+			if((errno = disk_transfer(d, i->dev, block, tmp, blksize, FOR_READING)) < 0) {
+				break;
+			}
+			if(mode == FOR_READING) {
+				memcpy_b(buffer + total, tmp + boffset, bytes);
+			} else {
+				memcpy_b(tmp + boffset, buffer + total, bytes);
+				if((errno = disk_transfer(d, i->dev, block, tmp, blksize, FOR_WRITING)) < 0) {
+					break;
+				}
+			}
+		}
+		if(mode == FOR_WRITING) {
+			update_page_cache(i, offset, buffer + total, bytes);
+		}
+		errno = 0;
+		total += bytes;
+		offset += bytes;
+	}
+
+	if(tmp) {
+		kfree((unsigned int)tmp);
+	}
+	return errno < 0 ? errno : total;
+}
+
+static void set_size(int minor)
+{
+	struct loop *lo;
+
+	lo = &loop_table[minor];
+	loop_sizes[minor] = 0;
+	if(lo->inode && lo->inode->i_size > lo->offset) {
+		loop_sizes[minor] = (lo->inode->i_size - lo->offset) / 1024;
+	}
+}
+
+int loop_open(struct inode *i, struct fd *fd_table)
+{
+	struct loop *lo;
+
+	if(!(lo = get_loop(MINOR(i->rdev)))) {
+		return -ENXIO;
+	}
+	lo->count++;
+	return 0;
+}
+
+int loop_close(struct inode *i, struct fd *fd_table)
+{
+	struct loop *lo;
+
+	if(!(lo = get_loop(MINOR(i->rdev)))) {
+		return -ENXIO;
+	}
+	if(lo->count) {
+		lo->count--;
+	}
+	return 0;
+}
+
+int loop_read(__dev_t dev, __blk_t block, char *buffer, int blksize)
+{
+	__off_t offset, size;
+	struct loop *lo;
+	int errno;
+
+	if(!(lo = get_loop(MINOR(dev))) || !lo->inode) {
+		return -ENXIO;
+	}
+
+	size = loop_sizes[MINOR(dev)] * 1024;
+	offset = block * blksize;
+	if(offset >= size) {
+		printk("%s(): block %d is beyond the size of the loop device.\n", __FUNCTION__, block);
+		return -EIO;
+	}
+	if(size - offset < blksize) {
+		/* the end of the file doesn't fill the last block */
+		memset_b(buffer, NULL, blksize);
+		blksize = size - offset;
+	}
+	if((errno = loop_transfer(lo->inode, lo->offset + offset, buffer, blksize, FOR_READING)) < 0) {
+		return errno;
+	}
+	return blksize;
+}
+
+int loop_write(__dev_t dev, __blk_t block, char *buffer, int blksize)
+{
+	__off_t offset, size;
+	struct loop *lo;
+	int errno;
+
+	if(!(lo = get_loop(MINOR(dev))) || !lo->inode) {
+		return -ENXIO;
+	}
+	if(lo->flags & LO_FLAGS_READ_ONLY) {
+		return -EROFS;
+	}
+
+	size = loop_sizes[MINOR(dev)] * 1024;
+	offset = block * blksize;
+	if(offset >= size) {
+		printk("%s(): block %d is beyond the size of the loop device.\n", __FUNCTION__, block);
+		return -EIO;
+	}
+	blksize = MIN(blksize, size - offset);
+	if((errno = loop_transfer(lo->inode, lo->offset + offset, buffer, blksize, FOR_WRITING)) < 0) {
+		return errno;
+	}
+	return blksize;
+}
+
+int loop_ioctl(struct inode *i, int cmd, unsigned long int arg)
+{
+	struct loop *lo;
+	struct loop_info *info;
+	struct inode *file;
+	struct fd *fd;
+	int minor, errno;
+
+	minor = MINOR(i->rdev);
+	if(!(lo = get_loop(minor))) {
+		return -ENXIO;
+	}
+
+	switch(cmd) {
+		case LOOP_SET_FD:
+			if(arg >= OPEN_MAX || !current->fd[arg]) {
+				return -EBADF;
+			}
+			if(lo->inode) {
+				return -EBUSY;
+			}
+			fd = &fd_table[current->fd[arg]];
+			file = fd->inode;
+			if(!S_ISREG(file->i_mode)) {
+				return -EINVAL;
+			}
+			lo->flags = 0;
+			if((fd->flags & O_ACCMODE) == O_RDONLY || IS_RDONLY_FS(file)) {
+				lo->flags = LO_FLAGS_READ_ONLY;
+			}
+			lo->offset = 0;
+			lo->name[0] = NULL;
+			lo->inode = file;
+			file->count++;
+			set_size(minor);
+			invalidate_buffers(i->rdev);
+			break;
+		case LOOP_CLR_FD:
+			if(!lo->inode) {
+				return -ENXIO;
+			}
+			/* it must not be mounted nor opened by anyone else */
+			if(lo->count > 1) {
+				return -EBUSY;
+			}
+			sync_buffers(i->rdev);
+			invalidate_buffers(i->rdev);
+			iput(lo->inode);
+			lo->inode = NULL;
+			set_size(minor);
+			break;
+		case LOOP_SET_STATUS:
+			if(!lo->inode) {
+				return -ENXIO;
+			}
+			if((errno = check_user_area(VERIFY_READ, (void *)arg, sizeof(struct loop_info)))) {
+				return errno;
+			}
+			info = (struct loop_info *)arg;
+			if(info->lo_offset < 0 || info->lo_offset > lo->inode->i_size) {
+				return -EINVAL;
+			}
+			if(info->lo_encrypt_type) {
+				return -EINVAL;
+			}
+			sync_buffers(i->rdev);
+			invalidate_buffers(i->rdev);
+			lo->offset = info->lo_offset;
+			memcpy_b(lo->name, info->lo_name, LO_NAME_SIZE);
+			lo->name[LO_NAME_SIZE - 1] = NULL;
+			set_size(minor);
+			break;
+		case LOOP_GET_STATUS:
+			if(!lo->inode) {
+				return -ENXIO;
+			}
+			if((errno = check_user_area(VERIFY_WRITE, (void *)arg, sizeof(struct loop_info)))) {
+				return errno;
+			}
+			info = (struct loop_info *)arg;
+			memset_b(info, NULL, sizeof(struct loop_info));
+			info->lo_number = minor;
+			info->lo_device = lo->inode->dev;
+			info->lo_inode = lo->inode->inode;
+			info->lo_rdevice = lo->inode->rdev;
+			info->lo_offset = lo->offset;
+			info->lo_flags = lo->flags;
+			memcpy_b(info->lo_name, lo->name, LO_NAME_SIZE);
+			break;
+		case BLKGETSIZE:
+			if((errno = check_user_area(VERIFY_WRITE, (void *)arg, sizeof(unsigned int)))) {
+				return errno;
+			}
+			*(int *)arg = loop_sizes[minor] * 2;
+			break;
+		case BLKFLSBUF:
+			sync_buffers(i->rdev);
+			invalidate_buffers(i->rdev);
+			break;
+		default:
+			return -EINVAL;
+	}
+	return 0;
+}
+
+int loop_lseek(struct inode *i, __off_t offset)
+{
+	return offset;
+}
+
+void loop_init(void)
+{
+	int n;
+
+	for(n = 0; n < LOOP_MINORS; n++) {
+		SET_MINOR(loop_device.minors, n);
+	}
+	memset_b(loop_table, NULL, sizeof(loop_table));
+	register_device(BLK_DEV, &loop_device);
+}
@@ -5,9 +5,9 @@
  * Distributed under the terms of the Fiwix License.
  */
 
-#include <fiwix/ide.h>
-#include <fiwix/ide_hd.h>
 #include <fiwix/fs.h>
+#include <fiwix/devices.h>
+#include <fiwix/diskstats.h>
 #include <fiwix/part.h>
 #include <fiwix/mm.h>
 #include <fiwix/errno.h>
@@ -16,13 +16,17 @@
 
 int read_msdos_partition(__dev_t dev, struct partition *part)
 {
+	struct device *d;
 	char *buffer;
 
+	if(!(d = get_device(BLK_DEV, dev)) || !d->fsop || !d->fsop->read_block) {
+		return -ENXIO;
+	}
 	if(!(buffer = (void *)kmalloc())) {
 		return -ENOMEM;
 	}
 
-	if(ide_hd_read(dev, PARTITION_BLOCK, buffer, BLKSIZE_1K) <= 0) {
+	if(disk_transfer(d, dev, PARTITION_BLOCK, buffer, BLKSIZE_1K, FOR_READING) <= 0) {
 		printk("WARNING: %s(): unable to read partition block in device %d,%d.\n", __FUNCTION__, MAJOR(dev), MINOR(dev));
 		kfree((unsigned int)buffer);
 		return -EIO;
@@ -68,6 +68,8 @@ static struct device ramdisk_device = {
 	BLKSIZE_1K,
 	&rd_sizes,
 	&ramdisk_driver_fsop,
+	NULL,
+	ramdisk_map_block,
 	NULL
 };
 
@@ -137,6 +139,26 @@ int ramdisk_write(__dev_t dev, __blk_t block, char *buffer, int blksize)
 	return blksize;
 }
 
+/*
+ * Returns the address of the block in the ramdisk, so the buffer cache can
+ * use it directly instead of keeping a copy of it.
+ */
+char * ramdisk_map_block(__dev_t dev, __blk_t block, int blksize)
+{
+	__off_t offset;
+	struct ramdisk *ramdisk;
+
+	if(!(ramdisk = get_ramdisk(MINOR(dev)))) {
+		return NULL;
+	}
+
+	offset = block * blksize;
+	if(offset + blksize > rd_sizes[MINOR(dev)] * 1024) {
+		return NULL;
+	}
+	return ramdisk->addr + offset;
+}
+
 int ramdisk_ioctl(struct inode *i, int cmd, unsigned long int arg)
 {
 	struct hd_geometry *geom;
@@ -0,0 +1,491 @@
+/*
+ * fiwix/drivers/block/virtio_blk.c
+ *
+ * Copyright 2021, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#include <fiwix/asm.h>
+#include <fiwix/kernel.h>
+#include <fiwix/virtio_blk.h>
+#include <fiwix/buffer.h>
+#include <fiwix/ioctl.h>
+#include <fiwix/devices.h>
+#include <fiwix/sleep.h>
+#include <fiwix/sched.h>
+#include <fiwix/fs.h>
+#include <fiwix/part.h>
+#include <fiwix/process.h>
+#include <fiwix/mm.h>
+#include <fiwix/errno.h>
+#include <fiwix/stdio.h>
+#include <fiwix/string.h>
+
+/*
+ * Paravirtual disks of QEMU/KVM through the legacy virtio PCI transport.
+ * A request is a chain of descriptors (header, data buffers and status)
+ * placed in the only queue of the device. A run of blocks from the buffer
+ * cache goes in a single request, with the buffers that are contiguous in
+ * memory merged in the same descriptor. All the requests of a run are made
+ * available before notifying the device once, and the interrupt handler
+ * completes all the requests found in the used ring, so a single exit to
+ * the host serves many blocks in both directions.
+ */
+
+static struct virtio_blk virtio_blk_table[NR_VIRTIO_BLK];
+static int virtio_blk_ndisks = 0;
+static unsigned int virtio_blk_sizes[256];
+
+/* the legacy transport needs the queues physically contiguous */
+static char virtio_blk_queues[NR_VIRTIO_BLK][VRING_SIZE(VIRTIO_BLK_QUEUE_MAX)] __attribute__((aligned(VIRTIO_QUEUE_ALIGN)));
+
+static struct fs_operations virtio_blk_driver_fsop = {
+	0,
+	0,
+
+	virtio_blk_open,
+	virtio_blk_close,
+	NULL,			/* read */
+	NULL,			/* write */
+	virtio_blk_ioctl,
+	NULL,			/* lseek */
+	NULL,			/* readdir */
+	NULL,			/* mmap */
+	NULL,			/* select */
+
+	NULL,			/* readlink */
+	NULL,			/* followlink */
+	NULL,			/* bmap */
+	NULL,			/* lockup */
+	NULL,			/* rmdir */
+	NULL,			/* link */
+	NULL,			/* unlink */
+	NULL,			/* symlink */
+	NULL,			/* mkdir */
+	NULL,			/* mknod */
+	NULL,			/* truncate */
+	NULL,			/* create */
+	NULL,			/* rename */
+
+	virtio_blk_read,
+	virtio_blk_write,
+
+	NULL,			/* read_inode */
+	NULL,			/* write_inode */
+	NULL,			/* ialloc */
+	NULL,			/* ifree */
+	NULL,			/* statfs */
+	NULL,			/* read_superblock */
+	NULL,			/* remount_fs */
+	NULL,			/* write_superblock */
+	NULL			/* release_superblock */
+};
+
+static struct device virtio_blk_device = {
+	"vd",
+	VIRTIO_BLK_MAJOR,
+	{ 0, 0, 0, 0, 0, 0, 0, 0 },
+	BLKSIZE_1K,
+	&virtio_blk_sizes,
+	&virtio_blk_driver_fsop,
+	virtio_blk_rw_blocks,
+	NULL,
+	NULL
+};
+
+static struct virtio_blk * get_virtio_blk(__dev_t dev)
+{
+	int n;
+
+	n = MINOR(dev) / VIRTIO_BLK_MINORS;
+	if(n < virtio_blk_ndisks && TEST_MINOR(virtio_blk_device.minors, MINOR(dev))) {
+		return &virtio_blk_table[n];
+	}
+	return NULL;
+}
+
+static unsigned int get_part_size(struct virtio_blk *vb, int minor)
+{
+	if(minor) {
+		return vb->part_table[minor - 1].nr_sects;
+	}
+	return vb->nr_sects;
+}
+
+static void assign_minors(struct virtio_blk *vb)
+{
+	int n, minor;
+
+	for(n = 0; n < NR_PARTITIONS; n++) {
+		minor = ((vb - virtio_blk_table) * VIRTIO_BLK_MINORS) + n + 1;
+		CLEAR_MINOR(virtio_blk_device.minors, minor);
+		if(vb->part_table[n].type) {
+			SET_MINOR(virtio_blk_device.minors, minor);
+			virtio_blk_sizes[minor] = vb->part_table[n].nr_sects / 2;
+		}
+	}
+}
+
+/* returns the chain of descriptors to the free list */
+static void free_chain(struct virtio_blk *vb, int head)
+{
+	int n;
+
+	for(n = head; vb->desc[n].flags & VRING_DESC_F_NEXT; n = vb->desc[n].next) {
+		vb->nfree++;
+	}
+	vb->desc[n].next = vb->free_head;
+	vb->free_head = head;
+	vb->nfree++;
+}
+
+/*
+ * Builds the chain of descriptors of a request and makes it available to
+ * the device, which is not notified yet. Returns the head of the chain, or
+ * -1 if there are not enough free descriptors and 'wait' is not set.
+ */
+static int add_request(struct virtio_blk *vb, int type, unsigned int sector, char **buffers, int nbuffers, int size, int wait)
+{
+	unsigned long int flags;
+	volatile struct vring_desc *d;
+	int head, n;
+
+	SAVE_FLAGS(flags); CLI();
+	while(vb->nfree < nbuffers + 2) {
+		if(!wait) {
+			RESTORE_FLAGS(flags);
+			return -1;
+		}
+		sleep(&vb->nfree, PROC_UNINTERRUPTIBLE);
+	}
+
+	head = vb->free_head;
+	vb->req[head].hdr.type = type;
+	vb->req[head].hdr.ioprio = 0;
+	vb->req[head].hdr.sector = sector;
+	vb->req[head].status = VIRTIO_BLK_S_IOERR;
+	vb->req[head].done = 0;
+	d = &vb->desc[head];
+	d->addr = V2P((unsigned int)&vb->req[head].hdr);
+	d->len = sizeof(struct virtio_blk_outhdr);
+	d->flags = VRING_DESC_F_NEXT;
+	vb->nfree--;
+
+	for(n = 0; n < nbuffers; n++) {
+		/* buffers contiguous in memory share the same descriptor */
+		if(n && d->addr + d->len == V2P((unsigned int)buffers[n])) {
+			d->len += size;
+			continue;
+		}
+		d = &vb->desc[d->next];
+		d->addr = V2P((unsigned int)buffers[n]);
+		d->len = size;
+		d->flags = VRING_DESC_F_NEXT;
+		if(type == VIRTIO_BLK_T_IN) {
+			d->flags |= VRING_DESC_F_WRITE;
+		}
+		vb->nfree--;
+	}
+
+	d = &vb->desc[d->next];
+	d->addr = V2P((unsigned int)&vb->req[head].status);
+	d->len = sizeof(unsigned char);
+	d->flags = VRING_DESC_F_WRITE;
+	vb->free_head = d->next;
+	vb->nfree--;
+
+	vb->avail->ring[vb->avail->idx % vb->num] = head;
+	vb->avail->idx++;
+	RESTORE_FLAGS(flags);
+	return head;
+}
+
+static void notify(struct virtio_blk *vb)
+{
+	if(!(vb->used->flags & VRING_USED_F_NO_NOTIFY)) {
+		outport_w(vb->base + VIRTIO_PCI_QUEUE_NOTIFY, 0);
+	}
+}
+
+/* returns 0 if the request completed successfully */
+static int wait_request(struct virtio_blk *vb, int head)
+{
+	unsigned long int flags;
+	int status;
+
+	SAVE_FLAGS(flags); CLI();
+	while(!vb->req[head].done) {
+		sleep(&vb->req[head], PROC_UNINTERRUPTIBLE);
+	}
+	status = vb->req[head].status;
+	free_chain(vb, head);
+	RESTORE_FLAGS(flags);
+	wakeup(&vb->nfree);
+	return status;
+}
+
+void irq_virtio_blk(int num, struct sigcontext *sc)
+{
+	struct virtio_blk *vb;
+	int head;
+
+	for(vb = &virtio_blk_table[0]; vb < &virtio_blk_table[virtio_blk_ndisks]; vb++) {
+		if(vb->pci->irq != num || !(inport_b(vb->base + VIRTIO_PCI_ISR) & VIRTIO_ISR_QUEUE)) {
+			continue;
+		}
+		while(vb->last_used != vb->used->idx) {
+			head = vb->used->ring[vb->last_used % vb->num].id;
+			vb->req[head].done = 1;
+			wakeup(&vb->req[head]);
+			vb->last_used++;
+		}
+	}
+}
+
+int virtio_blk_open(struct inode *i, struct fd *fd_table)
+{
+	if(!get_virtio_blk(i->rdev)) {
+		return -ENXIO;
+	}
+	return 0;
+}
+
+int virtio_blk_close(struct inode *i, struct fd *fd_table)
+{
+	sync_buffers(i->rdev);
+	return 0;
+}
+
+int virtio_blk_read(__dev_t dev, __blk_t block, char *buffer, int blksize)
+{
+	return virtio_blk_rw_blocks(dev, block, &buffer, 1, blksize, FOR_READING);
+}
+
+int virtio_blk_write(__dev_t dev, __blk_t block, char *buffer, int blksize)
+{
+	return virtio_blk_rw_blocks(dev, block, &buffer, 1, blksize, FOR_WRITING);
+}
+
+int virtio_blk_rw_blocks(__dev_t dev, __blk_t block, char **buffers, int nblocks, int blksize, int mode)
+{
+	struct virtio_blk *vb;
+	unsigned int sector;
+	int heads[NR_BUF_RUN];
+	int minor, n, count, nreqs, spb, type, errno;
+
+	if(!(vb = get_virtio_blk(dev))) {
+		return -ENXIO;
+	}
+	if(mode == FOR_WRITING && (vb->flags & VIRTIO_BLK_RDONLY)) {
+		return -EROFS;
+	}
+
+	minor = MINOR(dev) % VIRTIO_BLK_MINORS;
+	blksize = blksize ? blksize : BLKSIZE_1K;
+	spb = blksize / VIRTIO_BLK_SECTSIZE;
+	sector = block * spb;
+	if(block < 0 || sector + (nblocks * spb) > get_part_size(vb, minor)) {
+		printk("WARNING: %s(): %s: block %d is beyond the size of the device %d,%d.\n", __FUNCTION__, vb->dev_name, block, MAJOR(dev), MINOR(dev));
+		return -EIO;
+	}
+	if(minor) {
+		sector += vb->part_table[minor - 1].startsect;
+	}
+
+	type = mode == FOR_READING ? VIRTIO_BLK_T_IN : VIRTIO_BLK_T_OUT;
+	errno = n = 0;
+	while(n < nblocks) {
+		/*
+		 * All the requests of the run are made available before notifying
+		 * the device. If the queue gets full, the ones already added are
+		 * completed first since nobody else would free their descriptors.
+		 */
+		for(nreqs = 0; n < nblocks && nreqs < NR_BUF_RUN; nreqs++) {
+			count = MIN(nblocks - n, vb->seg_max);
+			if((heads[nreqs] = add_request(vb, type, sector + (n * spb), buffers + n, count, blksize, !nreqs)) < 0) {
+				break;
+			}
+			n += count;
+		}
+		notify(vb);
+		while(nreqs--) {
+			if(wait_request(vb, heads[nreqs]) != VIRTIO_BLK_S_OK) {
+				errno = -EIO;
+			}
+		}
+	}
+
+	if(errno) {
+		printk("WARNING: %s(): %s: error on device %d,%d during %s at block %d.\n", __FUNCTION__, vb->dev_name, MAJOR(dev), MINOR(dev), mode == FOR_READING ? "read" : "write", block);
+		return errno;
+	}
+	return nblocks * blksize;
+}
+
+int virtio_blk_ioctl(struct inode *i, int cmd, unsigned long int arg)
+{
+	struct virtio_blk *vb;
+	int minor, errno;
+
+	if(!(vb = get_virtio_blk(i->rdev))) {
+		return -ENXIO;
+	}
+	minor = MINOR(i->rdev) % VIRTIO_BLK_MINORS;
+
+	switch(cmd) {
+		case BLKGETSIZE:
+			if((errno = check_user_area(VERIFY_WRITE, (void *)arg, sizeof(unsigned int)))) {
+				return errno;
+			}
+			*(int *)arg = get_part_size(vb, minor);
+			break;
+		case BLKFLSBUF:
+			sync_buffers(i->rdev);
+			invalidate_buffers(i->rdev);
+			break;
+		case BLKRRPART:
+			read_msdos_partition(MKDEV(VIRTIO_BLK_MAJOR, (vb - virtio_blk_table) * VIRTIO_BLK_MINORS), vb->part_table);
+			assign_minors(vb);
+			break;
+		default:
+			return -EINVAL;
+	}
+	return 0;
+}
+
+/* sets up the only queue of the device, returns 1 on failure */
+static int setup_queue(struct virtio_blk *vb, char *addr)
+{
+	int n;
+
+	outport_w(vb->base + VIRTIO_PCI_QUEUE_SEL, 0);
+	vb->num = inport_w(vb->base + VIRTIO_PCI_QUEUE_SIZE);
+	if(!vb->num || vb->num > VIRTIO_BLK_QUEUE_MAX) {
+		printk("WARNING: %s(): %s: unsupported queue size %d.\n", __FUNCTION__, vb->dev_name, vb->num);
+		return 1;
+	}
+
+	memset_b(addr, NULL, VRING_SIZE(vb->num));
+	vb->desc = (struct vring_desc *)addr;
+	vb->avail = (struct vring_avail *)(addr + VRING_AVAIL_OFFSET(vb->num));
+	vb->used = (struct vring_used *)(addr + VRING_USED_OFFSET(vb->num));
+	for(n = 0; n < vb->num; n++) {
+		vb->desc[n].next = n + 1;
+	}
+	vb->free_head = 0;
+	vb->nfree = vb->num;
+	vb->last_used = 0;
+
+	/* a request needs the header and the status besides the data */
+	vb->seg_max = vb->num - 2;
+	if(inport_l(vb->base + VIRTIO_PCI_GUEST_FEATURES) & VIRTIO_BLK_F_SEG_MAX) {
+		if((n = inport_l(vb->base + VIRTIO_BLK_SEG_MAX))) {
+			vb->seg_max = MIN(vb->seg_max, n);
+		}
+	}
+	outport_l(vb->base + VIRTIO_PCI_QUEUE_PFN, V2P((unsigned int)addr) >> PAGE_SHIFT);
+	return 0;
+}
+
+static void show_disk(struct virtio_blk *vb)
+{
+	int n;
+
+	printk("%s       0x%04X-0x%04X   %2d    ", vb->dev_name, vb->base, vb->base + vb->pci->size[0] - 1, vb->pci->irq);
+	printk("virtio-blk DISK drive %dMB%s\n", vb->nr_sects / 2048, vb->flags & VIRTIO_BLK_RDONLY ? " (read-only)" : "");
+	printk("                                sectors=%d queue=%d seg_max=%d\n", vb->nr_sects, vb->num, vb->seg_max);
+	printk("                                partition summary: ");
+	for(n = 0; n < NR_PARTITIONS; n++) {
+		/* status values other than 0x00 and 0x80 are invalid */
+		if(vb->part_table[n].status && vb->part_table[n].status != 0x80) {
+			continue;
+		}
+		if(vb->part_table[n].type) {
+			printk("%s%d ", vb->dev_name, n + 1);
+		}
+	}
+	printk("\n");
+}
+
+static int disk_init(struct virtio_blk *vb)
+{
+	unsigned int features;
+	int minor;
+
+	/* reset the device and tell it that there is a driver */
+	outport_b(vb->base + VIRTIO_PCI_STATUS, 0);
+	outport_b(vb->base + VIRTIO_PCI_STATUS, VIRTIO_STATUS_ACK);
+	outport_b(vb->base + VIRTIO_PCI_STATUS, VIRTIO_STATUS_ACK | VIRTIO_STATUS_DRIVER);
+
+	features = inport_l(vb->base + VIRTIO_PCI_HOST_FEATURES);
+	features &= VIRTIO_BLK_F_SEG_MAX | VIRTIO_BLK_F_RO;
+	outport_l(vb->base + VIRTIO_PCI_GUEST_FEATURES, features);
+	if(features & VIRTIO_BLK_F_RO) {
+		vb->flags |= VIRTIO_BLK_RDONLY;
+	}
+
+	if(setup_queue(vb, virtio_blk_queues[vb - virtio_blk_table])) {
+		outport_b(vb->base + VIRTIO_PCI_STATUS, VIRTIO_STATUS_FAILED);
+		return 1;
+	}
+
+	/* sectors beyond 2TB are not reachable with 1KB blocks */
+	vb->nr_sects = inport_l(vb->base + VIRTIO_BLK_CAPACITY);
+	if(inport_l(vb->base + VIRTIO_BLK_CAPACITY + 4)) {
+		vb->nr_sects = 0xFFFFFFFF;
+	}
+
+	vb->irq.ticks = 0;
+	vb->irq.name = "virtio-blk";
+	vb->irq.handler = irq_virtio_blk;
+	vb->irq.next = NULL;
+	if(!register_irq(vb->pci->irq, &vb->irq)) {
+		enable_irq(vb->pci->irq);
+	}
+	outport_b(vb->base + VIRTIO_PCI_STATUS, VIRTIO_STATUS_ACK | VIRTIO_STATUS_DRIVER | VIRTIO_STATUS_DRIVER_OK);
+
+	minor = (vb - virtio_blk_table) * VIRTIO_BLK_MINORS;
+	SET_MINOR(virtio_blk_device.minors, minor);
+	virtio_blk_sizes[minor] = vb->nr_sects / 2;
+	read_msdos_partition(MKDEV(VIRTIO_BLK_MAJOR, minor), vb->part_table);
+	assign_minors(vb);
+	show_disk(vb);
+	return 0;
+}
+
+void virtio_blk_init(void)
+{
+	struct pci_device *pci;
+	struct virtio_blk *vb;
+
+	pci = NULL;
+	while((pci = pci_find_device(VIRTIO_PCI_VENDOR, VIRTIO_PCI_DEV_BLK, pci))) {
+		if(virtio_blk_ndisks >= NR_VIRTIO_BLK) {
+			printk("WARNING: %s(): too many virtio disks.\n", __FUNCTION__);
+			break;
+		}
+		if(!(pci->bar[0] & PCI_BAR_IO) || !pci->irq) {
+			printk("WARNING: %s(): virtio disk %02d:%02d.%d is not usable.\n", __FUNCTION__, pci->bus, pci->slot, pci->func);
+			continue;
+		}
+		if(!virtio_blk_ndisks) {
+			if(register_device(BLK_DEV, &virtio_blk_device)) {
+				printk("ERROR: %s(): unable to register the virtio disks.\n", __FUNCTION__);
+				return;
+			}
+		}
+
+		vb = &virtio_blk_table[virtio_blk_ndisks];
+		memset_b(vb, NULL, sizeof(struct virtio_blk));
+		vb->pci = pci;
+		vb->base = pci->bar[0] & PCI_BAR_IO_MASK;
+		vb->dev_name[0] = 'v';
+		vb->dev_name[1] = 'd';
+		vb->dev_name[2] = 'a' + virtio_blk_ndisks;
+		pci_enable_device(pci, PCI_COMMAND_IO | PCI_COMMAND_MASTER);
+		virtio_blk_ndisks++;
+		if(disk_init(vb)) {
+			virtio_blk_ndisks--;
+		}
+	}
+}
@@ -0,0 +1,416 @@
+/*
+ * fiwix/drivers/block/zram.c
+ *
+ * Copyright 2021, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#include <fiwix/kernel.h>
+#include <fiwix/zram.h>
+#include <fiwix/lz4.h>
+#include <fiwix/ioctl.h>
+#include <fiwix/devices.h>
+#include <fiwix/part.h>
+#include <fiwix/sleep.h>
+#include <fiwix/fs.h>
+#include <fiwix/errno.h>
+#include <fiwix/mm.h>
+#include <fiwix/stdio.h>
+#include <fiwix/string.h>
+
+/*
+ * The zram device is a RAM disk that keeps each block compressed with LZ4,
+ * in pages that are allocated as the blocks are written. Blocks filled with
+ * zeros take no memory at all, and the ones that don't compress well enough
+ * are stored as they are. The compressed data is packed in pages of slots
+ * of the same size, so a page is freed once all its slots are free.
+ */
+
+struct zram zram_table[ZRAM_MINORS];
+static unsigned int zram_sizes[256];
+
+static struct resource zram_resource = { NULL, NULL };
+static char zram_buffer[ZRAM_BLKSIZE];
+static unsigned short int zram_hash[LZ4_HASH_SIZE];
+
+static struct fs_operations zram_driver_fsop = {
+	0,
+	0,
+
+	zram_open,
+	zram_close,
+	NULL,			/* read */
+	NULL,			/* write */
+	zram_ioctl,
+	zram_lseek,
+	NULL,			/* readdir */
+	NULL,			/* mmap */
+	NULL,			/* select */
+
+	NULL,			/* readlink */
+	NULL,			/* followlink */
+	NULL,			/* bmap */
+	NULL,			/* lockup */
+	NULL,			/* rmdir */
+	NULL,			/* link */
+	NULL,			/* unlink */
+	NULL,			/* symlink */
+	NULL,			/* mkdir */
+	NULL,			/* mknod */
+	NULL,			/* truncate */
+	NULL,			/* create */
+	NULL,			/* rename */
+
+	zram_read,
+	zram_write,
+
+	NULL,			/* read_inode */
+	NULL,			/* write_inode */
+	NULL,			/* ialloc */
+	NULL,			/* ifree */
+	NULL,			/* statfs */
+	NULL,			/* read_superblock */
+	NULL,			/* remount_fs */
+	NULL,			/* write_superblock */
+	NULL			/* release_superblock */
+};
+
+static struct device zram_device = {
+	"zram",
+	ZRAM_MAJOR,
+	{ 0, 0, 0, 0, 0, 0, 0, 0 },
+	ZRAM_BLKSIZE,
+	&zram_sizes,
+	&zram_driver_fsop,
+	NULL,
+	NULL,
+	NULL
+};
+
+static struct zram * get_zram(int minor)
+{
+	if(TEST_MINOR(zram_device.minors, minor)) {
+		return &zram_table[minor];
+	}
+	return NULL;
+}
+
+/*
+ * The blocks are written by kswapd when it reclaims buffers, so this can't
+ * wait for free pages like kmalloc() does. The write fails with -ENOMEM
+ * instead, and the buffer cache keeps the buffer dirty (and its data) until
+ * a later sync succeeds.
+ */
+static char * get_page(struct zram *zram)
+{
+	char *addr;
+
+	if(!kstat.free_pages) {
+		return NULL;
+	}
+	if((addr = (char *)kmalloc())) {
+		zram->pages++;
+	}
+	return addr;
+}
+
+static void put_page(struct zram *zram, char *addr)
+{
+	kfree((unsigned int)addr);
+	zram->pages--;
+}
+
+static char * alloc_slot(struct zram *zram, int size)
+{
+	struct zram_page *zp;
+	char *slot;
+	int class, slotsize;
+
+	class = (size - 1) / ZRAM_SLOT;
+	slotsize = (class + 1) * ZRAM_SLOT;
+
+	if(!(zp = zram->partial[class])) {
+		if(!(zp = (struct zram_page *)get_page(zram))) {
+			return NULL;
+		}
+		zp->prev = zp->next = NULL;
+		zp->free = NULL;
+		zp->used = 0;
+		for(slot = (char *)zp + PAGE_SIZE - slotsize; slot >= (char *)zp + ZRAM_SLOT; slot -= slotsize) {
+			*(char **)slot = zp->free;
+			zp->free = slot;
+		}
+		zram->partial[class] = zp;
+	}
+
+	slot = zp->free;
+	zp->free = *(char **)slot;
+	zp->used++;
+
+	/* a full page leaves the list */
+	if(!zp->free) {
+		if(zp->next) {
+			zp->next->prev = NULL;
+		}
+		zram->partial[class] = zp->next;
+		zp->next = NULL;
+	}
+	return slot;
+}
+
+static void free_slot(struct zram *zram, char *slot, int size)
+{
+	struct zram_page *zp;
+	int class;
+
+	class = (size - 1) / ZRAM_SLOT;
+	zp = (struct zram_page *)((unsigned int)slot & PAGE_MASK);
+
+	if(!zp->free) {
+		zp->prev = NULL;
+		if((zp->next = zram->partial[class])) {
+			zp->next->prev = zp;
+		}
+		zram->partial[class] = zp;
+	}
+	*(char **)slot = zp->free;
+	zp->free = slot;
+
+	if(!--zp->used) {
+		if(zp->next) {
+			zp->next->prev = zp->prev;
+		}
+		if(zp->prev) {
+			zp->prev->next = zp->next;
+		} else {
+			zram->partial[class] = zp->next;
+		}
+		put_page(zram, (char *)zp);
+	}
+}
+
+static struct zram_entry * get_entry(struct zram *zram, __blk_t block, int alloc)
+{
+	struct zram_entry **entries;
+
+	entries = &zram->table[block / ZRAM_ENTRIES];
+	if(!*entries) {
+		if(!alloc || !(*entries = (struct zram_entry *)get_page(zram))) {
+			return NULL;
+		}
+		memset_b(*entries, 0, PAGE_SIZE);
+	}
+	return *entries + (block % ZRAM_ENTRIES);
+}
+
+static void free_entry(struct zram *zram, struct zram_entry *entry)
+{
+	if(entry->addr) {
+		free_slot(zram, entry->addr, entry->size);
+		zram->compr_size -= entry->size;
+		zram->stored--;
+	}
+	if(entry->flags & ZRAM_ZERO) {
+		zram->zero--;
+	}
+	entry->addr = NULL;
+	entry->size = 0;
+	entry->flags = 0;
+}
+
+static int is_zero(char *buffer)
+{
+	unsigned int *p;
+	int n;
+
+	p = (unsigned int *)buffer;
+	for(n = 0; n < ZRAM_BLKSIZE / sizeof(unsigned int); n++) {
+		if(p[n]) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static int read_block(struct zram *zram, __blk_t block, char *buffer)
+{
+	struct zram_entry *entry;
+
+	if(!(entry = get_entry(zram, block, 0)) || !entry->addr) {
+		memset_b(buffer, 0, ZRAM_BLKSIZE);
+		return 0;
+	}
+	if(entry->size == ZRAM_BLKSIZE) {
+		memcpy_b(buffer, entry->addr, ZRAM_BLKSIZE);
+		return 0;
+	}
+	if(lz4_decompress(entry->addr, entry->size, buffer, ZRAM_BLKSIZE) != ZRAM_BLKSIZE) {
+		printk("WARNING: %s(): corrupted data in block %d.\n", __FUNCTION__, block);
+		return -EIO;
+	}
+	return 0;
+}
+
+static int write_block(struct zram *zram, __blk_t block, char *buffer)
+{
+	struct zram_entry *entry;
+	char *data, *addr;
+	int size;
+
+	if(is_zero(buffer)) {
+		if((entry = get_entry(zram, block, 0))) {
+			free_entry(zram, entry);
+			entry->flags = ZRAM_ZERO;
+			zram->zero++;
+		}
+		return 0;
+	}
+	if(!(entry = get_entry(zram, block, 1))) {
+		return -ENOMEM;
+	}
+
+	size = lz4_compress(buffer, ZRAM_BLKSIZE, zram_buffer, ZRAM_MAX_COMPR, zram_hash);
+	data = zram_buffer;
+	if(!size) {
+		size = ZRAM_BLKSIZE;
+		data = buffer;
+	}
+	if(!(addr = alloc_slot(zram, size))) {
+		return -ENOMEM;
+	}
+	memcpy_b(addr, data, size);
+
+	free_entry(zram, entry);
+	entry->addr = addr;
+	entry->size = size;
+	zram->compr_size += size;
+	zram->stored++;
+	return 0;
+}
+
+/* reads or writes the ZRAM_BLKSIZE blocks that make up a block of 'blksize' */
+static int zram_transfer(__dev_t dev, __blk_t block, char *buffer, int blksize, int mode)
+{
+	struct zram *zram;
+	__blk_t zblock;
+	int n, errno;
+
+	if(!(zram = get_zram(MINOR(dev)))) {
+		return -ENXIO;
+	}
+	if(blksize < ZRAM_BLKSIZE) {
+		return -EINVAL;
+	}
+
+	zblock = block * (blksize / ZRAM_BLKSIZE);
+	if(zblock + (blksize / ZRAM_BLKSIZE) > zram->nr_blocks) {
+		printk("%s(): block %d is beyond the size of the zram device.\n", __FUNCTION__, block);
+		return -EIO;
+	}
+
+	lock_resource(&zram_resource);
+	for(n = 0; n < blksize; n += ZRAM_BLKSIZE, zblock++) {
+		if(mode == FOR_READING) {
+			errno = read_block(zram, zblock, buffer + n);
+		} else {
+			errno = write_block(zram, zblock, buffer + n);
+		}
+		if(errno < 0) {
+			unlock_resource(&zram_resource);
+			return errno;
+		}
+	}
+	unlock_resource(&zram_resource);
+	return blksize;
+}
+
+int zram_open(struct inode *i, struct fd *fd_table)
+{
+	if(!get_zram(MINOR(i->rdev))) {
+		return -ENXIO;
+	}
+	return 0;
+}
+
+int zram_close(struct inode *i, struct fd *fd_table)
+{
+	if(!get_zram(MINOR(i->rdev))) {
+		return -ENXIO;
+	}
+	return 0;
+}
+
+int zram_read(__dev_t dev, __blk_t block, char *buffer, int blksize)
+{
+	return zram_transfer(dev, block, buffer, blksize, FOR_READING);
+}
+
+int zram_write(__dev_t dev, __blk_t block, char *buffer, int blksize)
+{
+	return zram_transfer(dev, block, buffer, blksize, FOR_WRITING);
+}
+
+int zram_ioctl(struct inode *i, int cmd, unsigned long int arg)
+{
+	struct hd_geometry *geom;
+	int errno;
+
+	if(!get_zram(MINOR(i->rdev))) {
+		return -ENXIO;
+	}
+
+	switch(cmd) {
+		case HDIO_GETGEO:
+			if((errno = check_user_area(VERIFY_WRITE, (void *)arg, sizeof(struct hd_geometry)))) {
+				return errno;
+			}
+			geom = (struct hd_geometry *)arg;
+			geom->heads = 63;
+			geom->sectors = 16;
+			geom->cylinders = zram_sizes[MINOR(i->rdev)] * 1024 / BPS;
+			geom->cylinders /= (geom->heads * geom->sectors);
+			geom->start = 0;
+			break;
+		case BLKRRPART:
+			break;
+		case BLKGETSIZE:
+			if((errno = check_user_area(VERIFY_WRITE, (void *)arg, sizeof(unsigned int)))) {
+				return errno;
+			}
+			*(int *)arg = zram_sizes[MINOR(i->rdev)] * 2;
+			break;
+		default:
+			return -EINVAL;
+	}
+	return 0;
+}
+
+int zram_lseek(struct inode *i, __off_t offset)
+{
+	return offset;
+}
+
+void zram_init(void)
+{
+	int n;
+	struct zram *zram;
+
+	if(!_zramsize) {
+		_zramsize = ZRAM_SIZE;
+	}
+
+	memset_b(zram_table, NULL, sizeof(zram_table));
+	for(n = 0; n < ZRAM_MINORS; n++) {
+		zram = &zram_table[n];
+		if(!(zram->table = (struct zram_entry **)get_page(zram))) {
+			printk("WARNING: %s(): unable to allocate the table of zram%d.\n", __FUNCTION__, n);
+			continue;
+		}
+		memset_b(zram->table, NULL, PAGE_SIZE);
+		zram->nr_blocks = _zramsize / (ZRAM_BLKSIZE / 1024);
+		zram_sizes[n] = _zramsize;
+		SET_MINOR(zram_device.minors, n);
+		printk("zram%d                           %d compressed RAMdisk(s) of %dKB size, %dKB blocksize\n", n, ZRAM_MINORS, _zramsize, ZRAM_BLKSIZE / 1024);
+	}
+	register_device(BLK_DEV, &zram_device);
+}
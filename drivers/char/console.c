@@ -20,6 +20,7 @@
 #include <fiwix/sched.h>
 #include <fiwix/kd.h>
 #include <fiwix/stdio.h>
+#include <fiwix/errno.h>
 #include <fiwix/string.h>
 #include <fiwix/fbcon.h>
 
@@ -41,7 +42,8 @@
 #define DEVICE_NOT_OK	"\033[3n"
 
 #define SCREEN_SIZE	(video.columns * video.lines)
-#define VC_BUF_LINES	(video.lines * SCREENS_LOG)
+#define SCREEN_PAGES	(PAGE_ALIGN(SCREEN_SIZE * sizeof(short int)) >> PAGE_SHIFT)
+#define VC_BUF_PAGES	(PAGE_ALIGN(VC_BUF_SIZE * sizeof(short int)) >> PAGE_SHIFT)
 
 
 short int current_cons;
@@ -98,6 +100,8 @@ static struct device tty_device = {
 	0,
 	NULL,
 	&tty_driver_fsop,
+	NULL,
+	NULL,
 	NULL
 };
 
@@ -108,6 +112,8 @@ static struct device console_device = {
 	0,
 	NULL,
 	&tty_driver_fsop,
+	NULL,
+	NULL,
 	NULL
 };
 
@@ -380,9 +386,39 @@ static void insert_seq(struct tty *tty, char *buf, int count)
 	tty->input(tty);
 }
 
+/*
+ * The screen of a vconsole is allocated when it's opened or switched to, and
+ * it's freed once it's neither open nor visible.
+ */
+static int vconsole_alloc(struct vconsole *vc)
+{
+	if(vc->screen) {
+		return 0;
+	}
+	if(!(vc->screen = (short int *)kmalloc_pages(SCREEN_PAGES))) {
+		return -ENOMEM;
+	}
+	memset_w(vc->screen, BLANK_MEM, SCREEN_SIZE);
+	vc->x = vc->y = 0;
+	return 0;
+}
+
+static void vconsole_free(struct vconsole *vc)
+{
+	if(!vc->screen || (vc->flags & CONSOLE_HAS_FOCUS)) {
+		return;
+	}
+	/* the system console is always ready for the kernel messages */
+	if(vc->tty->dev == _syscondev) {
+		return;
+	}
+	kfree_pages((unsigned int)vc->screen, SCREEN_PAGES);
+	vc->screen = NULL;
+}
+
 static void vcbuf_scroll_up(void)
 {
-	memcpy_w(vcbuf, vcbuf + video.columns, (VC_BUF_SIZE - video.columns) * 2);
+	memcpy_w(vcbuf, vcbuf + video.columns, VC_BUF_SIZE - video.columns);
 }
 
 static void vcbuf_refresh(struct vconsole *vc)
@@ -471,10 +507,106 @@ static void echo_char(struct vconsole *vc, unsigned char *buf, unsigned int coun
 			}
 		}
 	}
-	video.update_curpos(vc);
 	RESTORE_FLAGS(flags);
 }
 
+/*
+ * Ends a write and draws the area of the screen changed during it. Only
+ * taking the area needs the interrupts disabled, the drawing can be long.
+ */
+static void draw_damage(struct vconsole *vc)
+{
+	unsigned long int flags;
+	int x1, y1, x2, y2;
+
+	SAVE_FLAGS(flags); CLI();
+	vc->flags &= ~CONSOLE_BATCH;
+	x1 = vc->damage_x1;
+	y1 = vc->damage_y1;
+	x2 = vc->damage_x2;
+	y2 = vc->damage_y2;
+	vc->damage_x1 = vc->damage_y1 = 0;
+	vc->damage_x2 = vc->damage_y2 = 0;
+	RESTORE_FLAGS(flags);
+
+	if(y2 && (vc->flags & CONSOLE_HAS_FOCUS) && !video.buf_top) {
+		video.update_screen(vc, x1, y1, x2, y2);
+	}
+}
+
+/*
+ * While a write is in progress (CONSOLE_BATCH) the video drivers only update
+ * the back-buffer of the console with the characters 'from' to 'from + count'
+ * and the area is accumulated here, so it is drawn just once at the end.
+ */
+void vconsole_damage(struct vconsole *vc, int from, int count)
+{
+	int x1, y1, x2, y2;
+
+	if((vc->flags & (CONSOLE_HAS_FOCUS | CONSOLE_BATCH)) != (CONSOLE_HAS_FOCUS | CONSOLE_BATCH) || count <= 0) {
+		return;
+	}
+
+	y1 = from / vc->columns;
+	y2 = ((from + count - 1) / vc->columns) + 1;
+	if(y2 - y1 > 1) {
+		x1 = 0;
+		x2 = vc->columns;
+	} else {
+		x1 = from % vc->columns;
+		x2 = x1 + count;
+	}
+	if(y2 > vc->lines) {
+		y2 = vc->lines;
+	}
+
+	if(!vc->damage_y2) {
+		vc->damage_x1 = x1;
+		vc->damage_y1 = y1;
+		vc->damage_x2 = x2;
+		vc->damage_y2 = y2;
+		return;
+	}
+	vc->damage_x1 = MIN(vc->damage_x1, x1);
+	vc->damage_y1 = MIN(vc->damage_y1, y1);
+	vc->damage_x2 = MAX(vc->damage_x2, x2);
+	vc->damage_y2 = MAX(vc->damage_y2, y2);
+}
+
+/*
+ * The lines from 'top' to the bottom were scrolled by one during a write, so
+ * the area not drawn yet moves with them and the new blank line is added.
+ */
+void vconsole_scroll_damage(struct vconsole *vc, int top, int mode)
+{
+	if((vc->flags & (CONSOLE_HAS_FOCUS | CONSOLE_BATCH)) != (CONSOLE_HAS_FOCUS | CONSOLE_BATCH)) {
+		return;
+	}
+
+	if(vc->damage_y2 > top) {
+		if(mode == SCROLL_UP) {
+			if(vc->damage_y1 > top) {
+				vc->damage_y1--;
+			}
+			vc->damage_y2--;
+		} else {
+			if(vc->damage_y1 >= top) {
+				vc->damage_y1++;
+			}
+			vc->damage_y2 = MIN(vc->damage_y2 + 1, vc->lines);
+		}
+		if(vc->damage_y1 >= vc->damage_y2) {
+			vc->damage_x1 = vc->damage_y1 = 0;
+			vc->damage_x2 = vc->damage_y2 = 0;
+		}
+	}
+	if(mode == SCROLL_UP) {
+		vconsole_damage(vc, (vc->lines - 1) * vc->columns, vc->columns);
+	} else {
+		vconsole_damage(vc, top * vc->columns, vc->columns);
+	}
+}
+
 void vconsole_reset(struct tty *tty)
 {
 	int n;
@@ -519,9 +651,10 @@ void vconsole_reset(struct tty *tty)
 
 void vconsole_write(struct tty *tty)
 {
-	int n;
-	unsigned char ch;
+	int n, pos, count;
+	unsigned char ch, buf[CBSIZE];
 	int numeric;
+	unsigned long int flags;
 	struct vconsole *vc;
 
 	vc = (struct vconsole *)tty->driver_data;
@@ -536,9 +669,21 @@ void vconsole_write(struct tty *tty)
 	}
 
 	ch = numeric = 0;
+	pos = count = 0;
+
+	SAVE_FLAGS(flags); CLI();
+	vc->flags |= CONSOLE_BATCH;
+	RESTORE_FLAGS(flags);
 
-	while(!vc->scrlock && tty->write_q.count > 0) {
-		ch = tty_queue_getchar(&tty->write_q);
+	/* the characters already taken from the queue are always shown */
+	while(!vc->scrlock || pos < count) {
+		if(pos == count) {
+			if(!(count = tty_queue_read(&tty->write_q, buf, CBSIZE))) {
+				break;
+			}
+			pos = 0;
+		}
+		ch = buf[pos++];
 
 		if(vc->esc) {
 			if(vc->sbracket) {
@@ -831,10 +976,18 @@ void vconsole_write(struct tty *tty)
 				vc->parmv1 = vc->parmv2 = 0;
 				continue;
 			default:
-				echo_char(vc, &ch, 1);
+				/* the characters up to the next escape go together */
+				n = pos - 1;
+				while(pos < count && buf[pos] != '\033') {
+					pos++;
+				}
+				echo_char(vc, &buf[n], pos - n);
 				continue;
 		}
 	}
+
+	draw_damage(vc);
+
 	if(ch) {
 		if(vc->vc_mode != KD_GRAPHICS) {
 			video.update_curpos(vc);
@@ -843,6 +996,19 @@ void vconsole_write(struct tty *tty)
 	}
 }
 
+int vconsole_open(struct tty *tty)
+{
+	return vconsole_alloc((struct vconsole *)tty->driver_data);
+}
+
+int vconsole_close(struct tty *tty)
+{
+	if(tty->count == 1) {
+		vconsole_free((struct vconsole *)tty->driver_data);
+	}
+	return 0;
+}
+
 void vconsole_select(int new_cons)
 {
 	new_cons++;
@@ -869,6 +1035,10 @@ void vconsole_select_final(int new_cons)
 				init_vt(&vc[new_cons]);
 			}
 		}
+		if(vconsole_alloc(&vc[new_cons])) {
+			printk("WARNING: %s(): unable to allocate the screen of tty%d.\n", __FUNCTION__, new_cons);
+			return;
+		}
 		if(video.buf_top) {
 			video.buf_top = 0;
 			video.show_cursor(&vc[current_cons], ON);
@@ -876,6 +1046,9 @@ void vconsole_select_final(int new_cons)
 		}
 		vc[current_cons].vidmem = NULL;
 		vc[current_cons].flags &= ~CONSOLE_HAS_FOCUS;
+		if(!vc[current_cons].tty->count) {
+			vconsole_free(&vc[current_cons]);
+		}
 		vc[new_cons].vidmem = (unsigned char *)video.address;
 		vc[new_cons].flags |= CONSOLE_HAS_FOCUS;
 		video.restore_screen(&vc[new_cons]);
@@ -976,6 +1149,7 @@ void vconsole_deltab(struct tty *tty)
 void console_flush_log_buf(char *buffer, unsigned int count)
 {
 	char *b;
+	int n;
 	struct tty *tty;
 
 	if(!(tty = get_tty(_syscondev))) {
@@ -985,14 +1159,11 @@ void console_flush_log_buf(char *buffer, unsigned int count)
 	b = buffer;
 
 	while(count) {
-		if(tty_queue_putchar(tty, &tty->write_q, *b) < 0) {
-			tty->output(tty);
-			continue;
-		}
-		count--;
-		b++;
+		n = tty_queue_write(&tty->write_q, (unsigned char *)b, count);
+		count -= n;
+		b += n;
+		tty->output(tty);
 	}
-	tty->output(tty);
 }
 
 void console_init(void)
@@ -1008,6 +1179,21 @@ void console_init(void)
 		printk("\t\t\t\t(%d virtual consoles)\n", NR_VCONSOLES);
 	}
 
+	if(!_screenslog) {
+		_screenslog = SCREENS_LOG;
+	}
+	while(!(vcbuf = (short int *)kmalloc_pages(VC_BUF_PAGES))) {
+		if(_screenslog == 1) {
+			PANIC("unable to allocate the console scroll back buffer.\n");
+		}
+		_screenslog /= 2;
+	}
+	memset_w(vcbuf, BLANK_MEM, VC_BUF_SIZE);
+	if(video.flags & VPF_VGA) {
+		/* keeps the messages already on the screen */
+		memcpy_w(vcbuf, video.address, SCREEN_SIZE);
+	}
+
 	for(n = 1; n <= NR_VCONSOLES; n++) {
 		if(!register_tty(MKDEV(VCONSOLES_MAJOR, n))) {
 			tty = get_tty(MKDEV(VCONSOLES_MAJOR, n));
@@ -1018,20 +1204,22 @@ void console_init(void)
 			tty->reset = vconsole_reset;
 			tty->input = do_cook;
 			tty->output = vconsole_write;
+			tty->open = vconsole_open;
+			tty->close = vconsole_close;
 			vc[n].tty = tty;
-			if(video.flags & VPF_VGA) {
-				vc[n].screen = (short int *)kmalloc();
-			}
-			if(video.flags & VPF_VESAFB) {
-				vc[n].screen = vc_screen[n];
-			}
+			vc[n].screen = NULL;
 			vc[n].vidmem = NULL;
-			memset_w(vc[n].screen, BLANK_MEM, SCREEN_SIZE);
 			vconsole_reset(tty);
 		}
 	}
 
 	current_cons = 1;
+	if(vconsole_alloc(&vc[current_cons])) {
+		PANIC("unable to allocate the screen of tty%d.\n", current_cons);
+	}
+	if(is_vconsole(_syscondev) && MINOR(_syscondev) && vconsole_alloc(&vc[MINOR(_syscondev)])) {
+		PANIC("unable to allocate the screen of tty%d.\n", MINOR(_syscondev));
+	}
 	video.show_cursor(&vc[current_cons], ON);
 	vc[current_cons].vidmem = (unsigned char *)video.address;
 	vc[current_cons].flags |= CONSOLE_HAS_FOCUS;
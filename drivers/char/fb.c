@@ -65,6 +65,8 @@ static struct device fb_device = {
 	0,
 	NULL,
 	&fb_driver_fsop,
+	NULL,
+	NULL,
 	NULL
 };
 
@@ -14,6 +14,8 @@
 #include <fiwix/mm.h>
 #include <fiwix/mman.h>
 #include <fiwix/bios.h>
+#include <fiwix/fcntl.h>
+#include <fiwix/random.h>
 #include <fiwix/stdio.h>
 #include <fiwix/string.h>
 
@@ -154,7 +156,7 @@ static struct fs_operations zero_driver_fsop = {
 	NULL,			/* ioctl */
 	zero_lseek,
 	NULL,			/* readdir */
-	NULL,			/* mmap */
+	zero_mmap,
 	NULL,			/* select */
 
 	NULL,			/* readlink */
@@ -227,6 +229,48 @@ static struct fs_operations memdev_driver_fsop = {
 	NULL			/* release_superblock */
 };
 
+static struct fs_operations random_driver_fsop = {
+	0,
+	0,
+
+	urandom_open,
+	urandom_close,
+	random_read,
+	urandom_write,
+	NULL,			/* ioctl */
+	urandom_lseek,
+	NULL,			/* readdir */
+	NULL,			/* mmap */
+	NULL,			/* select */
+
+	NULL,			/* readlink */
+	NULL,			/* followlink */
+	NULL,			/* bmap */
+	NULL,			/* lockup */
+	NULL,			/* rmdir */
+	NULL,			/* link */
+	NULL,			/* unlink */
+	NULL,			/* symlink */
+	NULL,			/* mkdir */
+	NULL,			/* mknod */
+	NULL,			/* truncate */
+	NULL,			/* create */
+	NULL,			/* rename */
+
+	NULL,			/* read_block */
+	NULL,			/* write_block */
+
+	NULL,			/* read_inode */
+	NULL,			/* write_inode */
+	NULL,			/* ialloc */
+	NULL,			/* ifree */
+	NULL,			/* statfs */
+	NULL,			/* read_superblock */
+	NULL,			/* remount_fs */
+	NULL,			/* write_superblock */
+	NULL			/* release_superblock */
+};
+
 static struct fs_operations urandom_driver_fsop = {
 	0,
 	0,
@@ -276,6 +320,8 @@ static struct device memdev_device = {
 	0,
 	NULL,
 	&memdev_driver_fsop,
+	NULL,
+	NULL,
 	NULL
 };
 
@@ -402,7 +448,13 @@ int zero_close(struct inode *i, struct fd *fd_table)
 
 int zero_read(struct inode *i, struct fd *fd_table, char *buffer, __size_t count)
 {
-	memset_b(buffer, NULL, count);
+	unsigned int n;
+
+	/* the bulk of the buffer is cleared a word at a time */
+	n = MIN(count, (sizeof(unsigned int) - ((unsigned int)buffer & 3)) & 3);
+	memset_b(buffer, NULL, n);
+	memset_l(buffer + n, NULL, (count - n) / sizeof(unsigned int));
+	memset_b(buffer + count - ((count - n) & 3), NULL, (count - n) & 3);
 	return count;
 }
 
@@ -426,20 +478,26 @@ int urandom_close(struct inode *i, struct fd *fd_table)
 	return 0;
 }
 
-int urandom_read(struct inode *i, struct fd *fd_table, char *buffer, __size_t count)
+/* /dev/random only waits for the first seed of the generator */
+int random_read(struct inode *i, struct fd *fd_table, char *buffer, __size_t count)
 {
-	int n;
+	int errno;
 
-	for(n = 0; n < count; n++) {
-		kstat.random_seed = kstat.random_seed * 1103515245 + 12345;
-		*buffer = (char)(unsigned int)(kstat.random_seed / 65536) % 256;
-		buffer++;
+	if((errno = random_wait(fd_table->flags & O_NONBLOCK))) {
+		return errno;
 	}
-	return count;
+	return get_random_bytes(buffer, count);
+}
+
+int urandom_read(struct inode *i, struct fd *fd_table, char *buffer, __size_t count)
+{
+	return get_random_bytes(buffer, count);
 }
 
+/* the data written is mixed into the entropy pool, but not credited */
 int urandom_write(struct inode *i, struct fd *fd_table, const char *buffer, __size_t count)
 {
+	add_randomness(buffer, count);
 	return count;
 }
 
@@ -467,7 +525,7 @@ int memdev_open(struct inode *i, struct fd *fd_table)
 			i->fsop = &zero_driver_fsop;
 			break;
 		case MEMDEV_RANDOM:
-			i->fsop = &urandom_driver_fsop;
+			i->fsop = &random_driver_fsop;
 			break;
 		case MEMDEV_URANDOM:
 			i->fsop = &urandom_driver_fsop;
@@ -508,6 +566,18 @@ int mem_mmap(struct inode *i, struct vma *vma)
 	return 0;
 }
 
+/* /dev/zero is mapped as anonymous memory */
+int zero_mmap(struct inode *i, struct vma *vma)
+{
+	iput(vma->inode);
+	vma->inode = NULL;
+	vma->flags |= ZERO_PAGE;
+	if((vma->flags & MAP_TYPE) == MAP_SHARED) {
+		return map_shared_anon(vma);
+	}
+	return 0;
+}
+
 void memdev_init(void)
 {
 	SET_MINOR(memdev_device.minors, MEMDEV_MEM);
@@ -0,0 +1,515 @@
+/*
+ * fiwix/drivers/char/pty.c
+ *
+ * Copyright 2021, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#include <fiwix/kernel.h>
+#include <fiwix/devices.h>
+#include <fiwix/fs.h>
+#include <fiwix/errno.h>
+#include <fiwix/fcntl.h>
+#include <fiwix/ioctl.h>
+#include <fiwix/sleep.h>
+#include <fiwix/sched.h>
+#include <fiwix/process.h>
+#include <fiwix/tty.h>
+#include <fiwix/pty.h>
+#include <fiwix/stdio.h>
+#include <fiwix/string.h>
+
+/*
+ * A pseudo-terminal is a pair of devices: the slave (/dev/ttypN) is a
+ * regular tty, and the master (/dev/ptypN) takes the place of the hardware.
+ * What is written to the master is queued (by blocks) in the read_q of the
+ * slave and cooked as if it came from a keyboard, and the master reads what
+ * the slave leaves in its write_q. There is no hardware in between, so the
+ * data is never sent character by character.
+ */
+
+static struct pty pty_table[NR_PTYS];
+
+/* the slave doesn't need to cook its input */
+#define PTY_RAW(tty)	(!((tty)->termios.c_lflag & (ICANON | ISIG | ECHO | ECHONL | IEXTEN)) && !((tty)->termios.c_iflag & (ISTRIP | IUCLC | IGNCR | ICRNL | INLCR | IXON)))
+
+static struct fs_operations pty_master_driver_fsop = {
+	0,
+	0,
+
+	pty_master_open,
+	pty_master_close,
+	pty_master_read,
+	pty_master_write,
+	pty_master_ioctl,
+	tty_lseek,
+	NULL,			/* readdir */
+	NULL,			/* mmap */
+	pty_master_select,
+
+	NULL,			/* readlink */
+	NULL,			/* followlink */
+	NULL,			/* bmap */
+	NULL,			/* lockup */
+	NULL,			/* rmdir */
+	NULL,			/* link */
+	NULL,			/* unlink */
+	NULL,			/* symlink */
+	NULL,			/* mkdir */
+	NULL,			/* mknod */
+	NULL,			/* truncate */
+	NULL,			/* create */
+	NULL,			/* rename */
+
+	NULL,			/* read_block */
+	NULL,			/* write_block */
+
+	NULL,			/* read_inode */
+	NULL,			/* write_inode */
+	NULL,			/* ialloc */
+	NULL,			/* ifree */
+	NULL,			/* statfs */
+	NULL,			/* read_superblock */
+	NULL,			/* remount_fs */
+	NULL,			/* write_superblock */
+	NULL			/* release_superblock */
+};
+
+static struct fs_operations pty_slave_driver_fsop = {
+	0,
+	0,
+
+	tty_open,
+	tty_close,
+	tty_read,
+	tty_write,
+	tty_ioctl,
+	tty_lseek,
+	NULL,			/* readdir */
+	NULL,			/* mmap */
+	tty_select,
+
+	NULL,			/* readlink */
+	NULL,			/* followlink */
+	NULL,			/* bmap */
+	NULL,			/* lockup */
+	NULL,			/* rmdir */
+	NULL,			/* link */
+	NULL,			/* unlink */
+	NULL,			/* symlink */
+	NULL,			/* mkdir */
+	NULL,			/* mknod */
+	NULL,			/* truncate */
+	NULL,			/* create */
+	NULL,			/* rename */
+
+	NULL,			/* read_block */
+	NULL,			/* write_block */
+
+	NULL,			/* read_inode */
+	NULL,			/* write_inode */
+	NULL,			/* ialloc */
+	NULL,			/* ifree */
+	NULL,			/* statfs */
+	NULL,			/* read_superblock */
+	NULL,			/* remount_fs */
+	NULL,			/* write_superblock */
+	NULL			/* release_superblock */
+};
+
+static struct device pty_master_device = {
+	"pty",
+	PTY_MASTER_MAJOR,
+	{ 0, 0, 0, 0, 0, 0, 0, 0 },
+	0,
+	NULL,
+	&pty_master_driver_fsop,
+	NULL,
+	NULL,
+	NULL
+};
+
+static struct device pty_slave_device = {
+	"ttyp",
+	PTY_SLAVE_MAJOR,
+	{ 0, 0, 0, 0, 0, 0, 0, 0 },
+	0,
+	NULL,
+	&pty_slave_driver_fsop,
+	NULL,
+	NULL,
+	NULL
+};
+
+static struct pty * get_pty(__dev_t dev)
+{
+	int minor;
+
+	minor = MINOR(dev);
+	if(minor < NR_PTYS && TEST_MINOR(pty_master_device.minors, minor)) {
+		return &pty_table[minor];
+	}
+	return NULL;
+}
+
+/* wakes up the master side */
+static void pty_wakeup(struct pty *pty)
+{
+	wakeup(pty);
+	wakeup(&do_select);
+}
+
+static void pty_stop(struct tty *tty)
+{
+	struct pty *pty;
+
+	pty = (struct pty *)tty->driver_data;
+	pty->flags |= PTY_STOPPED;
+}
+
+static void pty_start(struct tty *tty)
+{
+	struct pty *pty;
+
+	pty = (struct pty *)tty->driver_data;
+	pty->flags &= ~PTY_STOPPED;
+	pty_wakeup(pty);
+}
+
+static void pty_reset(struct tty *tty)
+{
+	termios_reset(tty);
+	tty->winsize.ws_row = 24;
+	tty->winsize.ws_col = 80;
+	tty->winsize.ws_xpixel = 0;
+	tty->winsize.ws_ypixel = 0;
+}
+
+static void pty_output(struct tty *tty)
+{
+	struct pty *pty;
+
+	pty = (struct pty *)tty->driver_data;
+
+	/* nobody will read it */
+	if(!(pty->flags & PTY_MASTER_OPEN)) {
+		tty_queue_flush(&tty->write_q);
+		wakeup(&tty_write);
+		return;
+	}
+	pty_wakeup(pty);
+}
+
+static int pty_open(struct tty *tty)
+{
+	struct pty *pty;
+
+	pty = (struct pty *)tty->driver_data;
+	if(!(pty->flags & PTY_MASTER_OPEN)) {
+		return -EIO;
+	}
+	pty->flags |= PTY_SLAVE_OPENED;
+	return 0;
+}
+
+static int pty_close(struct tty *tty)
+{
+	struct pty *pty;
+
+	pty = (struct pty *)tty->driver_data;
+
+	/* the last close of the slave is a hangup for the master */
+	if(tty->count == 1) {
+		pty_wakeup(pty);
+	}
+	return 0;
+}
+
+/* the slave has read from its cooked_q */
+static void pty_unthrottle(struct tty *tty)
+{
+	pty_wakeup((struct pty *)tty->driver_data);
+}
+
+/* the slave has been opened and all its descriptors closed */
+static int pty_hungup(struct pty *pty)
+{
+	return (pty->flags & PTY_SLAVE_OPENED) && !pty->tty->count;
+}
+
+/* returns the number of bytes that the master can write without waiting */
+static int pty_room(struct tty *tty)
+{
+	int room;
+
+	room = tty_queue_room(&tty->cooked_q) - tty->read_q.count;
+
+	/*
+	 * A line that doesn't fit in the cooked_q would block both sides
+	 * forever, so it is truncated instead.
+	 */
+	if(room <= 0 && (tty->termios.c_lflag & ICANON) && !tty->canon_data) {
+		room = tty_queue_room(&tty->read_q);
+	}
+	return MIN(room, tty_queue_room(&tty->read_q));
+}
+
+int pty_master_open(struct inode *i, struct fd *fd_table)
+{
+	struct pty *pty;
+	struct tty *tty;
+
+	if(!(pty = get_pty(i->rdev))) {
+		return -ENXIO;
+	}
+	tty = pty->tty;
+
+	/* a single master per pair, and not while the slave is still in use */
+	if((pty->flags & PTY_MASTER_OPEN) || tty->count) {
+		return -EIO;
+	}
+	pty->flags = PTY_MASTER_OPEN;
+	tty_queue_flush(&tty->read_q);
+	tty_queue_flush(&tty->cooked_q);
+	tty_queue_flush(&tty->write_q);
+	pty_reset(tty);
+	tty->canon_data = 0;
+	tty->column = 0;
+	tty->lnext = 0;
+	return 0;
+}
+
+int pty_master_close(struct inode *i, struct fd *fd_table)
+{
+	struct pty *pty;
+	struct tty *tty;
+
+	if(!(pty = get_pty(i->rdev))) {
+		return -ENXIO;
+	}
+	tty = pty->tty;
+
+	pty->flags &= ~PTY_MASTER_OPEN;
+	tty_queue_flush(&tty->write_q);
+	if(tty->count && tty->pgid > 0) {
+		kill_pgrp(tty->pgid, SIGHUP);
+	}
+	wakeup(&tty_read);
+	wakeup(&tty_write);
+	wakeup(&do_select);
+	return 0;
+}
+
+int pty_master_read(struct inode *i, struct fd *fd_table, char *buffer, __size_t count)
+{
+	unsigned char buf[CBSIZE];
+	struct pty *pty;
+	struct tty *tty;
+	int n, bytes;
+
+	if(!(pty = get_pty(i->rdev))) {
+		return -ENXIO;
+	}
+	tty = pty->tty;
+
+	n = 0;
+	while(!tty->write_q.count || (pty->flags & PTY_STOPPED)) {
+		if(pty_hungup(pty)) {
+			return -EIO;
+		}
+		if(fd_table->flags & O_NONBLOCK) {
+			return -EAGAIN;
+		}
+		if(sleep(pty, PROC_INTERRUPTIBLE)) {
+			return -EINTR;
+		}
+	}
+
+	while(n < count && tty->write_q.count) {
+		bytes = tty_queue_read(&tty->write_q, buf, MIN(count - n, CBSIZE));
+		memcpy_b(buffer + n, buf, bytes);
+		n += bytes;
+	}
+	wakeup(&tty_write);
+	wakeup(&do_select);
+	i->i_atime = CURRENT_TIME;
+	return n;
+}
+
+int pty_master_write(struct inode *i, struct fd *fd_table, const char *buffer, __size_t count)
+{
+	unsigned char buf[CBSIZE];
+	struct pty *pty;
+	struct tty *tty;
+	int n, bytes, written;
+
+	if(!(pty = get_pty(i->rdev))) {
+		return -ENXIO;
+	}
+	tty = pty->tty;
+
+	n = 0;
+	while(n < count) {
+		if(pty_hungup(pty)) {
+			return n ? n : -EIO;
+		}
+		if((bytes = MIN(pty_room(tty), MIN(count - n, CBSIZE))) <= 0) {
+			if(fd_table->flags & O_NONBLOCK) {
+				return n ? n : -EAGAIN;
+			}
+			if(sleep(pty, PROC_INTERRUPTIBLE)) {
+				return n ? n : -EINTR;
+			}
+			continue;
+		}
+		memcpy_b(buf, (void *)(buffer + n), bytes);
+
+		/* raw data goes straight to the slave's cooked_q */
+		if(PTY_RAW(tty)) {
+			written = tty_queue_write(&tty->cooked_q, buf, bytes);
+			wakeup(&tty_read);
+			wakeup(&do_select);
+		} else {
+			written = tty_queue_write(&tty->read_q, buf, bytes);
+			tty->input(tty);
+		}
+		n += written;
+		if(written < bytes) {
+			/* out of cblocks */
+			break;
+		}
+		if(need_resched) {
+			do_sched();
+		}
+	}
+
+	if(n) {
+		i->i_mtime = CURRENT_TIME;
+	}
+	return n;
+}
+
+int pty_master_ioctl(struct inode *i, int cmd, unsigned long int arg)
+{
+	struct pty *pty;
+	struct tty *tty;
+	struct winsize *ws;
+	int errno;
+
+	if(!(pty = get_pty(i->rdev))) {
+		return -ENXIO;
+	}
+	tty = pty->tty;
+
+	switch(cmd) {
+		case TCGETS:
+			if((errno = check_user_area(VERIFY_WRITE, (void *)arg, sizeof(struct termios)))) {
+				return errno;
+			}
+			memcpy_b((struct termios *)arg, &tty->termios, sizeof(struct termios));
+			break;
+		case TIOCGWINSZ:
+			if((errno = check_user_area(VERIFY_WRITE, (void *)arg, sizeof(struct winsize)))) {
+				return errno;
+			}
+			memcpy_b((struct winsize *)arg, &tty->winsize, sizeof(struct winsize));
+			break;
+		case TIOCSWINSZ:
+			if((errno = check_user_area(VERIFY_READ, (void *)arg, sizeof(struct winsize)))) {
+				return errno;
+			}
+			ws = (struct winsize *)arg;
+			if(tty->winsize.ws_row != ws->ws_row || tty->winsize.ws_col != ws->ws_col || tty->winsize.ws_xpixel != ws->ws_xpixel || tty->winsize.ws_ypixel != ws->ws_ypixel) {
+				memcpy_b(&tty->winsize, ws, sizeof(struct winsize));
+				if(tty->pgid > 0) {
+					kill_pgrp(tty->pgid, SIGWINCH);
+				}
+			}
+			break;
+		case FIONREAD:
+			if((errno = check_user_area(VERIFY_WRITE, (void *)arg, sizeof(unsigned int)))) {
+				return errno;
+			}
+			*(int *)arg = tty->write_q.count;
+			break;
+		default:
+			return -EINVAL;
+	}
+	return 0;
+}
+
+int pty_master_select(struct inode *i, int flag)
+{
+	struct pty *pty;
+
+	if(!(pty = get_pty(i->rdev))) {
+		return 0;
+	}
+
+	switch(flag) {
+		case SEL_R:
+			if(pty->tty->write_q.count && !(pty->flags & PTY_STOPPED)) {
+				return 1;
+			}
+			if(pty_hungup(pty)) {
+				return 1;
+			}
+			break;
+		case SEL_W:
+			if(pty_room(pty->tty) > 0 || pty_hungup(pty)) {
+				return 1;
+			}
+			break;
+	}
+	return 0;
+}
+
+void pty_init(void)
+{
+	int n, n2;
+	struct tty *tty;
+
+	memset_b(pty_table, NULL, sizeof(pty_table));
+	for(n = 0; n < NR_PTYS; n++) {
+		if(register_tty(MKDEV(PTY_SLAVE_MAJOR, n))) {
+			printk("WARNING: %s(): unable to register ttyp%x.\n", __FUNCTION__, n);
+			break;
+		}
+		tty = get_tty(MKDEV(PTY_SLAVE_MAJOR, n));
+		tty->driver_data = (void *)&pty_table[n];
+		tty->stop = pty_stop;
+		tty->start = pty_start;
+		tty->deltab = tty_deltab;
+		tty->reset = pty_reset;
+		tty->input = do_cook;
+		tty->output = pty_output;
+		tty->open = pty_open;
+		tty->close = pty_close;
+		tty->unthrottle = pty_unthrottle;
+		pty_reset(tty);
+		for(n2 = 0; n2 < MAX_TAB_COLS; n2++) {
+			if(!(n2 % TAB_SIZE)) {
+				tty->tab_stop[n2] = 1;
+			} else {
+				tty->tab_stop[n2] = 0;
+			}
+		}
+		tty->count = 0;
+		pty_table[n].tty = tty;
+		SET_MINOR(pty_master_device.minors, n);
+		SET_MINOR(pty_slave_device.minors, n);
+	}
+	if(!n) {
+		return;
+	}
+
+	if(register_device(CHR_DEV, &pty_master_device)) {
+		printk("WARNING: %s(): unable to register pty master device.\n", __FUNCTION__);
+		return;
+	}
+	if(register_device(CHR_DEV, &pty_slave_device)) {
+		printk("WARNING: %s(): unable to register pty slave device.\n", __FUNCTION__);
+		return;
+	}
+	printk("pty       -                     %d pseudo-terminal pairs (ptyp0-%x, ttyp0-%x)\n", n, n - 1, n - 1);
+}
@@ -0,0 +1,294 @@
+/*
+ * fiwix/drivers/char/random.c
+ *
+ * Copyright 2021, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#include <fiwix/asm.h>
+#include <fiwix/kernel.h>
+#include <fiwix/random.h>
+#include <fiwix/timer.h>
+#include <fiwix/pic.h>
+#include <fiwix/cpu.h>
+#include <fiwix/sleep.h>
+#include <fiwix/sched.h>
+#include <fiwix/process.h>
+#include <fiwix/errno.h>
+#include <fiwix/string.h>
+
+/*
+ * The random numbers come from a ChaCha20 generator that produces blocks of
+ * 64 bytes. Its key is replaced after each request (so the past output can't
+ * be recovered), and it's reseeded from an entropy pool which is fed with
+ * the timing of the interrupts (using the TSC if the CPU has one). The first
+ * seed needs RANDOM_SEED_BITS of entropy, and until then only /dev/urandom
+ * gives numbers.
+ */
+
+#define ROTL(v, n)	(((v) << (n)) | ((v) >> (32 - (n))))
+
+#define QUARTERROUND(a, b, c, d)				\
+	a += b; d ^= a; d = ROTL(d, 16);			\
+	c += d; b ^= c; b = ROTL(b, 12);			\
+	a += b; d ^= a; d = ROTL(d, 8);				\
+	c += d; b ^= c; b = ROTL(b, 7);
+
+/* the last delays between the interrupts of an IRQ line */
+struct irq_timing {
+	unsigned int last_time;
+	int last_delta;
+	int last_delta2;
+};
+
+static unsigned int pool[RANDOM_POOL_WORDS];
+static int pool_pos, pool_rotate;
+static int entropy_count;	/* bits of entropy in the pool */
+static struct irq_timing irq_timing[NR_IRQS];
+
+/* constants (0-3), key (4-11), block counter (12-13) and nonce (14-15) */
+static unsigned int crng_state[16];
+static int crng_seeded;
+static unsigned int last_reseed;
+
+static const unsigned int twist_table[8] = {
+	0x00000000, 0x3B6E20C8, 0x76DC4190, 0x4DB26158,
+	0xEDB88320, 0xD6D6A3E8, 0x9B64C2B0, 0xA00AE278
+};
+
+/* mixes a word into the pool (a twisted GFSR, as in the Linux kernel) */
+static void mix_pool(unsigned int value)
+{
+	unsigned int w;
+	int i;
+
+	w = pool_rotate ? ROTL(value, pool_rotate) : value;
+	i = pool_pos = (pool_pos - 1) & (RANDOM_POOL_WORDS - 1);
+	w ^= pool[i];
+	w ^= pool[(i + 26) & (RANDOM_POOL_WORDS - 1)];
+	w ^= pool[(i + 20) & (RANDOM_POOL_WORDS - 1)];
+	w ^= pool[(i + 14) & (RANDOM_POOL_WORDS - 1)];
+	w ^= pool[(i + 7) & (RANDOM_POOL_WORDS - 1)];
+	w ^= pool[(i + 1) & (RANDOM_POOL_WORDS - 1)];
+	pool[i] = (w >> 3) ^ twist_table[w & 7];
+	pool_rotate = (pool_rotate + (i ? 7 : 14)) & 31;
+}
+
+static unsigned int get_time(void)
+{
+	if(cpu_table.hz) {
+		return (unsigned int)get_rdtsc();
+	}
+	return CURRENT_TICKS;
+}
+
+static void chacha20_block(unsigned int *out)
+{
+	unsigned int x[16];
+	int n;
+
+	for(n = 0; n < 16; n++) {
+		x[n] = crng_state[n];
+	}
+	for(n = 0; n < 10; n++) {
+		QUARTERROUND(x[0], x[4], x[8], x[12]);
+		QUARTERROUND(x[1], x[5], x[9], x[13]);
+		QUARTERROUND(x[2], x[6], x[10], x[14]);
+		QUARTERROUND(x[3], x[7], x[11], x[15]);
+		QUARTERROUND(x[0], x[5], x[10], x[15]);
+		QUARTERROUND(x[1], x[6], x[11], x[12]);
+		QUARTERROUND(x[2], x[7], x[8], x[13]);
+		QUARTERROUND(x[3], x[4], x[9], x[14]);
+	}
+	for(n = 0; n < 16; n++) {
+		out[n] = x[n] + crng_state[n];
+	}
+	if(!++crng_state[12]) {
+		crng_state[13]++;
+	}
+}
+
+/* replaces the key with the first half of a new block */
+static void rekey(void)
+{
+	unsigned int block[16];
+	int n;
+
+	chacha20_block(block);
+	for(n = 0; n < 8; n++) {
+		crng_state[4 + n] = block[n];
+	}
+	memset_b(block, 0, sizeof(block));
+}
+
+/* feeds the key with the contents of the pool */
+static void reseed(void)
+{
+	unsigned long int flags;
+	unsigned int block[16];
+	int n;
+
+	SAVE_FLAGS(flags); CLI();
+	if(entropy_count >= RANDOM_SEED_BITS) {
+		crng_seeded = 1;
+	}
+	for(n = 0; n < 8; n++) {
+		crng_state[4 + n] ^= pool[n] ^ pool[n + 8] ^ pool[n + 16] ^ pool[n + 24];
+	}
+	entropy_count = 0;
+	RESTORE_FLAGS(flags);
+
+	chacha20_block(block);
+	for(n = 0; n < 8; n++) {
+		crng_state[4 + n] = block[n];
+	}
+
+	/* the pool is stirred so that it won't give the same key again */
+	SAVE_FLAGS(flags); CLI();
+	for(n = 8; n < 16; n++) {
+		mix_pool(block[n]);
+	}
+	RESTORE_FLAGS(flags);
+	memset_b(block, 0, sizeof(block));
+	last_reseed = CURRENT_TICKS;
+}
+
+static void check_reseed(void)
+{
+	if(!crng_seeded) {
+		if(entropy_count >= RANDOM_SEED_BITS) {
+			reseed();
+		}
+		return;
+	}
+	if(entropy_count >= RANDOM_RESEED_BITS && CURRENT_TICKS - last_reseed >= RANDOM_RESEED_INTERVAL) {
+		reseed();
+	}
+}
+
+/*
+ * Called on each interrupt (interrupts are disabled). The entropy is
+ * estimated from the smallest of the first, second and third order deltas
+ * of the time between the interrupts of the same IRQ line.
+ */
+void add_irq_randomness(int num)
+{
+	struct irq_timing *t;
+	unsigned int time, delta;
+	int delta1, delta2, delta3, bits;
+
+	time = get_time();
+	mix_pool(time ^ (num << 24));
+
+	t = &irq_timing[num];
+	delta1 = time - t->last_time;
+	t->last_time = time;
+	delta2 = delta1 - t->last_delta;
+	t->last_delta = delta1;
+	delta3 = delta2 - t->last_delta2;
+	t->last_delta2 = delta2;
+
+	delta1 = delta1 < 0 ? -delta1 : delta1;
+	delta2 = delta2 < 0 ? -delta2 : delta2;
+	delta3 = delta3 < 0 ? -delta3 : delta3;
+	delta = (unsigned int)MIN(delta1, MIN(delta2, delta3)) >> 1;
+	for(bits = 0; delta && bits < 11; bits++) {
+		delta >>= 1;
+	}
+
+	/* the timer is too regular to be trusted */
+	if(num == TIMER_IRQ) {
+		bits = MIN(bits, 1);
+	}
+
+	entropy_count = MIN(entropy_count + bits, RANDOM_POOL_BITS);
+	if(!crng_seeded && entropy_count >= RANDOM_SEED_BITS) {
+		wakeup(&random_wait);
+	}
+}
+
+/* mixes data into the pool without crediting any entropy */
+void add_randomness(const void *data, int count)
+{
+	unsigned long int flags;
+	const unsigned char *p;
+	unsigned int w;
+	int n;
+
+	p = (const unsigned char *)data;
+	SAVE_FLAGS(flags); CLI();
+	for(n = 0; n < count; n += 4) {
+		w = p[n];
+		if(n + 1 < count) {
+			w |= p[n + 1] << 8;
+		}
+		if(n + 2 < count) {
+			w |= p[n + 2] << 16;
+		}
+		if(n + 3 < count) {
+			w |= (unsigned int)p[n + 3] << 24;
+		}
+		mix_pool(w);
+	}
+	RESTORE_FLAGS(flags);
+}
+
+/* waits until the generator has been seeded */
+int random_wait(int nonblock)
+{
+	while(!crng_seeded) {
+		check_reseed();
+		if(crng_seeded) {
+			break;
+		}
+		if(nonblock) {
+			return -EAGAIN;
+		}
+		if(sleep(&random_wait, PROC_INTERRUPTIBLE)) {
+			return -EINTR;
+		}
+	}
+	return 0;
+}
+
+int get_random_bytes(char *buffer, int count)
+{
+	unsigned int block[16];
+	int n, bytes;
+
+	check_reseed();
+	for(n = 0; n < count; n += bytes) {
+		if(n && (current->sigpending & ~current->sigblocked)) {
+			break;
+		}
+		chacha20_block(block);
+		bytes = MIN(count - n, CHACHA_BLOCK_SIZE);
+		memcpy_b(buffer + n, block, bytes);
+		if(need_resched) {
+			do_sched();
+		}
+	}
+	memset_b(block, 0, sizeof(block));
+	rekey();
+	return n;
+}
+
+void random_init(void)
+{
+	unsigned long long int tsc;
+	unsigned int time;
+
+	crng_state[0] = 0x61707865;	/* "expand 32-byte k" */
+	crng_state[1] = 0x3320646E;
+	crng_state[2] = 0x79622D32;
+	crng_state[3] = 0x6B206574;
+
+	time = CURRENT_TIME;
+	add_randomness(&time, sizeof(time));
+	if(cpu_table.hz) {
+		tsc = get_rdtsc();
+		add_randomness(&tsc, sizeof(tsc));
+	}
+	add_randomness(&kstat, sizeof(kstat));
+	reseed();
+}
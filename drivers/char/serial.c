@@ -14,7 +14,6 @@
 #include <fiwix/sleep.h>
 #include <fiwix/serial.h>
 #include <fiwix/tty.h>
-#include <fiwix/ctype.h>
 #include <fiwix/stdio.h>
 #include <fiwix/string.h>
 
@@ -67,6 +66,8 @@ static struct device serial_device = {
 	0,
 	NULL,
 	&serial_driver_fsop,
+	NULL,
+	NULL,
 	NULL
 };
 
@@ -103,8 +104,21 @@ static int baud_table[] = {
 	9600,
 	19200,
 	38400,
-	57200,
+	57600,
 	115200,
+	230400,
+	460800,
+	500000,
+	576000,
+	921600,
+	1000000,
+	1152000,
+	1500000,
+	2000000,
+	2500000,
+	3000000,
+	3500000,
+	4000000,
 	0
 };
 
@@ -113,6 +127,19 @@ static struct bh serial_bh = { 0, &irq_serial_bh, NULL };
 static struct interrupt irq_config_serial0 = { 0, "serial", &irq_serial, NULL };
 static struct interrupt irq_config_serial1 = { 0, "serial", &irq_serial, NULL };
 
+static int get_trigger(void)
+{
+	switch(_serialtrigger) {
+		case 1:
+			return UART_FCR_FIFO1;
+		case 4:
+			return UART_FCR_FIFO4;
+		case 8:
+			return UART_FCR_FIFO8;
+	}
+	return UART_FCR_FIFO14;
+}
+
 static int is_serial(__dev_t dev)
 {
 	if(MAJOR(dev) == SERIAL_MAJOR && ((MINOR(dev) >= (1 << SERIAL_MSF) && MINOR(dev) < (1 << SERIAL_MSF) + SERIAL_MINORS))) {
@@ -164,13 +191,60 @@ static int serial_identify(struct serial *s)
 	return 0;
 }
 
+/* sets the interrupts enabled, 'tx' includes the transmitter one */
+static void set_ier(struct serial *s, int tx)
+{
+	s->ier = UART_IER_RDAI | UART_IER_RLSI;
+	if(s->flags & UART_RTSCTS) {
+		s->ier |= UART_IER_MSI;
+	}
+	if(tx) {
+		s->ier |= UART_IER_THREI;
+	}
+	outport_b(s->addr + UART_IER, s->ier);
+}
+
+/* returns the divisor for 'baud', or 0 if it's too far from the rate wanted */
+static int get_divisor(struct serial *s, int baud)
+{
+	int divisor, real;
+
+	if(!baud || baud > s->baud_base) {
+		return 0;
+	}
+	divisor = (s->baud_base + (baud / 2)) / baud;
+	real = s->baud_base / divisor;
+	if((real > baud ? real - baud : baud - real) > baud / 50) {
+		return 0;
+	}
+	return divisor;
+}
+
+/* room left for input characters until they are read */
+static int rx_room(struct tty *tty)
+{
+	return tty_queue_room(&tty->cooked_q) - tty->read_q.count;
+}
+
+static void set_rts(struct serial *s, int on)
+{
+	if(on) {
+		s->mcr |= UART_MCR_RTS;
+		s->flags &= ~UART_THROTTLED;
+	} else {
+		s->mcr &= ~UART_MCR_RTS;
+		s->flags |= UART_THROTTLED;
+	}
+	outport_b(s->addr + UART_MCR, s->mcr);
+}
+
 static void serial_default(struct serial *s)
 {
 	int divisor;
 
 	outport_b(s->addr + UART_IER, 0);	/* disable all interrupts */
 
-	divisor = 115200 / s->baud;
+	divisor = get_divisor(s, s->baud);
 	outport_b(s->addr + UART_LCR, UART_LCR_DLAB);	/* enable DLAB */
 	outport_b(s->addr + UART_DLL, divisor & 0xFF);	/* LSB of divisor */
 	outport_b(s->addr + UART_DLH, divisor >> 8);	/* MSB of divisor */
@@ -185,7 +259,7 @@ static void serial_stop(struct tty *tty)
 
 	SAVE_FLAGS(flags); CLI();
 	s = (struct serial *)tty->driver_data;
-	outport_b(s->addr + UART_IER, UART_IER_RDAI);
+	set_ier(s, 0);
 	RESTORE_FLAGS(flags);
 }
 
@@ -197,44 +271,10 @@ static void serial_start(struct tty *tty)
 
 	SAVE_FLAGS(flags); CLI();
 	s = (struct serial *)tty->driver_data;
-	outport_b(s->addr + UART_IER, UART_IER_RDAI | UART_IER_THREI);
+	set_ier(s, 1);
 	RESTORE_FLAGS(flags);
 }
 
-static void serial_deltab(struct tty *tty)
-{
-	unsigned short int col, n, count;
-	struct cblock *cb;
-	unsigned char ch;
-
-	cb = tty->cooked_q.head;
-	col = count = 0;
-
-	while(cb) {
-		for(n = 0; n < cb->end_off; n++) {
-			if(n >= cb->start_off) {
-				ch = cb->data[n];
-				if(ch == '\t') {
-					while(!tty->tab_stop[++col]);
-				} else {
-					col++;
-					if(ISCNTRL(ch) && !ISSPACE(ch) && tty->termios.c_lflag & ECHOCTL) {
-						col++;
-					}
-				}
-				col %= 80;
-			}
-		}
-		cb = cb->next;
-	}
-	count = tty->column - col;
-
-	while(count--) {
-		tty_queue_putchar(tty, &tty->write_q, '\b');
-		tty->column--;
-	}
-}
-
 static void serial_reset(struct tty *tty)
 {
 	termios_reset(tty);
@@ -245,6 +285,27 @@ static void serial_reset(struct tty *tty)
 	tty->lnext = 0;
 }
 
+/* reads the Line Status Register, accounting the errors of the input */
+static int read_lsr(struct serial *s)
+{
+	int status;
+
+	status = inport_b(s->addr + UART_LSR);
+	if(status & UART_LSR_OE) {
+		s->stats.overrun++;
+	}
+	if(status & UART_LSR_PE) {
+		s->stats.parity++;
+	}
+	if(status & UART_LSR_FE) {
+		s->stats.frame++;
+	}
+	if(status & UART_LSR_BI) {
+		s->stats.brk++;
+	}
+	return status;
+}
+
 static void serial_errors(struct serial *s, int status)
 {
 	struct tty *tty;
@@ -276,74 +337,106 @@ static void serial_errors(struct serial *s, int status)
 
 static void serial_send(struct tty *tty)
 {
-	unsigned char ch;
+	unsigned char buf[UART_FIFO_SIZE];
 	struct serial *s;
-	int count;
+	int n, count;
 
 	s = (struct serial *)tty->driver_data;
 
 	if(!tty->write_q.count) {
-		outport_b(s->addr + UART_IER, UART_IER_RDAI);
+		set_ier(s, 0);
 		return;
 	}
 
-	count = 0;
-	while(tty->write_q.count > 0 && count < UART_FIFO_SIZE) {
-		ch = tty_queue_getchar(&tty->write_q);
-		outport_b(s->addr + UART_TD, ch);
-		count++;
+	/* the modem status interrupt will resume the output */
+	if(s->flags & UART_RTSCTS) {
+		if(!(inport_b(s->addr + UART_MSR) & UART_MSR_CTS)) {
+			set_ier(s, 0);
+			return;
+		}
 	}
 
+	count = tty_queue_read(&tty->write_q, buf, s->flags & UART_HAS_FIFO ? UART_FIFO_SIZE : 1);
+	for(n = 0; n < count; n++) {
+		outport_b(s->addr + UART_TD, buf[n]);
+	}
+	s->stats.tx += count;
+
 	if(!tty->write_q.count) {
-		outport_b(s->addr + UART_IER, UART_IER_RDAI);
+		set_ier(s, 0);
 	}
 	wakeup(&tty_write);
 }
 
-static int serial_receive(struct serial *s)
+/*
+ * Takes the characters from the receiver in a single run, which are queued
+ * all at once. The characters that don't fit in the queue are discarded, so
+ * the receiver doesn't keep interrupting. Returns the last line status.
+ */
+static int serial_receive(struct serial *s, int status)
 {
-	int status, errno;
-	unsigned char ch;
+	unsigned char buf[UART_FIFO_SIZE];
 	struct tty *tty;
+	int n, count;
 
-	errno = 0;
 	tty = s->tty;
+	n = 0;
 
 	do {
-		if(!tty_queue_room(&tty->read_q)) {
-			errno = -EAGAIN;
-			break;
+		buf[n++] = inport_b(s->addr + UART_RD);
+		status = read_lsr(s);
+	} while((status & UART_LSR_RDA) && n < UART_FIFO_SIZE);
+
+	count = tty_queue_write(&tty->read_q, buf, n);
+	s->stats.rx += count;
+	s->stats.dropped += n - count;
+
+	if((s->flags & (UART_RTSCTS | UART_THROTTLED)) == UART_RTSCTS) {
+		if(rx_room(tty) < UART_RTS_LOW) {
+			set_rts(s, 0);
 		}
-		ch = inport_b(s->addr + UART_RD);
-		tty_queue_putchar(tty, &tty->read_q, ch);
-		status = inport_b(s->addr + UART_LSR);
-	} while(status & UART_LSR_RDA);
+	}
 
 	serial_bh.flags |= BH_ACTIVE;
-	return errno;
+	return status;
+}
+
+static void serial_modem_status(struct serial *s)
+{
+	int status;
+
+	status = inport_b(s->addr + UART_MSR);
+	if((s->flags & UART_RTSCTS) && (status & UART_MSR_CTS)) {
+		if(s->tty->write_q.count) {
+			set_ier(s, 1);
+		}
+	}
 }
 
 void irq_serial(int num, struct sigcontext *sc)
 {
 	struct serial *s;
-	int status;
+	int iir, status, errors;
 
 	s = serial_ports;
 
 	if(s) {
 		do {
 			if(s->irq == num) {
-				while(!(inport_b(s->addr + UART_IIR) & UART_IIR_NOINT)) {
-					status = inport_b(s->addr + UART_LSR);
+				while(!((iir = inport_b(s->addr + UART_IIR)) & UART_IIR_NOINT)) {
+					s->stats.interrupts++;
+					status = errors = read_lsr(s);
 					if(status & UART_LSR_RDA) {
-						if(serial_receive(s)) {
-							break;
-						}
+						status = serial_receive(s, status);
+						errors |= status;
 					}
-					if(status & UART_LSR_THRE) {
+					if((iir & UART_IIR_MKINT) == UART_IIR_MSI) {
+						serial_modem_status(s);
+					}
+					if((status & UART_LSR_THRE) && (s->ier & UART_IER_THREI)) {
 						serial_send(s->tty);
 					}
-					serial_errors(s, status);
+					serial_errors(s, errors);
 				}
 			}
 			s = s->next;
@@ -365,12 +458,14 @@ int serial_open(struct tty *tty)
 
 	/* enable FIFO */
 	if(s->flags & UART_HAS_FIFO) {
-		outport_b(s->addr + UART_FCR, UART_FCR_FIFO | UART_FCR_FIFO14);
+		outport_b(s->addr + UART_FCR, UART_FCR_FIFO | get_trigger());
 	}
-	outport_b(s->addr + UART_MCR, UART_MCR_OUT2 | UART_MCR_RTS | UART_MCR_DTR);
+	s->flags &= ~UART_THROTTLED;
+	s->mcr = UART_MCR_OUT2 | UART_MCR_RTS | UART_MCR_DTR;
+	outport_b(s->addr + UART_MCR, s->mcr);
 
 	/* enable interrupts */
-	outport_b(s->addr + UART_IER, UART_IER_RDAI);
+	set_ier(s, 0);
 
 	/* clear all input registers */
 	inport_b(s->addr + UART_RD);
@@ -398,6 +493,7 @@ int serial_close(struct tty *tty)
 	}
 
 	/* disable all interrupts */
+	s->ier = 0;
 	outport_b(s->addr + UART_IER, 0);
 
 	/* disable FIFO */
@@ -414,6 +510,7 @@ void serial_set_termios(struct tty *tty)
 	short int divisor;
 	int baud, size, stop;
 	int lctrl;
+	unsigned long int flags;
 	struct serial *s;
 
 	s = (struct serial *)tty->driver_data;
@@ -422,7 +519,14 @@ void serial_set_termios(struct tty *tty)
 	if(!(baud = tty->termios.c_cflag & CBAUD)) {
 		return;
 	}
-	divisor = 115200 / baud_table[baud];
+	if(baud & CBAUDEX) {
+		baud = (baud & ~CBAUDEX) + B38400;
+	}
+	if(!(divisor = get_divisor(s, baud_table[baud]))) {
+		printk("WARNING: %s(): %s doesn't support %d bps (base %d).\n", __FUNCTION__, s->name, baud_table[baud], s->baud_base);
+		return;
+	}
+	s->baud = baud_table[baud];
 
 	outport_b(s->addr + UART_LCR, UART_LCR_DLAB);	/* enable DLAB */
 	outport_b(s->addr + UART_DLL, divisor & 0xFF);	/* LSB of divisor */
@@ -462,9 +566,22 @@ void serial_set_termios(struct tty *tty)
 		lctrl |= UART_LCR_NP;
 	}
 
-	/* FIXME: flow control RTSCTS no supported */
-
 	outport_b(s->addr + UART_LCR, lctrl);	/* line control */
+	s->lctrl = lctrl;
+
+	SAVE_FLAGS(flags); CLI();
+	if(tty->termios.c_cflag & CRTSCTS) {
+		s->flags |= UART_RTSCTS;
+	} else {
+		s->flags &= ~UART_RTSCTS;
+		if(s->flags & UART_THROTTLED) {
+			set_rts(s, 1);
+		}
+	}
+	if(s->ier) {
+		set_ier(s, s->ier & UART_IER_THREI);
+	}
+	RESTORE_FLAGS(flags);
 }
 
 void serial_write(struct tty *tty)
@@ -474,7 +591,7 @@ void serial_write(struct tty *tty)
 
 	SAVE_FLAGS(flags); CLI();
 	s = (struct serial *)tty->driver_data;
-	outport_b(s->addr + UART_IER, UART_IER_RDAI | UART_IER_THREI);
+	set_ier(s, 1);
 	RESTORE_FLAGS(flags);
 }
 
@@ -482,6 +599,7 @@ void irq_serial_bh(void)
 {
 	struct tty *tty;
 	struct serial *s;
+	unsigned long int flags;
 
 	s = serial_ports;
 
@@ -496,6 +614,17 @@ void irq_serial_bh(void)
 					serial_bh.flags |= BH_ACTIVE;
 				}
 			}
+
+			/* keep checking until the reader makes room */
+			SAVE_FLAGS(flags); CLI();
+			if(s->flags & UART_THROTTLED) {
+				if(rx_room(tty) >= UART_RTS_HIGH) {
+					set_rts(s, 1);
+				} else {
+					serial_bh.flags |= BH_ACTIVE;
+				}
+			}
+			RESTORE_FLAGS(flags);
 			s = s->next;
 		} while(s);
 	}
@@ -507,8 +636,13 @@ void serial_init(void)
 	struct serial **sp, *s;
 	struct tty *tty;
 
+	if(!_serialbase) {
+		_serialbase = UART_BAUD_BASE;
+	}
+
 	for(n = 0, found = 0; n < SERIAL_MINORS; n++) {
 		s = &serial_table[n];
+		s->baud_base = _serialbase;
 		if((type = serial_identify(s))) {
 			printk("ttyS%d     0x%04X-0x%04X    %d    type=%s%s\n", n, s->addr, s->addr + 7, s->irq, serial_chip[type], s->flags & UART_HAS_FIFO ? " FIFO=yes" : "");
 
@@ -525,7 +659,7 @@ void serial_init(void)
 				tty->driver_data = (void *)s;
 				tty->stop = serial_stop;
 				tty->start = serial_start;
-				tty->deltab = serial_deltab;
+				tty->deltab = tty_deltab;
 				tty->reset = serial_reset;
 				tty->input = do_cook;
 				tty->output = serial_write;
@@ -416,6 +416,41 @@ void do_cook(struct tty *tty)
 	wakeup(&tty_read);
 }
 
+/* moves the cursor back to the column before the last tab (echoed as spaces) */
+void tty_deltab(struct tty *tty)
+{
+	unsigned short int col, n, count;
+	struct cblock *cb;
+	unsigned char ch;
+
+	cb = tty->cooked_q.head;
+	col = count = 0;
+
+	while(cb) {
+		for(n = 0; n < cb->end_off; n++) {
+			if(n >= cb->start_off) {
+				ch = cb->data[n];
+				if(ch == '\t') {
+					while(!tty->tab_stop[++col]);
+				} else {
+					col++;
+					if(ISCNTRL(ch) && !ISSPACE(ch) && tty->termios.c_lflag & ECHOCTL) {
+						col++;
+					}
+				}
+				col %= 80;
+			}
+		}
+		cb = cb->next;
+	}
+	count = tty->column - col;
+
+	while(count--) {
+		tty_queue_putchar(tty, &tty->write_q, '\b');
+		tty->column--;
+	}
+}
+
 int tty_open(struct inode *i, struct fd *fd_table)
 {
 	int noctty_flag;
@@ -488,6 +523,21 @@ int tty_close(struct inode *i, struct fd *fd_table)
 	return 0;
 }
 
+/* moves the characters of a queue to the buffer of the process */
+static int read_queue(struct clist *q, char *buffer, int count)
+{
+	unsigned char buf[CBSIZE];
+	int n, bytes;
+
+	for(n = 0; n < count; n += bytes) {
+		if(!(bytes = tty_queue_read(q, buf, MIN(count - n, CBSIZE)))) {
+			break;
+		}
+		memcpy_b(buffer + n, buf, bytes);
+	}
+	return n;
+}
+
 int tty_read(struct inode *i, struct fd *fd_table, char *buffer, __size_t count)
 {
 	unsigned int min;
@@ -513,15 +563,7 @@ int tty_read(struct inode *i, struct fd *fd_table, char *buffer, __size_t count)
 	n = min = 0;
 	while(count > 0) {
 		if(tty->kbd.mode == K_RAW || tty->kbd.mode == K_MEDIUMRAW) {
-			n = 0;
-			while(n < count) {
-				if((ch = tty_queue_getchar(&tty->read_q))) {
-					buffer[n++] = ch;
-				} else {
-					break;
-				}
-			}
-			if(n) {
+			if((n = read_queue(&tty->read_q, buffer, count))) {
 				break;
 			}
 		}
@@ -536,13 +578,7 @@ int tty_read(struct inode *i, struct fd *fd_table, char *buffer, __size_t count)
 						tty_queue_unputchar(&tty->cooked_q);
 					}
 
-					while(n < count) {
-						if((ch = tty_queue_getchar(&tty->cooked_q))) {
-							buffer[n++] = ch;
-						} else {
-							break;
-						}
-					}
+					n += read_queue(&tty->cooked_q, buffer + n, count - n);
 					break;
 				}
 			}
@@ -566,13 +602,7 @@ int tty_read(struct inode *i, struct fd *fd_table, char *buffer, __size_t count)
 							return -EINTR;
 						}
 					}
-					while(n < count) {
-						if((ch = tty_queue_getchar(&tty->cooked_q))) {
-							buffer[n++] = ch;
-						} else {
-							break;
-						}
-					}
+					n += read_queue(&tty->cooked_q, buffer + n, count - n);
 					break;
 				} else {
 					if(tty->cooked_q.count > 0) {
@@ -633,14 +663,35 @@ int tty_read(struct inode *i, struct fd *fd_table, char *buffer, __size_t count)
 	if(n) {
 		i->i_atime = CURRENT_TIME;
 	}
+	if(n > 0 && tty->unthrottle) {
+		tty->unthrottle(tty);
+	}
+	return n;
+}
+
+/*
+ * Returns the number of characters at the beginning of 'buf' that don't
+ * need output processing, so they can be queued all at once.
+ */
+static int output_run(struct tty *tty, unsigned char *buf, int count)
+{
+	int n;
+
+	if(!(tty->termios.c_oflag & OPOST)) {
+		return count;
+	}
+	if(tty->termios.c_oflag & OLCUC) {
+		return 0;
+	}
+	for(n = 0; n < count && !ISCNTRL(buf[n]); n++);
 	return n;
 }
 
 int tty_write(struct inode *i, struct fd *fd_table, const char *buffer, __size_t count)
 {
-	unsigned char ch;
+	unsigned char buf[CBSIZE];
 	struct tty *tty;
-	int n;
+	int n, bytes, run, written;
 
 	if(!(tty = get_tty(i->rdev))) {
 		printk("%s(): oops! (%x)\n", __FUNCTION__, i->rdev);
@@ -665,13 +716,24 @@ int tty_write(struct inode *i, struct fd *fd_table, const char *buffer, __size_t
 		if(current->sigpending & ~current->sigblocked) {
 			return -ERESTART;
 		}
-		while(count && n < count) {
-			ch = *(buffer + n);
-			/* FIXME: check if *(buffer + n) address is valid */
-			if(opost(tty, ch) < 0) {
+		while(n < count) {
+			bytes = MIN(count - n, CBSIZE);
+			memcpy_b(buf, (void *)(buffer + n), bytes);
+			if(!(run = output_run(tty, buf, bytes))) {
+				if(opost(tty, buf[0]) < 0) {
+					break;
+				}
+				n++;
+				continue;
+			}
+			written = tty_queue_write(&tty->write_q, buf, run);
+			if(tty->termios.c_oflag & OPOST) {
+				tty->column += written;
+			}
+			n += written;
+			if(written < run) {
 				break;
 			}
-			n++;
 		}
 		tty->output(tty);
 		if(n == count) {
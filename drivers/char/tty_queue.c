@@ -58,7 +58,6 @@ static struct cblock *insert_cblock_in_head(struct clist *q)
 
 	/* initialize cblock */
 	cb->start_off = cb->end_off = 0;
-	memset_b(cb->data, 0, CBSIZE);
 	cb->prev = cb->next = NULL;
 	q->cb_num++;
 
@@ -86,7 +85,6 @@ static struct cblock *insert_cblock_in_tail(struct clist *q)
 
 	/* initialize cblock */
 	cb->start_off = cb->end_off = 0;
-	memset_b(cb->data, 0, CBSIZE);
 	cb->prev = cb->next = NULL;
 	q->cb_num++;
 
@@ -176,6 +174,32 @@ int tty_queue_putchar(struct tty *tty, struct clist *q, unsigned char ch)
 	return errno;
 }
 
+/* appends up to 'count' characters, returns the number of them queued */
+int tty_queue_write(struct clist *q, const unsigned char *buffer, int count)
+{
+	unsigned long int flags;
+	struct cblock *cb;
+	int n, bytes;
+
+	SAVE_FLAGS(flags); CLI();
+
+	for(n = 0; n < count; n += bytes) {
+		cb = q->tail;
+		if(!cb || cb->end_off >= CBSIZE) {
+			if(!(cb = insert_cblock_in_tail(q))) {
+				break;
+			}
+		}
+		bytes = MIN(CBSIZE - cb->end_off, count - n);
+		memcpy_b(cb->data + cb->end_off, (void *)(buffer + n), bytes);
+		cb->end_off += bytes;
+		q->count += bytes;
+	}
+
+	RESTORE_FLAGS(flags);
+	return n;
+}
+
 int tty_queue_unputchar(struct clist *q)
 {
 	unsigned long int flags;
@@ -226,6 +250,29 @@ unsigned char tty_queue_getchar(struct clist *q)
 	return ch;
 }
 
+/* removes up to 'count' characters, returns the number of them copied */
+int tty_queue_read(struct clist *q, unsigned char *buffer, int count)
+{
+	unsigned long int flags;
+	struct cblock *cb;
+	int n, bytes;
+
+	SAVE_FLAGS(flags); CLI();
+
+	for(n = 0; n < count && (cb = q->head); n += bytes) {
+		bytes = MIN(cb->end_off - cb->start_off, count - n);
+		memcpy_b(buffer + n, cb->data + cb->start_off, bytes);
+		cb->start_off += bytes;
+		q->count -= bytes;
+		if(cb->end_off - cb->start_off == 0) {
+			delete_cblock_from_head(q);
+		}
+	}
+
+	RESTORE_FLAGS(flags);
+	return n;
+}
+
 void tty_queue_flush(struct clist *q)
 {
 	unsigned long int flags;
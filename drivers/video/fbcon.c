@@ -21,6 +21,8 @@ unsigned char *font_data;
 unsigned char *cursor_shape;
 struct video_parms video;
 static unsigned char screen_is_off = 0;
+static unsigned char shadow_batch = 0;	/* drawing only on the shadow copy */
+static int shadow_moved = -1;		/* first line scrolled only in the shadow */
 
 /* RGB colors */
 static int color_table[] = {
@@ -85,6 +87,7 @@ static void set_color(void *addr, int color)
 			b = (color & 0xFF) << 8;
 			addr16 = (unsigned short int *)addr;
 			*addr16 = (r & 0xf800) | ((g & 0xfc00) >> 5) | ((b & 0xf800) >> 11);
+			break;
 		case 15:
 			/* 1:5:5:5 */
 			r = ((color >> 16) & 0xFF) << 8;
@@ -96,16 +99,159 @@ static void set_color(void *addr, int color)
 	}
 }
 
-static void draw_glyph(unsigned char *addr, int x, int y, unsigned char *ch, int color)
+/*
+ * The glyphs 8 pixels wide are drawn a whole row at a time. The bits of the
+ * row are expanded to pixels using masks precomputed for the depth of the
+ * screen, so each pixel word is just (mask & (fg ^ bg)) ^ bg.
+ */
+static unsigned int mask8[16];		/* 4 pixels of 8bpp per nibble */
+static unsigned int mask16[4];		/* 2 pixels of 15/16bpp per 2 bits */
+static unsigned int mask24[16][3];	/* 4 pixels of 24bpp per nibble */
+
+static unsigned int pixel_table[16];	/* color_table in the screen format */
+
+/* the words of the last color pair used, replicated for the screen depth */
+static int glyph_color = -1;
+static unsigned int glyph_fg[3], glyph_bg[3];
+
+static unsigned int get_pixel(int color)
 {
-	int n, b, offset;
+	int r, g, b;
 
-	if(screen_is_off) {
-		return;
+	r = (color >> 16) & 0xFF;
+	g = (color >> 8) & 0xFF;
+	b = color & 0xFF;
+	switch(video.fb_bpp) {
+		case 32:
+		case 24:
+			return color;
+		case 16:
+			/* 0:5:6:5 */
+			return ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+		case 15:
+			/* 1:5:5:5 */
+			return ((r >> 3) << 10) | ((g >> 3) << 5) | (b >> 3);
 	}
+	return 0;
+}
 
-	offset = (y * video.fb_linesize) + (x * video.fb_bpp);
-	addr += offset;
+static void set_glyph_colors(unsigned int *words, int index)
+{
+	unsigned int pixel;
+
+	pixel = pixel_table[index];
+	switch(video.fb_bpp) {
+		case 8:
+			pixel = index;		/* the first 16 entries of the palette */
+			pixel |= pixel << 8;
+			words[0] = pixel | (pixel << 16);
+			break;
+		case 15:
+		case 16:
+			words[0] = pixel | (pixel << 16);
+			break;
+		case 24:
+			/* 4 pixels take 3 words */
+			pixel &= 0xFFFFFF;
+			words[0] = pixel | (pixel << 24);
+			words[1] = (pixel >> 8) | (pixel << 16);
+			words[2] = (pixel >> 16) | (pixel << 8);
+			break;
+		case 32:
+			words[0] = pixel;
+			break;
+	}
+}
+
+static void draw_glyph_rows(unsigned char *addr, unsigned char *ch, int color)
+{
+	unsigned int *p, diff[3], *bg;
+	unsigned char row;
+	int n, b;
+
+	if(color != glyph_color) {
+		set_glyph_colors(glyph_fg, (color & 0xF));
+		set_glyph_colors(glyph_bg, (color >> 4) & 7);
+		glyph_color = color;
+	}
+	bg = glyph_bg;
+	diff[0] = glyph_fg[0] ^ bg[0];
+	diff[1] = glyph_fg[1] ^ bg[1];
+	diff[2] = glyph_fg[2] ^ bg[2];
+
+	for(n = 0; n < video.fb_char_height; n++, addr += video.fb_pitch) {
+		row = ch[n];
+		if(!row && ch == cursor_shape) {
+			continue;
+		}
+		p = (unsigned int *)addr;
+		switch(video.fb_bpp) {
+			case 8:
+				p[0] = (mask8[row >> 4] & diff[0]) ^ bg[0];
+				p[1] = (mask8[row & 0xF] & diff[0]) ^ bg[0];
+				break;
+			case 15:
+			case 16:
+				p[0] = (mask16[row >> 6] & diff[0]) ^ bg[0];
+				p[1] = (mask16[(row >> 4) & 3] & diff[0]) ^ bg[0];
+				p[2] = (mask16[(row >> 2) & 3] & diff[0]) ^ bg[0];
+				p[3] = (mask16[row & 3] & diff[0]) ^ bg[0];
+				break;
+			case 24:
+				p[0] = (mask24[row >> 4][0] & diff[0]) ^ bg[0];
+				p[1] = (mask24[row >> 4][1] & diff[1]) ^ bg[1];
+				p[2] = (mask24[row >> 4][2] & diff[2]) ^ bg[2];
+				p[3] = (mask24[row & 0xF][0] & diff[0]) ^ bg[0];
+				p[4] = (mask24[row & 0xF][1] & diff[1]) ^ bg[1];
+				p[5] = (mask24[row & 0xF][2] & diff[2]) ^ bg[2];
+				break;
+			case 32:
+				for(b = 0; b < 8; b++) {
+					p[b] = row & (0x80 >> b) ? glyph_fg[0] : bg[0];
+				}
+				break;
+		}
+	}
+}
+
+static void init_glyph_masks(void)
+{
+	unsigned char bytes[12];
+	int n, b;
+
+	for(n = 0; n < 16; n++) {
+		mask8[n] = 0;
+		memset_b(bytes, 0, sizeof(bytes));
+		for(b = 0; b < 4; b++) {
+			/* the leftmost pixel is the highest bit */
+			if(n & (8 >> b)) {
+				mask8[n] |= 0xFF << (b * 8);
+				memset_b(bytes + (b * 3), 0xFF, 3);
+			}
+		}
+		memcpy_b(mask24[n], bytes, sizeof(bytes));
+	}
+	for(n = 0; n < 4; n++) {
+		mask16[n] = (n & 2 ? 0x0000FFFF : 0) | (n & 1 ? 0xFFFF0000 : 0);
+	}
+	for(n = 0; n < 16; n++) {
+		pixel_table[n] = get_pixel(color_table[n]);
+	}
+}
+
+static void render_glyph(unsigned char *addr, unsigned char *ch, int color)
+{
+	int n, b;
+
+	switch(video.fb_char_width == 8 ? video.fb_bpp : 0) {
+		case 8:
+		case 15:
+		case 16:
+		case 24:
+		case 32:
+			draw_glyph_rows(addr, ch, color);
+			return;
+	}
 
 	for(n = 0; n < video.fb_char_height; n++) {
 		if(*(ch + n) == 0) {
@@ -131,7 +277,95 @@ static void draw_glyph(unsigned char *addr, int x, int y, unsigned char *ch, int
 				b--;
 			} while(b >= 0);
 		}
-		addr += (video.fb_width - video.fb_char_width) * video.fb_pixelwidth;
+		addr += video.fb_pitch - (video.fb_char_width * video.fb_pixelwidth);
+	}
+}
+
+/*
+ * If there is a shadow copy of the screen, the glyphs are drawn there and
+ * then their rows are copied to the video memory (unless the whole screen
+ * is going to be copied afterwards).
+ */
+static void draw_glyph(unsigned char *addr, int x, int y, unsigned char *ch, int color)
+{
+	unsigned char *shadow;
+	int n, offset, bytes;
+
+	if(screen_is_off) {
+		return;
+	}
+
+	offset = (y * video.fb_linesize) + (x * video.fb_char_width * video.fb_pixelwidth);
+	if(!(shadow = video.fb_shadow)) {
+		render_glyph(addr + offset, ch, color);
+		return;
+	}
+
+	render_glyph(shadow + offset, ch, color);
+	if(shadow_batch) {
+		return;
+	}
+	addr += offset;
+	shadow += offset;
+	bytes = video.fb_char_width * video.fb_pixelwidth;
+	for(n = 0; n < video.fb_char_height; n++) {
+		if(bytes & 3) {
+			memcpy_b(addr, shadow, bytes);
+		} else {
+			memcpy_l(addr, shadow, bytes / sizeof(unsigned int));
+		}
+		addr += video.fb_pitch;
+		shadow += video.fb_pitch;
+	}
+}
+
+/* copies the text lines from 'top' to 'bottom' (excluded) to the screen */
+static void flush_shadow(unsigned char *vidmem, int top, int bottom)
+{
+	int offset;
+
+	offset = top * video.fb_linesize;
+	memcpy_l(vidmem + offset, video.fb_shadow + offset, ((bottom - top) * video.fb_linesize) / sizeof(unsigned int));
+}
+
+/* copies the columns from 'x1' to 'x2' (excluded) of the text lines from 'y1' to 'y2' (excluded) */
+static void flush_shadow_area(unsigned char *vidmem, int x1, int y1, int x2, int y2)
+{
+	int n, offset, bytes;
+
+	if(!x1 && x2 == video.columns) {
+		flush_shadow(vidmem, y1, y2);
+		return;
+	}
+
+	offset = (y1 * video.fb_linesize) + (x1 * video.fb_char_width * video.fb_pixelwidth);
+	bytes = (x2 - x1) * video.fb_char_width * video.fb_pixelwidth;
+	for(n = (y2 - y1) * video.fb_char_height; n; n--) {
+		if(bytes & 3) {
+			memcpy_b(vidmem + offset, video.fb_shadow + offset, bytes);
+		} else {
+			memcpy_l(vidmem + offset, video.fb_shadow + offset, bytes / sizeof(unsigned int));
+		}
+		offset += video.fb_pitch;
+	}
+}
+
+/* moves the text lines in the shadow copy, leaving 'lines' blank lines */
+static void scroll_shadow(int top, int bottom, int lines, int mode)
+{
+	unsigned char *shadow;
+	int y, lsize;
+
+	shadow = video.fb_shadow;
+	lsize = video.fb_linesize;
+	if(mode == SCROLL_UP) {
+		memcpy_l(shadow + (top * lsize), shadow + ((top + lines) * lsize), ((bottom - top - lines) * lsize) / sizeof(unsigned int));
+		memset_l(shadow + ((bottom - lines) * lsize), 0, (lines * lsize) / sizeof(unsigned int));
+	} else {
+		for(y = bottom - lines - 1; y >= top; y--) {
+			memcpy_l(shadow + ((y + lines) * lsize), shadow + (y * lsize), lsize / sizeof(unsigned int));
+		}
+		memset_l(shadow + (top * lsize), 0, (lines * lsize) / sizeof(unsigned int));
 	}
 }
 
@@ -174,10 +408,14 @@ void fbcon_put_char(struct vconsole *vc, unsigned char ch)
 		return;
 	}
 
-	vidmem = vc->vidmem;
-	draw_glyph(vidmem, vc->x, vc->y, &font_data[ch * video.fb_char_height], vc->color_attr >> 8);
 	screen[(vc->y * vc->columns) + vc->x] = vc->color_attr | ch;
 	vcbuf[(video.buf_y * vc->columns) + vc->x] = vc->color_attr | ch;
+	if(vc->flags & CONSOLE_BATCH) {
+		vconsole_damage(vc, (vc->y * vc->columns) + vc->x, 1);
+		return;
+	}
+	vidmem = vc->vidmem;
+	draw_glyph(vidmem, vc->x, vc->y, &font_data[ch * video.fb_char_height], vc->color_attr >> 8);
 }
 
 void fbcon_insert_char(struct vconsole *vc)
@@ -193,10 +431,11 @@ void fbcon_insert_char(struct vconsole *vc)
 	n = vc->x;
 	last_ch = &font_data[SPACE_CHAR * video.fb_char_height];
 	slast_ch = BLANK_MEM;
+	vconsole_damage(vc, soffset, vc->columns - vc->x);
 
 	while(n < vc->columns) {
 		tmp = screen[soffset];
-		if(vc->flags & CONSOLE_HAS_FOCUS) {
+		if(CAN_DRAW(vc)) {
 			draw_glyph(vidmem, n, vc->y, last_ch, vc->color_attr >> 8);
 			last_ch = &font_data[(tmp & 0xFF) * video.fb_char_height];
 		}
@@ -218,10 +457,11 @@ void fbcon_delete_char(struct vconsole *vc)
 	screen = vc->screen;
 	soffset = (vc->y * vc->columns) + vc->x;
 	n = vc->x;
+	vconsole_damage(vc, soffset, vc->columns - vc->x);
 
 	while(n < vc->columns) {
 		sch = screen[soffset + 1];
-		if(vc->flags & CONSOLE_HAS_FOCUS) {
+		if(CAN_DRAW(vc)) {
 			if(sch & 0xFF) {
 				ch = &font_data[(sch & 0xFF) * video.fb_char_height];
 			} else {
@@ -285,7 +525,8 @@ void fbcon_write_screen(struct vconsole *vc, int from, int count, short int colo
 	short int *screen;
 
 	screen = vc->screen;
-	if(!(vc->flags & CONSOLE_HAS_FOCUS)) {
+	if(!CAN_DRAW(vc)) {
+		vconsole_damage(vc, from, count);
 		memset_w(screen + from, color, count);
 		return;
 	}
@@ -332,7 +573,7 @@ void fbcon_blank_screen(struct vconsole *vc)
 void fbcon_scroll_screen(struct vconsole *vc, int top, int mode)
 {
 	int soffset, poffset, count;
-	int x, y;
+	int x, y, redraw, moved;
 	short int *screen, sch, pch;
 	unsigned char *vidmem, *ch;
 
@@ -342,9 +583,33 @@ void fbcon_scroll_screen(struct vconsole *vc, int top, int mode)
 	if(!top) {
 		top = vc->top;
 	}
+
+	/*
+	 * With a shadow copy the screen is moved instead of redrawn. During a
+	 * write the moved lines are copied to the screen at the end, and only
+	 * the new ones are drawn.
+	 */
+	redraw = CAN_DRAW(vc);
+	moved = !(vc->flags & CONSOLE_BATCH);
+	if(video.fb_shadow && (vc->flags & CONSOLE_HAS_FOCUS)) {
+		if(!screen_is_off) {
+			scroll_shadow(top, vc->lines, 1, mode);
+			if(redraw) {
+				flush_shadow(vidmem, top, vc->lines);
+			} else if(shadow_moved < 0 || top < shadow_moved) {
+				shadow_moved = top;
+			}
+		}
+		vconsole_scroll_damage(vc, top, mode);
+		redraw = 0;
+		moved = 1;
+	} else {
+		vconsole_damage(vc, top * vc->columns, (vc->lines - top) * vc->columns);
+	}
+
 	switch(mode) {
 		case SCROLL_UP:
-			if(vc->flags & CONSOLE_HAS_FOCUS) {
+			if(redraw) {
 				for(y = top + 1; y < vc->lines; y++) {
 					for(x = 0; x < vc->columns; x++) {
 						soffset = (y * vc->columns) + x;
@@ -370,7 +635,8 @@ void fbcon_scroll_screen(struct vconsole *vc, int top, int mode)
 			count = vc->columns * (vc->lines - top - 1);
 			soffset = top * vc->columns;
 			top = (top + 1) * vc->columns;
-			if(vc->cursor_y) {
+			/* the cursor moves with the screen unless it's redrawn */
+			if(vc->cursor_y && moved) {
 				vc->cursor_y--;
 			}
 			memcpy_w(screen + soffset, screen + top, count);
@@ -379,7 +645,7 @@ void fbcon_scroll_screen(struct vconsole *vc, int top, int mode)
 		case SCROLL_DOWN:
 			for(y = vc->lines - 2; y >= top; y--) {
 				for(x = 0; x < vc->columns; x++) {
-					if(vc->flags & CONSOLE_HAS_FOCUS) {
+					if(redraw) {
 						soffset = (y * vc->columns) + x;
 						poffset = ((y + 1) * vc->columns) + x;
 						sch = screen[soffset];
@@ -397,7 +663,7 @@ void fbcon_scroll_screen(struct vconsole *vc, int top, int mode)
 				}
 				memcpy_w(screen + (vc->columns * (y + 1)), screen + (vc->columns * y), vc->columns);
 			}
-			if((vc->flags & CONSOLE_HAS_FOCUS) && !screen_is_off) {
+			if(redraw && !screen_is_off) {
 				count = video.fb_pitch * video.fb_char_height;
 				memset_l(vidmem + (top * count), 0, count / sizeof(unsigned int));
 			}
@@ -418,7 +684,12 @@ void fbcon_restore_screen(struct vconsole *vc)
 
 	if(!screen_is_off && !video.buf_top) {
 		memset_b(vidmem, 0, video.fb_size);
+		if(video.fb_shadow) {
+			memset_l(video.fb_shadow, 0, video.fb_vsize / sizeof(unsigned int));
+		}
 	}
+	shadow_batch = video.fb_shadow ? 1 : 0;
+	shadow_moved = -1;
 	for(y = 0; y < video.lines; y++) {
 		for(x = 0; x < vc->columns; x++) {
 			sch = screen[(y * vc->columns) + x];
@@ -430,6 +701,12 @@ void fbcon_restore_screen(struct vconsole *vc)
 			draw_glyph(vidmem, x, y, ch, sch >> 8);
 		}
 	}
+	if(shadow_batch) {
+		shadow_batch = 0;
+		if(!screen_is_off) {
+			flush_shadow(vidmem, 0, video.lines);
+		}
+	}
 	vc->flags &= ~CONSOLE_BLANKED;
 }
 
@@ -466,18 +743,59 @@ void fbcon_screen_off(unsigned int arg)
 	RESTORE_FLAGS(flags);
 }
 
-void fbcon_buf_scroll(struct vconsole *vc, int mode)
+/*
+ * Draws the scrollback buffer from 'video.buf_top'. With a shadow copy the
+ * lines still visible from 'prev_top' are moved and only the rest is drawn.
+ */
+static void draw_vcbuf(struct vconsole *vc, int prev_top)
 {
 	short int sch;
-	int y, x, offset;
-	unsigned char *vidmem, *ch;
+	int y, x, first, last, lines;
+	unsigned char *ch;
+
+	first = 0;
+	last = video.lines;
+	if(video.fb_shadow && !screen_is_off) {
+		shadow_batch = 1;
+		lines = (prev_top - video.buf_top) / SCREEN_COLS;
+		if(lines > 0 && lines < video.lines) {
+			if(video.flags & VPF_CURSOR_ON) {
+				remove_cursor(vc);
+			}
+			scroll_shadow(0, video.lines, lines, SCROLL_DOWN);
+			last = lines;
+		} else if(lines < 0 && -lines < video.lines) {
+			scroll_shadow(0, video.lines, -lines, SCROLL_UP);
+			first = video.lines + lines;
+		}
+	}
+
+	for(y = first; y < last; y++) {
+		for(x = 0; x < vc->columns; x++) {
+			sch = vcbuf[video.buf_top + (y * vc->columns) + x];
+			if(sch & 0xFF) {
+				ch = &font_data[(sch & 0xFF) * video.fb_char_height];
+			} else {
+				ch = &font_data[SPACE_CHAR * video.fb_char_height];
+			}
+			draw_glyph(vc->vidmem, x, y, ch, sch >> 8);
+		}
+	}
+
+	if(shadow_batch) {
+		shadow_batch = 0;
+		flush_shadow(vc->vidmem, 0, video.lines);
+	}
+}
+
+void fbcon_buf_scroll(struct vconsole *vc, int mode)
+{
+	int prev_top;
 
 	if(video.buf_y <= SCREEN_LINES) {
 		return;
 	}
 
-	vidmem = vc->vidmem;
-
 	if(mode == SCROLL_UP) {
 		if(video.buf_top < 0) {
 			return;
@@ -485,21 +803,12 @@ void fbcon_buf_scroll(struct vconsole *vc, int mode)
 		if(!video.buf_top) {
 			video.buf_top = (video.buf_y - SCREEN_LINES + 1) * SCREEN_COLS;
 		}
+		prev_top = video.buf_top;
 		video.buf_top -= (SCREEN_LINES / 2) * SCREEN_COLS;
 		if(video.buf_top < 0) {
 			video.buf_top = 0;
 		}
-		for(offset = 0, y = 0; y < video.lines; y++) {
-			for(x = 0; x < vc->columns; x++, offset++) {
-				sch = vcbuf[video.buf_top + offset];
-				if(sch & 0xFF) {
-					ch = &font_data[(sch & 0xFF) * video.fb_char_height];
-				} else {
-					ch = &font_data[SPACE_CHAR * video.fb_char_height];
-				}
-				draw_glyph(vidmem, x, y, ch, sch >> 8);
-			}
-		}
+		draw_vcbuf(vc, prev_top);
 		if(!video.buf_top) {
 			video.buf_top = -1;
 		}
@@ -516,21 +825,12 @@ void fbcon_buf_scroll(struct vconsole *vc, int mode)
 		if(video.buf_top < 0) {
 			video.buf_top = 0;
 		}
+		prev_top = video.buf_top;
 		video.buf_top += (SCREEN_LINES / 2) * SCREEN_COLS;
 		if(video.buf_top >= (video.buf_y - SCREEN_LINES + 1) * SCREEN_COLS) {
 			video.buf_top = (video.buf_y - SCREEN_LINES + 1) * SCREEN_COLS;
 		}
-		for(offset = 0, y = 0; y < video.lines; y++) {
-			for(x = 0; x < vc->columns; x++, offset++) {
-				sch = vcbuf[video.buf_top + offset];
-				if(sch & 0xFF) {
-					ch = &font_data[(sch & 0xFF) * video.fb_char_height];
-				} else {
-					ch = &font_data[SPACE_CHAR * video.fb_char_height];
-				}
-				draw_glyph(vidmem, x, y, ch, sch >> 8);
-			}
-		}
+		draw_vcbuf(vc, prev_top);
 		if(video.buf_top >= (video.buf_y - SCREEN_LINES + 1) * SCREEN_COLS) {
 			fbcon_show_cursor(vc, ON);
 			fbcon_update_curpos(vc);
@@ -563,6 +863,40 @@ void fbcon_cursor_blink(unsigned int arg)
 	add_callout(&creq, 25);		/* 250ms */
 }
 
+/* draws the characters of the area from ('x1', 'y1') to ('x2', 'y2') (excluded) */
+void fbcon_update_screen(struct vconsole *vc, int x1, int y1, int x2, int y2)
+{
+	int x, y;
+	short int *screen, sch;
+	unsigned char *vidmem, *ch;
+
+	vidmem = vc->vidmem;
+	screen = vc->screen;
+
+	shadow_batch = video.fb_shadow ? 1 : 0;
+	for(y = y1; y < y2; y++) {
+		for(x = x1; x < x2; x++) {
+			sch = screen[(y * vc->columns) + x];
+			if(sch & 0xFF) {
+				ch = &font_data[(sch & 0xFF) * video.fb_char_height];
+			} else {
+				ch = &font_data[SPACE_CHAR * video.fb_char_height];
+			}
+			draw_glyph(vidmem, x, y, ch, sch >> 8);
+		}
+	}
+	if(shadow_batch) {
+		shadow_batch = 0;
+		if(!screen_is_off) {
+			flush_shadow_area(vidmem, x1, y1, x2, y2);
+			if(shadow_moved >= 0) {
+				flush_shadow(vidmem, shadow_moved, vc->lines);
+			}
+		}
+	}
+	shadow_moved = -1;
+}
+
 void fbcon_init(void)
 {
 	struct fbcon_font_desc *font_desc;
@@ -580,10 +914,12 @@ void fbcon_init(void)
 	video.screen_on = fbcon_screen_on;
 	video.buf_scroll = fbcon_buf_scroll;
 	video.cursor_blink = fbcon_cursor_blink;
+	video.update_screen = fbcon_update_screen;
 
 	if(!(font_desc = fbcon_find_font(video.fb_char_height))) {
 		font_desc = fbcon_find_font(16);
 	}
 	font_data = font_desc->data;
 	cursor_shape = font_desc->cursorshape;
+	init_glyph_masks();
 }
@@ -46,10 +46,14 @@ void vgacon_put_char(struct vconsole *vc, unsigned char ch)
 		return;
 	}
 
-	vidmem = (short int *)vc->vidmem;
-	vidmem[(vc->y * vc->columns) + vc->x] = vc->color_attr | ch;
 	screen[(vc->y * vc->columns) + vc->x] = vc->color_attr | ch;
 	vcbuf[(video.buf_y * vc->columns) + vc->x] = vc->color_attr | ch;
+	if(vc->flags & CONSOLE_BATCH) {
+		vconsole_damage(vc, (vc->y * vc->columns) + vc->x, 1);
+		return;
+	}
+	vidmem = (short int *)vc->vidmem;
+	vidmem[(vc->y * vc->columns) + vc->x] = vc->color_attr | ch;
 }
 
 void vgacon_insert_char(struct vconsole *vc)
@@ -62,9 +66,10 @@ void vgacon_insert_char(struct vconsole *vc)
 	offset = (vc->y * vc->columns) + vc->x;
 	n = vc->x;
 	last_char = BLANK_MEM;
+	vconsole_damage(vc, offset, vc->columns - vc->x);
 
 	while(n++ < vc->columns) {
-		if(vc->flags & CONSOLE_HAS_FOCUS) {
+		if(CAN_DRAW(vc)) {
 			memcpy_w(&tmp, vidmem + offset, 1);
 			memset_w(vidmem + offset, last_char, 1);
 		}
@@ -84,8 +89,9 @@ void vgacon_delete_char(struct vconsole *vc)
 	screen = vc->screen;
 	offset = (vc->y * vc->columns) + vc->x;
 	count = vc->columns - vc->x;
+	vconsole_damage(vc, offset, count);
 
-	if(vc->flags & CONSOLE_HAS_FOCUS) {
+	if(CAN_DRAW(vc)) {
 		memcpy_w(vidmem + offset, vidmem + offset + 1, count);
 		memset_w(vidmem + offset + count, BLANK_MEM, 1);
 	}
@@ -149,7 +155,8 @@ void vgacon_write_screen(struct vconsole *vc, int from, int count, short int col
 	short int *vidmem, *screen;
 
 	screen = vc->screen;
-	if(!(vc->flags & CONSOLE_HAS_FOCUS)) {
+	if(!CAN_DRAW(vc)) {
+		vconsole_damage(vc, from, count);
 		memset_w(screen + from, color, count);
 		return;
 	}
@@ -186,12 +193,13 @@ void vgacon_scroll_screen(struct vconsole *vc, int top, int mode)
 	if(!top) {
 		top = vc->top;
 	}
+	vconsole_damage(vc, top * vc->columns, (vc->lines - top) * vc->columns);
 	switch(mode) {
 		case SCROLL_UP:
 			count = vc->columns * (vc->lines - top - 1);
 			offset = top * vc->columns;
 			top = (top + 1) * vc->columns;
-			if(vc->flags & CONSOLE_HAS_FOCUS) {
+			if(CAN_DRAW(vc)) {
 				memcpy_w(vidmem + offset, screen + top, count);
 				memset_w(vidmem + offset + count, BLANK_MEM, top);
 			}
@@ -202,12 +210,12 @@ void vgacon_scroll_screen(struct vconsole *vc, int top, int mode)
 			count = vc->columns;
 			for(n = vc->lines - 1; n >= top; n--) {
 				memcpy_w(screen + (vc->columns * (n + 1)), screen + (vc->columns * n), count);
-				if(vc->flags & CONSOLE_HAS_FOCUS) {
+				if(CAN_DRAW(vc)) {
 					memcpy_w(vidmem + (vc->columns * (n + 1)), screen + (vc->columns * n), count);
 				}
 			}
 			memset_w(screen + (top * vc->columns), BLANK_MEM, count);
-			if(vc->flags & CONSOLE_HAS_FOCUS) {
+			if(CAN_DRAW(vc)) {
 				memset_w(vidmem + (top * vc->columns), BLANK_MEM, count);
 			}
 			break;
@@ -312,6 +320,19 @@ void vgacon_cursor_blink(unsigned int arg)
 	/* not used */
 }
 
+void vgacon_update_screen(struct vconsole *vc, int x1, int y1, int x2, int y2)
+{
+	int offset;
+	short int *vidmem, *screen;
+
+	vidmem = (short int *)vc->vidmem;
+	screen = vc->screen;
+	for(; y1 < y2; y1++) {
+		offset = (y1 * vc->columns) + x1;
+		memcpy_w(vidmem + offset, screen + offset, x2 - x1);
+	}
+}
+
 void vgacon_init(void)
 {
 	short int *bios_data;
@@ -346,6 +367,5 @@ void vgacon_init(void)
 	video.screen_on = vgacon_screen_on;
 	video.buf_scroll = vgacon_buf_scroll;
 	video.cursor_blink = vgacon_cursor_blink;
-
-	memcpy_w(vcbuf, video.address, SCREEN_SIZE * 2);
+	video.update_screen = vgacon_update_screen;
 }
@@ -18,8 +18,6 @@ struct video_parms video;
 
 void video_init(void)
 {
-	memset_b(vcbuf, 0, (video.columns * video.lines * SCREENS_LOG * 2 * sizeof(short int)));
-
 	if(video.flags & VPF_VGA) {
 		vgacon_init();
 	}
@@ -29,6 +29,7 @@
 #include <fiwix/sched.h>
 #include <fiwix/buffer.h>
 #include <fiwix/devices.h>
+#include <fiwix/diskstats.h>
 #include <fiwix/fs.h>
 #include <fiwix/mm.h>
 #include <fiwix/errno.h>
@@ -211,22 +212,27 @@ static void sync_one_buffer(struct buffer *buf)
 
 	if(!(d = get_device(BLK_DEV, buf->dev))) {
 		printk("WARNING: %s(): block device %d,%d not registered!\n", __FUNCTION__, MAJOR(buf->dev), MINOR(buf->dev));
+		remove_from_dirty_list(buf);
 		return;
 	}
 
 	if(d->fsop && d->fsop->write_block) {
-		errno = d->fsop->write_block(buf->dev, buf->block, buf->data, buf->size);
+		errno = disk_transfer(d, buf->dev, buf->block, buf->data, buf->size, FOR_WRITING);
 		if(errno < 0) {
+			/* out of memory (i.e. zram) is temporary, so it stays dirty */
+			if(errno == -ENOMEM) {
+				return;
+			}
 			if(errno == -EROFS) {
 				printk("WARNING: %s(): write protection on device %d,%d.\n", __FUNCTION__, MAJOR(buf->dev), MINOR(buf->dev), buf->block);
 			} else {
 				printk("WARNING: %s(): I/O error on device %d,%d.\n", __FUNCTION__, MAJOR(buf->dev), MINOR(buf->dev), buf->block);
 			}
-			return;
 		}
 		remove_from_dirty_list(buf);
 	} else {
 		printk("WARNING: %s(): device %d,%d does not have the write_block() method!\n", __FUNCTION__, MAJOR(buf->dev), MINOR(buf->dev));
+		remove_from_dirty_list(buf);
 	}
 }
 
@@ -251,8 +257,11 @@ static struct buffer * search_buffer_hash(__dev_t dev, __blk_t block, int size)
 static struct buffer * getblk(__dev_t dev, __blk_t block, int size)
 {
 	unsigned long int flags;
-	struct buffer *buf;
+	struct buffer *buf, *first;
+	struct device *d;
+	char *data;
 
+	first = NULL;
 	for(;;) {
 		if((buf = search_buffer_hash(dev, block, size))) {
 			SAVE_FLAGS(flags); CLI();
@@ -275,6 +284,39 @@ static struct buffer * getblk(__dev_t dev, __blk_t block, int size)
 
 		if(buf->flags & BUFFER_DIRTY) {
 			sync_one_buffer(buf);
+
+			/* it couldn't be written, so it can't be reused yet */
+			if(buf->flags & BUFFER_DIRTY) {
+				brelse(buf);
+				if(!first) {
+					first = buf;
+				} else if(first == buf) {
+					first = NULL;
+					wakeup(&kswapd);
+					sleep(&get_free_page, PROC_UNINTERRUPTIBLE);
+				}
+				continue;
+			}
+		}
+		if(buf->flags & BUFFER_MAPPED) {
+			buf->data = NULL;
+			buf->flags &= ~BUFFER_MAPPED;
+		}
+
+		/*
+		 * If the device has the block in memory (i.e. a ramdisk), the
+		 * buffer points to it and it's valid without having to read it.
+		 */
+		data = NULL;
+		if((d = get_device(BLK_DEV, dev)) && d->map_block) {
+			data = d->map_block(dev, block, size);
+		}
+		if(data) {
+			if(buf->data) {
+				kfree((unsigned int)buf->data);
+				kstat.buffers -= (PAGE_SIZE / 1024);
+			}
+			buf->data = data;
 		} else {
 			if(!buf->data) {
 				if(!(buf->data = (char *)kmalloc())) {
@@ -293,6 +335,9 @@ static struct buffer * getblk(__dev_t dev, __blk_t block, int size)
 		buf->size = size;
 		insert_to_hash(buf);
 		buf->flags &= ~BUFFER_VALID;
+		if(data) {
+			buf->flags |= (BUFFER_MAPPED | BUFFER_VALID);
+		}
 		RESTORE_FLAGS(flags);
 		return buf;
 	}
@@ -311,7 +356,7 @@ struct buffer * bread(__dev_t dev, __blk_t block, int size)
 	if((buf = getblk(dev, block, size))) {
 		if(!(buf->flags & BUFFER_VALID)) {
 			if(d->fsop && d->fsop->read_block) {
-				if(d->fsop->read_block(dev, block, buf->data, size) >= 0) {
+				if(disk_transfer(d, dev, block, buf->data, size, FOR_READING) >= 0) {
 					buf->flags |= BUFFER_VALID;
 				}
 			}
@@ -326,6 +371,101 @@ struct buffer * bread(__dev_t dev, __blk_t block, int size)
 	return NULL;
 }
 
+/*
+ * Gets the buffers of a run of consecutive blocks. The ones that aren't
+ * valid in the cache are read at once if the driver accepts a run of blocks,
+ * otherwise (or if that fails) they are read one by one.
+ */
+int bread_blocks(__dev_t dev, __blk_t block, int size, struct buffer **bufs, int nblocks)
+{
+	struct device *d;
+	char *data[NR_BUF_RUN];
+	int n, n2, run, errno;
+
+	if(!(d = get_device(BLK_DEV, dev))) {
+		printk("WARNING: %s(): device major %d not found!\n", __FUNCTION__, MAJOR(dev));
+		return -ENXIO;
+	}
+	if(nblocks > NR_BUF_RUN) {
+		return -EINVAL;
+	}
+
+	for(n = 0; n < nblocks; n++) {
+		if(!(bufs[n] = getblk(dev, block + n, size))) {
+			while(n--) {
+				brelse(bufs[n]);
+			}
+			return -ENOMEM;
+		}
+	}
+
+	errno = 0;
+	for(n = 0; n < nblocks; n += run) {
+		for(run = 0; n + run < nblocks && !(bufs[n + run]->flags & BUFFER_VALID); run++) {
+			data[run] = bufs[n + run]->data;
+		}
+		if(!run) {
+			run = 1;
+			continue;
+		}
+		if(run > 1 && d->rw_blocks) {
+			if(disk_transfer_run(d, dev, block + n, data, run, size, FOR_READING) >= 0) {
+				for(n2 = n; n2 < n + run; n2++) {
+					bufs[n2]->flags |= BUFFER_VALID;
+				}
+				continue;
+			}
+		}
+		for(n2 = n; n2 < n + run; n2++) {
+			if(d->fsop && d->fsop->read_block) {
+				if(disk_transfer(d, dev, block + n2, bufs[n2]->data, size, FOR_READING) >= 0) {
+					bufs[n2]->flags |= BUFFER_VALID;
+					continue;
+				}
+			}
+			errno = -EIO;
+		}
+	}
+
+	if(errno) {
+		for(n = 0; n < nblocks; n++) {
+			brelse(bufs[n]);
+		}
+		printk("WARNING: %s(): unable to read blocks %d-%d!\n", __FUNCTION__, block, block + nblocks - 1);
+	}
+	return errno;
+}
+
+/*
+ * Returns the buffer only if it's already valid in the cache. This allows
+ * the drivers that bypass the buffer cache to remain coherent with it.
+ */
+struct buffer * get_cached_buffer(__dev_t dev, __blk_t block, int size)
+{
+	unsigned long int flags;
+	struct buffer *buf;
+
+	for(;;) {
+		if(!(buf = search_buffer_hash(dev, block, size))) {
+			return NULL;
+		}
+		SAVE_FLAGS(flags); CLI();
+		if(buf->flags & BUFFER_LOCKED) {
+			RESTORE_FLAGS(flags);
+			sleep(&buffer_wait, PROC_UNINTERRUPTIBLE);
+			continue;
+		}
+		if(!(buf->flags & BUFFER_VALID)) {
+			RESTORE_FLAGS(flags);
+			return NULL;
+		}
+		buf->flags |= BUFFER_LOCKED;
+		remove_from_free_list(buf);
+		RESTORE_FLAGS(flags);
+		return buf;
+	}
+}
+
 void bwrite(struct buffer *buf)
 {
 	buf->flags |= (BUFFER_DIRTY | BUFFER_VALID);
@@ -338,6 +478,10 @@ void brelse(struct buffer *buf)
 
 	SAVE_FLAGS(flags); CLI();
 
+	/* a mapped buffer was written directly in the memory of the device */
+	if(buf->flags & BUFFER_MAPPED) {
+		buf->flags &= ~BUFFER_DIRTY;
+	}
 	if(buf->flags & BUFFER_DIRTY) {
 		insert_on_dirty_list(buf);
 	}
@@ -351,9 +495,70 @@ void brelse(struct buffer *buf)
 	wakeup(&buffer_wait);
 }
 
+/*
+ * Gets and locks the dirty buffers of the blocks consecutive to the locked
+ * buffer 'buf', so they can be written with a single request.
+ */
+static int get_dirty_run(struct buffer *buf, struct buffer **run)
+{
+	unsigned long int flags;
+	struct buffer *b;
+	__blk_t first;
+	int n;
+
+	first = buf->block;
+
+	SAVE_FLAGS(flags); CLI();
+	for(n = 1; n < NR_BUF_RUN / 2 && first; n++) {
+		b = search_buffer_hash(buf->dev, first - 1, buf->size);
+		if(!b || (b->flags & (BUFFER_DIRTY | BUFFER_LOCKED)) != BUFFER_DIRTY) {
+			break;
+		}
+		first--;
+	}
+	for(n = 0; n < NR_BUF_RUN; n++) {
+		if(first + n == buf->block) {
+			run[n] = buf;
+			continue;
+		}
+		b = search_buffer_hash(buf->dev, first + n, buf->size);
+		if(!b || (b->flags & (BUFFER_DIRTY | BUFFER_LOCKED)) != BUFFER_DIRTY) {
+			break;
+		}
+		b->flags |= BUFFER_LOCKED;
+		run[n] = b;
+	}
+	RESTORE_FLAGS(flags);
+	return n;
+}
+
+static void sync_run(struct buffer **run, int nblocks)
+{
+	static char *data[NR_BUF_RUN];
+	struct device *d;
+	int n;
+
+	if(nblocks > 1 && (d = get_device(BLK_DEV, run[0]->dev)) && d->rw_blocks) {
+		for(n = 0; n < nblocks; n++) {
+			data[n] = run[n]->data;
+		}
+		if(disk_transfer_run(d, run[0]->dev, run[0]->block, data, nblocks, run[0]->size, FOR_WRITING) >= 0) {
+			for(n = 0; n < nblocks; n++) {
+				remove_from_dirty_list(run[n]);
+			}
+			return;
+		}
+	}
+	for(n = 0; n < nblocks; n++) {
+		sync_one_buffer(run[n]);
+	}
+}
+
 void sync_buffers(__dev_t dev)
 {
+	static struct buffer *run[NR_BUF_RUN];
 	struct buffer *buf, *next;
+	int n, nblocks;
 
 	buf = buffer_dirty_head;
 
@@ -362,9 +567,20 @@ void sync_buffers(__dev_t dev)
 		next = buf->next_dirty;
 		if(!dev || buf->dev == dev) {
 			buffer_wait(buf);
-			sync_one_buffer(buf);
-			buf->flags &= ~BUFFER_LOCKED;
+			if(buf->flags & BUFFER_DIRTY) {
+				nblocks = get_dirty_run(buf, run);
+				sync_run(run, nblocks);
+				for(n = 0; n < nblocks; n++) {
+					run[n]->flags &= ~BUFFER_LOCKED;
+				}
+			} else {
+				buf->flags &= ~BUFFER_LOCKED;
+			}
 			wakeup(&buffer_wait);
+			/* the next buffer might have been written as part of the run */
+			if(next && !(next->flags & BUFFER_DIRTY)) {
+				next = buffer_dirty_head;
+			}
 		}
 		buf = next;
 	}
@@ -428,7 +644,14 @@ int reclaim_buffers(void)
 		} else {
 			first = buf;
 		}
-		if(buf->data) {
+
+		/* a buffer that couldn't be written keeps its data */
+		if(buf->flags & BUFFER_DIRTY) {
+			brelse(buf);
+			continue;
+		}
+		/* mapped buffers don't use memory of their own */
+		if(buf->data && !(buf->flags & BUFFER_MAPPED)) {
 			kfree((unsigned int)buf->data);
 			buf->data = NULL;
 			remove_from_hash(buf);
@@ -9,12 +9,16 @@
 #include <fiwix/errno.h>
 #include <fiwix/buffer.h>
 #include <fiwix/devices.h>
+#include <fiwix/diskstats.h>
 #include <fiwix/fs.h>
 #include <fiwix/mm.h>
 #include <fiwix/process.h>
 #include <fiwix/stdio.h>
 #include <fiwix/string.h>
 
+#define RAW_MIN_SIZE	(16 * 1024)	/* smaller transfers use the cache */
+#define RAW_MAX_SIZE	(64 * 1024)	/* max. size of a request */
+
 struct device *chr_device_table[NR_CHRDEV];
 struct device *blk_device_table[NR_BLKDEV];
 
@@ -240,12 +244,124 @@ int blk_dev_close(struct inode *i, struct fd *fd_table)
 	return -ENXIO;
 }
 
+/*
+ * Large transfers of whole blocks bypass the buffer cache, so reading or
+ * writing an entire device doesn't evict everything else from it. The
+ * blocks are sent to the driver in runs of up to RAW_MAX_SIZE bytes through
+ * kernel pages (as the driver may use DMA), except the ones already in the
+ * cache, which are read from or written to their buffers to keep it coherent.
+ * The buffers of the blocks read by someone else during a raw write are
+ * refreshed afterwards.
+ */
+static int raw_run(struct device *d, __dev_t dev, __blk_t block, char **data, int nblocks, int blksize, int mode)
+{
+	int n, errno;
+
+	if(nblocks > 1 && d->rw_blocks) {
+		if(disk_transfer_run(d, dev, block, data, nblocks, blksize, mode) >= 0) {
+			return 0;
+		}
+	}
+	for(n = 0; n < nblocks; n++) {
+		if((errno = disk_transfer(d, dev, block + n, data[n], blksize, mode)) < 0) {
+			return errno;
+		}
+	}
+	return 0;
+}
+
+static int raw_transfer(struct device *d, __dev_t dev, __blk_t block, char *buffer, int nblocks, int blksize, int mode)
+{
+	struct buffer *buf;
+	char *pages[RAW_MAX_SIZE / PAGE_SIZE];
+	char *data[RAW_MAX_SIZE / BLKSIZE_1K];
+	int n, max, npages, done, run, errno;
+
+	max = MIN(nblocks, RAW_MAX_SIZE / blksize);
+	npages = ((max * blksize) + PAGE_SIZE - 1) / PAGE_SIZE;
+	for(n = 0; n < npages; n++) {
+		if(!(pages[n] = (char *)kmalloc())) {
+			while(n--) {
+				kfree((unsigned int)pages[n]);
+			}
+			return -ENOMEM;
+		}
+	}
+	for(n = 0; n < max; n++) {
+		data[n] = pages[(n * blksize) / PAGE_SIZE] + ((n * blksize) % PAGE_SIZE);
+	}
+
+	done = errno = 0;
+	while(done < nblocks) {
+		buf = NULL;
+		for(run = 0; run < max && done + run < nblocks; run++) {
+			if((buf = get_cached_buffer(dev, block + done + run, blksize))) {
+				break;
+			}
+		}
+		if(!run) {
+			if(mode == FOR_READING) {
+				memcpy_b(buffer + (done * blksize), buf->data, blksize);
+				brelse(buf);
+			} else {
+				memcpy_b(buf->data, buffer + (done * blksize), blksize);
+				bwrite(buf);
+			}
+			done++;
+			continue;
+		}
+		if(buf) {
+			brelse(buf);
+		}
+
+		if(mode == FOR_WRITING) {
+			for(n = 0; n < run; n++) {
+				memcpy_b(data[n], buffer + ((done + n) * blksize), blksize);
+			}
+		}
+		if((errno = raw_run(d, dev, block + done, data, run, blksize, mode)) < 0) {
+			break;
+		}
+		if(mode == FOR_READING) {
+			for(n = 0; n < run; n++) {
+				memcpy_b(buffer + ((done + n) * blksize), data[n], blksize);
+			}
+		} else {
+			/* the blocks might have been read while they were written */
+			for(n = 0; n < run; n++) {
+				if((buf = get_cached_buffer(dev, block + done + n, blksize))) {
+					memcpy_b(buf->data, data[n], blksize);
+					brelse(buf);
+				}
+			}
+		}
+		done += run;
+	}
+
+	for(n = 0; n < npages; n++) {
+		kfree((unsigned int)pages[n]);
+	}
+	return errno < 0 ? errno : nblocks * blksize;
+}
+
+/* returns the number of blocks that can be transferred bypassing the cache */
+static int raw_blocks(struct device *d, __off_t offset, __size_t count, int blksize, int mode)
+{
+	if(offset % blksize || count < RAW_MIN_SIZE || blksize > PAGE_SIZE) {
+		return 0;
+	}
+	if(!d->fsop || !d->fsop->read_block || (mode == FOR_WRITING && !d->fsop->write_block)) {
+		return 0;
+	}
+	return count / blksize;
+}
+
 int blk_dev_read(struct inode *i, struct fd *fd_table, char *buffer, __size_t count)
 {
 	__blk_t block;
 	__off_t total_read;
 	unsigned long long int device_size;
-	int blksize;
+	int blksize, nblocks, errno;
 	unsigned int boffset, bytes;
 	struct buffer *buf;
 	struct device *d;
@@ -271,6 +387,15 @@ int blk_dev_read(struct inode *i, struct fd *fd_table, char *buffer, __size_t co
 	while(count) {
 		boffset = fd_table->offset % blksize;
 		block = (fd_table->offset / blksize);
+		if((nblocks = raw_blocks(d, fd_table->offset, count, blksize, FOR_READING))) {
+			if((errno = raw_transfer(d, i->rdev, block, buffer + total_read, nblocks, blksize, FOR_READING)) < 0) {
+				return errno;
+			}
+			total_read += errno;
+			count -= errno;
+			fd_table->offset += errno;
+			continue;
+		}
 		if(!(buf = bread(i->rdev, block, blksize))) {
 			return -EIO;
 		}
@@ -290,7 +415,7 @@ int blk_dev_write(struct inode *i, struct fd *fd_table, const char *buffer, __si
 	__blk_t block;
 	__off_t total_written;
 	unsigned long long int device_size;
-	int blksize;
+	int blksize, nblocks, errno;
 	unsigned int boffset, bytes;
 	struct buffer *buf;
 	struct device *d;
@@ -316,6 +441,15 @@ int blk_dev_write(struct inode *i, struct fd *fd_table, const char *buffer, __si
 	while(count) {
 		boffset = fd_table->offset % blksize;
 		block = (fd_table->offset / blksize);
+		if((nblocks = raw_blocks(d, fd_table->offset, count, blksize, FOR_WRITING))) {
+			if((errno = raw_transfer(d, i->rdev, block, (char *)buffer + total_written, nblocks, blksize, FOR_WRITING)) < 0) {
+				return errno;
+			}
+			total_written += errno;
+			count -= errno;
+			fd_table->offset += errno;
+			continue;
+		}
 		if(!(buf = bread(i->rdev, block, blksize))) {
 			return -EIO;
 		}
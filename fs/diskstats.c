@@ -0,0 +1,203 @@
+/*
+ * fiwix/fs/diskstats.c
+ *
+ * Copyright 2021, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#include <fiwix/asm.h>
+#include <fiwix/kernel.h>
+#include <fiwix/diskstats.h>
+#include <fiwix/devices.h>
+#include <fiwix/timer.h>
+#include <fiwix/cpu.h>
+#include <fiwix/fs.h>
+#include <fiwix/ramdisk.h>
+#include <fiwix/floppy.h>
+#include <fiwix/ide.h>
+#include <fiwix/ahci.h>
+#include <fiwix/virtio_blk.h>
+#include <fiwix/stdio.h>
+#include <fiwix/string.h>
+
+/*
+ * The requests to the block device drivers are sent through these functions,
+ * which account them per device. The time is measured with the TSC if the
+ * CPU has one, otherwise with the kernel ticks.
+ */
+
+struct disk_stats disk_stats_table[NR_DISKSTATS];
+
+static unsigned long long int get_time(void)
+{
+	if(cpu_table.hz) {
+		return get_rdtsc();
+	}
+	return CURRENT_TICKS;
+}
+
+/*
+ * The kernel has no 64-bit division, so the TSC cycles are divided 16 bits
+ * at a time (the cycles per microsecond always fit in 16 bits). The result
+ * only overflows after 2^32 microseconds (71 minutes).
+ */
+static unsigned int get_usecs(unsigned long long int start, unsigned long long int end)
+{
+	unsigned long long int diff;
+	unsigned int high, low, div, q1, q0;
+
+	diff = end - start;
+	if(cpu_table.hz) {
+		div = cpu_table.hz / 1000000;
+		while(div >> 16) {
+			div >>= 1;
+			diff >>= 1;
+		}
+		high = (unsigned int)(diff >> 32);
+		low = (unsigned int)diff;
+		if(high >= div) {
+			return ~0;
+		}
+		q1 = ((high << 16) | (low >> 16)) / div;
+		high = ((high << 16) | (low >> 16)) % div;
+		q0 = ((high << 16) | (low & 0xFFFF)) / div;
+		return (q1 << 16) | q0;
+	}
+	return (unsigned int)diff * TICK;
+}
+
+static void add_usecs(unsigned int *msecs, unsigned int *usecs, unsigned int value)
+{
+	*msecs += value / 1000;
+	*usecs += value % 1000;
+	if(*usecs >= 1000) {
+		(*msecs)++;
+		*usecs -= 1000;
+	}
+}
+
+static struct disk_stats * get_disk_stats(__dev_t dev)
+{
+	struct disk_stats *ds, *free;
+	int n;
+
+	free = NULL;
+	for(n = 0; n < NR_DISKSTATS; n++) {
+		ds = &disk_stats_table[n];
+		if(ds->dev == dev) {
+			return ds;
+		}
+		if(!ds->dev && !free) {
+			free = ds;
+		}
+	}
+	if(free) {
+		free->dev = dev;
+	}
+	return free;
+}
+
+static void disk_io_start(struct disk_io *io, __dev_t dev)
+{
+	if(!(io->ds = get_disk_stats(dev))) {
+		return;
+	}
+	io->start = get_time();
+	if(!io->ds->in_flight++) {
+		io->ds->io_start = io->start;
+	}
+}
+
+/* accounts a request of 'nblocks' blocks, started by disk_io_start() */
+static void disk_io_end(struct disk_io *io, int mode, int nblocks, int blksize)
+{
+	struct disk_stats *ds;
+	unsigned long long int now;
+	unsigned int usecs;
+	int bucket;
+
+	if(!(ds = io->ds)) {
+		return;
+	}
+
+	now = get_time();
+	usecs = get_usecs(io->start, now);
+	ds->ios[mode]++;
+	ds->merges[mode] += nblocks - 1;
+	ds->sectors[mode] += nblocks * (blksize / 512);
+	add_usecs(&ds->msecs[mode], &ds->usecs[mode], usecs);
+	for(bucket = 0; bucket < DISKSTATS_BUCKETS - 1 && (usecs >> bucket); bucket++);
+	ds->hist[mode][bucket]++;
+
+	if(!--ds->in_flight) {
+		add_usecs(&ds->io_msecs, &ds->io_usecs, get_usecs(ds->io_start, now));
+	}
+}
+
+/* reads or writes a block using the read_block() or write_block() method */
+int disk_transfer(struct device *d, __dev_t dev, __blk_t block, char *buffer, int blksize, int mode)
+{
+	struct disk_io io;
+	int errno;
+
+	disk_io_start(&io, dev);
+	if(mode == FOR_READING) {
+		errno = d->fsop->read_block(dev, block, buffer, blksize);
+	} else {
+		errno = d->fsop->write_block(dev, block, buffer, blksize);
+	}
+	disk_io_end(&io, mode, 1, blksize);
+	return errno;
+}
+
+/* reads or writes a run of blocks using the rw_blocks() method */
+int disk_transfer_run(struct device *d, __dev_t dev, __blk_t block, char **buffers, int nblocks, int blksize, int mode)
+{
+	struct disk_io io;
+	int errno;
+
+	disk_io_start(&io, dev);
+	errno = d->rw_blocks(dev, block, buffers, nblocks, blksize, mode);
+	disk_io_end(&io, mode, nblocks, blksize);
+	return errno;
+}
+
+/* builds the name of the device as in /dev */
+void disk_name(__dev_t dev, char *name)
+{
+	struct device *d;
+	int minor;
+
+	minor = MINOR(dev);
+	switch(MAJOR(dev)) {
+		case RAMDISK_MAJOR:
+			sprintk(name, "ram%d", minor);
+			return;
+		case FDC_MAJOR:
+			sprintk(name, "fd%d", minor & 1);
+			return;
+		case IDE0_MAJOR:
+		case IDE1_MAJOR:
+			sprintk(name, "hd%c", 'a' + (MAJOR(dev) == IDE1_MAJOR ? 2 : 0) + (minor >> IDE_SLAVE_MSF));
+			minor &= (1 << IDE_SLAVE_MSF) - 1;
+			break;
+		case AHCI_MAJOR:
+			sprintk(name, "sd%c", 'a' + minor / AHCI_DISK_MINORS);
+			minor %= AHCI_DISK_MINORS;
+			break;
+		case VIRTIO_BLK_MAJOR:
+			sprintk(name, "vd%c", 'a' + minor / VIRTIO_BLK_MINORS);
+			minor %= VIRTIO_BLK_MINORS;
+			break;
+		default:
+			if((d = get_device(BLK_DEV, dev))) {
+				sprintk(name, "%s%d", d->name, minor);
+			} else {
+				sprintk(name, "%d,%d", MAJOR(dev), minor);
+			}
+			return;
+	}
+	if(minor) {
+		sprintk(name + strlen(name), "%d", minor);
+	}
+}
@@ -301,6 +301,7 @@ static int elf_load_interpreter(struct inode *ii)
 {
 	int n, errno;
 	struct buffer *buf;
+	struct fd fd_table;
 	struct elf32_hdr *elf32_h;
 	struct elf32_phdr *elf32_ph, *last_ptload;
 	__blk_t block;
@@ -309,24 +310,40 @@ static int elf_load_interpreter(struct inode *ii)
 	char *data;
 	char type;
 
-	if((block = bmap(ii, 0, FOR_READING)) < 0) {
-		return block;
-	}
-	if(!(buf = bread(ii->dev, block, ii->sb->s_blocksize))) {
-		return -EIO;
+	if(!(data = (void *)kmalloc())) {
+		return -ENOMEM;
 	}
 
-	/*
-	 * The contents of the buffer is copied and then freed immediately to
-	 * make sure that it won't conflict while zeroing the BSS fractional
-	 * page, in case that the same block is requested during the page fault.
-	 */
-	if(!(data = (void *)kmalloc())) {
+	if(!ii->fsop->bmap) {
+		/* filesystems without blocks (i.e. tmpfs) */
+		memset_b(data, 0, PAGE_SIZE);
+		fd_table.inode = ii;
+		fd_table.flags = 0;
+		fd_table.count = 0;
+		fd_table.offset = 0;
+		if(!ii->fsop->read || ii->fsop->read(ii, &fd_table, data, PAGE_SIZE) < 0) {
+			kfree((unsigned int)data);
+			return -EIO;
+		}
+	} else {
+		if((block = bmap(ii, 0, FOR_READING)) < 0) {
+			kfree((unsigned int)data);
+			return block;
+		}
+		if(!(buf = bread(ii->dev, block, ii->sb->s_blocksize))) {
+			kfree((unsigned int)data);
+			return -EIO;
+		}
+
+		/*
+		 * The contents of the buffer is copied and then freed
+		 * immediately to make sure that it won't conflict while
+		 * zeroing the BSS fractional page, in case that the same
+		 * block is requested during the page fault.
+		 */
+		memcpy_b(data, buf->data, ii->sb->s_blocksize);
 		brelse(buf);
-		return -ENOMEM;
 	}
-	memcpy_b(data, buf->data, ii->sb->s_blocksize);
-	brelse(buf);
 
 	elf32_h = (struct elf32_hdr *)data;
 	if(check_elf(elf32_h)) {
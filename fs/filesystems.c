@@ -12,6 +12,8 @@
 #include <fiwix/fs_pipe.h>
 #include <fiwix/fs_iso9660.h>
 #include <fiwix/fs_proc.h>
+#include <fiwix/fs_tmpfs.h>
+#include <fiwix/fs_squashfs.h>
 #include <fiwix/stdio.h>
 #include <fiwix/string.h>
 
@@ -78,4 +80,10 @@ void fs_init(void)
 	if(procfs_init()) {
 		printk("%s(): unable to register 'procfs' filesystem.\n", __FUNCTION__);
 	}
+	if(tmpfs_init()) {
+		printk("%s(): unable to register 'tmpfs' filesystem.\n", __FUNCTION__);
+	}
+	if(squashfs_init()) {
+		printk("%s(): unable to register 'squashfs' filesystem.\n", __FUNCTION__);
+	}
 }
@@ -35,7 +35,6 @@
 #include <fiwix/string.h>
 
 #define INODE_HASH(dev, inode)	(((__dev_t)(dev) ^ (__ino_t)(inode)) % (NR_INO_HASH))
-#define NR_INODES	(inode_table_size / sizeof(struct inode))
 #define NR_INO_HASH	(inode_hash_table_size / sizeof(unsigned int))
 
 struct inode *inode_table;		/* inode pool */
@@ -159,6 +158,7 @@ static struct inode * get_free_inode(void)
 	i->rdev = 0;
 	i->fsop = NULL;
 	i->sb = NULL;
+	i->locks = NULL;
 	memset_b(&i->u, NULL, sizeof(i->u));
 
 	RESTORE_FLAGS(flags);
@@ -11,87 +11,171 @@
 #include <fiwix/fs.h>
 #include <fiwix/sleep.h>
 #include <fiwix/sched.h>
+#include <fiwix/mm.h>
 #include <fiwix/stdio.h>
 #include <fiwix/string.h>
 
 static struct resource flock_resource = { NULL, NULL };
+static struct file_lock *flock_free_list;
 
-static struct flock_file * get_new_flock(struct inode *i)
+/* takes a lock from the pool, which grows by one page when empty */
+static struct file_lock * get_new_flock(void)
 {
-	int n;
-	struct flock_file *ff;
+	struct file_lock *fl;
+	unsigned int n;
 
-	lock_resource(&flock_resource);
-
-	for(n = 0; n < NR_FLOCKS; n++) {
-		ff = &flock_file_table[n];
-		if(!ff->inode) {
-			ff->inode = i;	/* mark it as busy */
-			unlock_resource(&flock_resource);
-			return ff;
+	if(!flock_free_list) {
+		if(!(fl = (struct file_lock *)kmalloc())) {
+			printk("WARNING: %s(): unable to grow the lock pool.\n", __FUNCTION__);
+			return NULL;
+		}
+		for(n = 0; n < PAGE_SIZE / sizeof(struct file_lock); n++, fl++) {
+			fl->next = flock_free_list;
+			flock_free_list = fl;
 		}
 	}
+	fl = flock_free_list;
+	flock_free_list = fl->next;
+	memset_b(fl, 0, sizeof(struct file_lock));
+	return fl;
+}
 
-	printk("WARNING: %s(): no more free slots in flock file table.\n");
-	unlock_resource(&flock_resource);
-	return NULL;
+/* the processes waiting on this lock will check again for conflicts */
+static void release_flock(struct file_lock *fl)
+{
+	wakeup(fl);
+	fl->inode = NULL;
+	fl->next = flock_free_list;
+	flock_free_list = fl;
 }
 
-static void release_flock(struct flock_file *ff)
+static void insert_flock(struct inode *i, struct file_lock *fl)
 {
-	memset_b(ff, 0, sizeof(struct flock_file));
+	fl->inode = i;
+	fl->next = i->locks;
+	i->locks = fl;
 }
 
-static struct flock_file * get_flock_file(struct inode *i, int op, struct proc *p)
+/* unlinks and releases the lock pointed to by 'prev' */
+static void remove_flock(struct file_lock **prev)
 {
-	int n;
-	struct flock_file *ff;
+	struct file_lock *fl;
 
-	lock_resource(&flock_resource);
+	fl = *prev;
+	*prev = fl->next;
+	release_flock(fl);
+}
+
+static int overlaps(struct file_lock *fl, __off_t start, __off_t end)
+{
+	return fl->start <= end && start <= fl->end;
+}
 
-	ff = NULL;
-	for(n = 0; n < NR_FLOCKS; n++) {
-		ff = &flock_file_table[n];
-		if(ff->inode != i) {
+/* returns the first lock of another process that conflicts with the request */
+static struct file_lock * get_conflict(struct inode *i, int flags, int type, __off_t start, __off_t end)
+{
+	struct file_lock *fl;
+
+	for(fl = i->locks; fl; fl = fl->next) {
+		if(fl->flags != flags || fl->proc == current) {
 			continue;
 		}
-		if(p && p != ff->proc) {
+		if(!(type & LOCK_EX) && !(fl->type & LOCK_EX)) {
 			continue;
 		}
-		break;
+		if(overlaps(fl, start, end)) {
+			return fl;
+		}
 	}
-	unlock_resource(&flock_resource);
-	return ff;
+	return NULL;
 }
 
-int posix_lock(int ufd, int cmd, struct flock *fl)
+/*
+ * Applies a request of the current process on the range 'start'-'end' to
+ * its own POSIX locks, merging adjacent locks of the same type and trimming
+ * or splitting the ones that are replaced. A type of LOCK_UN only removes.
+ */
+static int posix_apply(struct inode *i, int type, __off_t start, __off_t end)
 {
-	int n;
-	struct flock_file *ff;
-	struct inode *i;
-	unsigned char type;
+	struct file_lock *fl, **prev, *new, *split;
 
-	lock_resource(&flock_resource);
-	i = fd_table[current->fd[ufd]].inode;
-	for(n = 0; n < NR_FLOCKS; n++) {
-		ff = &flock_file_table[n];
-		if(ff->inode != i) {
+	/* get the structures needed in advance so the list is never left half updated */
+	new = split = NULL;
+	if(!(split = get_new_flock())) {
+		return -ENOLCK;
+	}
+	if(type != LOCK_UN && !(new = get_new_flock())) {
+		release_flock(split);
+		return -ENOLCK;
+	}
+
+	prev = &i->locks;
+	while((fl = *prev)) {
+		if(fl->flags != FL_POSIX || fl->proc != current) {
+			prev = &fl->next;
 			continue;
 		}
-		break;
-	}
-	unlock_resource(&flock_resource);
-	if(cmd == F_GETLK) {
-		if(ff->inode == i) {
-			fl->l_type = (ff->type & LOCK_SH) ? F_RDLCK : F_WRLCK;
-			fl->l_whence = SEEK_SET;
-			fl->l_start = 0;
-			fl->l_len = 0;
-			fl->l_pid = ff->proc->pid;
+		if(fl->type == type) {
+			/* same type: merge if they overlap or are adjacent */
+			if(overlaps(fl, start, end) || (fl->end != FL_EOF && fl->end + 1 == start) || (end != FL_EOF && end + 1 == fl->start)) {
+				start = MIN(start, fl->start);
+				end = MAX(end, fl->end);
+				remove_flock(prev);
+				continue;
+			}
+			prev = &fl->next;
+			continue;
+		}
+		if(!overlaps(fl, start, end)) {
+			prev = &fl->next;
+			continue;
+		}
+		if(fl->start < start && fl->end > end) {
+			/* the request falls in the middle, split the old lock */
+			split->proc = current;
+			split->flags = FL_POSIX;
+			split->type = fl->type;
+			split->start = end + 1;
+			split->end = fl->end;
+			insert_flock(i, split);
+			split = NULL;
+			fl->end = start - 1;
+			wakeup(fl);
+		} else if(fl->start < start) {
+			fl->end = start - 1;
+			wakeup(fl);
+		} else if(fl->end > end) {
+			fl->start = end + 1;
+			wakeup(fl);
 		} else {
-			fl->l_type = F_UNLCK;
+			remove_flock(prev);
+			continue;
 		}
+		prev = &fl->next;
+	}
+
+	if(new) {
+		new->proc = current;
+		new->flags = FL_POSIX;
+		new->type = type;
+		new->start = start;
+		new->end = end;
+		insert_flock(i, new);
 	}
+	if(split) {
+		release_flock(split);
+	}
+	return 0;
+}
+
+int posix_lock(int ufd, int cmd, struct flock *fl)
+{
+	struct file_lock *ff;
+	struct inode *i;
+	__off_t start, end;
+	int type, errno;
+
+	i = fd_table[current->fd[ufd]].inode;
 
 	switch(fl->l_type) {
 		case F_RDLCK:
@@ -106,103 +190,150 @@ int posix_lock(int ufd, int cmd, struct flock *fl)
 		default:
 			return -EINVAL;
 	}
-	if(cmd == F_SETLK) {
-		return flock_inode(i, type);
+
+	switch(fl->l_whence) {
+		case SEEK_SET:
+			start = 0;
+			break;
+		case SEEK_CUR:
+			start = fd_table[current->fd[ufd]].offset;
+			break;
+		case SEEK_END:
+			start = i->i_size;
+			break;
+		default:
+			return -EINVAL;
 	}
-	if(cmd == F_SETLKW) {
-		return flock_inode(i, type | LOCK_NB);
+	start += fl->l_start;
+	if((int)fl->l_len < 0) {
+		if(start < -fl->l_len) {
+			return -EINVAL;
+		}
+		end = start - 1;
+		start += fl->l_len;
+	} else if(fl->l_len) {
+		end = start + fl->l_len - 1;
+	} else {
+		end = FL_EOF;
 	}
-	return 0;
+	if(end < start) {
+		return -EINVAL;
+	}
+
+	if(cmd == F_GETLK) {
+		lock_resource(&flock_resource);
+		if(type != LOCK_UN && (ff = get_conflict(i, FL_POSIX, type, start, end))) {
+			fl->l_type = (ff->type & LOCK_SH) ? F_RDLCK : F_WRLCK;
+			fl->l_whence = SEEK_SET;
+			fl->l_start = ff->start;
+			fl->l_len = ff->end == FL_EOF ? 0 : ff->end - ff->start + 1;
+			fl->l_pid = ff->proc->pid;
+		} else {
+			fl->l_type = F_UNLCK;
+		}
+		unlock_resource(&flock_resource);
+		return 0;
+	}
+
+	for(;;) {
+		lock_resource(&flock_resource);
+		if(type == LOCK_UN || !(ff = get_conflict(i, FL_POSIX, type, start, end))) {
+			break;
+		}
+		unlock_resource(&flock_resource);
+		if(cmd == F_SETLK) {
+			return -EAGAIN;
+		}
+		if(sleep(ff, PROC_INTERRUPTIBLE)) {
+			return -EINTR;
+		}
+	}
+	errno = posix_apply(i, type, start, end);
+	unlock_resource(&flock_resource);
+	return errno;
 }
 
-void flock_release_inode(struct inode *i)
+/* releases the locks of type 'flags' the current process holds on the inode */
+void flock_release_inode(struct inode *i, int flags)
 {
-	int n;
-	struct flock_file *ff;
+	struct file_lock *fl, **prev;
 
 	lock_resource(&flock_resource);
-	for(n = 0; n < NR_FLOCKS; n++) {
-		ff = &flock_file_table[n];
-		if(ff->inode != i) {
-			continue;
-		}
-		if(ff->proc != current) {
+	prev = &i->locks;
+	while((fl = *prev)) {
+		if(fl->proc == current && (fl->flags & flags)) {
+			remove_flock(prev);
 			continue;
 		}
-		wakeup(ff);
-		release_flock(ff);
+		prev = &fl->next;
 	}
 	unlock_resource(&flock_resource);
 }
 
 int flock_inode(struct inode *i, int op)
 {
-	int n;
-	struct flock_file *ff, *new;
+	struct file_lock *fl, *ff, **prev;
+	int type;
 
+	lock_resource(&flock_resource);
+
+	/* the lock already held by this process is replaced */
+	for(prev = &i->locks; (fl = *prev); prev = &fl->next) {
+		if(fl->flags == FL_FLOCK && fl->proc == current) {
+			break;
+		}
+	}
 	if(op & LOCK_UN) {
-		if((ff = get_flock_file(i, op, current))) {
-			wakeup(ff);
-			release_flock(ff);
+		if(fl) {
+			remove_flock(prev);
 		}
+		unlock_resource(&flock_resource);
 		return 0;
 	}
+	type = op & (LOCK_SH | LOCK_EX);
+	if(!type) {
+		unlock_resource(&flock_resource);
+		return -EINVAL;
+	}
 
-loop:
-	lock_resource(&flock_resource);
-	new = NULL;
-	for(n = 0; n < NR_FLOCKS; n++) {
-		ff = &flock_file_table[n];
-		if(ff->inode != i) {
-			continue;
+	while((ff = get_conflict(i, FL_FLOCK, type, 0, FL_EOF))) {
+		unlock_resource(&flock_resource);
+		if(op & LOCK_NB) {
+			return -EWOULDBLOCK;
 		}
-		if(op & LOCK_SH) {
-			if(ff->type & LOCK_EX) {
-				if(ff->proc == current) {
-					new = ff;
-					wakeup(ff);
-					break;
-				}
-				unlock_resource(&flock_resource);
-				if(op & LOCK_NB) {
-					return -EWOULDBLOCK;
-				}
-				if(sleep(ff, PROC_INTERRUPTIBLE)) {
-					return -EINTR;
-				}
-				goto loop;
-			}
-		}
-		if(op & LOCK_EX) {
-			if(ff->proc == current) {
-				new = ff;
-				continue;
-			}
-			unlock_resource(&flock_resource);
-			if(op & LOCK_NB) {
-				return -EWOULDBLOCK;
-			}
-			if(sleep(ff, PROC_INTERRUPTIBLE)) {
-				return -EINTR;
-			}
-			goto loop;
+		if(sleep(ff, PROC_INTERRUPTIBLE)) {
+			return -EINTR;
 		}
+		lock_resource(&flock_resource);
 	}
-	unlock_resource(&flock_resource);
 
-	if(!new) {
-		if(!(new = get_new_flock(i))) {
+	/* the list might have changed while sleeping */
+	for(fl = i->locks; fl; fl = fl->next) {
+		if(fl->flags == FL_FLOCK && fl->proc == current) {
+			break;
+		}
+	}
+	if(!fl) {
+		if(!(fl = get_new_flock())) {
+			unlock_resource(&flock_resource);
 			return -ENOLCK;
 		}
+		fl->proc = current;
+		fl->flags = FL_FLOCK;
+		fl->start = 0;
+		fl->end = FL_EOF;
+		insert_flock(i, fl);
+	}
+	if(fl->type != type) {
+		fl->type = type;
+		wakeup(fl);
 	}
-	new->inode = i;
-	new->type = op;
-	new->proc = current;
 
+	unlock_resource(&flock_resource);
 	return 0;
 }
 
 void flock_init(void)
 {
-	memset_b(flock_file_table, NULL, sizeof(flock_file_table));
+	flock_free_list = NULL;
 }
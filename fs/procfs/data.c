@@ -15,6 +15,7 @@
 #include <fiwix/fs.h>
 #include <fiwix/filesystems.h>
 #include <fiwix/devices.h>
+#include <fiwix/diskstats.h>
 #include <fiwix/locks.h>
 #include <fiwix/mm.h>
 #include <fiwix/mman.h>
@@ -24,6 +25,8 @@
 #include <fiwix/sched.h>
 #include <fiwix/timer.h>
 #include <fiwix/utsname.h>
+#include <fiwix/serial.h>
+#include <fiwix/zram.h>
 #include <fiwix/version.h>
 #include <fiwix/errno.h>
 #include <fiwix/stdio.h>
@@ -121,6 +124,88 @@ int data_proc_devices(char *buffer, __pid_t pid)
 	return size;
 }
 
+/* returns the next device accounted in disk_stats_table starting from 'ds' */
+static struct disk_stats * get_disk_stats(struct disk_stats *ds)
+{
+	for(; ds < &disk_stats_table[NR_DISKSTATS]; ds++) {
+		if(ds->dev) {
+			return ds;
+		}
+	}
+	return NULL;
+}
+
+static void * diskstats_start(struct procfs_seq *seq, int index)
+{
+	struct disk_stats *ds;
+
+	ds = get_disk_stats(&disk_stats_table[0]);
+	while(ds && index--) {
+		ds = get_disk_stats(ds + 1);
+	}
+	return ds;
+}
+
+static void * diskstats_next(struct procfs_seq *seq, void *v)
+{
+	return get_disk_stats((struct disk_stats *)v + 1);
+}
+
+/*
+ * Each line has the latency histograms (reads and writes) of a device. The
+ * column of 'n' us counts the requests that took less than that and more
+ * than the previous one.
+ */
+static int disklatency_show(char *buffer, struct procfs_seq *seq, void *v)
+{
+	struct disk_stats *ds;
+	char name[16];
+	int n, mode, size;
+
+	ds = (struct disk_stats *)v;
+	size = 0;
+	if(!seq->index) {
+		size += sprintk(buffer + size, "name   op   ");
+		for(n = 0; n < DISKSTATS_BUCKETS - 1; n++) {
+			size += sprintk(buffer + size, " %8u", 1 << n);
+		}
+		size += sprintk(buffer + size, "     more\n");
+	}
+	disk_name(ds->dev, name);
+	for(mode = FOR_READING; mode <= FOR_WRITING; mode++) {
+		size += sprintk(buffer + size, "%-6s %-5s", name, mode == FOR_READING ? "read" : "write");
+		for(n = 0; n < DISKSTATS_BUCKETS; n++) {
+			size += sprintk(buffer + size, " %8u", ds->hist[mode][n]);
+		}
+		size += sprintk(buffer + size, "\n");
+	}
+	return size;
+}
+
+struct procfs_seq_operations seq_proc_disklatency = {
+	diskstats_start,
+	diskstats_next,
+	disklatency_show,
+	NULL			/* stop */
+};
+
+static int diskstats_show(char *buffer, struct procfs_seq *seq, void *v)
+{
+	struct disk_stats *ds;
+	char name[16];
+
+	ds = (struct disk_stats *)v;
+	disk_name(ds->dev, name);
+	return sprintk(buffer, "%4d %7d %s %u %u %u %u %u %u %u %u %u %u %u\n", MAJOR(ds->dev), MINOR(ds->dev), name, ds->ios[FOR_READING], ds->merges[FOR_READING], ds->sectors[FOR_READING], ds->msecs[FOR_READING], ds->ios[FOR_WRITING], ds->merges[FOR_WRITING], ds->sectors[FOR_WRITING], ds->msecs[FOR_WRITING], ds->in_flight, ds->io_msecs, ds->msecs[FOR_READING] + ds->msecs[FOR_WRITING]);
+}
+
+struct procfs_seq_operations seq_proc_diskstats = {
+	diskstats_start,
+	diskstats_next,
+	diskstats_show,
+	NULL			/* stop */
+};
+
 int data_proc_dma(char *buffer, __pid_t pid)
 {
 	int n, size;
@@ -195,24 +280,59 @@ int data_proc_loadavg(char *buffer, __pid_t pid)
 	return size;
 }
 
-int data_proc_locks(char *buffer, __pid_t pid)
+/* returns the first lock of the inodes starting from 'i' */
+static struct file_lock * get_inode_lock(struct inode *i)
 {
-	int n, size;
-	struct flock_file *ff;
+	for(; i < &inode_table[NR_INODES]; i++) {
+		if(i->locks) {
+			return i->locks;
+		}
+	}
+	return NULL;
+}
 
-	size = 0;
+static void * locks_start(struct procfs_seq *seq, int index)
+{
+	struct file_lock *fl;
 
-	for(n = 0; n < NR_FLOCKS; n++) {
-		ff = &flock_file_table[n];
-		if(ff->inode) {
-			size += sprintk(buffer + size, "%d: FLOCK  ADVISORY  %s ", n + 1, ff->type & LOCK_SH ? "READ " : "WRITE");
-			size += sprintk(buffer + size, "%d %x:%d:%d 0 EOF\n", ff->proc->pid, MAJOR(ff->inode->dev), MINOR(ff->inode->dev), ff->inode->inode);
-		}
+	fl = get_inode_lock(&inode_table[0]);
+	while(fl && index--) {
+		fl = fl->next ? fl->next : get_inode_lock(fl->inode + 1);
 	}
+	return fl;
+}
+
+static void * locks_next(struct procfs_seq *seq, void *v)
+{
+	struct file_lock *fl;
+
+	fl = (struct file_lock *)v;
+	return fl->next ? fl->next : get_inode_lock(fl->inode + 1);
+}
+
+static int locks_show(char *buffer, struct procfs_seq *seq, void *v)
+{
+	struct file_lock *fl;
+	int size;
 
+	fl = (struct file_lock *)v;
+	size = sprintk(buffer, "%d: %s  ADVISORY  %s ", seq->index + 1, fl->flags == FL_POSIX ? "POSIX" : "FLOCK", fl->type & LOCK_SH ? "READ " : "WRITE");
+	size += sprintk(buffer + size, "%d %x:%d:%d %u ", fl->proc->pid, MAJOR(fl->inode->dev), MINOR(fl->inode->dev), fl->inode->inode, fl->start);
+	if(fl->end == FL_EOF) {
+		size += sprintk(buffer + size, "EOF\n");
+	} else {
+		size += sprintk(buffer + size, "%u\n", fl->end);
+	}
 	return size;
 }
 
+struct procfs_seq_operations seq_proc_locks = {
+	locks_start,
+	locks_next,
+	locks_show,
+	NULL			/* stop */
+};
+
 int data_proc_meminfo(char *buffer, __pid_t pid)
 {
 	struct page *pg;
@@ -245,26 +365,55 @@ int data_proc_meminfo(char *buffer, __pid_t pid)
 	return size;
 }
 
-int data_proc_mounts(char *buffer, __pid_t pid)
+/* returns the next mount point listed in /proc/mounts starting from 'n' */
+static struct mount * get_mount(int n)
 {
-	int n, size;
-	char *flag;
-
-	size = 0;
-	for(n = 0; n < NR_MOUNT_POINTS; n++) {
+	for(; n < NR_MOUNT_POINTS; n++) {
 		if(mount_table[n].used) {
 			if(mount_table[n].fs->fsop->flags != FSOP_KERN_MOUNT) {
-				flag = "rw";
-				if(mount_table[n].sb.flags & MS_RDONLY) {
-					flag = "ro";
-				}
-				size += sprintk(buffer + size, "%s %s %s %s 0 0\n", mount_table[n].devname, mount_table[n].dirname, mount_table[n].fs->name, flag);
+				return &mount_table[n];
 			}
 		}
 	}
-	return size;
+	return NULL;
+}
+
+static void * mounts_start(struct procfs_seq *seq, int index)
+{
+	struct mount *mt;
+
+	mt = get_mount(0);
+	while(mt && index--) {
+		mt = get_mount((mt - mount_table) + 1);
+	}
+	return mt;
+}
+
+static void * mounts_next(struct procfs_seq *seq, void *v)
+{
+	return get_mount(((struct mount *)v - mount_table) + 1);
 }
 
+static int mounts_show(char *buffer, struct procfs_seq *seq, void *v)
+{
+	struct mount *mt;
+	char *flag;
+
+	mt = (struct mount *)v;
+	flag = "rw";
+	if(mt->sb.flags & MS_RDONLY) {
+		flag = "ro";
+	}
+	return sprintk(buffer, "%s %s %s %s 0 0\n", mt->devname, mt->dirname, mt->fs->name, flag);
+}
+
+struct procfs_seq_operations seq_proc_mounts = {
+	mounts_start,
+	mounts_next,
+	mounts_show,
+	NULL			/* stop */
+};
+
 int data_proc_partitions(char *buffer, __pid_t pid)
 {
 	int n, ctrl, drv, size;
@@ -334,6 +483,26 @@ int data_proc_rtc(char *buffer, __pid_t pid)
 	return size;
 }
 
+int data_proc_serial(char *buffer, __pid_t pid)
+{
+	int n, type, size;
+	struct serial *s;
+
+	size = 0;
+	for(n = 0; n < NR_SERIAL; n++) {
+		s = &serial_table[n];
+		if(!s->tty) {
+			continue;
+		}
+		/* UART_IS_8250 and the following flags are in the same order as the chips */
+		for(type = 1; type < 4 && !(s->flags & (UART_IS_8250 << (type - 1))); type++);
+		size += sprintk(buffer + size, "%d: uart:%s port:%04X irq:%d baud:%d tx:%d rx:%d", n, serial_chip[type], s->addr, s->irq, s->baud, s->stats.tx, s->stats.rx);
+		size += sprintk(buffer + size, " fe:%d pe:%d brk:%d oe:%d bo:%d int:%d", s->stats.frame, s->stats.parity, s->stats.brk, s->stats.overrun, s->stats.dropped, s->stats.interrupts);
+		size += sprintk(buffer + size, "%s%s\n", s->flags & UART_RTSCTS ? " RTSCTS" : "", s->flags & UART_THROTTLED ? " throttled" : "");
+	}
+	return size;
+}
+
 int data_proc_stat(char *buffer, __pid_t pid)
 {
 	int n, size;
@@ -376,6 +545,23 @@ int data_proc_fullversion(char *buffer, __pid_t pid)
 	return sprintk(buffer, "Fiwix version %s %s\n", UTS_RELEASE, UTS_VERSION);
 }
 
+int data_proc_zram(char *buffer, __pid_t pid)
+{
+	int n, size;
+	struct zram *zram;
+
+	size = 0;
+	size += sprintk(buffer + size, "name      disksize   orig_data  compr_data   mem_used  zero_blocks\n");
+	for(n = 0; n < ZRAM_MINORS; n++) {
+		zram = &zram_table[n];
+		if(!zram->nr_blocks) {
+			continue;
+		}
+		size += sprintk(buffer + size, "zram%d   %8d kB %8d kB %8d kB %8d kB  %11d\n", n, zram->nr_blocks * (ZRAM_BLKSIZE / 1024), zram->stored * (ZRAM_BLKSIZE / 1024), zram->compr_size / 1024, zram->pages * (PAGE_SIZE / 1024), zram->zero);
+	}
+	return size;
+}
+
 int data_proc_domainname(char *buffer, __pid_t pid)
 {
 	return sprintk(buffer, "%s\n", sys_utsname.domainname);
@@ -536,88 +722,109 @@ int data_proc_pid_exe(char *buffer, __pid_t pid)
 	return size;
 }
 
-int data_proc_pid_maps(char *buffer, __pid_t pid)
+static void * maps_start(struct procfs_seq *seq, int index)
+{
+	struct proc *p;
+
+	if(!(p = get_proc_by_pid(seq->pid))) {
+		return NULL;
+	}
+	seq->data = p;
+	if(index >= VMA_REGIONS || !p->vma[index].start) {
+		return NULL;
+	}
+	return &p->vma[index];
+}
+
+static void * maps_next(struct procfs_seq *seq, void *v)
+{
+	struct proc *p;
+	struct vma *vma;
+
+	p = (struct proc *)seq->data;
+	vma = (struct vma *)v + 1;
+	if(vma >= &p->vma[VMA_REGIONS] || !vma->start) {
+		return NULL;
+	}
+	return vma;
+}
+
+static int maps_show(char *buffer, struct procfs_seq *seq, void *v)
 {
-	unsigned int n;
-	int size, len;
 	__ino_t inode;
 	int major, minor;
 	char *section;
 	char r, w, x, f;
-	struct proc *p;
 	struct vma *vma;
 
-	size = 0;
-	if((p = get_proc_by_pid(pid))) {
-		if(!p->vma) {
-			return 0;
-		}
-		vma = p->vma;
-		for(n = 0; n < VMA_REGIONS && vma->start; n++, vma++) {
-			r = vma->prot & PROT_READ ? 'r' : '-';
-			w = vma->prot & PROT_WRITE ? 'w' : '-';
-			x = vma->prot & PROT_EXEC ? 'x' : '-';
-			if(vma->flags & MAP_SHARED) {
-				f = 's';
-			} else if(vma->flags & MAP_PRIVATE) {
-				f = 'p';
-			} else {
-				f = '-';
-			}
-			switch(vma->s_type) {
-				case P_TEXT:	section = "text";
-						break;
-				case P_DATA:	section = "data";
-						break;
-				case P_BSS:	section = "bss";
-						break;
-				case P_HEAP:	section = "heap";
-						break;
-				case P_STACK:	section = "stack";
-						break;
-				case P_MMAP:	section = "mmap";
-						break;
-				default:
-					section = NULL;
-					break;
-			}
-			inode = major = minor = 0;
-			if(vma->inode) {
-				inode = vma->inode->inode;
-				major = MAJOR(vma->inode->dev);
-				minor = MINOR(vma->inode->dev);
-			}
-			len = sprintk(buffer + size, "%08x-%08x %c%c%c%c %08x %02d:%02d %- 10u [%s]\n", vma->start, vma->end, r, w, x, f, vma->offset, major, minor, inode, section);
-			size += len;
-		}
+	vma = (struct vma *)v;
+	r = vma->prot & PROT_READ ? 'r' : '-';
+	w = vma->prot & PROT_WRITE ? 'w' : '-';
+	x = vma->prot & PROT_EXEC ? 'x' : '-';
+	if(vma->flags & MAP_SHARED) {
+		f = 's';
+	} else if(vma->flags & MAP_PRIVATE) {
+		f = 'p';
+	} else {
+		f = '-';
 	}
-	return size;
+	switch(vma->s_type) {
+		case P_TEXT:	section = "text";
+				break;
+		case P_DATA:	section = "data";
+				break;
+		case P_BSS:	section = "bss";
+				break;
+		case P_HEAP:	section = "heap";
+				break;
+		case P_STACK:	section = "stack";
+				break;
+		case P_MMAP:	section = "mmap";
+				break;
+		default:
+			section = NULL;
+			break;
+	}
+	inode = major = minor = 0;
+	if(vma->inode) {
+		inode = vma->inode->inode;
+		major = MAJOR(vma->inode->dev);
+		minor = MINOR(vma->inode->dev);
+	}
+	return sprintk(buffer, "%08x-%08x %c%c%c%c %08x %02d:%02d %- 10u [%s]\n", vma->start, vma->end, r, w, x, f, vma->offset, major, minor, inode, section);
 }
 
-int data_proc_pid_mountinfo(char *buffer, __pid_t pid)
+struct procfs_seq_operations seq_proc_pid_maps = {
+	maps_start,
+	maps_next,
+	maps_show,
+	NULL			/* stop */
+};
+
+static int mountinfo_show(char *buffer, struct procfs_seq *seq, void *v)
 {
-	int n, size;
+	struct mount *mt;
 	char *flag, *devname;
 
-	size = 0;
-	for(n = 0; n < NR_MOUNT_POINTS; n++) {
-		if(mount_table[n].used) {
-			if(mount_table[n].fs->fsop->flags != FSOP_KERN_MOUNT) {
-				flag = "rw";
-				if(mount_table[n].sb.flags & MS_RDONLY) {
-					flag = "ro";
-				}
-				devname = mount_table[n].devname;
-				if(!strcmp(mount_table[n].devname, "/dev/root")) {
-					devname = _rootdevname;
-				}
-				size += sprintk(buffer + size, "%d 0 %d:%d %s %s %s - %s %s %s\n", n, MAJOR(mount_table[n].dev), MINOR(mount_table[n].dev), "/", mount_table[n].dirname, flag, mount_table[n].fs->name, devname, flag);
-			}
-		}
+	mt = (struct mount *)v;
+	flag = "rw";
+	if(mt->sb.flags & MS_RDONLY) {
+		flag = "ro";
 	}
-	return size;
+	devname = mt->devname;
+	if(!strcmp(mt->devname, "/dev/root")) {
+		devname = _rootdevname;
+	}
+	return sprintk(buffer, "%d 0 %d:%d %s %s %s - %s %s %s\n", mt - mount_table, MAJOR(mt->dev), MINOR(mt->dev), "/", mt->dirname, flag, mt->fs->name, devname, flag);
 }
 
+struct procfs_seq_operations seq_proc_pid_mountinfo = {
+	mounts_start,
+	mounts_next,
+	mountinfo_show,
+	NULL			/* stop */
+};
+
 int data_proc_pid_root(char *buffer, __pid_t pid)
 {
 	int size;
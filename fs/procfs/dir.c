@@ -82,6 +82,7 @@ static int proc_listdir(char *buffer, int count)
 		}
 		d.name = p->pidstr;
 		d.data_fn = NULL;
+		d.seq = NULL;
 
 		if(size + sizeof(struct procfs_dir_entry) > (count - 1)) {
 			printk("WARNING: kmalloc() is limited to 4096 bytes.\n");
@@ -117,6 +118,7 @@ static int proc_listfd(struct inode *i, char *buffer, int count)
 			d.lev = -1;
 			d.name_len = sprintk(d.name, "%d", n);
 			d.data_fn = NULL;
+			d.seq = NULL;
 
 			if(size + sizeof(struct procfs_dir_entry) > (count - 1)) {
 				printk("WARNING: kmalloc() is limited to 4096 bytes.\n");
@@ -12,6 +12,7 @@
 #include <fiwix/fs_proc.h>
 #include <fiwix/fcntl.h>
 #include <fiwix/mm.h>
+#include <fiwix/syslog.h>
 #include <fiwix/stdio.h>
 #include <fiwix/string.h>
 
@@ -71,6 +72,65 @@ int procfs_file_close(struct inode *i, struct fd *fd_table)
 	return 0;
 }
 
+/*
+ * The position of the next record to generate is remembered in the file
+ * descriptor, so sequential reads resume from there instead of generating
+ * the whole file again. Seeking backwards restarts from the first record.
+ */
+static int procfs_seq_read(struct procfs_seq_operations *ops, struct fd *fd_table, __pid_t pid, char *buffer, __size_t count)
+{
+	struct procfs_seq seq;
+	__off_t total_read, pos;
+	unsigned int boffset, bytes;
+	int index, len;
+	char *buf;
+	void *v;
+
+	if(!(buf = (void *)kmalloc())) {
+		return -ENOMEM;
+	}
+
+	if(fd_table->offset < fd_table->seq_offset) {
+		fd_table->seq_index = 0;
+		fd_table->seq_offset = 0;
+	}
+	index = fd_table->seq_index;
+	pos = fd_table->seq_offset;
+	total_read = 0;
+
+	seq.pid = pid;
+	seq.index = index;
+	seq.data = NULL;
+	v = ops->start(&seq, index);
+	while(v && count) {
+		seq.index = index;
+		len = ops->show(buf, &seq, v);
+		if(pos + len > fd_table->offset) {
+			boffset = fd_table->offset - pos;
+			bytes = MIN(len - boffset, count);
+			memcpy_b(buffer + total_read, buf + boffset, bytes);
+			total_read += bytes;
+			count -= bytes;
+			fd_table->offset += bytes;
+			if(boffset + bytes < len) {
+				/* this record will be generated again on next read */
+				break;
+			}
+		}
+		pos += len;
+		index++;
+		v = ops->next(&seq, v);
+	}
+	if(ops->stop) {
+		ops->stop(&seq);
+	}
+
+	fd_table->seq_index = index;
+	fd_table->seq_offset = pos;
+	kfree((unsigned int)buf);
+	return total_read;
+}
+
 int procfs_file_read(struct inode *i, struct fd *fd_table, char *buffer, __size_t count)
 {
 	__off_t total_read;
@@ -82,6 +142,12 @@ int procfs_file_read(struct inode *i, struct fd *fd_table, char *buffer, __size_
 	if(!(d = get_procfs_by_inode(i))) {
 		return -EINVAL;
 	}
+	if(i->inode == PROC_KMSG_INO) {
+		return do_syslog(SYSLOG_ACTION_READ, buffer, count);
+	}
+	if(d->seq) {
+		return procfs_seq_read(d->seq, fd_table, (i->inode >> 12) & 0xFFFF, buffer, count);
+	}
 	if(!d->data_fn) {
 		return -EINVAL;
 	}
@@ -32,19 +32,24 @@ struct procfs_dir_entry procfs_array[][PROC_ARRAY_ENTRIES + 1] = {
 	{ 4,     REG,  1, 0, 7,  "cmdline",      data_proc_cmdline },
 	{ 5,     REG,  1, 0, 7,  "cpuinfo",      data_proc_cpuinfo },
 	{ 6,     REG,  1, 0, 7,  "devices",      data_proc_devices },
+	{ 21,    REG,  1, 0, 11, "disklatency",  NULL, &seq_proc_disklatency },
+	{ 22,    REG,  1, 0, 9,  "diskstats",    NULL, &seq_proc_diskstats },
 	{ 7,     REG,  1, 0, 3,  "dma",	         data_proc_dma },
 	{ 8,     REG,  1, 0, 11, "filesystems",  data_proc_filesystems },
 	{ 9,     REG,  1, 0, 10, "interrupts",   data_proc_interrupts },
+	{ PROC_KMSG_INO, REGUSR, 1, 0, 4, "kmsg",   NULL },
 	{ 10,    REG,  1, 0, 7,  "loadavg",      data_proc_loadavg },
-	{ 11,    REG,  1, 0, 5,  "locks",        data_proc_locks },
+	{ 11,    REG,  1, 0, 5,  "locks",        NULL, &seq_proc_locks },
 	{ 12,    REG,  1, 0, 7,  "meminfo",      data_proc_meminfo },
-	{ 13,    REG,  1, 0, 6,  "mounts",       data_proc_mounts },
+	{ 13,    REG,  1, 0, 6,  "mounts",       NULL, &seq_proc_mounts },
 	{ 14,    REG,  1, 0, 10, "partitions",   data_proc_partitions },
 	{ 15,    REG,  1, 0, 3,  "rtc",          data_proc_rtc },
 	{ 16,    LNK,  1, 0, 4,  "self",         data_proc_self },
+	{ 24,    REG,  1, 0, 6,  "serial",       data_proc_serial },
 	{ 17,    REG,  1, 0, 4,  "stat",         data_proc_stat },
 	{ 18,    REG,  1, 0, 6,  "uptime",       data_proc_uptime },
 	{ 19,    REG,  1, 0, 7,  "version",      data_proc_fullversion },
+	{ 20,    REG,  1, 0, 4,  "zram",         data_proc_zram },
 	{ 0, 0, 0, 0, 0, NULL, NULL }
    },
    {	/* [1] /PID/ */
@@ -55,8 +60,8 @@ struct procfs_dir_entry procfs_array[][PROC_ARRAY_ENTRIES + 1] = {
 	{ PROC_PID_CWD,     LNKPID, 1, 1, 3,  "cwd",      data_proc_pid_cwd },
 	{ PROC_PID_ENVIRON, REGUSR, 1, 1, 7,  "environ",  data_proc_pid_environ },
 	{ PROC_PID_EXE,     LNKPID, 1, 1, 3,  "exe",      data_proc_pid_exe },
-	{ PROC_PID_MAPS,    REG,    1, 1, 4,  "maps",     data_proc_pid_maps },
-	{ PROC_PID_MOUNTINFO,REG,   1, 1, 9,  "mountinfo",data_proc_pid_mountinfo },
+	{ PROC_PID_MAPS,    REG,    1, 1, 4,  "maps",     NULL, &seq_proc_pid_maps },
+	{ PROC_PID_MOUNTINFO,REG,   1, 1, 9,  "mountinfo",NULL, &seq_proc_pid_mountinfo },
 	{ PROC_PID_ROOT,    LNKPID, 1, 1, 4,  "root",     data_proc_pid_root },
 	{ PROC_PID_STAT,    REG,    1, 1, 4,  "stat",     data_proc_pid_stat },
 	{ PROC_PID_STATM,   REG,    1, 1, 5,  "statm",    data_proc_pid_statm },
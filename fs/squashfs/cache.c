@@ -0,0 +1,349 @@
+/*
+ * fiwix/fs/squashfs/cache.c
+ *
+ * Copyright 2021, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#include <fiwix/kernel.h>
+#include <fiwix/types.h>
+#include <fiwix/errno.h>
+#include <fiwix/buffer.h>
+#include <fiwix/fs.h>
+#include <fiwix/filesystems.h>
+#include <fiwix/fs_squashfs.h>
+#include <fiwix/inflate.h>
+#include <fiwix/sleep.h>
+#include <fiwix/mm.h>
+#include <fiwix/stdio.h>
+#include <fiwix/string.h>
+
+/*
+ * Squashfs blocks can be bigger than a page, so every decompressed block is
+ * kept in a set of pages which don't need to be contiguous. The compressed
+ * data is read through the buffer cache and it's passed directly to the
+ * decompressor, one buffer at a time.
+ *
+ * All the functions in this file expect the caller to hold squashfs_lock(),
+ * which protects both the caches and the decompressors.
+ */
+
+static struct resource squashfs_resource = { NULL, NULL };
+
+struct squashfs_reader {
+	struct superblock *sb;
+	struct buffer *buf;
+	__u32 pos;			/* next position to read on disk */
+	__u32 left;			/* bytes left to read */
+};
+
+static int reader_fill(struct inflate_stream *s)
+{
+	struct squashfs_reader *r;
+	unsigned int blksize, offset, len;
+
+	r = (struct squashfs_reader *)s->fill_data;
+	if(r->buf) {
+		brelse(r->buf);
+		r->buf = NULL;
+	}
+	if(!r->left) {
+		return 1;
+	}
+
+	blksize = r->sb->s_blocksize;
+	if(!(r->buf = bread(r->sb->dev, r->pos / blksize, blksize))) {
+		return 1;
+	}
+	offset = r->pos % blksize;
+	len = MIN(blksize - offset, r->left);
+	s->in = (unsigned char *)r->buf->data + offset;
+	s->in_len = len;
+	r->pos += len;
+	r->left -= len;
+	return 0;
+}
+
+void squashfs_lock(void)
+{
+	lock_resource(&squashfs_resource);
+}
+
+void squashfs_unlock(void)
+{
+	unlock_resource(&squashfs_resource);
+}
+
+/* copies 'len' bytes into the pages 'data' starting at 'offset' */
+static void copy_to_pages(char **data, unsigned int offset, const char *src, unsigned int len)
+{
+	unsigned int poffset, bytes;
+
+	while(len) {
+		poffset = offset & (PAGE_SIZE - 1);
+		bytes = MIN(PAGE_SIZE - poffset, len);
+		memcpy_b(data[offset >> PAGE_SHIFT] + poffset, src, bytes);
+		offset += bytes;
+		src += bytes;
+		len -= bytes;
+	}
+}
+
+/* copies 'len' bytes from a cached block starting at 'offset' */
+void squashfs_copy_from_entry(char *dest, struct squashfs_cache_entry *entry, unsigned int offset, unsigned int len)
+{
+	unsigned int poffset, bytes;
+
+	while(len) {
+		poffset = offset & (PAGE_SIZE - 1);
+		bytes = MIN(PAGE_SIZE - poffset, len);
+		memcpy_b(dest, entry->data[offset >> PAGE_SHIFT] + poffset, bytes);
+		offset += bytes;
+		dest += bytes;
+		len -= bytes;
+	}
+}
+
+/* reads 'len' bytes from the device, not necessarily aligned to a block */
+int squashfs_read_raw(struct superblock *sb, __u32 pos, void *buffer, unsigned int len)
+{
+	struct buffer *buf;
+	unsigned int blksize, offset, bytes;
+	char *dest;
+
+	blksize = sb->s_blocksize;
+	dest = (char *)buffer;
+	while(len) {
+		if(!(buf = bread(sb->dev, pos / blksize, blksize))) {
+			return -EIO;
+		}
+		offset = pos % blksize;
+		bytes = MIN(blksize - offset, len);
+		memcpy_b(dest, buf->data + offset, bytes);
+		brelse(buf);
+		pos += bytes;
+		dest += bytes;
+		len -= bytes;
+	}
+	return 0;
+}
+
+/*
+ * Reads a block of 'csize' bytes located at 'pos' and decompresses it into
+ * 'data'. It returns the size of the uncompressed data.
+ */
+static int read_block(struct superblock *sb, __u32 pos, unsigned int csize, int compressed, char **data, unsigned int size)
+{
+	struct inflate_stream *s;
+	struct squashfs_reader r;
+	int errno;
+
+	r.sb = sb;
+	r.buf = NULL;
+	r.pos = pos;
+	r.left = csize;
+
+	s = sb->u.squashfs.stream;
+	s->in = NULL;
+	s->in_len = 0;
+	s->fill = reader_fill;
+	s->fill_data = &r;
+
+	if(!compressed) {
+		if(csize > size) {
+			return -EIO;
+		}
+		size = 0;
+		while(!reader_fill(s)) {
+			copy_to_pages(data, size, (char *)s->in, s->in_len);
+			size += s->in_len;
+		}
+		if(size != csize) {
+			return -EIO;
+		}
+		return size;
+	}
+
+	s->out = data;
+	s->out_size = size;
+	s->out_pos = 0;
+	errno = zlib_inflate(s);
+	if(r.buf) {
+		brelse(r.buf);
+	}
+	return errno;
+}
+
+struct squashfs_cache * squashfs_cache_init(int entries, int pages)
+{
+	struct squashfs_cache *cache;
+	char **data;
+	int n;
+
+	if(entries * pages * sizeof(char *) > PAGE_SIZE - sizeof(struct squashfs_cache)) {
+		return NULL;
+	}
+	if(!(cache = (struct squashfs_cache *)kmalloc())) {
+		return NULL;
+	}
+	memset_b(cache, NULL, PAGE_SIZE);
+	cache->entries = entries;
+	cache->pages = pages;
+	cache->victim = 0;
+
+	/* the page pointers of each entry are right after the structure */
+	data = (char **)(cache + 1);
+	for(n = 0; n < entries; n++) {
+		cache->entry[n].length = -1;
+		cache->entry[n].data = data + (n * pages);
+	}
+	return cache;
+}
+
+void squashfs_cache_free(struct squashfs_cache *cache)
+{
+	int n, n2;
+
+	if(!cache) {
+		return;
+	}
+	for(n = 0; n < cache->entries; n++) {
+		for(n2 = 0; n2 < cache->pages; n2++) {
+			if(cache->entry[n].data[n2]) {
+				kfree((unsigned int)cache->entry[n].data[n2]);
+			}
+		}
+	}
+	kfree((unsigned int)cache);
+}
+
+/* returns an entry to be replaced, with its pages allocated */
+static struct squashfs_cache_entry * get_victim(struct squashfs_cache *cache)
+{
+	struct squashfs_cache_entry *entry;
+	int n;
+
+	entry = &cache->entry[cache->victim];
+	cache->victim = (cache->victim + 1) % cache->entries;
+	entry->length = -1;
+
+	for(n = 0; n < cache->pages; n++) {
+		if(!entry->data[n]) {
+			if(!(entry->data[n] = (char *)kmalloc())) {
+				return NULL;
+			}
+		}
+	}
+	return entry;
+}
+
+static struct squashfs_cache_entry * search_cache(struct squashfs_cache *cache, __u32 block)
+{
+	int n;
+
+	for(n = 0; n < cache->entries; n++) {
+		if(cache->entry[n].length >= 0 && cache->entry[n].block == block) {
+			return &cache->entry[n];
+		}
+	}
+	return NULL;
+}
+
+/* returns the decompressed metadata block located at 'block' */
+struct squashfs_cache_entry * squashfs_get_metadata_block(struct superblock *sb, __u32 block)
+{
+	struct squashfs_cache *cache;
+	struct squashfs_cache_entry *entry;
+	unsigned char hdr[2];
+	unsigned int csize;
+	int length;
+
+	cache = sb->u.squashfs.meta_cache;
+	if((entry = search_cache(cache, block))) {
+		return entry;
+	}
+
+	/* every metadata block is preceded by its compressed size */
+	if(squashfs_read_raw(sb, block, hdr, sizeof(hdr))) {
+		return NULL;
+	}
+	csize = (hdr[0] | (hdr[1] << 8)) & ~SQUASHFS_COMPRESSED_BIT;
+	if(!csize || csize > SQUASHFS_METADATA_SIZE) {
+		printk("WARNING: %s(): corrupted metadata block at %d.\n", __FUNCTION__, block);
+		return NULL;
+	}
+	if(!(entry = get_victim(cache))) {
+		return NULL;
+	}
+	length = read_block(sb, block + 2, csize, !(hdr[1] & (SQUASHFS_COMPRESSED_BIT >> 8)), entry->data, SQUASHFS_METADATA_SIZE);
+	if(length < 0) {
+		printk("WARNING: %s(): unable to read metadata block at %d.\n", __FUNCTION__, block);
+		return NULL;
+	}
+	entry->block = block;
+	entry->next = block + 2 + csize;
+	entry->length = length;
+	return entry;
+}
+
+/* returns the decompressed data block located at 'block' */
+struct squashfs_cache_entry * squashfs_get_data_block(struct superblock *sb, struct squashfs_cache *cache, __u32 block, __u32 size)
+{
+	struct squashfs_cache_entry *entry;
+	unsigned int csize;
+	int length;
+
+	if((entry = search_cache(cache, block))) {
+		return entry;
+	}
+
+	csize = SQUASHFS_BLOCK_SIZE(size);
+	if(!csize || csize > sb->u.squashfs.sb.block_size) {
+		printk("WARNING: %s(): corrupted data block at %d.\n", __FUNCTION__, block);
+		return NULL;
+	}
+	if(!(entry = get_victim(cache))) {
+		return NULL;
+	}
+	length = read_block(sb, block, csize, !(size & SQUASHFS_COMPRESSED_BIT_BLOCK), entry->data, sb->u.squashfs.sb.block_size);
+	if(length < 0) {
+		printk("WARNING: %s(): unable to read data block at %d.\n", __FUNCTION__, block);
+		return NULL;
+	}
+	entry->block = block;
+	entry->next = block + csize;
+	entry->length = length;
+	return entry;
+}
+
+/*
+ * Reads 'length' bytes of metadata starting at 'offset' in the metadata
+ * block 'block', crossing to the next blocks if needed. Both values are
+ * updated to point right after the data read.
+ */
+int squashfs_read_metadata(struct superblock *sb, void *buffer, __u32 *block, unsigned int *offset, unsigned int length)
+{
+	struct squashfs_cache_entry *entry;
+	unsigned int bytes;
+	char *dest;
+
+	dest = (char *)buffer;
+	while(length) {
+		if(!(entry = squashfs_get_metadata_block(sb, *block))) {
+			return -EIO;
+		}
+		if(*offset >= entry->length) {
+			return -EIO;
+		}
+		bytes = MIN(entry->length - *offset, length);
+		squashfs_copy_from_entry(dest, entry, *offset, bytes);
+		dest += bytes;
+		length -= bytes;
+		*offset += bytes;
+		if(*offset == entry->length) {
+			*block = entry->next;
+			*offset = 0;
+		}
+	}
+	return 0;
+}
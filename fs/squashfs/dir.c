@@ -0,0 +1,198 @@
+/*
+ * fiwix/fs/squashfs/dir.c
+ *
+ * Copyright 2021, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#include <fiwix/types.h>
+#include <fiwix/errno.h>
+#include <fiwix/fs.h>
+#include <fiwix/filesystems.h>
+#include <fiwix/fs_squashfs.h>
+#include <fiwix/mm.h>
+#include <fiwix/sleep.h>
+#include <fiwix/stat.h>
+#include <fiwix/dirent.h>
+#include <fiwix/stdio.h>
+#include <fiwix/string.h>
+
+struct fs_operations squashfs_dir_fsop = {
+	0,
+	0,
+
+	squashfs_dir_open,
+	squashfs_dir_close,
+	squashfs_dir_read,
+	NULL,			/* write */
+	NULL,			/* ioctl */
+	NULL,			/* lseek */
+	squashfs_dir_readdir,
+	NULL,			/* mmap */
+	NULL,			/* select */
+
+	NULL,			/* readlink */
+	NULL,			/* followlink */
+	NULL,			/* bmap */
+	squashfs_lookup,
+	NULL,			/* rmdir */
+	NULL,			/* link */
+	NULL,			/* unlink */
+	NULL,			/* symlink */
+	NULL,			/* mkdir */
+	NULL,			/* mknod */
+	NULL,			/* truncate */
+	NULL,			/* create */
+	NULL,			/* rename */
+
+	NULL,			/* read_block */
+	NULL,			/* write_block */
+
+	NULL,			/* read_inode */
+	NULL,			/* write_inode */
+	NULL,			/* ialloc */
+	NULL,			/* ifree */
+	NULL,			/* statfs */
+	NULL,			/* read_superblock */
+	NULL,			/* remount_fs */
+	NULL,			/* write_superblock */
+	NULL			/* release_superblock */
+};
+
+static int fill_dirent(struct dirent *dirent, __ino_t inode, __off_t offset, char *name, unsigned int size, unsigned int count)
+{
+	unsigned int dirent_len, name_len;
+
+	name_len = strlen(name);
+	dirent_len = (sizeof(dirent->d_ino) + sizeof(dirent->d_off) + sizeof(dirent->d_reclen) + (name_len + 1)) + 3;
+	dirent_len &= ~3;	/* round up */
+	if((size + dirent_len) >= count) {
+		return 0;
+	}
+	dirent->d_ino = inode;
+	dirent->d_off = offset;
+	dirent->d_reclen = dirent_len;
+	memcpy_b(dirent->d_name, name, name_len);
+	dirent->d_name[name_len] = NULL;
+	return dirent_len;
+}
+
+int squashfs_dir_open(struct inode *i, struct fd *fd_table)
+{
+	fd_table->offset = 0;
+	return 0;
+}
+
+int squashfs_dir_close(struct inode *i, struct fd *fd_table)
+{
+	return 0;
+}
+
+int squashfs_dir_read(struct inode *i, struct fd *fd_table, char *buffer, __size_t count)
+{
+	return -EISDIR;
+}
+
+/*
+ * The directory size includes 3 extra bytes for the entries '.' and '..'
+ * which are not stored in the listing. So the offsets 0 and 1 are used for
+ * them, and from the offset 3 onwards it's the position in the listing.
+ */
+int squashfs_dir_readdir(struct inode *i, struct fd *fd_table, struct dirent *dirent, unsigned int count)
+{
+	struct superblock *sb;
+	struct squashfs_dir_header hdr;
+	struct squashfs_dir_entry d;
+	struct dirent *kdirent;
+	char name[SQUASHFS_NAME_LEN + 1];
+	char *buffer;
+	__u32 block;
+	unsigned int offset, pos, next, size;
+	int dirent_len, errno;
+
+	if(!(S_ISDIR(i->i_mode))) {
+		return -EBADF;
+	}
+
+	/*
+	 * The entries are placed in a kernel page and copied to the user
+	 * buffer once squashfs_lock() is released, as that buffer might be
+	 * a mapping of a file of this filesystem.
+	 */
+	if(!(buffer = (char *)kmalloc())) {
+		return -ENOMEM;
+	}
+	count = MIN(count, PAGE_SIZE);
+	kdirent = (struct dirent *)buffer;
+
+	sb = i->sb;
+	size = 0;
+	errno = 0;
+	if(fd_table->offset == 0) {
+		if(!(dirent_len = fill_dirent(kdirent, i->inode, 0, ".", size, count))) {
+			goto end;
+		}
+		kdirent = (struct dirent *)((char *)kdirent + dirent_len);
+		size += dirent_len;
+		fd_table->offset = 1;
+	}
+	if(fd_table->offset == 1) {
+		if(!(dirent_len = fill_dirent(kdirent, i->u.squashfs.parent ? i->u.squashfs.parent : i->inode, 1, "..", size, count))) {
+			goto end;
+		}
+		kdirent = (struct dirent *)((char *)kdirent + dirent_len);
+		size += dirent_len;
+		fd_table->offset = 3;
+	}
+
+	squashfs_lock();
+	block = sb->u.squashfs.dir_table + i->u.squashfs.start_block;
+	offset = i->u.squashfs.dir_offset;
+	pos = 3;
+
+	while(pos < i->i_size) {
+		if((errno = squashfs_read_metadata(sb, &hdr, &block, &offset, sizeof(struct squashfs_dir_header)))) {
+			break;
+		}
+		pos += sizeof(struct squashfs_dir_header);
+		hdr.count++;
+		while(hdr.count--) {
+			if((errno = squashfs_read_metadata(sb, &d, &block, &offset, sizeof(struct squashfs_dir_entry)))) {
+				break;
+			}
+			if(d.size >= SQUASHFS_NAME_LEN) {
+				errno = -EIO;
+				break;
+			}
+			if((errno = squashfs_read_metadata(sb, name, &block, &offset, d.size + 1))) {
+				break;
+			}
+			name[d.size + 1] = NULL;
+			next = pos + sizeof(struct squashfs_dir_entry) + d.size + 1;
+
+			/* skip the entries already returned */
+			if(pos >= fd_table->offset) {
+				if(!(dirent_len = fill_dirent(kdirent, SQUASHFS_MKINODE(hdr.start_block, d.offset), pos, name, size, count))) {
+					squashfs_unlock();
+					goto end;
+				}
+				kdirent = (struct dirent *)((char *)kdirent + dirent_len);
+				size += dirent_len;
+				fd_table->offset = next;
+			}
+			pos = next;
+		}
+		if(errno) {
+			break;
+		}
+	}
+	squashfs_unlock();
+
+end:
+	memcpy_b(dirent, buffer, size);
+	kfree((unsigned int)buffer);
+	if(errno && !size) {
+		return errno;
+	}
+	return size;
+}
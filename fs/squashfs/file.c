@@ -0,0 +1,219 @@
+/*
+ * fiwix/fs/squashfs/file.c
+ *
+ * Copyright 2021, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#include <fiwix/kernel.h>
+#include <fiwix/types.h>
+#include <fiwix/errno.h>
+#include <fiwix/fs.h>
+#include <fiwix/filesystems.h>
+#include <fiwix/fs_squashfs.h>
+#include <fiwix/mm.h>
+#include <fiwix/sleep.h>
+#include <fiwix/fcntl.h>
+#include <fiwix/stdio.h>
+#include <fiwix/string.h>
+
+#define BLIST_CHUNK	32	/* block sizes read at once */
+
+struct fs_operations squashfs_file_fsop = {
+	0,
+	0,
+
+	squashfs_file_open,
+	squashfs_file_close,
+	squashfs_file_read,
+	NULL,			/* write */
+	NULL,			/* ioctl */
+	squashfs_file_lseek,
+	NULL,			/* readdir */
+	NULL,			/* mmap */
+	NULL,			/* select */
+
+	NULL,			/* readlink */
+	NULL,			/* followlink */
+	NULL,			/* bmap */
+	NULL,			/* lookup */
+	NULL,			/* rmdir */
+	NULL,			/* link */
+	NULL,			/* unlink */
+	NULL,			/* symlink */
+	NULL,			/* mkdir */
+	NULL,			/* mknod */
+	NULL,			/* truncate */
+	NULL,			/* create */
+	NULL,			/* rename */
+
+	NULL,			/* read_block */
+	NULL,			/* write_block */
+
+	NULL,			/* read_inode */
+	NULL,			/* write_inode */
+	NULL,			/* ialloc */
+	NULL,			/* ifree */
+	NULL,			/* statfs */
+	NULL,			/* read_superblock */
+	NULL,			/* remount_fs */
+	NULL,			/* write_superblock */
+	NULL			/* release_superblock */
+};
+
+/*
+ * Gets the block 'nblock' of the file and the offset where its data starts.
+ * The entry is set to NULL if the block is a hole. The position of the last
+ * block looked up is kept in the inode, so a sequential read continues from
+ * there instead of reading the whole list of sizes again.
+ */
+static int get_file_block(struct inode *i, unsigned int nblock, struct squashfs_cache_entry **entry, unsigned int *offset)
+{
+	struct superblock *sb;
+	struct squashfs_fragment_entry frag;
+	__u32 sizes[BLIST_CHUNK];
+	__u32 pos, mblock;
+	unsigned int moffset, nblocks, n, n2, chunk;
+
+	sb = i->sb;
+	nblocks = i->i_size >> sb->u.squashfs.sb.block_log;
+	if(i->u.squashfs.fragment == SQUASHFS_INVALID_FRAG && (i->i_size & (sb->u.squashfs.sb.block_size - 1))) {
+		nblocks++;
+	}
+	*entry = NULL;
+	*offset = 0;
+
+	if(nblock < nblocks) {
+		/* the position of a block is the sum of the sizes of the previous ones */
+		if(i->u.squashfs.blist_mblock && nblock >= i->u.squashfs.blist_block) {
+			n = i->u.squashfs.blist_block;
+			pos = i->u.squashfs.blist_pos;
+			mblock = i->u.squashfs.blist_mblock;
+			moffset = i->u.squashfs.blist_moffset;
+		} else {
+			n = 0;
+			pos = i->u.squashfs.start_block;
+			mblock = i->u.squashfs.meta_block;
+			moffset = i->u.squashfs.meta_offset;
+		}
+		for(; n < nblock; n += chunk) {
+			chunk = MIN(BLIST_CHUNK, nblock - n);
+			if(squashfs_read_metadata(sb, sizes, &mblock, &moffset, chunk * sizeof(__u32))) {
+				return -EIO;
+			}
+			for(n2 = 0; n2 < chunk; n2++) {
+				pos += SQUASHFS_BLOCK_SIZE(sizes[n2]);
+			}
+		}
+		i->u.squashfs.blist_block = nblock;
+		i->u.squashfs.blist_pos = pos;
+		i->u.squashfs.blist_mblock = mblock;
+		i->u.squashfs.blist_moffset = moffset;
+
+		if(squashfs_read_metadata(sb, sizes, &mblock, &moffset, sizeof(__u32))) {
+			return -EIO;
+		}
+		if(!SQUASHFS_BLOCK_SIZE(sizes[0])) {
+			return 0;	/* sparse block */
+		}
+		if(!(*entry = squashfs_get_data_block(sb, sb->u.squashfs.data_cache, pos, sizes[0]))) {
+			return -EIO;
+		}
+		return 0;
+	}
+
+	/* the tail of the file is in a fragment block */
+	if(i->u.squashfs.fragment >= sb->u.squashfs.sb.fragments) {
+		return -EIO;
+	}
+	mblock = sb->u.squashfs.frag_index[i->u.squashfs.fragment / SQUASHFS_FRAGMENTS_PER_BLOCK];
+	moffset = (i->u.squashfs.fragment % SQUASHFS_FRAGMENTS_PER_BLOCK) * sizeof(struct squashfs_fragment_entry);
+	if(squashfs_read_metadata(sb, &frag, &mblock, &moffset, sizeof(struct squashfs_fragment_entry))) {
+		return -EIO;
+	}
+	if(!(*entry = squashfs_get_data_block(sb, sb->u.squashfs.frag_cache, (__u32)frag.start_block, frag.size))) {
+		return -EIO;
+	}
+	*offset = i->u.squashfs.frag_offset;
+	return 0;
+}
+
+int squashfs_file_open(struct inode *i, struct fd *fd_table)
+{
+	if(fd_table->flags & (O_WRONLY | O_RDWR | O_TRUNC | O_APPEND)) {
+		return -EROFS;
+	}
+	fd_table->offset = 0;
+	return 0;
+}
+
+int squashfs_file_close(struct inode *i, struct fd *fd_table)
+{
+	return 0;
+}
+
+/*
+ * The data is copied from the decompressed blocks kept in the caches, so
+ * sequential reads decompress every block only once. It goes through a
+ * kernel page and reaches the user buffer once squashfs_lock() is released,
+ * as that buffer might be a mapping of a file of this filesystem.
+ */
+int squashfs_file_read(struct inode *i, struct fd *fd_table, char *buffer, __size_t count)
+{
+	struct superblock *sb;
+	struct squashfs_cache_entry *entry;
+	__off_t total_read;
+	unsigned int boffset, offset, bytes;
+	char *tmp;
+	int errno;
+
+	sb = i->sb;
+	if(fd_table->offset > i->i_size) {
+		fd_table->offset = i->i_size;
+	}
+	count = MIN(count, i->i_size - fd_table->offset);
+	total_read = 0;
+	errno = 0;
+
+	if(!(tmp = (char *)kmalloc())) {
+		return -ENOMEM;
+	}
+	while(count) {
+		boffset = fd_table->offset & (sb->u.squashfs.sb.block_size - 1);
+		bytes = MIN(sb->u.squashfs.sb.block_size - boffset, count);
+		bytes = MIN(bytes, PAGE_SIZE);
+		squashfs_lock();
+		if((errno = get_file_block(i, fd_table->offset >> sb->u.squashfs.sb.block_log, &entry, &offset))) {
+			squashfs_unlock();
+			break;
+		}
+		if(entry) {
+			if(offset + boffset + bytes > entry->length) {
+				squashfs_unlock();
+				errno = -EIO;
+				break;
+			}
+			squashfs_copy_from_entry(tmp, entry, offset + boffset, bytes);
+		} else {
+			/* fill the hole with zeros */
+			memset_b(tmp, NULL, bytes);
+		}
+		squashfs_unlock();
+
+		memcpy_b(buffer + total_read, tmp, bytes);
+		total_read += bytes;
+		count -= bytes;
+		fd_table->offset += bytes;
+	}
+	kfree((unsigned int)tmp);
+
+	if(errno && !total_read) {
+		return errno;
+	}
+	return total_read;
+}
+
+int squashfs_file_lseek(struct inode *i, __off_t offset)
+{
+	return offset;
+}
@@ -0,0 +1,212 @@
+/*
+ * fiwix/fs/squashfs/inode.c
+ *
+ * Copyright 2021, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#include <fiwix/kernel.h>
+#include <fiwix/types.h>
+#include <fiwix/errno.h>
+#include <fiwix/fs.h>
+#include <fiwix/filesystems.h>
+#include <fiwix/fs_squashfs.h>
+#include <fiwix/fs_pipe.h>
+#include <fiwix/sleep.h>
+#include <fiwix/stat.h>
+#include <fiwix/stdio.h>
+#include <fiwix/string.h>
+
+/* returns the uid or gid stored in the entry 'index' of the id table */
+static __u32 get_id(struct superblock *sb, unsigned int index)
+{
+	__u32 block, id;
+	unsigned int offset;
+
+	if(index >= sb->u.squashfs.sb.no_ids) {
+		return 0;
+	}
+	block = sb->u.squashfs.id_index[index / SQUASHFS_IDS_PER_BLOCK];
+	offset = (index % SQUASHFS_IDS_PER_BLOCK) * sizeof(__u32);
+	if(squashfs_read_metadata(sb, &id, &block, &offset, sizeof(__u32))) {
+		return 0;
+	}
+	return id;
+}
+
+/* converts a squashfs inode number into an inode of this kernel */
+static __ino_t get_inode(struct superblock *sb, __u32 number)
+{
+	__u32 block;
+	__u64 ref;
+	unsigned int offset;
+
+	if(!sb->u.squashfs.lookup_index || !number || number > sb->u.squashfs.sb.inodes) {
+		return 0;
+	}
+	number--;
+	block = sb->u.squashfs.lookup_index[number / SQUASHFS_LOOKUP_PER_BLOCK];
+	offset = (number % SQUASHFS_LOOKUP_PER_BLOCK) * sizeof(__u64);
+	if(squashfs_read_metadata(sb, &ref, &block, &offset, sizeof(__u64))) {
+		return 0;
+	}
+	return SQUASHFS_MKINODE((__u32)(ref >> 16), (__u32)ref & 0xFFFF);
+}
+
+int squashfs_read_inode(struct inode *i)
+{
+	struct superblock *sb;
+	union squashfs_inode sqi;
+	__u32 block, rdev;
+	unsigned int offset, size;
+	int errno;
+
+	sb = i->sb;
+	block = sb->u.squashfs.inode_table + SQUASHFS_INODE_BLOCK(i->inode);
+	offset = SQUASHFS_INODE_OFFSET(i->inode);
+
+	squashfs_lock();
+	if(squashfs_read_metadata(sb, &sqi.base, &block, &offset, sizeof(struct squashfs_base_inode))) {
+		squashfs_unlock();
+		return -EIO;
+	}
+
+	switch(sqi.base.inode_type) {
+		case SQUASHFS_DIR_TYPE:
+			size = sizeof(struct squashfs_dir_inode);
+			break;
+		case SQUASHFS_LDIR_TYPE:
+			size = sizeof(struct squashfs_ldir_inode);
+			break;
+		case SQUASHFS_REG_TYPE:
+			size = sizeof(struct squashfs_reg_inode);
+			break;
+		case SQUASHFS_LREG_TYPE:
+			size = sizeof(struct squashfs_lreg_inode);
+			break;
+		case SQUASHFS_SYMLINK_TYPE:
+		case SQUASHFS_LSYMLINK_TYPE:
+			size = sizeof(struct squashfs_symlink_inode);
+			break;
+		case SQUASHFS_BLKDEV_TYPE:
+		case SQUASHFS_CHRDEV_TYPE:
+		case SQUASHFS_LBLKDEV_TYPE:
+		case SQUASHFS_LCHRDEV_TYPE:
+			size = sizeof(struct squashfs_dev_inode);
+			break;
+		default:
+			size = sizeof(struct squashfs_ipc_inode);
+			break;
+	}
+	size -= sizeof(struct squashfs_base_inode);
+	if(squashfs_read_metadata(sb, (char *)&sqi + sizeof(struct squashfs_base_inode), &block, &offset, size)) {
+		squashfs_unlock();
+		return -EIO;
+	}
+
+	i->i_mode = sqi.base.mode & ~S_IFMT;
+	i->i_uid = get_id(sb, sqi.base.uid);
+	i->i_gid = get_id(sb, sqi.base.guid);
+	i->i_size = 0;
+	i->i_atime = sqi.base.mtime;
+	i->i_ctime = sqi.base.mtime;
+	i->i_mtime = sqi.base.mtime;
+	i->count = 1;
+	memset_b(&i->u.squashfs, NULL, sizeof(struct squashfs_i_info));
+
+	errno = 0;
+	switch(sqi.base.inode_type) {
+		case SQUASHFS_DIR_TYPE:
+			i->i_mode |= S_IFDIR;
+			i->i_nlink = sqi.dir.nlink;
+			i->i_size = sqi.dir.file_size;
+			i->u.squashfs.start_block = sqi.dir.start_block;
+			i->u.squashfs.dir_offset = sqi.dir.offset;
+			i->u.squashfs.parent = get_inode(sb, sqi.dir.parent_inode);
+			i->fsop = &squashfs_dir_fsop;
+			break;
+		case SQUASHFS_LDIR_TYPE:
+			i->i_mode |= S_IFDIR;
+			i->i_nlink = sqi.ldir.nlink;
+			i->i_size = sqi.ldir.file_size;
+			i->u.squashfs.start_block = sqi.ldir.start_block;
+			i->u.squashfs.dir_offset = sqi.ldir.offset;
+			i->u.squashfs.parent = get_inode(sb, sqi.ldir.parent_inode);
+			i->fsop = &squashfs_dir_fsop;
+			break;
+		case SQUASHFS_REG_TYPE:
+			i->i_mode |= S_IFREG;
+			i->i_nlink = 1;
+			i->i_size = sqi.reg.file_size;
+			i->u.squashfs.start_block = sqi.reg.start_block;
+			i->u.squashfs.fragment = sqi.reg.fragment;
+			i->u.squashfs.frag_offset = sqi.reg.offset;
+			i->u.squashfs.meta_block = block;
+			i->u.squashfs.meta_offset = offset;
+			i->fsop = &squashfs_file_fsop;
+			break;
+		case SQUASHFS_LREG_TYPE:
+			if((sqi.lreg.file_size >> 32) || (sqi.lreg.start_block >> 32)) {
+				printk("WARNING: %s(): inode %d is too big.\n", __FUNCTION__, i->inode);
+				errno = -EFBIG;
+				break;
+			}
+			i->i_mode |= S_IFREG;
+			i->i_nlink = sqi.lreg.nlink;
+			i->i_size = (__u32)sqi.lreg.file_size;
+			i->u.squashfs.start_block = (__u32)sqi.lreg.start_block;
+			i->u.squashfs.fragment = sqi.lreg.fragment;
+			i->u.squashfs.frag_offset = sqi.lreg.offset;
+			i->u.squashfs.meta_block = block;
+			i->u.squashfs.meta_offset = offset;
+			i->fsop = &squashfs_file_fsop;
+			break;
+		case SQUASHFS_SYMLINK_TYPE:
+		case SQUASHFS_LSYMLINK_TYPE:
+			i->i_mode |= S_IFLNK;
+			i->i_nlink = sqi.symlink.nlink;
+			i->i_size = sqi.symlink.symlink_size;
+			i->u.squashfs.meta_block = block;
+			i->u.squashfs.meta_offset = offset;
+			i->fsop = &squashfs_symlink_fsop;
+			break;
+		case SQUASHFS_BLKDEV_TYPE:
+		case SQUASHFS_LBLKDEV_TYPE:
+		case SQUASHFS_CHRDEV_TYPE:
+		case SQUASHFS_LCHRDEV_TYPE:
+			if(sqi.base.inode_type == SQUASHFS_BLKDEV_TYPE || sqi.base.inode_type == SQUASHFS_LBLKDEV_TYPE) {
+				i->i_mode |= S_IFBLK;
+				i->fsop = &def_blk_fsop;
+			} else {
+				i->i_mode |= S_IFCHR;
+				i->fsop = &def_chr_fsop;
+			}
+			i->i_nlink = sqi.dev.nlink;
+			/* major in bits 8-19, minor in bits 0-7 and 20-31 */
+			rdev = sqi.dev.rdev;
+			i->rdev = MKDEV((rdev >> 8) & 0xFF, rdev & 0xFF);
+			break;
+		case SQUASHFS_FIFO_TYPE:
+		case SQUASHFS_LFIFO_TYPE:
+			i->i_mode |= S_IFIFO;
+			i->i_nlink = sqi.ipc.nlink;
+			i->fsop = &pipefs_fsop;
+			/* it's a union so we need to clear pipefs_i */
+			memset_b(&i->u.pipefs, NULL, sizeof(struct pipefs_inode));
+			break;
+		case SQUASHFS_SOCKET_TYPE:
+		case SQUASHFS_LSOCKET_TYPE:
+			i->i_mode |= S_IFSOCK;
+			i->i_nlink = sqi.ipc.nlink;
+			i->fsop = NULL;
+			break;
+		default:
+			printk("WARNING: %s(): invalid inode (%d) type %d.\n", __FUNCTION__, i->inode, sqi.base.inode_type);
+			errno = -ENOENT;
+			break;
+	}
+	i->i_blocks = (i->i_size + BPS - 1) / BPS;
+
+	squashfs_unlock();
+	return errno;
+}
@@ -0,0 +1,99 @@
+/*
+ * fiwix/fs/squashfs/namei.c
+ *
+ * Copyright 2021, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#include <fiwix/kernel.h>
+#include <fiwix/types.h>
+#include <fiwix/fs.h>
+#include <fiwix/filesystems.h>
+#include <fiwix/fs_squashfs.h>
+#include <fiwix/sleep.h>
+#include <fiwix/errno.h>
+#include <fiwix/stat.h>
+#include <fiwix/stdio.h>
+#include <fiwix/string.h>
+
+int squashfs_lookup(const char *name, struct inode *dir, struct inode **i_res)
+{
+	struct superblock *sb;
+	struct squashfs_dir_header hdr;
+	struct squashfs_dir_entry d;
+	char d_name[SQUASHFS_NAME_LEN + 1];
+	__u32 block;
+	unsigned int offset, pos;
+	__ino_t inode;
+	int errno;
+
+	sb = dir->sb;
+	inode = 0;
+
+	/* '.' and '..' are not stored in the directory listing */
+	if(!strcmp(name, ".")) {
+		*i_res = dir;
+		return 0;
+	}
+	if(!strcmp(name, "..")) {
+		inode = dir->u.squashfs.parent;
+		if(!inode || inode == dir->inode) {
+			*i_res = dir;
+			return 0;
+		}
+	}
+
+	if(!inode) {
+		squashfs_lock();
+		block = sb->u.squashfs.dir_table + dir->u.squashfs.start_block;
+		offset = dir->u.squashfs.dir_offset;
+		pos = 3;
+		errno = 0;
+
+		while(pos < dir->i_size && !inode && !errno) {
+			if((errno = squashfs_read_metadata(sb, &hdr, &block, &offset, sizeof(struct squashfs_dir_header)))) {
+				break;
+			}
+			pos += sizeof(struct squashfs_dir_header);
+			hdr.count++;
+			while(hdr.count--) {
+				if((errno = squashfs_read_metadata(sb, &d, &block, &offset, sizeof(struct squashfs_dir_entry)))) {
+					break;
+				}
+				if(d.size >= SQUASHFS_NAME_LEN) {
+					errno = -EIO;
+					break;
+				}
+				if((errno = squashfs_read_metadata(sb, d_name, &block, &offset, d.size + 1))) {
+					break;
+				}
+				d_name[d.size + 1] = NULL;
+				pos += sizeof(struct squashfs_dir_entry) + d.size + 1;
+				if(!strcmp(d_name, name)) {
+					inode = SQUASHFS_MKINODE(hdr.start_block, d.offset);
+					break;
+				}
+			}
+		}
+		squashfs_unlock();
+		if(!inode) {
+			iput(dir);
+			return errno ? errno : -ENOENT;
+		}
+	}
+
+	if(!(*i_res = iget(sb, inode))) {
+		iput(dir);
+		return -EACCES;
+	}
+
+	/*
+	 * Without export table the parent of a directory is only known when
+	 * it is reached through a lookup.
+	 */
+	if((*i_res)->sb == sb && S_ISDIR((*i_res)->i_mode) && !(*i_res)->u.squashfs.parent) {
+		(*i_res)->u.squashfs.parent = dir->inode;
+	}
+	iput(dir);
+	return 0;
+}
@@ -0,0 +1,245 @@
+/*
+ * fiwix/fs/squashfs/super.c
+ *
+ * Copyright 2021, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#include <fiwix/kernel.h>
+#include <fiwix/types.h>
+#include <fiwix/errno.h>
+#include <fiwix/buffer.h>
+#include <fiwix/devices.h>
+#include <fiwix/fs.h>
+#include <fiwix/filesystems.h>
+#include <fiwix/fs_squashfs.h>
+#include <fiwix/inflate.h>
+#include <fiwix/statfs.h>
+#include <fiwix/sleep.h>
+#include <fiwix/mm.h>
+#include <fiwix/stdio.h>
+#include <fiwix/string.h>
+
+struct fs_operations squashfs_fsop = {
+	FSOP_REQUIRES_DEV,
+	0,
+
+	NULL,			/* open */
+	NULL,			/* close */
+	NULL,			/* read */
+	NULL,			/* write */
+	NULL,			/* ioctl */
+	NULL,			/* lseek */
+	NULL,			/* readdir */
+	NULL,			/* mmap */
+	NULL,			/* select */
+
+	NULL,			/* readlink */
+	NULL,			/* followlink */
+	NULL,			/* bmap */
+	NULL,			/* lookup */
+	NULL,			/* rmdir */
+	NULL,			/* link */
+	NULL,			/* unlink */
+	NULL,			/* symlink */
+	NULL,			/* mkdir */
+	NULL,			/* mknod */
+	NULL,			/* truncate */
+	NULL,			/* create */
+	NULL,			/* rename */
+
+	NULL,			/* read_block */
+	NULL,			/* write_block */
+
+	squashfs_read_inode,
+	NULL,			/* write_inode */
+	NULL,			/* ialloc */
+	NULL,			/* ifree */
+	squashfs_statfs,
+	squashfs_read_superblock,
+	NULL,			/* remount_fs */
+	NULL,			/* write_superblock */
+	squashfs_release_superblock
+};
+
+/*
+ * Reads a table of 64bit positions located at 'start' into a page of 32bit
+ * values, since this kernel can't address devices bigger than 4GB.
+ */
+static __u32 * read_index(struct superblock *sb, __u64 start, unsigned int entries)
+{
+	__u32 *index;
+	__u64 value;
+	unsigned int n;
+
+	if(entries > PAGE_SIZE / sizeof(__u32)) {
+		return NULL;
+	}
+	if(!(index = (__u32 *)kmalloc())) {
+		return NULL;
+	}
+	for(n = 0; n < entries; n++) {
+		if(squashfs_read_raw(sb, (__u32)start + (n * sizeof(__u64)), &value, sizeof(__u64)) || value >> 32) {
+			kfree((unsigned int)index);
+			return NULL;
+		}
+		index[n] = (__u32)value;
+	}
+	return index;
+}
+
+void squashfs_statfs(struct superblock *sb, struct statfs *statfsbuf)
+{
+	statfsbuf->f_type = SQUASHFS_SUPER_MAGIC;
+	statfsbuf->f_bsize = sb->u.squashfs.sb.block_size;
+	statfsbuf->f_blocks = ((__u32)sb->u.squashfs.sb.bytes_used + statfsbuf->f_bsize - 1) >> sb->u.squashfs.sb.block_log;
+	statfsbuf->f_bfree = 0;
+	statfsbuf->f_bavail = 0;
+	statfsbuf->f_files = sb->u.squashfs.sb.inodes;
+	statfsbuf->f_ffree = 0;
+	/* statfsbuf->f_fsid = ? */
+	statfsbuf->f_namelen = SQUASHFS_NAME_LEN;
+}
+
+int squashfs_read_superblock(__dev_t dev, struct superblock *sb)
+{
+	struct device *d;
+	struct buffer *buf;
+	struct squashfs_super_block *sqsb;
+	unsigned int blksize, pages, entries;
+	__ino_t root_inode;
+
+	superblock_lock(sb);
+	if(!(d = get_device(BLK_DEV, dev))) {
+		superblock_unlock(sb);
+		return -ENXIO;
+	}
+	blksize = d->blksize ? d->blksize : BLKSIZE_1K;
+	if(!(buf = bread(dev, 0, blksize))) {
+		superblock_unlock(sb);
+		return -EIO;
+	}
+
+	sqsb = (struct squashfs_super_block *)buf->data;
+	if(sqsb->s_magic != SQUASHFS_SUPER_MAGIC) {
+		printk("WARNING: %s(): invalid filesystem type or bad superblock on device %d,%d.\n", __FUNCTION__, MAJOR(dev), MINOR(dev));
+		superblock_unlock(sb);
+		brelse(buf);
+		return -EINVAL;
+	}
+	if(sqsb->s_major != SQUASHFS_MAJOR) {
+		printk("WARNING: %s(): squashfs version %d.%d is not supported on device %d,%d.\n", __FUNCTION__, sqsb->s_major, sqsb->s_minor, MAJOR(dev), MINOR(dev));
+		superblock_unlock(sb);
+		brelse(buf);
+		return -EINVAL;
+	}
+	if(sqsb->compression != SQUASHFS_ZLIB) {
+		printk("WARNING: %s(): compression method %d is not supported on device %d,%d.\n", __FUNCTION__, sqsb->compression, MAJOR(dev), MINOR(dev));
+		superblock_unlock(sb);
+		brelse(buf);
+		return -EINVAL;
+	}
+
+	memset_b(&sb->u.squashfs, NULL, sizeof(struct squashfs_sb_info));
+	memcpy_b(&sb->u.squashfs.sb, sqsb, sizeof(struct squashfs_super_block));
+	brelse(buf);
+	sqsb = &sb->u.squashfs.sb;
+
+	sb->dev = dev;
+	sb->fsop = &squashfs_fsop;
+	sb->flags = MS_RDONLY;
+	sb->s_blocksize = blksize;
+
+	if(sqsb->block_size < PAGE_SIZE || sqsb->block_size > SQUASHFS_MAX_BLOCK_SIZE || sqsb->block_size != (1 << sqsb->block_log)) {
+		printk("WARNING: %s(): invalid block size %d on device %d,%d.\n", __FUNCTION__, sqsb->block_size, MAJOR(dev), MINOR(dev));
+		superblock_unlock(sb);
+		return -EINVAL;
+	}
+	if(sqsb->bytes_used >> 32) {
+		printk("WARNING: %s(): filesystem too big on device %d,%d.\n", __FUNCTION__, MAJOR(dev), MINOR(dev));
+		superblock_unlock(sb);
+		return -EINVAL;
+	}
+	if(sqsb->directory_table_start - sqsb->inode_table_start >= SQUASHFS_INODE_MAX_BLOCK) {
+		printk("WARNING: %s(): inode table too big on device %d,%d.\n", __FUNCTION__, MAJOR(dev), MINOR(dev));
+		superblock_unlock(sb);
+		return -EINVAL;
+	}
+	sb->u.squashfs.inode_table = (__u32)sqsb->inode_table_start;
+	sb->u.squashfs.dir_table = (__u32)sqsb->directory_table_start;
+
+	if(sizeof(struct inflate_stream) > PAGE_SIZE || !(sb->u.squashfs.stream = (struct inflate_stream *)kmalloc())) {
+		squashfs_release_superblock(sb);
+		superblock_unlock(sb);
+		return -ENOMEM;
+	}
+
+	pages = sqsb->block_size / PAGE_SIZE;
+	sb->u.squashfs.meta_cache = squashfs_cache_init(SQUASHFS_META_ENTRIES, SQUASHFS_METADATA_PAGES);
+	sb->u.squashfs.frag_cache = squashfs_cache_init(SQUASHFS_FRAG_ENTRIES, pages);
+	sb->u.squashfs.data_cache = squashfs_cache_init(SQUASHFS_DATA_ENTRIES, pages);
+	if(!sb->u.squashfs.meta_cache || !sb->u.squashfs.frag_cache || !sb->u.squashfs.data_cache) {
+		squashfs_release_superblock(sb);
+		superblock_unlock(sb);
+		return -ENOMEM;
+	}
+
+	entries = (sqsb->no_ids + SQUASHFS_IDS_PER_BLOCK - 1) / SQUASHFS_IDS_PER_BLOCK;
+	if(!(sb->u.squashfs.id_index = read_index(sb, sqsb->id_table_start, entries))) {
+		printk("WARNING: %s(): unable to read the id table on device %d,%d.\n", __FUNCTION__, MAJOR(dev), MINOR(dev));
+		squashfs_release_superblock(sb);
+		superblock_unlock(sb);
+		return -EINVAL;
+	}
+	if(sqsb->fragments) {
+		entries = (sqsb->fragments + SQUASHFS_FRAGMENTS_PER_BLOCK - 1) / SQUASHFS_FRAGMENTS_PER_BLOCK;
+		if(!(sb->u.squashfs.frag_index = read_index(sb, sqsb->fragment_table_start, entries))) {
+			printk("WARNING: %s(): unable to read the fragment table on device %d,%d.\n", __FUNCTION__, MAJOR(dev), MINOR(dev));
+			squashfs_release_superblock(sb);
+			superblock_unlock(sb);
+			return -EINVAL;
+		}
+	}
+	/* the export table is optional, it's used to find the parent directories */
+	if(sqsb->lookup_table_start != SQUASHFS_INVALID_BLK) {
+		entries = (sqsb->inodes + SQUASHFS_LOOKUP_PER_BLOCK - 1) / SQUASHFS_LOOKUP_PER_BLOCK;
+		sb->u.squashfs.lookup_index = read_index(sb, sqsb->lookup_table_start, entries);
+	}
+
+	root_inode = SQUASHFS_MKINODE((__u32)(sqsb->root_inode >> 16), (__u32)sqsb->root_inode & 0xFFFF);
+	if(!(sb->root = iget(sb, root_inode))) {
+		printk("WARNING: %s(): unable to get root inode.\n", __FUNCTION__);
+		squashfs_release_superblock(sb);
+		superblock_unlock(sb);
+		return -EINVAL;
+	}
+	sb->root->u.squashfs.parent = root_inode;
+
+	superblock_unlock(sb);
+	return 0;
+}
+
+void squashfs_release_superblock(struct superblock *sb)
+{
+	squashfs_cache_free(sb->u.squashfs.meta_cache);
+	squashfs_cache_free(sb->u.squashfs.frag_cache);
+	squashfs_cache_free(sb->u.squashfs.data_cache);
+	if(sb->u.squashfs.stream) {
+		kfree((unsigned int)sb->u.squashfs.stream);
+	}
+	if(sb->u.squashfs.id_index) {
+		kfree((unsigned int)sb->u.squashfs.id_index);
+	}
+	if(sb->u.squashfs.frag_index) {
+		kfree((unsigned int)sb->u.squashfs.frag_index);
+	}
+	if(sb->u.squashfs.lookup_index) {
+		kfree((unsigned int)sb->u.squashfs.lookup_index);
+	}
+	memset_b(&sb->u.squashfs, NULL, sizeof(struct squashfs_sb_info));
+}
+
+int squashfs_init(void)
+{
+	return register_filesystem("squashfs", &squashfs_fsop);
+}
@@ -0,0 +1,141 @@
+/*
+ * fiwix/fs/squashfs/symlink.c
+ *
+ * Copyright 2021, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#include <fiwix/kernel.h>
+#include <fiwix/types.h>
+#include <fiwix/errno.h>
+#include <fiwix/fs.h>
+#include <fiwix/filesystems.h>
+#include <fiwix/fs_squashfs.h>
+#include <fiwix/sleep.h>
+#include <fiwix/stat.h>
+#include <fiwix/mm.h>
+#include <fiwix/process.h>
+#include <fiwix/sched.h>
+#include <fiwix/stdio.h>
+#include <fiwix/string.h>
+
+struct fs_operations squashfs_symlink_fsop = {
+	0,
+	0,
+
+	NULL,			/* open */
+	NULL,			/* close */
+	NULL,			/* read */
+	NULL,			/* write */
+	NULL,			/* ioctl */
+	NULL,			/* lseek */
+	NULL,			/* readdir */
+	NULL,			/* mmap */
+	NULL,			/* select */
+
+	squashfs_readlink,
+	squashfs_followlink,
+	NULL,			/* bmap */
+	NULL,			/* lookup */
+	NULL,			/* rmdir */
+	NULL,			/* link */
+	NULL,			/* unlink */
+	NULL,			/* symlink */
+	NULL,			/* mkdir */
+	NULL,			/* mknod */
+	NULL,			/* truncate */
+	NULL,			/* create */
+	NULL,			/* rename */
+
+	NULL,			/* read_block */
+	NULL,			/* write_block */
+
+	NULL,			/* read_inode */
+	NULL,			/* write_inode */
+	NULL,			/* ialloc */
+	NULL,			/* ifree */
+	NULL,			/* statfs */
+	NULL,			/* read_superblock */
+	NULL,			/* remount_fs */
+	NULL,			/* write_superblock */
+	NULL			/* release_superblock */
+};
+
+/* the target path is stored in the inode table right after the inode */
+static int read_target(struct inode *i, char *buffer, __size_t count)
+{
+	__u32 block;
+	unsigned int offset;
+	int errno;
+
+	block = i->u.squashfs.meta_block;
+	offset = i->u.squashfs.meta_offset;
+	squashfs_lock();
+	errno = squashfs_read_metadata(i->sb, buffer, &block, &offset, count);
+	squashfs_unlock();
+	buffer[count] = NULL;
+	return errno;
+}
+
+int squashfs_readlink(struct inode *i, char *buffer, __size_t count)
+{
+	char *tmp;
+	int errno;
+
+	if(!S_ISLNK(i->i_mode)) {
+		printk("%s(): Oops, inode '%d' is not a symlink (!?).\n", __FUNCTION__, i->inode);
+		return 0;
+	}
+
+	count = MIN(count, i->i_size);
+	count = MIN(count, PAGE_SIZE - 1);
+	if(!count) {
+		return 0;
+	}
+
+	/* the user buffer is written once squashfs_lock() is released */
+	if(!(tmp = (char *)kmalloc())) {
+		return -ENOMEM;
+	}
+	if(!(errno = read_target(i, tmp, count))) {
+		memcpy_b(buffer, tmp, count);
+		errno = count;
+	}
+	kfree((unsigned int)tmp);
+	return errno;
+}
+
+int squashfs_followlink(struct inode *dir, struct inode *i, struct inode **i_res)
+{
+	char *name;
+	__ino_t errno;
+
+	if(!i) {
+		return -ENOENT;
+	}
+
+	if(!S_ISLNK(i->i_mode)) {
+		printk("%s(): Oops, inode '%d' is not a symlink (!?).\n", __FUNCTION__, i->inode);
+		return 0;
+	}
+
+	if(current->loopcnt > MAX_SYMLINKS) {
+		printk("%s(): too many nested symbolic links!\n", __FUNCTION__);
+		return -ELOOP;
+	}
+
+	if(!(name = (char *)kmalloc())) {
+		return -ENOMEM;
+	}
+	if((errno = read_target(i, name, MIN(i->i_size, PAGE_SIZE - 1)))) {
+		kfree((unsigned int)name);
+		return errno;
+	}
+
+	current->loopcnt++;
+	iput(i);
+	errno = parse_namei(name, dir, i_res, NULL, FOLLOW_LINKS);
+	current->loopcnt--;
+	kfree((unsigned int)name);
+	return errno;
+}
@@ -0,0 +1,130 @@
+/*
+ * fiwix/fs/tmpfs/dir.c
+ *
+ * Copyright 2021, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#include <fiwix/types.h>
+#include <fiwix/errno.h>
+#include <fiwix/fs.h>
+#include <fiwix/filesystems.h>
+#include <fiwix/fs_tmpfs.h>
+#include <fiwix/stat.h>
+#include <fiwix/dirent.h>
+#include <fiwix/mm.h>
+#include <fiwix/stdio.h>
+#include <fiwix/string.h>
+
+struct fs_operations tmpfs_dir_fsop = {
+	0,
+	0,
+
+	tmpfs_dir_open,
+	tmpfs_dir_close,
+	tmpfs_dir_read,
+	tmpfs_dir_write,
+	NULL,			/* ioctl */
+	NULL,			/* lseek */
+	tmpfs_dir_readdir,
+	NULL,			/* mmap */
+	NULL,			/* select */
+
+	NULL,			/* readlink */
+	NULL,			/* followlink */
+	NULL,			/* bmap */
+	tmpfs_lookup,
+	tmpfs_rmdir,
+	tmpfs_link,
+	tmpfs_unlink,
+	tmpfs_symlink,
+	tmpfs_mkdir,
+	tmpfs_mknod,
+	NULL,			/* truncate */
+	tmpfs_create,
+	tmpfs_rename,
+
+	NULL,			/* read_block */
+	NULL,			/* write_block */
+
+	NULL,			/* read_inode */
+	NULL,			/* write_inode */
+	NULL,			/* ialloc */
+	NULL,			/* ifree */
+	NULL,			/* statfs */
+	NULL,			/* read_superblock */
+	NULL,			/* remount_fs */
+	NULL,			/* write_superblock */
+	NULL			/* release_superblock */
+};
+
+int tmpfs_dir_open(struct inode *i, struct fd *fd_table)
+{
+	fd_table->offset = 0;
+	return 0;
+}
+
+int tmpfs_dir_close(struct inode *i, struct fd *fd_table)
+{
+	return 0;
+}
+
+int tmpfs_dir_read(struct inode *i, struct fd *fd_table, char *buffer, __size_t count)
+{
+	return -EISDIR;
+}
+
+int tmpfs_dir_write(struct inode *i, struct fd *fd_table, const char *buffer, __size_t count)
+{
+	return -EBADF;
+}
+
+int tmpfs_dir_readdir(struct inode *i, struct fd *fd_table, struct dirent *dirent, unsigned int count)
+{
+	struct tmpfs_inode *ii;
+	struct tmpfs_dir_entry *d;
+	unsigned int size, dirent_len;
+	int base_dirent_len, name_len;
+	char *data;
+
+	if(!(S_ISDIR(i->i_mode))) {
+		return -EBADF;
+	}
+	if(!(ii = tmpfs_get_inode(i->sb, i->inode, FOR_READING))) {
+		return -EIO;
+	}
+
+	inode_lock(i);
+	if(fd_table->offset > i->i_size) {
+		fd_table->offset = i->i_size;
+	}
+
+	base_dirent_len = sizeof(dirent->d_ino) + sizeof(dirent->d_off) + sizeof(dirent->d_reclen);
+	size = 0;
+
+	while(fd_table->offset < i->i_size) {
+		if(!(data = tmpfs_get_page(i->sb, ii, fd_table->offset, FOR_READING))) {
+			break;
+		}
+		d = (struct tmpfs_dir_entry *)(data + (fd_table->offset % PAGE_SIZE));
+		if(d->inode) {
+			name_len = strlen(d->name);
+			dirent_len = (base_dirent_len + (name_len + 1)) + 3;
+			dirent_len &= ~3;	/* round up */
+			if((size + dirent_len) >= count) {
+				break;
+			}
+			dirent->d_ino = d->inode;
+			dirent->d_off = fd_table->offset;
+			dirent->d_reclen = dirent_len;
+			memcpy_b(dirent->d_name, d->name, name_len);
+			dirent->d_name[name_len] = NULL;
+			dirent = (struct dirent *)((char *)dirent + dirent_len);
+			size += dirent_len;
+		}
+		fd_table->offset += TMPFS_DIRSIZE;
+	}
+
+	inode_unlock(i);
+	return size;
+}
@@ -0,0 +1,194 @@
+/*
+ * fiwix/fs/tmpfs/file.c
+ *
+ * Copyright 2021, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#include <fiwix/kernel.h>
+#include <fiwix/types.h>
+#include <fiwix/errno.h>
+#include <fiwix/fs.h>
+#include <fiwix/filesystems.h>
+#include <fiwix/fs_tmpfs.h>
+#include <fiwix/mm.h>
+#include <fiwix/fcntl.h>
+#include <fiwix/stdio.h>
+#include <fiwix/string.h>
+
+struct fs_operations tmpfs_file_fsop = {
+	0,
+	0,
+
+	tmpfs_file_open,
+	tmpfs_file_close,
+	tmpfs_file_read,
+	tmpfs_file_write,
+	NULL,			/* ioctl */
+	tmpfs_file_lseek,
+	NULL,			/* readdir */
+	NULL,			/* mmap */
+	NULL,			/* select */
+
+	NULL,			/* readlink */
+	NULL,			/* followlink */
+	NULL,			/* bmap */
+	NULL,			/* lookup */
+	NULL,			/* rmdir */
+	NULL,			/* link */
+	NULL,			/* unlink */
+	NULL,			/* symlink */
+	NULL,			/* mkdir */
+	NULL,			/* mknod */
+	tmpfs_truncate,
+	NULL,			/* create */
+	NULL,			/* rename */
+
+	NULL,			/* read_block */
+	NULL,			/* write_block */
+
+	NULL,			/* read_inode */
+	NULL,			/* write_inode */
+	NULL,			/* ialloc */
+	NULL,			/* ifree */
+	NULL,			/* statfs */
+	NULL,			/* read_superblock */
+	NULL,			/* remount_fs */
+	NULL,			/* write_superblock */
+	NULL			/* release_superblock */
+};
+
+int tmpfs_file_open(struct inode *i, struct fd *fd_table)
+{
+	if(fd_table->flags & O_APPEND) {
+		fd_table->offset = i->i_size;
+	} else {
+		fd_table->offset = 0;
+	}
+	if(fd_table->flags & O_TRUNC) {
+		i->i_size = 0;
+		tmpfs_truncate(i, 0);
+	}
+	return 0;
+}
+
+int tmpfs_file_close(struct inode *i, struct fd *fd_table)
+{
+	return 0;
+}
+
+/*
+ * The file contents are already in memory, so they are copied straight from
+ * the pages of the file without going through the buffer cache. The user
+ * buffer is accessed with the inode unlocked, through a kernel page, since
+ * it might be a mapping of this same file and then its page fault would
+ * read the file again.
+ */
+int tmpfs_file_read(struct inode *i, struct fd *fd_table, char *buffer, __size_t count)
+{
+	struct tmpfs_inode *ii;
+	__off_t total_read;
+	unsigned int poffset, bytes;
+	char *data, *tmp;
+
+	if(!(tmp = (char *)kmalloc())) {
+		return -ENOMEM;
+	}
+	total_read = 0;
+
+	while(count) {
+		inode_lock(i);
+		if(!(ii = tmpfs_get_inode(i->sb, i->inode, FOR_READING))) {
+			inode_unlock(i);
+			kfree((unsigned int)tmp);
+			return total_read ? total_read : -EIO;
+		}
+		if(fd_table->offset > i->i_size) {
+			fd_table->offset = i->i_size;
+		}
+		poffset = fd_table->offset % PAGE_SIZE;
+		bytes = PAGE_SIZE - poffset;
+		bytes = MIN(bytes, count);
+		bytes = MIN(bytes, i->i_size - fd_table->offset);
+		if(!bytes) {
+			inode_unlock(i);
+			break;
+		}
+		if((data = tmpfs_get_page(i->sb, ii, fd_table->offset, FOR_READING))) {
+			memcpy_b(tmp, data + poffset, bytes);
+		} else {
+			/* fill the hole with zeros */
+			memset_b(tmp, NULL, bytes);
+		}
+		fd_table->offset += bytes;
+		inode_unlock(i);
+
+		memcpy_b(buffer + total_read, tmp, bytes);
+		total_read += bytes;
+		count -= bytes;
+	}
+
+	kfree((unsigned int)tmp);
+	return total_read;
+}
+
+int tmpfs_file_write(struct inode *i, struct fd *fd_table, const char *buffer, __size_t count)
+{
+	struct tmpfs_inode *ii;
+	__off_t total_written;
+	unsigned int poffset, bytes;
+	char *data, *tmp;
+	int errno;
+
+	if(!(tmp = (char *)kmalloc())) {
+		return -ENOMEM;
+	}
+	total_written = 0;
+	errno = 0;
+
+	while(total_written < count) {
+		bytes = MIN(PAGE_SIZE, count - total_written);
+		memcpy_b(tmp, buffer + total_written, bytes);
+
+		inode_lock(i);
+		if(!(ii = tmpfs_get_inode(i->sb, i->inode, FOR_READING))) {
+			inode_unlock(i);
+			errno = -EIO;
+			break;
+		}
+		if(fd_table->flags & O_APPEND) {
+			fd_table->offset = i->i_size;
+		}
+		poffset = fd_table->offset % PAGE_SIZE;
+		bytes = MIN(bytes, PAGE_SIZE - poffset);
+		if(!(data = tmpfs_get_page(i->sb, ii, fd_table->offset, FOR_WRITING))) {
+			inode_unlock(i);
+			errno = -ENOSPC;
+			break;
+		}
+		memcpy_b(data + poffset, tmp, bytes);
+		update_page_cache(i, fd_table->offset, tmp, bytes);
+		total_written += bytes;
+		fd_table->offset += bytes;
+
+		if(fd_table->offset > i->i_size) {
+			i->i_size = fd_table->offset;
+		}
+		i->i_blocks = ii->i_blocks * (PAGE_SIZE / BPS);
+		i->i_ctime = CURRENT_TIME;
+		i->i_mtime = CURRENT_TIME;
+		i->dirty = 1;
+		inode_unlock(i);
+	}
+
+	kfree((unsigned int)tmp);
+	if(!total_written && count) {
+		return errno;
+	}
+	return total_written;
+}
+
+int tmpfs_file_lseek(struct inode *i, __off_t offset)
+{
+	return offset;
+}
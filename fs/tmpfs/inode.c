@@ -0,0 +1,319 @@
+/*
+ * fiwix/fs/tmpfs/inode.c
+ *
+ * Copyright 2021, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#include <fiwix/kernel.h>
+#include <fiwix/fs.h>
+#include <fiwix/filesystems.h>
+#include <fiwix/fs_tmpfs.h>
+#include <fiwix/fs_pipe.h>
+#include <fiwix/statfs.h>
+#include <fiwix/sleep.h>
+#include <fiwix/stat.h>
+#include <fiwix/sched.h>
+#include <fiwix/mm.h>
+#include <fiwix/process.h>
+#include <fiwix/errno.h>
+#include <fiwix/stdio.h>
+#include <fiwix/string.h>
+
+static unsigned int alloc_page(struct superblock *sb)
+{
+	unsigned int addr;
+
+	if(sb->u.tmpfs.used_pages >= sb->u.tmpfs.max_pages) {
+		return 0;
+	}
+	if(!(addr = kmalloc())) {
+		return 0;
+	}
+	memset_b((void *)addr, NULL, PAGE_SIZE);
+	sb->u.tmpfs.used_pages++;
+	return addr;
+}
+
+static void free_page(struct superblock *sb, unsigned int addr)
+{
+	kfree(addr);
+	sb->u.tmpfs.used_pages--;
+}
+
+/* returns the entry of the inode table, allocating its page if needed */
+struct tmpfs_inode * tmpfs_get_inode(struct superblock *sb, __ino_t inode, int mode)
+{
+	unsigned int n;
+
+	if(!inode || !sb->u.tmpfs.itable) {
+		return NULL;
+	}
+	n = (inode - 1) / TMPFS_INODES_PER_PAGE;
+	if(n >= TMPFS_PTRS_PER_PAGE) {
+		return NULL;
+	}
+	if(!sb->u.tmpfs.itable[n]) {
+		if(mode != FOR_WRITING) {
+			return NULL;
+		}
+		if(!(sb->u.tmpfs.itable[n] = alloc_page(sb))) {
+			return NULL;
+		}
+	}
+	return ((struct tmpfs_inode *)sb->u.tmpfs.itable[n]) + ((inode - 1) % TMPFS_INODES_PER_PAGE);
+}
+
+/*
+ * Returns the page that holds the data at 'offset' or NULL if it's a hole.
+ * If 'mode' is FOR_WRITING the holes are filled with new zeroed pages, so NULL
+ * means that the filesystem is full.
+ */
+char * tmpfs_get_page(struct superblock *sb, struct tmpfs_inode *ii, __off_t offset, int mode)
+{
+	unsigned int *leaf;
+	unsigned int page, n;
+
+	page = offset >> PAGE_SHIFT;
+	n = page / TMPFS_PTRS_PER_PAGE;
+
+	if(!ii->i_index) {
+		if(mode != FOR_WRITING) {
+			return NULL;
+		}
+		if(!(ii->i_index = (unsigned int *)alloc_page(sb))) {
+			return NULL;
+		}
+	}
+	if(!(leaf = (unsigned int *)ii->i_index[n])) {
+		if(mode != FOR_WRITING) {
+			return NULL;
+		}
+		if(!(leaf = (unsigned int *)alloc_page(sb))) {
+			return NULL;
+		}
+		ii->i_index[n] = (unsigned int)leaf;
+	}
+	page %= TMPFS_PTRS_PER_PAGE;
+	if(!leaf[page] && mode == FOR_WRITING) {
+		if(!(leaf[page] = alloc_page(sb))) {
+			return NULL;
+		}
+		ii->i_blocks++;
+	}
+	return (char *)leaf[page];
+}
+
+/* frees all the pages beyond 'length' and removes them from the page cache */
+void tmpfs_free_pages(struct superblock *sb, __ino_t inode, struct tmpfs_inode *ii, __off_t length)
+{
+	unsigned int *leaf;
+	unsigned int first, n, n2, start;
+	char *data;
+
+	if(!ii->i_index) {
+		return;
+	}
+
+	/* the tail of the last page must be clean in case the file grows */
+	if(length % PAGE_SIZE) {
+		if((data = tmpfs_get_page(sb, ii, length, FOR_READING))) {
+			memset_b(data + (length % PAGE_SIZE), NULL, PAGE_SIZE - (length % PAGE_SIZE));
+			invalidate_page(sb->dev, inode, length & PAGE_MASK);
+		}
+	}
+
+	first = PAGE_ALIGN(length) >> PAGE_SHIFT;
+	for(n = first / TMPFS_PTRS_PER_PAGE; n < TMPFS_PTRS_PER_PAGE; n++) {
+		if(!(leaf = (unsigned int *)ii->i_index[n])) {
+			continue;
+		}
+		start = n == first / TMPFS_PTRS_PER_PAGE ? first % TMPFS_PTRS_PER_PAGE : 0;
+		for(n2 = start; n2 < TMPFS_PTRS_PER_PAGE; n2++) {
+			if(leaf[n2]) {
+				free_page(sb, leaf[n2]);
+				leaf[n2] = 0;
+				ii->i_blocks--;
+				invalidate_page(sb->dev, inode, ((n * TMPFS_PTRS_PER_PAGE) + n2) << PAGE_SHIFT);
+			}
+		}
+		if(!start) {
+			free_page(sb, (unsigned int)leaf);
+			ii->i_index[n] = 0;
+		}
+	}
+	if(!first) {
+		free_page(sb, (unsigned int)ii->i_index);
+		ii->i_index = NULL;
+	}
+}
+
+int tmpfs_read_inode(struct inode *i)
+{
+	struct tmpfs_inode *ii;
+	int errno;
+
+	if(!(ii = tmpfs_get_inode(i->sb, i->inode, FOR_READING)) || !ii->i_mode) {
+		return -ENOENT;
+	}
+
+	i->i_mode = ii->i_mode;
+	i->i_nlink = ii->i_nlink;
+	i->i_uid = ii->i_uid;
+	i->i_gid = ii->i_gid;
+	i->i_size = ii->i_size;
+	i->i_atime = ii->i_atime;
+	i->i_mtime = ii->i_mtime;
+	i->i_ctime = ii->i_ctime;
+	i->i_blocks = ii->i_blocks * (PAGE_SIZE / BPS);
+	i->count = 1;
+
+	errno = 0;
+	switch(i->i_mode & S_IFMT) {
+		case S_IFCHR:
+			i->fsop = &def_chr_fsop;
+			i->rdev = ii->i_rdev;
+			break;
+		case S_IFBLK:
+			i->fsop = &def_blk_fsop;
+			i->rdev = ii->i_rdev;
+			break;
+		case S_IFIFO:
+			i->fsop = &pipefs_fsop;
+			/* it's a union so we need to clear pipefs_i */
+			memset_b(&i->u.pipefs, NULL, sizeof(struct pipefs_inode));
+			break;
+		case S_IFDIR:
+			i->fsop = &tmpfs_dir_fsop;
+			break;
+		case S_IFREG:
+			i->fsop = &tmpfs_file_fsop;
+			break;
+		case S_IFLNK:
+			i->fsop = &tmpfs_symlink_fsop;
+			break;
+		case S_IFSOCK:
+			i->fsop = NULL;
+			break;
+		default:
+			printk("WARNING: %s(): invalid inode (%d) mode %o.\n", __FUNCTION__, i->inode, i->i_mode);
+			errno = -ENOENT;
+			break;
+	}
+
+	return errno;
+}
+
+int tmpfs_write_inode(struct inode *i)
+{
+	struct tmpfs_inode *ii;
+
+	/* the inode table is already gone if the filesystem was unmounted */
+	if((ii = tmpfs_get_inode(i->sb, i->inode, FOR_READING)) && ii->i_mode) {
+		ii->i_mode = i->i_mode;
+		ii->i_nlink = i->i_nlink;
+		ii->i_uid = i->i_uid;
+		ii->i_gid = i->i_gid;
+		ii->i_size = i->i_size;
+		ii->i_atime = i->i_atime;
+		ii->i_mtime = i->i_mtime;
+		ii->i_ctime = i->i_ctime;
+		if(S_ISCHR(i->i_mode) || S_ISBLK(i->i_mode)) {
+			ii->i_rdev = i->rdev;
+		}
+	}
+	i->dirty = 0;
+	return 0;
+}
+
+int tmpfs_ialloc(struct inode *i, int mode)
+{
+	struct superblock *sb;
+	struct tmpfs_inode *ii;
+	__ino_t inode;
+	unsigned int n;
+
+	sb = i->sb;
+	superblock_lock(sb);
+
+	if(sb->u.tmpfs.used_inodes >= sb->u.tmpfs.max_inodes) {
+		superblock_unlock(sb);
+		return -ENOSPC;
+	}
+
+	/* start searching right after the last inode allocated */
+	ii = NULL;
+	inode = sb->u.tmpfs.last_ino;
+	for(n = 0; n < sb->u.tmpfs.max_inodes; n++) {
+		if(++inode > sb->u.tmpfs.max_inodes) {
+			inode = 1;
+		}
+		if(!(ii = tmpfs_get_inode(sb, inode, FOR_WRITING))) {
+			superblock_unlock(sb);
+			return -ENOSPC;
+		}
+		if(!ii->i_mode) {
+			break;
+		}
+		ii = NULL;
+	}
+	if(!ii) {
+		superblock_unlock(sb);
+		return -ENOSPC;
+	}
+
+	memset_b(ii, NULL, sizeof(struct tmpfs_inode));
+	ii->i_mode = mode;
+	sb->u.tmpfs.used_inodes++;
+	sb->u.tmpfs.last_ino = inode;
+
+	i->inode = inode;
+	i->i_atime = CURRENT_TIME;
+	i->i_mtime = CURRENT_TIME;
+	i->i_ctime = CURRENT_TIME;
+	superblock_unlock(sb);
+	return 0;
+}
+
+void tmpfs_ifree(struct inode *i)
+{
+	struct superblock *sb;
+	struct tmpfs_inode *ii;
+
+	sb = i->sb;
+	if(!(ii = tmpfs_get_inode(sb, i->inode, FOR_READING)) || !ii->i_mode) {
+		return;
+	}
+
+	superblock_lock(sb);
+	tmpfs_free_pages(sb, i->inode, ii, 0);
+	memset_b(ii, NULL, sizeof(struct tmpfs_inode));
+	sb->u.tmpfs.used_inodes--;
+	superblock_unlock(sb);
+
+	i->i_size = 0;
+	i->i_blocks = 0;
+	i->dirty = 0;
+}
+
+int tmpfs_truncate(struct inode *i, __off_t length)
+{
+	struct tmpfs_inode *ii;
+
+	if(!S_ISDIR(i->i_mode) && !S_ISREG(i->i_mode) && !S_ISLNK(i->i_mode)) {
+		return -EINVAL;
+	}
+	if(!(ii = tmpfs_get_inode(i->sb, i->inode, FOR_READING))) {
+		return -EINVAL;
+	}
+
+	tmpfs_free_pages(i->sb, i->inode, ii, length);
+
+	i->i_blocks = ii->i_blocks * (PAGE_SIZE / BPS);
+	i->i_mtime = CURRENT_TIME;
+	i->i_ctime = CURRENT_TIME;
+	i->i_size = length;
+	i->dirty = 1;
+
+	return 0;
+}
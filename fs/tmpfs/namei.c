@@ -0,0 +1,580 @@
+/*
+ * fiwix/fs/tmpfs/namei.c
+ *
+ * Copyright 2021, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#include <fiwix/kernel.h>
+#include <fiwix/types.h>
+#include <fiwix/fs.h>
+#include <fiwix/filesystems.h>
+#include <fiwix/fs_tmpfs.h>
+#include <fiwix/fs_pipe.h>
+#include <fiwix/sched.h>
+#include <fiwix/mm.h>
+#include <fiwix/errno.h>
+#include <fiwix/stat.h>
+#include <fiwix/stdio.h>
+#include <fiwix/string.h>
+
+/* returns the directory entry located at 'offset' */
+static struct tmpfs_dir_entry * get_dir_entry(struct inode *dir, __off_t offset, int mode)
+{
+	struct tmpfs_inode *ii;
+	char *data;
+
+	if(!(ii = tmpfs_get_inode(dir->sb, dir->inode, FOR_READING))) {
+		return NULL;
+	}
+	if(!(data = tmpfs_get_page(dir->sb, ii, offset, mode))) {
+		return NULL;
+	}
+	if(mode == FOR_WRITING) {
+		dir->i_blocks = ii->i_blocks * (PAGE_SIZE / BPS);
+	}
+	return (struct tmpfs_dir_entry *)(data + (offset % PAGE_SIZE));
+}
+
+static void set_dir_entry(struct tmpfs_dir_entry *d, __ino_t inode, const char *name)
+{
+	int n;
+
+	d->inode = inode;
+	for(n = 0; n < TMPFS_NAME_LEN; n++) {
+		d->name[n] = name[n];
+		if(!name[n] || name[n] == '/') {
+			break;
+		}
+	}
+	for(; n <= TMPFS_NAME_LEN; n++) {
+		d->name[n] = 0;
+	}
+}
+
+static int is_dir_empty(struct inode *dir)
+{
+	struct tmpfs_dir_entry *d;
+	__off_t offset;
+
+	/* accept only "." and ".." */
+	for(offset = TMPFS_DIRSIZE * 2; offset < dir->i_size; offset += TMPFS_DIRSIZE) {
+		if(!(d = get_dir_entry(dir, offset, FOR_READING))) {
+			break;
+		}
+		if(d->inode) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/* finds the entry 'name' with inode 'i' in the directory 'dir' */
+static struct tmpfs_dir_entry * find_dir_entry(struct inode *dir, struct inode *i, const char *name)
+{
+	struct tmpfs_dir_entry *d;
+	__off_t offset;
+
+	for(offset = 0; offset < dir->i_size; offset += TMPFS_DIRSIZE) {
+		if(!(d = get_dir_entry(dir, offset, FOR_READING))) {
+			break;
+		}
+		if(!i) {
+			/* returns the first empty entry */
+			if(!d->inode) {
+				return d;
+			}
+		} else {
+			if(d->inode == i->inode) {
+				/* returns the first matching inode */
+				if(!name) {
+					return d;
+				}
+				/* returns the matching inode and name */
+				if(!strcmp(d->name, name)) {
+					return d;
+				}
+			}
+		}
+	}
+
+	return NULL;
+}
+
+static struct tmpfs_dir_entry * add_dir_entry(struct inode *dir)
+{
+	struct tmpfs_dir_entry *d;
+
+	if(!(d = find_dir_entry(dir, NULL, NULL))) {
+		/* the directory grows by directory entry size */
+		if(!(d = get_dir_entry(dir, dir->i_size, FOR_WRITING))) {
+			return NULL;
+		}
+		dir->i_size += TMPFS_DIRSIZE;
+	}
+
+	return d;
+}
+
+static int is_subdir(struct inode *dir_new, struct inode *i_old)
+{
+	__ino_t inode;
+	int errno;
+
+	errno = 0;
+	dir_new->count++;
+	for(;;) {
+		if(dir_new == i_old) {
+			errno = 1;
+			break;
+		}
+		inode = dir_new->inode;
+		if(tmpfs_lookup("..", dir_new, &dir_new)) {
+			break;
+		}
+		if(dir_new->inode == inode) {
+			break;
+		}
+	}
+	iput(dir_new);
+	return errno;
+}
+
+int tmpfs_lookup(const char *name, struct inode *dir, struct inode **i_res)
+{
+	struct tmpfs_dir_entry *d;
+	__off_t offset;
+
+	for(offset = 0; offset < dir->i_size; offset += TMPFS_DIRSIZE) {
+		if(!(d = get_dir_entry(dir, offset, FOR_READING))) {
+			break;
+		}
+		if(d->inode && !strcmp(d->name, name)) {
+			if(!(*i_res = iget(dir->sb, d->inode))) {
+				iput(dir);
+				return -EACCES;
+			}
+			iput(dir);
+			return 0;
+		}
+	}
+	iput(dir);
+	return -ENOENT;
+}
+
+int tmpfs_rmdir(struct inode *dir, struct inode *i)
+{
+	struct tmpfs_dir_entry *d;
+
+	inode_lock(i);
+
+	if(!is_dir_empty(i)) {
+		inode_unlock(i);
+		return -ENOTEMPTY;
+	}
+
+	inode_lock(dir);
+
+	if(!(d = find_dir_entry(dir, i, NULL))) {
+		inode_unlock(i);
+		inode_unlock(dir);
+		return -ENOENT;
+	}
+
+	d->inode = 0;
+	i->i_nlink = 0;
+	dir->i_nlink--;
+
+	i->i_ctime = CURRENT_TIME;
+	dir->i_mtime = CURRENT_TIME;
+	dir->i_ctime = CURRENT_TIME;
+
+	i->dirty = 1;
+	dir->dirty = 1;
+
+	inode_unlock(i);
+	inode_unlock(dir);
+	return 0;
+}
+
+int tmpfs_link(struct inode *i_old, struct inode *dir_new, char *name)
+{
+	struct tmpfs_dir_entry *d;
+
+	if(strlen(name) > TMPFS_NAME_LEN) {
+		return -ENAMETOOLONG;
+	}
+
+	inode_lock(i_old);
+	inode_lock(dir_new);
+
+	if(!(d = add_dir_entry(dir_new))) {
+		inode_unlock(i_old);
+		inode_unlock(dir_new);
+		return -ENOSPC;
+	}
+
+	set_dir_entry(d, i_old->inode, name);
+
+	i_old->i_nlink++;
+	i_old->i_ctime = CURRENT_TIME;
+	dir_new->i_mtime = CURRENT_TIME;
+	dir_new->i_ctime = CURRENT_TIME;
+
+	i_old->dirty = 1;
+	dir_new->dirty = 1;
+
+	inode_unlock(i_old);
+	inode_unlock(dir_new);
+	return 0;
+}
+
+int tmpfs_unlink(struct inode *dir, struct inode *i, char *name)
+{
+	struct tmpfs_dir_entry *d;
+
+	inode_lock(dir);
+	inode_lock(i);
+
+	if(!(d = find_dir_entry(dir, i, name))) {
+		inode_unlock(dir);
+		inode_unlock(i);
+		return -ENOENT;
+	}
+
+	d->inode = 0;
+	i->i_nlink--;
+
+	i->i_ctime = CURRENT_TIME;
+	dir->i_mtime = CURRENT_TIME;
+	dir->i_ctime = CURRENT_TIME;
+
+	i->dirty = 1;
+	dir->dirty = 1;
+
+	inode_unlock(dir);
+	inode_unlock(i);
+	return 0;
+}
+
+int tmpfs_symlink(struct inode *dir, char *name, char *oldname)
+{
+	struct tmpfs_inode *ii;
+	struct tmpfs_dir_entry *d;
+	struct inode *i;
+	char *data;
+	int n;
+
+	if(strlen(name) > TMPFS_NAME_LEN) {
+		return -ENAMETOOLONG;
+	}
+
+	inode_lock(dir);
+
+	if(!(i = ialloc(dir->sb, S_IFLNK))) {
+		inode_unlock(dir);
+		return -ENOSPC;
+	}
+
+	i->i_mode = S_IFLNK | (S_IRWXU | S_IRWXG | S_IRWXO);
+	i->i_uid = current->euid;
+	i->i_gid = current->egid;
+	i->i_nlink = 1;
+	i->dev = dir->dev;
+	i->count = 1;
+	i->fsop = &tmpfs_symlink_fsop;
+	i->dirty = 1;
+
+	/* the target path is kept in the first data page of the inode */
+	ii = tmpfs_get_inode(i->sb, i->inode, FOR_READING);
+	if(!ii || !(data = tmpfs_get_page(i->sb, ii, 0, FOR_WRITING))) {
+		i->i_nlink = 0;
+		iput(i);
+		inode_unlock(dir);
+		return -ENOSPC;
+	}
+
+	if(!(d = add_dir_entry(dir))) {
+		i->i_nlink = 0;
+		iput(i);
+		inode_unlock(dir);
+		return -ENOSPC;
+	}
+
+	set_dir_entry(d, i->inode, name);
+
+	for(n = 0; n < NAME_MAX && oldname[n]; n++) {
+		data[n] = oldname[n];
+	}
+	data[n] = 0;
+	i->i_size = n;
+	i->i_blocks = ii->i_blocks * (PAGE_SIZE / BPS);
+
+	dir->i_mtime = CURRENT_TIME;
+	dir->i_ctime = CURRENT_TIME;
+	dir->dirty = 1;
+
+	iput(i);
+	inode_unlock(dir);
+	return 0;
+}
+
+int tmpfs_mkdir(struct inode *dir, char *name, __mode_t mode)
+{
+	struct tmpfs_dir_entry *d, *d_new;
+	struct inode *i;
+
+	if(strlen(name) > TMPFS_NAME_LEN) {
+		return -ENAMETOOLONG;
+	}
+
+	inode_lock(dir);
+
+	if(!(i = ialloc(dir->sb, S_IFDIR))) {
+		inode_unlock(dir);
+		return -ENOSPC;
+	}
+
+	i->i_mode = ((mode & (S_IRWXU | S_IRWXG | S_IRWXO)) & ~current->umask);
+	i->i_mode |= S_IFDIR;
+	i->i_uid = current->euid;
+	i->i_gid = current->egid;
+	i->i_nlink = 1;
+	i->dev = dir->dev;
+	i->count = 1;
+	i->fsop = &tmpfs_dir_fsop;
+	i->dirty = 1;
+
+	if(!(d_new = get_dir_entry(i, 0, FOR_WRITING))) {
+		i->i_nlink = 0;
+		iput(i);
+		inode_unlock(dir);
+		return -ENOSPC;
+	}
+
+	if(!(d = add_dir_entry(dir))) {
+		i->i_nlink = 0;
+		iput(i);
+		inode_unlock(dir);
+		return -ENOSPC;
+	}
+
+	set_dir_entry(d, i->inode, name);
+
+	set_dir_entry(d_new, i->inode, ".");
+	i->i_size += TMPFS_DIRSIZE;
+	i->i_nlink++;
+	d_new++;
+	set_dir_entry(d_new, dir->inode, "..");
+	i->i_size += TMPFS_DIRSIZE;
+
+	dir->i_mtime = CURRENT_TIME;
+	dir->i_ctime = CURRENT_TIME;
+	dir->i_nlink++;
+	dir->dirty = 1;
+
+	iput(i);
+	inode_unlock(dir);
+	return 0;
+}
+
+int tmpfs_mknod(struct inode *dir, char *name, __mode_t mode, __dev_t dev)
+{
+	struct tmpfs_dir_entry *d;
+	struct inode *i;
+
+	if(strlen(name) > TMPFS_NAME_LEN) {
+		return -ENAMETOOLONG;
+	}
+
+	inode_lock(dir);
+
+	if(!(i = ialloc(dir->sb, mode & S_IFMT))) {
+		inode_unlock(dir);
+		return -ENOSPC;
+	}
+
+	if(!(d = add_dir_entry(dir))) {
+		i->i_nlink = 0;
+		iput(i);
+		inode_unlock(dir);
+		return -ENOSPC;
+	}
+
+	set_dir_entry(d, i->inode, name);
+
+	i->i_mode = (mode & ~current->umask) & ~S_IFMT;
+	i->i_uid = current->euid;
+	i->i_gid = current->egid;
+	i->i_nlink = 1;
+	i->dev = dir->dev;
+	i->count = 1;
+	i->dirty = 1;
+
+	switch(mode & S_IFMT) {
+		case S_IFCHR:
+			i->fsop = &def_chr_fsop;
+			i->rdev = dev;
+			i->i_mode |= S_IFCHR;
+			break;
+		case S_IFBLK:
+			i->fsop = &def_blk_fsop;
+			i->rdev = dev;
+			i->i_mode |= S_IFBLK;
+			break;
+		case S_IFIFO:
+			i->fsop = &pipefs_fsop;
+			i->i_mode |= S_IFIFO;
+			/* it's a union so we need to clear pipefs_i */
+			memset_b(&i->u.pipefs, NULL, sizeof(struct pipefs_inode));
+			break;
+	}
+
+	dir->i_mtime = CURRENT_TIME;
+	dir->i_ctime = CURRENT_TIME;
+	dir->dirty = 1;
+
+	iput(i);
+	inode_unlock(dir);
+	return 0;
+}
+
+int tmpfs_create(struct inode *dir, char *name, __mode_t mode, struct inode **i_res)
+{
+	struct tmpfs_dir_entry *d;
+	struct inode *i;
+
+	if(strlen(name) > TMPFS_NAME_LEN) {
+		return -ENAMETOOLONG;
+	}
+
+	inode_lock(dir);
+
+	if(!(i = ialloc(dir->sb, S_IFREG))) {
+		inode_unlock(dir);
+		return -ENOSPC;
+	}
+
+	if(!(d = add_dir_entry(dir))) {
+		i->i_nlink = 0;
+		iput(i);
+		inode_unlock(dir);
+		return -ENOSPC;
+	}
+
+	set_dir_entry(d, i->inode, name);
+
+	i->i_mode = (mode & ~current->umask) & ~S_IFMT;
+	i->i_mode |= S_IFREG;
+	i->i_uid = current->euid;
+	i->i_gid = current->egid;
+	i->i_nlink = 1;
+	i->dev = dir->dev;
+	i->fsop = &tmpfs_file_fsop;
+	i->count = 1;
+	i->dirty = 1;
+
+	dir->i_mtime = CURRENT_TIME;
+	dir->i_ctime = CURRENT_TIME;
+	dir->dirty = 1;
+
+	*i_res = i;
+	inode_unlock(dir);
+	return 0;
+}
+
+int tmpfs_rename(struct inode *i_old, struct inode *dir_old, struct inode *i_new, struct inode *dir_new, char *oldpath, char *newpath)
+{
+	struct tmpfs_dir_entry *d_old, *d_new;
+	int errno;
+
+	if(strlen(newpath) > TMPFS_NAME_LEN) {
+		return -ENAMETOOLONG;
+	}
+	if(is_subdir(dir_new, i_old)) {
+		return -EINVAL;
+	}
+
+	errno = 0;
+	inode_lock(i_old);
+	inode_lock(dir_old);
+	if(dir_old != dir_new) {
+		inode_lock(dir_new);
+	}
+
+	if(!(d_old = find_dir_entry(dir_old, i_old, oldpath))) {
+		errno = -ENOENT;
+		goto end;
+	}
+
+	if(i_new) {
+		if(S_ISDIR(i_old->i_mode)) {
+			if(!S_ISDIR(i_new->i_mode)) {
+				errno = -ENOTDIR;
+				goto end;
+			}
+			if(!is_dir_empty(i_new)) {
+				errno = -ENOTEMPTY;
+				goto end;
+			}
+		} else if(S_ISDIR(i_new->i_mode)) {
+			errno = -EISDIR;
+			goto end;
+		}
+		if(!(d_new = find_dir_entry(dir_new, i_new, newpath))) {
+			errno = -ENOENT;
+			goto end;
+		}
+		if(S_ISDIR(i_new->i_mode)) {
+			/*
+			 * The directory replaced is removed as in rmdir(). The
+			 * new parent loses its link but gains the one of
+			 * 'i_old', so only the old parent loses one.
+			 */
+			i_new->i_nlink = 0;
+			dir_old->i_nlink--;
+		} else {
+			i_new->i_nlink--;
+		}
+		i_new->i_ctime = CURRENT_TIME;
+		i_new->dirty = 1;
+	} else {
+		if(!(d_new = add_dir_entry(dir_new))) {
+			errno = -ENOSPC;
+			goto end;
+		}
+		set_dir_entry(d_new, 0, newpath);
+		if(S_ISDIR(i_old->i_mode)) {
+			dir_old->i_nlink--;
+			dir_new->i_nlink++;
+		}
+	}
+
+	d_new->inode = i_old->inode;
+	d_old->inode = 0;
+
+	dir_new->i_mtime = CURRENT_TIME;
+	dir_new->i_ctime = CURRENT_TIME;
+	dir_new->dirty = 1;
+	dir_old->i_mtime = CURRENT_TIME;
+	dir_old->i_ctime = CURRENT_TIME;
+	dir_old->dirty = 1;
+	i_old->i_ctime = CURRENT_TIME;
+	i_old->dirty = 1;
+
+	/* update the parent directory */
+	if(S_ISDIR(i_old->i_mode)) {
+		if((d_new = find_dir_entry(i_old, dir_old, ".."))) {
+			d_new->inode = dir_new->inode;
+		}
+	}
+
+end:
+	inode_unlock(i_old);
+	inode_unlock(dir_old);
+	if(dir_old != dir_new) {
+		inode_unlock(dir_new);
+	}
+	return errno;
+}
@@ -0,0 +1,168 @@
+/*
+ * fiwix/fs/tmpfs/super.c
+ *
+ * Copyright 2021, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#include <fiwix/kernel.h>
+#include <fiwix/types.h>
+#include <fiwix/errno.h>
+#include <fiwix/fs.h>
+#include <fiwix/filesystems.h>
+#include <fiwix/fs_tmpfs.h>
+#include <fiwix/stat.h>
+#include <fiwix/mm.h>
+#include <fiwix/sched.h>
+#include <fiwix/stdio.h>
+#include <fiwix/string.h>
+
+struct fs_operations tmpfs_fsop = {
+	0,
+	TMPFS_DEV,
+
+	NULL,			/* open */
+	NULL,			/* close */
+	NULL,			/* read */
+	NULL,			/* write */
+	NULL,			/* ioctl */
+	NULL,			/* lseek */
+	NULL,			/* readdir */
+	NULL,			/* mmap */
+	NULL,			/* select */
+
+	NULL,			/* readlink */
+	NULL,			/* followlink */
+	NULL,			/* bmap */
+	NULL,			/* lookup */
+	NULL,			/* rmdir */
+	NULL,			/* link */
+	NULL,			/* unlink */
+	NULL,			/* symlink */
+	NULL,			/* mkdir */
+	NULL,			/* mknod */
+	NULL,			/* truncate */
+	NULL,			/* create */
+	NULL,			/* rename */
+
+	NULL,			/* read_block */
+	NULL,			/* write_block */
+
+	tmpfs_read_inode,
+	tmpfs_write_inode,
+	tmpfs_ialloc,
+	tmpfs_ifree,
+	tmpfs_statfs,
+	tmpfs_read_superblock,
+	tmpfs_remount_fs,
+	NULL,			/* write_superblock */
+	tmpfs_release_superblock
+};
+
+void tmpfs_statfs(struct superblock *sb, struct statfs *statfsbuf)
+{
+	statfsbuf->f_type = TMPFS_SUPER_MAGIC;
+	statfsbuf->f_bsize = sb->s_blocksize;
+	statfsbuf->f_blocks = sb->u.tmpfs.max_pages;
+	statfsbuf->f_bfree = sb->u.tmpfs.max_pages - sb->u.tmpfs.used_pages;
+	statfsbuf->f_bavail = statfsbuf->f_bfree;
+
+	statfsbuf->f_files = sb->u.tmpfs.max_inodes;
+	statfsbuf->f_ffree = sb->u.tmpfs.max_inodes - sb->u.tmpfs.used_inodes;
+	/* statfsbuf->f_fsid = ? */
+	statfsbuf->f_namelen = TMPFS_NAME_LEN;
+}
+
+int tmpfs_read_superblock(__dev_t dev, struct superblock *sb)
+{
+	struct tmpfs_inode *ii;
+	struct tmpfs_dir_entry *d;
+
+	superblock_lock(sb);
+	sb->dev = dev;
+	sb->fsop = &tmpfs_fsop;
+	sb->s_blocksize = PAGE_SIZE;
+	sb->u.tmpfs.max_pages = (kstat.total_mem_pages * TMPFS_PERCENTAGE) / 100;
+	sb->u.tmpfs.used_pages = 0;
+	sb->u.tmpfs.max_inodes = TMPFS_PTRS_PER_PAGE * TMPFS_INODES_PER_PAGE;
+	sb->u.tmpfs.used_inodes = 0;
+	sb->u.tmpfs.last_ino = 0;
+
+	if(!(sb->u.tmpfs.itable = (unsigned int *)kmalloc())) {
+		superblock_unlock(sb);
+		return -ENOMEM;
+	}
+	memset_b(sb->u.tmpfs.itable, NULL, PAGE_SIZE);
+
+	/* the root directory is created from scratch on every mount */
+	if(!(ii = tmpfs_get_inode(sb, TMPFS_ROOT_INO, FOR_WRITING))) {
+		tmpfs_release_superblock(sb);
+		superblock_unlock(sb);
+		return -ENOMEM;
+	}
+	ii->i_mode = S_IFDIR | S_ISVTX | S_IRWXU | S_IRWXG | S_IRWXO;
+	ii->i_nlink = 2;
+	sb->u.tmpfs.used_inodes++;
+	sb->u.tmpfs.last_ino = TMPFS_ROOT_INO;
+	if(!(d = (struct tmpfs_dir_entry *)tmpfs_get_page(sb, ii, 0, FOR_WRITING))) {
+		tmpfs_release_superblock(sb);
+		superblock_unlock(sb);
+		return -ENOMEM;
+	}
+	d->inode = TMPFS_ROOT_INO;
+	strcpy(d->name, ".");
+	d++;
+	d->inode = TMPFS_ROOT_INO;
+	strcpy(d->name, "..");
+	ii->i_size = TMPFS_DIRSIZE * 2;
+	ii->i_atime = ii->i_mtime = ii->i_ctime = CURRENT_TIME;
+
+	if(!(sb->root = iget(sb, TMPFS_ROOT_INO))) {
+		printk("WARNING: %s(): unable to get root inode.\n", __FUNCTION__);
+		tmpfs_release_superblock(sb);
+		superblock_unlock(sb);
+		return -EINVAL;
+	}
+
+	superblock_unlock(sb);
+	return 0;
+}
+
+int tmpfs_remount_fs(struct superblock *sb, int flags)
+{
+	return 0;
+}
+
+/* all the contents of the filesystem are lost when it is unmounted */
+void tmpfs_release_superblock(struct superblock *sb)
+{
+	struct tmpfs_inode *ii;
+	unsigned int n, n2;
+	__ino_t inode;
+
+	if(!sb->u.tmpfs.itable) {
+		return;
+	}
+
+	for(n = 0; n < TMPFS_PTRS_PER_PAGE; n++) {
+		if(!(ii = (struct tmpfs_inode *)sb->u.tmpfs.itable[n])) {
+			continue;
+		}
+		for(n2 = 0; n2 < TMPFS_INODES_PER_PAGE; n2++, ii++) {
+			if(ii->i_mode) {
+				inode = (n * TMPFS_INODES_PER_PAGE) + n2 + 1;
+				tmpfs_free_pages(sb, inode, ii, 0);
+			}
+		}
+		kfree(sb->u.tmpfs.itable[n]);
+		sb->u.tmpfs.used_pages--;
+	}
+	kfree((unsigned int)sb->u.tmpfs.itable);
+	sb->u.tmpfs.itable = NULL;
+	sb->u.tmpfs.used_inodes = 0;
+}
+
+int tmpfs_init(void)
+{
+	return register_filesystem("tmpfs", &tmpfs_fsop);
+}
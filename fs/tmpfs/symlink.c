@@ -0,0 +1,130 @@
+/*
+ * fiwix/fs/tmpfs/symlink.c
+ *
+ * Copyright 2021, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#include <fiwix/kernel.h>
+#include <fiwix/types.h>
+#include <fiwix/errno.h>
+#include <fiwix/fs.h>
+#include <fiwix/filesystems.h>
+#include <fiwix/fs_tmpfs.h>
+#include <fiwix/stat.h>
+#include <fiwix/mm.h>
+#include <fiwix/process.h>
+#include <fiwix/sched.h>
+#include <fiwix/stdio.h>
+#include <fiwix/string.h>
+
+struct fs_operations tmpfs_symlink_fsop = {
+	0,
+	0,
+
+	NULL,			/* open */
+	NULL,			/* close */
+	NULL,			/* read */
+	NULL,			/* write */
+	NULL,			/* ioctl */
+	NULL,			/* lseek */
+	NULL,			/* readdir */
+	NULL,			/* mmap */
+	NULL,			/* select */
+
+	tmpfs_readlink,
+	tmpfs_followlink,
+	NULL,			/* bmap */
+	NULL,			/* lookup */
+	NULL,			/* rmdir */
+	NULL,			/* link */
+	NULL,			/* unlink */
+	NULL,			/* symlink */
+	NULL,			/* mkdir */
+	NULL,			/* mknod */
+	NULL,			/* truncate */
+	NULL,			/* create */
+	NULL,			/* rename */
+
+	NULL,			/* read_block */
+	NULL,			/* write_block */
+
+	NULL,			/* read_inode */
+	NULL,			/* write_inode */
+	NULL,			/* ialloc */
+	NULL,			/* ifree */
+	NULL,			/* statfs */
+	NULL,			/* read_superblock */
+	NULL,			/* remount_fs */
+	NULL,			/* write_superblock */
+	NULL			/* release_superblock */
+};
+
+int tmpfs_readlink(struct inode *i, char *buffer, __size_t count)
+{
+	struct tmpfs_inode *ii;
+	char *data;
+
+	if(!S_ISLNK(i->i_mode)) {
+		printk("%s(): Oops, inode '%d' is not a symlink (!?).\n", __FUNCTION__, i->inode);
+		return 0;
+	}
+
+	inode_lock(i);
+	count = MIN(count, i->i_size);
+	if(!count) {
+		inode_unlock(i);
+		return 0;
+	}
+	ii = tmpfs_get_inode(i->sb, i->inode, FOR_READING);
+	if(!ii || !(data = tmpfs_get_page(i->sb, ii, 0, FOR_READING))) {
+		inode_unlock(i);
+		return -EIO;
+	}
+	memcpy_b(buffer, data, count);
+	buffer[count] = NULL;
+	inode_unlock(i);
+	return count;
+}
+
+int tmpfs_followlink(struct inode *dir, struct inode *i, struct inode **i_res)
+{
+	struct tmpfs_inode *ii;
+	char *data, *name;
+	__ino_t errno;
+
+	if(!i) {
+		return -ENOENT;
+	}
+
+	if(!S_ISLNK(i->i_mode)) {
+		printk("%s(): Oops, inode '%d' is not a symlink (!?).\n", __FUNCTION__, i->inode);
+		return 0;
+	}
+
+	if(current->loopcnt > MAX_SYMLINKS) {
+		printk("%s(): too many nested symbolic links!\n", __FUNCTION__);
+		return -ELOOP;
+	}
+
+	inode_lock(i);
+	ii = tmpfs_get_inode(i->sb, i->inode, FOR_READING);
+	if(!ii || !(data = tmpfs_get_page(i->sb, ii, 0, FOR_READING))) {
+		inode_unlock(i);
+		return -EIO;
+	}
+	/* the page of the symlink might be freed by iput() */
+	if(!(name = (char *)kmalloc())) {
+		inode_unlock(i);
+		return -ENOMEM;
+	}
+	memcpy_b(name, data, i->i_size + 1);
+	inode_unlock(i);
+
+	current->loopcnt++;
+	iput(i);
+	errno = parse_namei(name, dir, i_res, NULL, FOLLOW_LINKS);
+	current->loopcnt--;
+	kfree((unsigned int)name);
+	return errno;
+}
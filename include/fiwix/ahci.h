@@ -0,0 +1,205 @@
+/*
+ * fiwix/include/fiwix/ahci.h
+ *
+ * Copyright 2021, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#ifndef _FIWIX_AHCI_H
+#define _FIWIX_AHCI_H
+
+#include <fiwix/fs.h>
+#include <fiwix/ide.h>
+#include <fiwix/part.h>
+#include <fiwix/pci.h>
+#include <fiwix/pic.h>
+
+#define AHCI_MAJOR		8	/* SATA disks major number */
+#define AHCI_DISK_MINORS	16	/* minors per disk (sda, sda1, ...) */
+#define NR_AHCI_DISKS		16
+#define NR_AHCI_CTRLS		2
+#define NR_AHCI_PORTS		32
+#define AHCI_SECTSIZE		512	/* sector size (in bytes) */
+
+#define AHCI_MAX_SLOTS		32	/* command slots per port */
+#define AHCI_MAX_PRDS		56	/* PRD entries per command table */
+#define AHCI_CMD_TABLES		(PAGE_SIZE / sizeof(struct ahci_cmd_table))
+#define AHCI_FIS_OFFSET		1024	/* FIS area after the command list */
+
+#define WAIT_FOR_AHCI		(5 * HZ)	/* timeout for a command */
+
+#define AHCI_PCI_PROG_IF	0x01	/* AHCI 1.0 programming interface */
+#define AHCI_PCI_ABAR		5	/* BAR of the HBA registers */
+
+/* CAP register */
+#define AHCI_CAP_NCS(cap)	((((cap) >> 8) & 0x1F) + 1)	/* slots */
+#define AHCI_CAP_SNCQ		0x40000000	/* supports NCQ */
+#define AHCI_CAP_S64A		0x80000000	/* supports 64bit addressing */
+
+/* GHC register */
+#define AHCI_GHC_HR		0x00000001	/* HBA reset */
+#define AHCI_GHC_IE		0x00000002	/* interrupt enable */
+#define AHCI_GHC_AE		0x80000000	/* AHCI enable */
+
+/* PxCMD register */
+#define AHCI_PxCMD_ST		0x00000001	/* start */
+#define AHCI_PxCMD_SUD		0x00000002	/* spin-up device */
+#define AHCI_PxCMD_POD		0x00000004	/* power on device */
+#define AHCI_PxCMD_FRE		0x00000010	/* FIS receive enable */
+#define AHCI_PxCMD_FR		0x00004000	/* FIS receive running */
+#define AHCI_PxCMD_CR		0x00008000	/* command list running */
+
+/* PxIS and PxIE registers */
+#define AHCI_PxIS_DHRS		0x00000001	/* D2H register FIS */
+#define AHCI_PxIS_PSS		0x00000002	/* PIO setup FIS */
+#define AHCI_PxIS_DSS		0x00000004	/* DMA setup FIS */
+#define AHCI_PxIS_SDBS		0x00000008	/* set device bits FIS */
+#define AHCI_PxIS_DPS		0x00000020	/* descriptor processed */
+#define AHCI_PxIS_IFS		0x08000000	/* interface fatal error */
+#define AHCI_PxIS_HBDS		0x10000000	/* host bus data error */
+#define AHCI_PxIS_HBFS		0x20000000	/* host bus fatal error */
+#define AHCI_PxIS_TFES		0x40000000	/* task file error */
+#define AHCI_PxIS_ERROR		(AHCI_PxIS_IFS | AHCI_PxIS_HBDS | AHCI_PxIS_HBFS | AHCI_PxIS_TFES)
+#define AHCI_PxIE_DEFAULT	(AHCI_PxIS_DHRS | AHCI_PxIS_PSS | AHCI_PxIS_DSS | AHCI_PxIS_SDBS | AHCI_PxIS_ERROR)
+
+/* PxTFD register */
+#define AHCI_PxTFD_ERR		0x01
+#define AHCI_PxTFD_DRQ		0x08
+#define AHCI_PxTFD_BSY		0x80
+
+#define AHCI_PxSSTS_DET(ssts)	((ssts) & 0x0F)
+#define AHCI_DET_PRESENT	3	/* device present and link up */
+#define AHCI_SIG_ATA		0x00000101	/* SATA disk signature */
+
+/* command header flags */
+#define AHCI_CMD_WRITE		0x0040	/* data goes to the device */
+#define AHCI_CMD_CLEAR_BUSY	0x0400	/* clear busy upon R_OK */
+
+#define AHCI_FIS_H2D		0x27	/* register FIS host to device */
+#define AHCI_FIS_COMMAND	0x80	/* the FIS carries a command */
+#define AHCI_FIS_LBA_MODE	0x40
+
+#define AHCI_PRD_INTR		0x80000000	/* interrupt on completion */
+
+#define ATA_SATA_HAS_NCQ	0x0100	/* bit 8 of the SATA capabilities */
+
+/* ahci_disk flags */
+#define AHCI_DISK_NCQ		0x01	/* native command queuing is used */
+
+struct ahci_port_regs {
+	unsigned int clb;		/* command list base address */
+	unsigned int clbu;
+	unsigned int fb;		/* FIS base address */
+	unsigned int fbu;
+	unsigned int is;		/* interrupt status */
+	unsigned int ie;		/* interrupt enable */
+	unsigned int cmd;		/* command and status */
+	unsigned int reserved0;
+	unsigned int tfd;		/* task file data */
+	unsigned int sig;		/* signature */
+	unsigned int ssts;		/* SATA status */
+	unsigned int sctl;		/* SATA control */
+	unsigned int serr;		/* SATA error */
+	unsigned int sact;		/* SATA active (NCQ tags) */
+	unsigned int ci;		/* command issue */
+	unsigned int sntf;
+	unsigned int fbs;
+	unsigned int reserved1[11];
+	unsigned int vendor[4];
+};
+
+struct ahci_hba_regs {
+	unsigned int cap;		/* host capabilities */
+	unsigned int ghc;		/* global host control */
+	unsigned int is;		/* interrupt status (a bit per port) */
+	unsigned int pi;		/* ports implemented */
+	unsigned int vs;		/* version */
+	unsigned int ccc_ctl;
+	unsigned int ccc_ports;
+	unsigned int em_loc;
+	unsigned int em_ctl;
+	unsigned int cap2;
+	unsigned int bohc;
+	unsigned char reserved[0xA0 - 0x2C];
+	unsigned char vendor[0x100 - 0xA0];
+	struct ahci_port_regs port[NR_AHCI_PORTS];
+};
+
+struct ahci_fis_h2d {
+	unsigned char type;
+	unsigned char flags;
+	unsigned char command;
+	unsigned char features;
+	unsigned char lba0;
+	unsigned char lba1;
+	unsigned char lba2;
+	unsigned char device;
+	unsigned char lba3;
+	unsigned char lba4;
+	unsigned char lba5;
+	unsigned char features_exp;
+	unsigned char count;
+	unsigned char count_exp;
+	unsigned char icc;
+	unsigned char control;
+	unsigned char reserved[4];
+};
+
+struct ahci_cmd_header {
+	unsigned short int flags;	/* FIS length in dwords and flags */
+	unsigned short int prdtl;	/* number of PRD entries */
+	unsigned int prdbc;		/* bytes transferred */
+	unsigned int ctba;		/* command table base address */
+	unsigned int ctbau;
+	unsigned int reserved[4];
+};
+
+struct ahci_prd {
+	unsigned int dba;		/* data base address */
+	unsigned int dbau;
+	unsigned int reserved;
+	unsigned int dbc;		/* byte count - 1 and interrupt flag */
+};
+
+struct ahci_cmd_table {
+	unsigned char cfis[64];		/* command FIS */
+	unsigned char acmd[16];		/* ATAPI command */
+	unsigned char reserved[48];
+	struct ahci_prd prd[AHCI_MAX_PRDS];
+};
+
+struct ahci {
+	struct pci_device *pci;
+	volatile struct ahci_hba_regs *regs;
+	int nslots;			/* command slots per port */
+	struct interrupt irq;
+};
+
+struct ahci_disk {
+	struct ahci *ahci;
+	int port;
+	char dev_name[4];
+	volatile struct ahci_port_regs *regs;
+	struct ahci_cmd_header *cmd_list;
+	struct ahci_cmd_table *cmd_table[AHCI_MAX_SLOTS];
+	int depth;			/* command slots used */
+	int flags;
+	unsigned int busy;		/* slots in use by a request */
+	unsigned int active;		/* slots issued to the HBA */
+	unsigned int error;		/* slots completed with an error */
+	unsigned int nr_sects;
+	struct ide_drv_ident ident;
+	struct partition part_table[NR_PARTITIONS];
+};
+
+int ahci_open(struct inode *, struct fd *);
+int ahci_close(struct inode *, struct fd *);
+int ahci_read(__dev_t, __blk_t, char *, int);
+int ahci_write(__dev_t, __blk_t, char *, int);
+int ahci_rw_blocks(__dev_t, __blk_t, char **, int, int, int);
+int ahci_ioctl(struct inode *, int, unsigned long int);
+
+void irq_ahci(int, struct sigcontext *);
+void ahci_init(void);
+
+#endif /* _FIWIX_AHCI_H */
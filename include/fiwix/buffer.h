@@ -15,6 +15,9 @@
 #define BUFFER_VALID	0x0001
 #define BUFFER_LOCKED	0x0002
 #define BUFFER_DIRTY	0x0004
+#define BUFFER_MAPPED	0x0008	/* 'data' is the memory of the device */
+
+#define NR_BUF_RUN	64	/* max. buffers in a multi-block request */
 
 struct buffer {
 	__dev_t dev;			/* device number */
@@ -37,6 +40,8 @@ extern unsigned int buffer_table_size;		/* size in bytes */
 extern unsigned int buffer_hash_table_size;	/* size in bytes */
 
 struct buffer * bread(__dev_t, __blk_t, int);
+int bread_blocks(__dev_t, __blk_t, int, struct buffer **, int);
+struct buffer * get_cached_buffer(__dev_t, __blk_t, int);
 void bwrite(struct buffer *);
 void brelse(struct buffer *);
 void sync_buffers(__dev_t);
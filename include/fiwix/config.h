@@ -20,9 +20,6 @@
 /* maximum number of opened files in system */
 #define NR_OPENS		1024
 
-/* maximum number of flocks in system */
-#define NR_FLOCKS		(NR_PROCS * 5)
-
 
 
 /* percentage of memory that buffer cache will borrow from available memory */
@@ -41,12 +38,16 @@
 /* percentage of hash buckets relative to the size of the inode table */
 #define INODE_HASH_PERCENTAGE	10
 
+/* percentage of memory that a tmpfs filesystem can use */
+#define TMPFS_PERCENTAGE	50
+
 
 /* maximum value for PID */
 #define MAX_PID_VALUE		32767
 
-/* number of screens in console' scroll back */
+/* number of screens in console' scroll back (default and maximum) */
 #define SCREENS_LOG		6
+#define SCREENS_LOG_MAX		32
 
 /* maximum number of messages on spurious interrupts */
 #define MAX_SPU_NOTICES		10
@@ -73,7 +73,7 @@
 #define SCREEN_COLS		video.columns
 #define SCREEN_LINES		video.lines
 #define SCREEN_SIZE		(video.columns * video.lines)
-#define VC_BUF_LINES		(video.lines * SCREENS_LOG)
+#define VC_BUF_LINES		(video.lines * _screenslog)
 #define VC_BUF_SIZE		(video.columns * VC_BUF_LINES)
 
 #define SCROLL_UP		1
@@ -92,11 +92,13 @@
 /* console flags */
 #define CONSOLE_HAS_FOCUS       0x0001
 #define CONSOLE_BLANKED         0x0002
+#define CONSOLE_BATCH           0x0004	/* drawing deferred to the end of a write */
 
+/* the changes in the console are drawn as they are made */
+#define CAN_DRAW(vc)	(((vc)->flags & (CONSOLE_HAS_FOCUS | CONSOLE_BATCH)) == CONSOLE_HAS_FOCUS)
 
-extern short int current_cons;	/* current console (/dev/tty1 ... /dev/tty12) */
 
-short int *vc_screen[NR_VCONSOLES + 1];
+extern short int current_cons;	/* current console (/dev/tty1 ... /dev/tty12) */
 
 /*
  * This is the scrollback history buffer which is used only in the active
@@ -122,6 +124,8 @@ struct vconsole {
 	int insert_mode;
 	unsigned char *vidmem;	/* write here only when console has focus */
 	short int *screen;	/* the back-buffer of the screen */
+	int damage_x1, damage_y1;	/* area of the screen not drawn yet */
+	int damage_x2, damage_y2;	/* (excluded), 0 = nothing */
 	int saved_x, cursor_x;
 	int saved_y, cursor_y;
 	struct vt_mode vt_mode;
@@ -151,6 +155,7 @@ struct video_parms {
 	int fb_linesize;
 	int fb_size;	/* size of screen based on resolution */
 	int fb_vsize;	/* size of screen based on columns x lines */
+	unsigned char *fb_shadow;	/* copy of the screen in RAM (or NULL) */
 
 	/* formerly video driver operations */
 	void (*put_char)(struct vconsole *, unsigned char);
@@ -166,11 +171,14 @@ struct video_parms {
 	void (*screen_on)(struct vconsole *);
 	void (*buf_scroll)(struct vconsole *, int);
 	void (*cursor_blink)(unsigned int);
+	void (*update_screen)(struct vconsole *, int, int, int, int);
 };
 extern struct video_parms video;
 
 void vconsole_reset(struct tty *);
 void vconsole_write(struct tty *);
+int vconsole_open(struct tty *);
+int vconsole_close(struct tty *);
 void vconsole_select(int);
 void vconsole_select_final(int);
 void vconsole_restore(struct vconsole *);
@@ -179,6 +187,8 @@ void vconsole_start(struct tty *);
 void vconsole_stop(struct tty *);
 void vconsole_beep(void);
 void vconsole_deltab(struct tty *);
+void vconsole_damage(struct vconsole *, int, int);
+void vconsole_scroll_damage(struct vconsole *, int, int);
 void console_flush_log_buf(char *, unsigned int);
 void console_init(void);
 
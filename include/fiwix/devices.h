@@ -28,6 +28,8 @@ struct device {
 	int blksize;
 	void *device_data;		/* mostly used for minor sizes, in KB */
 	struct fs_operations *fsop;
+	int (*rw_blocks)(__dev_t, __blk_t, char **, int, int, int);	/* optional */
+	char *(*map_block)(__dev_t, __blk_t, int);	/* optional */
 	struct device *next;
 };
 
@@ -0,0 +1,43 @@
+/*
+ * fiwix/include/fiwix/diskstats.h
+ *
+ * Copyright 2021, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#ifndef _FIWIX_DISKSTATS_H
+#define _FIWIX_DISKSTATS_H
+
+#include <fiwix/types.h>
+#include <fiwix/devices.h>
+
+#define NR_DISKSTATS		32	/* devices accounted */
+#define DISKSTATS_BUCKETS	24	/* last one is for 2^22us (4s) and up */
+
+struct disk_stats {
+	__dev_t dev;			/* 0 = free entry */
+	unsigned int ios[2];		/* requests completed (read, write) */
+	unsigned int merges[2];		/* blocks merged into a request */
+	unsigned int sectors[2];	/* 512-byte sectors transferred */
+	unsigned int msecs[2];		/* time spent in requests */
+	unsigned int usecs[2];		/* remainder (< 1000) of the above */
+	unsigned int in_flight;		/* requests in progress */
+	unsigned int io_msecs;		/* time with requests in progress */
+	unsigned int io_usecs;
+	unsigned long long int io_start;
+	unsigned int hist[2][DISKSTATS_BUCKETS];	/* log2 of latency in us */
+};
+
+/* a request being accounted */
+struct disk_io {
+	struct disk_stats *ds;
+	unsigned long long int start;
+};
+
+extern struct disk_stats disk_stats_table[NR_DISKSTATS];
+
+int disk_transfer(struct device *, __dev_t, __blk_t, char *, int, int);
+int disk_transfer_run(struct device *, __dev_t, __blk_t, char **, int, int, int);
+void disk_name(__dev_t, char *);
+
+#endif /* _FIWIX_DISKSTATS_H */
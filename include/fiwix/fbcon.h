@@ -24,6 +24,7 @@ void fbcon_screen_on(struct vconsole *);
 void fbcon_screen_off(unsigned int);
 void fbcon_buf_scroll(struct vconsole *, int);
 void fbcon_cursor_blink(unsigned int);
+void fbcon_update_screen(struct vconsole *, int, int, int, int);
 void fbcon_init(void);
 
 #endif /* _FIWIX_FBCON_H */
@@ -11,7 +11,7 @@
 #include <fiwix/types.h>
 #include <fiwix/limits.h>
 
-#define NR_FILESYSTEMS		5	/* supported filesystems */
+#define NR_FILESYSTEMS		7	/* supported filesystems */
 
 /* value to be determined during system startup */
 extern unsigned int mount_table_size;	/* size in bytes */
@@ -165,4 +165,56 @@ void procfs_statfs(struct superblock *, struct statfs *);
 int procfs_read_superblock(__dev_t, struct superblock *);
 int procfs_init(void);
 
+
+/* tmpfs prototypes */
+int tmpfs_file_open(struct inode *, struct fd *);
+int tmpfs_file_close(struct inode *, struct fd *);
+int tmpfs_file_read(struct inode *, struct fd *, char *, __size_t);
+int tmpfs_file_write(struct inode *, struct fd *, const char *, __size_t);
+int tmpfs_file_lseek(struct inode *, __off_t);
+int tmpfs_dir_open(struct inode *, struct fd *);
+int tmpfs_dir_close(struct inode *, struct fd *);
+int tmpfs_dir_read(struct inode *, struct fd *, char *, __size_t);
+int tmpfs_dir_write(struct inode *, struct fd *, const char *, __size_t);
+int tmpfs_dir_readdir(struct inode *, struct fd *, struct dirent *, unsigned int);
+int tmpfs_readlink(struct inode *, char *, __size_t);
+int tmpfs_followlink(struct inode *, struct inode *, struct inode **);
+int tmpfs_lookup(const char *, struct inode *, struct inode **);
+int tmpfs_rmdir(struct inode *, struct inode *);
+int tmpfs_link(struct inode *, struct inode *, char *);
+int tmpfs_unlink(struct inode *, struct inode *, char *);
+int tmpfs_symlink(struct inode *, char *, char *);
+int tmpfs_mkdir(struct inode *, char *, __mode_t);
+int tmpfs_mknod(struct inode *, char *, __mode_t, __dev_t);
+int tmpfs_truncate(struct inode *, __off_t);
+int tmpfs_create(struct inode *, char *, __mode_t, struct inode **);
+int tmpfs_rename(struct inode *, struct inode *, struct inode *, struct inode *, char *, char *);
+int tmpfs_read_inode(struct inode *);
+int tmpfs_write_inode(struct inode *);
+int tmpfs_ialloc(struct inode *, int);
+void tmpfs_ifree(struct inode *);
+void tmpfs_statfs(struct superblock *, struct statfs *);
+int tmpfs_read_superblock(__dev_t, struct superblock *);
+int tmpfs_remount_fs(struct superblock *, int);
+void tmpfs_release_superblock(struct superblock *);
+int tmpfs_init(void);
+
+/* squashfs prototypes */
+int squashfs_file_open(struct inode *, struct fd *);
+int squashfs_file_close(struct inode *, struct fd *);
+int squashfs_file_read(struct inode *, struct fd *, char *, __size_t);
+int squashfs_file_lseek(struct inode *, __off_t);
+int squashfs_dir_open(struct inode *, struct fd *);
+int squashfs_dir_close(struct inode *, struct fd *);
+int squashfs_dir_read(struct inode *, struct fd *, char *, __size_t);
+int squashfs_dir_readdir(struct inode *, struct fd *, struct dirent *, unsigned int);
+int squashfs_readlink(struct inode *, char *, __size_t);
+int squashfs_followlink(struct inode *, struct inode *, struct inode **);
+int squashfs_lookup(const char *, struct inode *, struct inode **);
+int squashfs_read_inode(struct inode *);
+void squashfs_statfs(struct superblock *, struct statfs *);
+int squashfs_read_superblock(__dev_t, struct superblock *);
+void squashfs_release_superblock(struct superblock *);
+int squashfs_init(void);
+
 #endif /* _FIWIX_FILESYSTEMS_H */
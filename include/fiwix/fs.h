@@ -23,6 +23,8 @@ struct fd {
 	unsigned short int flags;	/* flags */
 	unsigned short int count;	/* number of opened instances */
 	__off_t offset;			/* r/w pointer position */
+	int seq_index;			/* procfs: next record to generate */
+	__off_t seq_offset;		/* procfs: file position of that record */
 };
 
 #include <fiwix/statfs.h>
@@ -34,6 +36,8 @@ struct fd {
 #include <fiwix/fs_pipe.h>
 #include <fiwix/fs_iso9660.h>
 #include <fiwix/fs_proc.h>
+#include <fiwix/fs_tmpfs.h>
+#include <fiwix/fs_squashfs.h>
 
 #define BPS			512	/* bytes per sector */
 #define BLKSIZE_1K		1024	/* 1KB block size */
@@ -91,6 +95,7 @@ struct inode {
 	__dev_t		rdev;
 	struct fs_operations *fsop;
 	struct superblock *sb;
+	struct file_lock *locks;	/* POSIX and flock locks */
 	struct inode *prev_hash;
 	struct inode *next_hash;
 	struct inode *prev_free;
@@ -101,6 +106,7 @@ struct inode {
 		struct pipefs_inode pipefs;
 		struct iso9660_inode iso9660;
 		struct procfs_inode procfs;
+		struct squashfs_i_info squashfs;
 	} u;
 };
 extern struct inode *inode_table;
@@ -111,6 +117,8 @@ extern unsigned int inode_table_size;		/* size in bytes */
 extern unsigned int inode_hash_table_size;	/* size in bytes */
 extern unsigned int fd_table_size;		/* size in bytes */
 
+#define NR_INODES	(inode_table_size / sizeof(struct inode))
+
 extern struct fd *fd_table;
 
 struct superblock {
@@ -127,6 +135,8 @@ struct superblock {
 		struct minix_sb_info minix;
 		struct ext2_sb_info ext2;
 		struct iso9660_sb_info iso9660;
+		struct tmpfs_sb_info tmpfs;
+		struct squashfs_sb_info squashfs;
 	} u;
 };
 
@@ -225,6 +235,30 @@ void check_rrip_inode(struct iso9660_directory_record *, struct inode *);
 int get_rrip_filename(struct iso9660_directory_record *, struct inode *, char *);
 int get_rrip_symlink(struct inode *, char *);
 
+/* fs_tmpfs.h prototypes */
+extern struct fs_operations tmpfs_fsop;
+extern struct fs_operations tmpfs_file_fsop;
+extern struct fs_operations tmpfs_dir_fsop;
+extern struct fs_operations tmpfs_symlink_fsop;
+struct tmpfs_inode * tmpfs_get_inode(struct superblock *, __ino_t, int);
+char * tmpfs_get_page(struct superblock *, struct tmpfs_inode *, __off_t, int);
+void tmpfs_free_pages(struct superblock *, __ino_t, struct tmpfs_inode *, __off_t);
+
+/* fs_squashfs.h prototypes */
+extern struct fs_operations squashfs_fsop;
+extern struct fs_operations squashfs_file_fsop;
+extern struct fs_operations squashfs_dir_fsop;
+extern struct fs_operations squashfs_symlink_fsop;
+void squashfs_lock(void);
+void squashfs_unlock(void);
+void squashfs_copy_from_entry(char *, struct squashfs_cache_entry *, unsigned int, unsigned int);
+int squashfs_read_raw(struct superblock *, __u32, void *, unsigned int);
+struct squashfs_cache * squashfs_cache_init(int, int);
+void squashfs_cache_free(struct squashfs_cache *);
+struct squashfs_cache_entry * squashfs_get_metadata_block(struct superblock *, __u32);
+struct squashfs_cache_entry * squashfs_get_data_block(struct superblock *, struct squashfs_cache *, __u32, __u32);
+int squashfs_read_metadata(struct superblock *, void *, __u32 *, unsigned int *, unsigned int);
+
 
 /* generic VFS function prototypes */
 void inode_lock(struct inode *);
@@ -14,10 +14,12 @@
 #define PROC_ROOT_INO		1	/* root inode */
 #define PROC_SUPER_MAGIC	0x9FA0	/* same as in Linux */
 
+#define PROC_KMSG_INO		23	/* read through syslog() */
+
 #define PROC_PID_INO		0x40000000	/* base for PID inodes */
 #define PROC_PID_LEV		1	/* array level for PID */
 
-#define PROC_ARRAY_ENTRIES	20
+#define PROC_ARRAY_ENTRIES	34
 
 enum pid_dir_inodes {
 	PROC_PID_FD = PROC_PID_INO + 1001,
@@ -37,6 +39,26 @@ struct procfs_inode {
 	unsigned int i_lev;		/* array level (directory depth) */
 };
 
+/*
+ * Files that can grow beyond a page are generated one record at a time, so
+ * a read() only needs to produce the records that fall within the range
+ * requested. The start() method returns the record 'index' (or NULL if there
+ * are no more records), next() returns the record that follows 'v' and show()
+ * prints a record (smaller than a page) returning its length.
+ */
+struct procfs_seq {
+	__pid_t pid;
+	int index;			/* number of the current record */
+	void *data;			/* private data of the iterator */
+};
+
+struct procfs_seq_operations {
+	void *(*start)(struct procfs_seq *, int);
+	void *(*next)(struct procfs_seq *, void *);
+	int (*show)(char *, struct procfs_seq *, void *);
+	void (*stop)(struct procfs_seq *);
+};
+
 struct procfs_dir_entry {
 	__ino_t inode;
 	__mode_t mode;
@@ -45,6 +67,7 @@ struct procfs_dir_entry {
 	unsigned short int name_len;
 	char *name;
 	int (*data_fn)(char *, __pid_t);
+	struct procfs_seq_operations *seq;
 };
 
 extern struct procfs_dir_entry procfs_array[][PROC_ARRAY_ENTRIES + 1];
@@ -56,15 +79,15 @@ int data_proc_dma(char *, __pid_t);
 int data_proc_filesystems(char *, __pid_t);
 int data_proc_interrupts(char *, __pid_t);
 int data_proc_loadavg(char *, __pid_t);
-int data_proc_locks(char *, __pid_t);
 int data_proc_meminfo(char *, __pid_t);
-int data_proc_mounts(char *, __pid_t);
 int data_proc_partitions(char *, __pid_t);
 int data_proc_rtc(char *, __pid_t);
+int data_proc_serial(char *, __pid_t);
 int data_proc_self(char *, __pid_t);
 int data_proc_stat(char *, __pid_t);
 int data_proc_uptime(char *, __pid_t);
 int data_proc_fullversion(char *, __pid_t);
+int data_proc_zram(char *, __pid_t);
 int data_proc_domainname(char *, __pid_t);
 int data_proc_filemax(char *, __pid_t);
 int data_proc_filenr(char *, __pid_t);
@@ -74,6 +97,10 @@ int data_proc_inodenr(char *, __pid_t);
 int data_proc_osrelease(char *, __pid_t);
 int data_proc_ostype(char *, __pid_t);
 int data_proc_version(char *, __pid_t);
+extern struct procfs_seq_operations seq_proc_disklatency;
+extern struct procfs_seq_operations seq_proc_diskstats;
+extern struct procfs_seq_operations seq_proc_locks;
+extern struct procfs_seq_operations seq_proc_mounts;
 
 /* PID related functions */
 int data_proc_pid_fd(char *, __pid_t);
@@ -81,11 +108,11 @@ int data_proc_pid_cmdline(char *, __pid_t);
 int data_proc_pid_cwd(char *, __pid_t);
 int data_proc_pid_environ(char *, __pid_t);
 int data_proc_pid_exe(char *, __pid_t);
-int data_proc_pid_maps(char *, __pid_t);
-int data_proc_pid_mountinfo(char *, __pid_t);
 int data_proc_pid_root(char *, __pid_t);
 int data_proc_pid_stat(char *, __pid_t);
 int data_proc_pid_statm(char *, __pid_t);
 int data_proc_pid_status(char *, __pid_t);
+extern struct procfs_seq_operations seq_proc_pid_maps;
+extern struct procfs_seq_operations seq_proc_pid_mountinfo;
 
 #endif /* _FIWIX_FS_PROC_H */
@@ -0,0 +1,240 @@
+/*
+ * fiwix/include/fiwix/fs_squashfs.h
+ *
+ * Copyright 2021, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#ifndef _FIWIX_FS_SQUASHFS_H
+#define _FIWIX_FS_SQUASHFS_H
+
+#include <fiwix/types.h>
+#include <fiwix/inflate.h>
+
+#define SQUASHFS_SUPER_MAGIC	0x73717368	/* "hsqs" */
+#define SQUASHFS_MAJOR		4		/* only version 4.0 is supported */
+#define SQUASHFS_ZLIB		1		/* gzip compression */
+
+#define SQUASHFS_METADATA_SIZE	8192
+#define SQUASHFS_METADATA_PAGES	(SQUASHFS_METADATA_SIZE / PAGE_SIZE)
+#define SQUASHFS_COMPRESSED_BIT		(1 << 15)
+#define SQUASHFS_COMPRESSED_BIT_BLOCK	(1 << 24)
+#define SQUASHFS_BLOCK_SIZE(size)	((size) & ~SQUASHFS_COMPRESSED_BIT_BLOCK)
+#define SQUASHFS_INVALID_FRAG	0xFFFFFFFF
+#define SQUASHFS_INVALID_BLK	0xFFFFFFFFFFFFFFFFULL
+#define SQUASHFS_NAME_LEN	256
+#define SQUASHFS_MAX_BLOCK_SIZE	(1024 * 1024)
+
+#define SQUASHFS_FRAGMENTS_PER_BLOCK	(SQUASHFS_METADATA_SIZE / sizeof(struct squashfs_fragment_entry))
+#define SQUASHFS_IDS_PER_BLOCK		(SQUASHFS_METADATA_SIZE / sizeof(__u32))
+#define SQUASHFS_LOOKUP_PER_BLOCK	(SQUASHFS_METADATA_SIZE / sizeof(__u64))
+
+/* number of blocks kept decompressed in memory */
+#define SQUASHFS_META_ENTRIES	8	/* inode and directory tables */
+#define SQUASHFS_FRAG_ENTRIES	3	/* fragment blocks (tails of files) */
+#define SQUASHFS_DATA_ENTRIES	2	/* file data blocks */
+#define SQUASHFS_CACHE_MAX_ENTRIES	8
+
+/* inode types */
+#define SQUASHFS_DIR_TYPE	1
+#define SQUASHFS_REG_TYPE	2
+#define SQUASHFS_SYMLINK_TYPE	3
+#define SQUASHFS_BLKDEV_TYPE	4
+#define SQUASHFS_CHRDEV_TYPE	5
+#define SQUASHFS_FIFO_TYPE	6
+#define SQUASHFS_SOCKET_TYPE	7
+#define SQUASHFS_LDIR_TYPE	8
+#define SQUASHFS_LREG_TYPE	9
+#define SQUASHFS_LSYMLINK_TYPE	10
+#define SQUASHFS_LBLKDEV_TYPE	11
+#define SQUASHFS_LCHRDEV_TYPE	12
+#define SQUASHFS_LFIFO_TYPE	13
+#define SQUASHFS_LSOCKET_TYPE	14
+
+/*
+ * Inodes are referenced by the position of the compressed metadata block
+ * (relative to the start of the inode table) and the offset within the
+ * uncompressed block. Both values are packed into the inode number:
+ *
+ * 7FFFF 1FFF
+ * \---/ \--/
+ *   ^     ^
+ *   |     +--- offset within the metadata block	(13bit)
+ *   +--------- metadata block where to find it		(19bit)
+ *
+ * The inode number is incremented by one to never be zero.
+ */
+#define SQUASHFS_INODE_BITS	13
+#define SQUASHFS_INODE_MASK	0x1FFF
+#define SQUASHFS_INODE_MAX_BLOCK	(1 << (32 - SQUASHFS_INODE_BITS))
+#define SQUASHFS_MKINODE(block, offset)	((((block) << SQUASHFS_INODE_BITS) | (offset)) + 1)
+#define SQUASHFS_INODE_BLOCK(ino)	(((ino) - 1) >> SQUASHFS_INODE_BITS)
+#define SQUASHFS_INODE_OFFSET(ino)	(((ino) - 1) & SQUASHFS_INODE_MASK)
+
+struct squashfs_super_block {
+	__u32 s_magic;
+	__u32 inodes;
+	__u32 mkfs_time;
+	__u32 block_size;
+	__u32 fragments;
+	__u16 compression;
+	__u16 block_log;
+	__u16 flags;
+	__u16 no_ids;
+	__u16 s_major;
+	__u16 s_minor;
+	__u64 root_inode;
+	__u64 bytes_used;
+	__u64 id_table_start;
+	__u64 xattr_id_table_start;
+	__u64 inode_table_start;
+	__u64 directory_table_start;
+	__u64 fragment_table_start;
+	__u64 lookup_table_start;
+};
+
+struct squashfs_base_inode {
+	__u16 inode_type;
+	__u16 mode;
+	__u16 uid;			/* index in the id table */
+	__u16 guid;			/* index in the id table */
+	__u32 mtime;
+	__u32 inode_number;
+};
+
+struct squashfs_dir_inode {
+	struct squashfs_base_inode base;
+	__u32 start_block;
+	__u32 nlink;
+	__u16 file_size;
+	__u16 offset;
+	__u32 parent_inode;
+};
+
+struct squashfs_ldir_inode {
+	struct squashfs_base_inode base;
+	__u32 nlink;
+	__u32 file_size;
+	__u32 start_block;
+	__u32 parent_inode;
+	__u16 i_count;
+	__u16 offset;
+	__u32 xattr;
+};
+
+struct squashfs_reg_inode {
+	struct squashfs_base_inode base;
+	__u32 start_block;
+	__u32 fragment;
+	__u32 offset;
+	__u32 file_size;
+	/* followed by the list of block sizes */
+};
+
+struct squashfs_lreg_inode {
+	struct squashfs_base_inode base;
+	__u64 start_block;
+	__u64 file_size;
+	__u64 sparse;
+	__u32 nlink;
+	__u32 fragment;
+	__u32 offset;
+	__u32 xattr;
+	/* followed by the list of block sizes */
+};
+
+struct squashfs_symlink_inode {
+	struct squashfs_base_inode base;
+	__u32 nlink;
+	__u32 symlink_size;
+	/* followed by the target path */
+};
+
+struct squashfs_dev_inode {
+	struct squashfs_base_inode base;
+	__u32 nlink;
+	__u32 rdev;
+};
+
+struct squashfs_ipc_inode {
+	struct squashfs_base_inode base;
+	__u32 nlink;
+};
+
+union squashfs_inode {
+	struct squashfs_base_inode base;
+	struct squashfs_dir_inode dir;
+	struct squashfs_ldir_inode ldir;
+	struct squashfs_reg_inode reg;
+	struct squashfs_lreg_inode lreg;
+	struct squashfs_symlink_inode symlink;
+	struct squashfs_dev_inode dev;
+	struct squashfs_ipc_inode ipc;
+};
+
+struct squashfs_dir_header {
+	__u32 count;			/* number of entries minus one */
+	__u32 start_block;		/* metadata block of their inodes */
+	__u32 inode_number;
+};
+
+struct squashfs_dir_entry {
+	__u16 offset;			/* offset of the inode */
+	__s16 inode_number;
+	__u16 type;
+	__u16 size;			/* length of the name minus one */
+	/* followed by the name (not null-terminated) */
+};
+
+struct squashfs_fragment_entry {
+	__u64 start_block;
+	__u32 size;
+	__u32 unused;
+};
+
+/* a block kept decompressed in memory */
+struct squashfs_cache_entry {
+	__u32 block;			/* position on disk */
+	__u32 next;			/* position of the next block on disk */
+	int length;			/* uncompressed size (-1 = unused) */
+	char **data;			/* pages of the block */
+};
+
+/* this structure and the page pointers must fit in a page */
+struct squashfs_cache {
+	int entries;
+	int pages;			/* pages per entry */
+	int victim;			/* next entry to be replaced */
+	struct squashfs_cache_entry entry[SQUASHFS_CACHE_MAX_ENTRIES];
+};
+
+/* inode in memory */
+struct squashfs_i_info {
+	__u32 start_block;		/* first data block or directory block */
+	__u32 fragment;			/* fragment index */
+	__u32 frag_offset;		/* offset within the fragment block */
+	__u32 meta_block;		/* block list or symlink target */
+	__u16 meta_offset;
+	__u16 dir_offset;		/* offset within the directory block */
+	__ino_t parent;			/* parent directory */
+	__u32 blist_block;		/* last block looked up in the list */
+	__u32 blist_pos;		/* its position on disk */
+	__u32 blist_mblock;		/* and of its size (0 = none) */
+	__u16 blist_moffset;
+};
+
+/* super block in memory */
+struct squashfs_sb_info {
+	struct squashfs_super_block sb;
+	__u32 inode_table;		/* positions on disk of the tables */
+	__u32 dir_table;
+	__u32 *frag_index;		/* blocks of the fragment table */
+	__u32 *id_index;		/* blocks of the id table */
+	__u32 *lookup_index;		/* blocks of the export table */
+	struct squashfs_cache *meta_cache;
+	struct squashfs_cache *frag_cache;
+	struct squashfs_cache *data_cache;
+	struct inflate_stream *stream;	/* decompressor workspace */
+};
+
+#endif /* _FIWIX_FS_SQUASHFS_H */
@@ -0,0 +1,74 @@
+/*
+ * fiwix/include/fiwix/fs_tmpfs.h
+ *
+ * Copyright 2021, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#ifndef _FIWIX_FS_TMPFS_H
+#define _FIWIX_FS_TMPFS_H
+
+#include <fiwix/types.h>
+
+#define TMPFS_DEV		0xFFF2	/* special device number for nodev fs */
+#define TMPFS_ROOT_INO		1	/* root inode */
+#define TMPFS_SUPER_MAGIC	0x01021994	/* same as in Linux */
+
+#define TMPFS_NAME_LEN		123	/* maximum length of a filename */
+
+#define TMPFS_PTRS_PER_PAGE	(PAGE_SIZE / sizeof(unsigned int))
+#define TMPFS_INODES_PER_PAGE	(PAGE_SIZE / sizeof(struct tmpfs_inode))
+#define TMPFS_DIRSIZE		sizeof(struct tmpfs_dir_entry)
+
+/*
+ * There is no device behind tmpfs, everything lives in pages taken from the
+ * page pool (kmalloc()), so the table of inodes and the file contents grow
+ * and shrink on demand:
+ *
+ * sb->u.tmpfs.itable            inode table
+ * +--------+                    +--------+--------+-----+
+ * | page 0 ------------------>  | inode 1| inode 2| ... |
+ * +--------+                    +--------+--------+-----+
+ * | page 1 ---> ...
+ * +--------+
+ *
+ * ii->i_index                   data index             data
+ * +--------+                    +--------+             +--------+
+ * | leaf 0 ------------------>  | page 0 ----------->  |  4KB   |
+ * +--------+                    +--------+             +--------+
+ * | leaf 1 ---> ...             | page 1 ---> ...
+ * +--------+                    +--------+
+ *
+ * Each data index page (leaf) maps 4MB of a file.
+ */
+
+struct tmpfs_inode {
+	__mode_t i_mode;		/* file mode (0 = free inode) */
+	__nlink_t i_nlink;		/* links count */
+	__uid_t i_uid;			/* owner uid */
+	__gid_t i_gid;			/* group id */
+	__size_t i_size;		/* size in bytes */
+	__u32 i_atime;			/* access time */
+	__u32 i_mtime;			/* modification time */
+	__u32 i_ctime;			/* creation time */
+	__blk_t i_blocks;		/* data pages count */
+	__dev_t i_rdev;			/* device number (char/block inodes) */
+	unsigned int *i_index;		/* page of data index pages */
+};
+
+struct tmpfs_dir_entry {
+	__ino_t inode;
+	char name[TMPFS_NAME_LEN + 1];
+};
+
+/* super block in memory */
+struct tmpfs_sb_info {
+	unsigned int *itable;		/* page of inode table pages */
+	unsigned int max_pages;		/* size limit (in pages) */
+	unsigned int used_pages;	/* pages currently in use */
+	unsigned int max_inodes;
+	unsigned int used_inodes;
+	__ino_t last_ino;		/* last inode allocated */
+};
+
+#endif /* _FIWIX_FS_TMPFS_H */
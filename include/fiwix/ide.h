@@ -12,6 +12,7 @@
 #include <fiwix/part.h>
 #include <fiwix/sigcontext.h>
 #include <fiwix/sleep.h>
+#include <fiwix/timer.h>
 
 #define IDE0_IRQ		14	/* primary controller interrupt */
 #define IDE1_IRQ		15	/* secondary controller interrupt */
@@ -40,10 +41,33 @@
 
 #define IDE_BASE_LEN		7	/* controller address length */
 
+/* bus master registers (PCI IDE controllers) */
+#define IDE_BM_COMMAND		0x0	/* Bus Master Command Register (R/W) */
+#define IDE_BM_STATUS		0x2	/* Bus Master Status Register (R/W) */
+#define IDE_BM_PRDT		0x4	/* PRD Table Address Register (R/W) */
+#define IDE_BM_CHANNEL_LEN	0x8	/* registers per channel */
+
+/* bus master command register bits */
+#define IDE_BM_CMD_START	0x01	/* start the transfer */
+#define IDE_BM_CMD_READ		0x08	/* transfer from the drive to memory */
+
+/* bus master status register bits */
+#define IDE_BM_STAT_ACTIVE	0x01	/* transfer in progress */
+#define IDE_BM_STAT_ERR		0x02	/* error during the transfer */
+#define IDE_BM_STAT_INTR	0x04	/* the drive raised its interrupt */
+
+/* programming interface bits of PCI IDE controllers */
+#define IDE_PCI_NATIVE		0x01	/* primary channel in native mode */
+#define IDE_PCI_BUS_MASTER	0x80	/* supports bus mastering */
+
+#define IDE_PRD_EOT		0x8000	/* last entry in the PRD table */
+#define IDE_PRD_BOUNDARY	0x10000	/* an entry can't cross a 64KB boundary */
+
 #define IDE_RDY_RETR_LONG	50000	/* long delay for fast CPUs */
 #define IDE_RDY_RETR_SHORT	500	/* short delay for slow CPUs */
 #define MAX_IDE_ERR		10	/* number of retries */
 #define MAX_CD_ERR		5	/* number of retries in CDROMs */
+#define IDE_MAX_SECTORS		256	/* max. sectors per command (LBA28) */
 
 #define SET_IDE_RDY_RETR(retries)					\
 	if((cpu_table.hz / 1000000) <= 100) {				\
@@ -104,10 +128,21 @@
 #define ATA_WRITE_PIO		0x30	/* write sector(s) with retries */
 #define ATA_WRITE_MULTIPLE_PIO	0xC5	/* write multiple sectors */
 #define ATA_SET_MULTIPLE_MODE	0xC6
+#define ATA_READ_DMA		0xC8	/* read sector(s) with DMA */
+#define ATA_WRITE_DMA		0xCA	/* write sector(s) with DMA */
+#define ATA_READ_DMA_EXT	0x25	/* read sector(s) with DMA (48bit LBA) */
+#define ATA_WRITE_DMA_EXT	0x35	/* write sector(s) with DMA (48bit LBA) */
+#define ATA_READ_FPDMA_QUEUED	0x60	/* read sector(s) with NCQ */
+#define ATA_WRITE_FPDMA_QUEUED	0x61	/* write sector(s) with NCQ */
+#define ATA_SET_FEATURES	0xEF
 #define ATA_PACKET		0xA0
 #define ATA_IDENTIFY_PACKET	0xA1	/* identify ATAPI device */
 #define ATA_IDENTIFY		0xEC	/* identify ATA device */
 
+/* set features subcommands */
+#define ATA_SET_XFER_MODE	0x03	/* set transfer mode */
+#define ATA_XFER_MWDMA		0x20	/* multiword DMA mode (+ mode number) */
+
 /* ATAPI commands */
 #define ATAPI_TEST_UNIT		0x00
 #define ATAPI_REQUEST_SENSE	0x03
@@ -149,6 +184,7 @@
 #define DEVICE_IS_CDROM		0x08
 #define DEVICE_REQUIRES_LBA	0x10
 #define DEVICE_HAS_RW_MULTIPLE	0x20
+#define DEVICE_HAS_DMA		0x40	/* transfers done by the bus master */
 
 /* ATA/ATAPI-4 based */
 struct ide_drv_ident {
@@ -197,7 +233,7 @@ struct ide_drv_ident {
 	unsigned short int reserved73;
 	unsigned short int reserved74;
 	unsigned short int queue_depth;		/* queue depth */
-	unsigned short int reserved76;
+	unsigned short int sata_cap;		/* SATA capabilities */
 	unsigned short int reserved77;
 	unsigned short int reserved78;
 	unsigned short int reserved79;
@@ -213,13 +249,22 @@ struct ide_drv_ident {
 	unsigned short int reserved89;
 	unsigned short int reserved90;
 	unsigned short int curapm;		/* current APM values */
-	unsigned short int reserved92_126[35];
+	unsigned short int reserved92_99[8];
+	unsigned short int lba48_sects[4];	/* sectors (48bit LBA) */
+	unsigned short int reserved104_126[23];
 	unsigned short int r_status_notif;	/* removable media status notif. */
 	unsigned short int security_status;	/* security status */
 	unsigned short int vendor_spec129_159[31];
 	unsigned short int reserved160_255[96];
 };
 
+/* Physical Region Descriptor */
+struct ide_prd {
+	unsigned int addr;		/* physical address of the region */
+	unsigned short int size;	/* size in bytes (0 means 64KB) */
+	unsigned short int flags;
+};
+
 struct ide_drv {
 	int drive;			/* master or slave */
 	char *dev_name;
@@ -230,6 +275,7 @@ struct ide_drv {
 	int lba_heads;
 	short int lba_factor;
 	unsigned int nr_sects;		/* total sectors (LBA) */
+	int multiple;			/* sectors per interrupt in R/W MULTIPLE */
 	struct fs_operations *fsop;
 	struct ide_drv_ident ident;
 	struct partition part_table[NR_PARTITIONS];
@@ -240,6 +286,8 @@ struct ide {
 	int base;			/* base address */
 	int ctrl;			/* control port address */
 	short int irq;
+	int bm_base;			/* bus master address (0 if none) */
+	struct ide_prd *prd_table;
 	struct resource resource;
 	struct ide_drv drive[NR_IDE_DRVS];
 };
@@ -258,11 +306,16 @@ void ide0_timer(unsigned int);
 void irq_ide1(int, struct sigcontext *);
 void ide1_timer(unsigned int);
 
+void ide_set_wait_interrupt(struct ide *, struct callout_req *);
+int ide_wait_interrupt(struct ide *, struct callout_req *);
 void ide_error(struct ide *, int);
 void ide_delay(void);
 void ide_wait400ns(struct ide *);
 int ide_drvsel(struct ide *, int, int, unsigned char);
 int ide_softreset(struct ide *);
+void ide_bm_setup(struct ide *, char **, int, int, int);
+void ide_bm_start(struct ide *);
+int ide_bm_stop(struct ide *);
 
 struct ide * get_ide_controller(__dev_t);
 int get_ide_drive(__dev_t);
@@ -271,6 +324,7 @@ int ide_open(struct inode *, struct fd *);
 int ide_close(struct inode *, struct fd *);
 int ide_read(__dev_t, __blk_t, char *, int);
 int ide_write(__dev_t, __blk_t, char *, int);
+int ide_rw_blocks(__dev_t, __blk_t, char **, int, int, int);
 int ide_ioctl(struct inode *, int, unsigned long int);
 
 void ide_init(void);
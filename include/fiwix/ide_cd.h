@@ -11,12 +11,22 @@
 #include <fiwix/fs.h>
 
 #define IDE_CD_SECTSIZE		BLKSIZE_2K	/* sector size (in bytes) */
+#define IDE_CD_RA_BLOCKS	16		/* blocks in the read-ahead window */
+
+/* read-ahead window of a drive, filled on sequential reads */
+struct ide_cd_ra {
+	__blk_t block;			/* first block in the window */
+	int count;			/* blocks in the window (0 = empty) */
+	__blk_t next;			/* block that follows the last read */
+	char *buffers[IDE_CD_RA_BLOCKS];
+};
 
 void ide_cd_timer(unsigned int);
 
 int ide_cd_open(struct inode *, struct fd *);
 int ide_cd_close(struct inode *, struct fd *);
 int ide_cd_read(__dev_t, __blk_t, char *, int);
+int ide_cd_rw_blocks(__dev_t, __blk_t, char **, int, int, int);
 int ide_cd_ioctl(struct inode *, int, unsigned long int);
 
 int ide_cd_init(struct ide *, int);
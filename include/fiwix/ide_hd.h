@@ -16,6 +16,7 @@ int ide_hd_open(struct inode *, struct fd *);
 int ide_hd_close(struct inode *, struct fd *);
 int ide_hd_read(__dev_t, __blk_t, char *, int);
 int ide_hd_write(__dev_t, __blk_t, char *, int);
+int ide_hd_rw_blocks(__dev_t, __blk_t, char **, int, int, int);
 int ide_hd_ioctl(struct inode *, int, unsigned long int);
 
 int ide_hd_init(struct ide *, int);
@@ -0,0 +1,49 @@
+/*
+ * fiwix/include/fiwix/inflate.h
+ *
+ * Copyright 2021, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#ifndef _FIWIX_INFLATE_H
+#define _FIWIX_INFLATE_H
+
+#define INFLATE_MAXBITS		15	/* maximum bits in a code */
+#define INFLATE_MAXLCODES	286	/* maximum number of literal/length codes */
+#define INFLATE_MAXDCODES	30	/* maximum number of distance codes */
+#define INFLATE_FIXLCODES	288	/* number of fixed literal/length codes */
+
+/*
+ * The compressed data is consumed in chunks: when 'in' is exhausted, fill()
+ * must set 'in' and 'in_len' to the next chunk or return non-zero if there
+ * is no more data. The uncompressed data is written into an array of pages
+ * ('out'), so the output doesn't need to be physically contiguous.
+ *
+ * This structure is too big to be placed in the kernel stack.
+ */
+struct inflate_stream {
+	unsigned char *in;		/* next input byte */
+	unsigned int in_len;		/* bytes available in 'in' */
+	int (*fill)(struct inflate_stream *);
+	void *fill_data;		/* private data for fill() */
+
+	char **out;			/* pages of the output buffer */
+	unsigned int out_size;		/* size of the output buffer */
+	unsigned int out_pos;		/* bytes written so far */
+
+	unsigned int bitbuf;		/* bit buffer */
+	int bitcnt;			/* number of bits in bit buffer */
+	int error;			/* premature end of input */
+
+	/* workspace for the Huffman tables */
+	short lencnt[INFLATE_MAXBITS + 1];
+	short lensym[INFLATE_FIXLCODES];
+	short distcnt[INFLATE_MAXBITS + 1];
+	short distsym[INFLATE_MAXDCODES];
+	short lengths[INFLATE_FIXLCODES + INFLATE_MAXDCODES];
+};
+
+int inflate(struct inflate_stream *);
+int zlib_inflate(struct inflate_stream *);
+
+#endif /* _FIWIX_INFLATE_H */
@@ -35,6 +35,10 @@ extern int _extmemsize;
 extern int _rootdev;
 extern int _noramdisk;
 extern int _ramdisksize;
+extern int _zramsize;
+extern int _serialbase;
+extern int _serialtrigger;
+extern int _screenslog;
 extern char _rootfstype[10];
 extern char _rootdevname[DEVNAME_MAX + 1];
 extern char _initrd[DEVNAME_MAX + 1];
@@ -78,7 +82,6 @@ struct kernel_stat {
 	int cached;			/* memory used to cache file pages */
 	int shared;			/* pages with count > 1 */
 	int dirty;			/* dirty buffers (in KB) */
-	unsigned long int random_seed;	/* next random seed */
 };
 extern struct kernel_stat kstat;
 
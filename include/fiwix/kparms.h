@@ -9,7 +9,7 @@
 #define _FIWIX_KPARMS_H
 
 #define CMDL_ARG_LEN	100	/* max length of cmdline argument */
-#define CMDL_NUM_VALUES	30	/* max values of cmdline parameter */
+#define CMDL_NUM_VALUES	40	/* max values of cmdline parameter */
 
 struct kparms {
 	char *name;
@@ -24,12 +24,18 @@ static struct kparms parm_table[] = {
 	     "/dev/hdb", "/dev/hdb1", "/dev/hdb2", "/dev/hdb3", "/dev/hdb4",
 	     "/dev/hdc", "/dev/hdc1", "/dev/hdc2", "/dev/hdc3", "/dev/hdc4",
 	     "/dev/hdd", "/dev/hdd1", "/dev/hdd2", "/dev/hdd3", "/dev/hdd4",
+	     "/dev/sda", "/dev/sda1", "/dev/sda2", "/dev/sda3", "/dev/sda4",
+	     "/dev/sdb", "/dev/sdb1", "/dev/sdb2", "/dev/sdb3", "/dev/sdb4",
+	     "/dev/vda", "/dev/vda1", "/dev/vda2", "/dev/vda3", "/dev/vda4",
 	   },
 	   { 0x100, 0x200, 0x201,
 	     0x300, 0x301, 0x302, 0x303, 0x304,
 	     0x340, 0x341, 0x342, 0x343, 0x344,
 	     0x1600, 0x1601, 0x1602, 0x1603, 0x1604,
 	     0x1640, 0x1641, 0x1642, 0x1643, 0x1644,
+	     0x800, 0x801, 0x802, 0x803, 0x804,
+	     0x810, 0x811, 0x812, 0x813, 0x814,
+	     0x7800, 0x7801, 0x7802, 0x7803, 0x7804,
 	   }
 	},
 	{ "noramdisk",
@@ -44,8 +50,24 @@ static struct kparms parm_table[] = {
 	   { NULL },
 	   { NULL },
 	},
+	{ "zramsize=",
+	   { NULL },
+	   { NULL },
+	},
+	{ "screenslog=",
+	   { NULL },
+	   { NULL },
+	},
+	{ "serialbase=",
+	   { "115200", "230400", "460800", "921600" },
+	   { 115200, 230400, 460800, 921600 }
+	},
+	{ "serialtrigger=",
+	   { "1", "4", "8", "14" },
+	   { 1, 4, 8, 14 }
+	},
 	{ "rootfstype=",
-	   { "minix", "ext2", "iso9660" },
+	   { "minix", "ext2", "iso9660", "squashfs" },
 	   { 0, 0 }
 	},
 	{ "console=",
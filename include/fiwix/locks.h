@@ -12,17 +12,29 @@
 #include <fiwix/fs.h>
 #include <fiwix/fcntl.h>
 
-struct flock_file {
+#define FL_POSIX	1	/* byte-range lock from fcntl() */
+#define FL_FLOCK	2	/* whole file lock from flock() */
+
+#define FL_EOF		0xFFFFFFFF	/* lock extends until the end of file */
+
+/*
+ * Every in-core inode keeps the list of the locks held on it, so looking
+ * for conflicts only involves the locks of the same file. The structures
+ * are taken from a pool that grows one page at a time.
+ */
+struct file_lock {
 	struct inode *inode;	/* file */
-	unsigned char type;	/* type of lock */
 	struct proc *proc;	/* owner */
+	unsigned char flags;	/* FL_POSIX or FL_FLOCK */
+	unsigned char type;	/* LOCK_SH or LOCK_EX */
+	__off_t start;		/* first byte locked */
+	__off_t end;		/* last byte locked (or FL_EOF) */
+	struct file_lock *next;	/* next lock on the same inode */
 };
 
-struct flock_file flock_file_table[NR_FLOCKS];
-
 int posix_lock(int, int, struct flock *);
 
-void flock_release_inode(struct inode *);
+void flock_release_inode(struct inode *, int);
 int flock_inode(struct inode *, int);
 void flock_init(void);
 
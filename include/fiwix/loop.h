@@ -0,0 +1,57 @@
+/*
+ * fiwix/include/fiwix/loop.h
+ *
+ * Copyright 2021, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#ifndef _FIWIX_LOOP_H
+#define _FIWIX_LOOP_H
+
+#include <fiwix/fs.h>
+
+#define LOOP_MAJOR	7	/* loop device major number */
+#define LOOP_MINORS	8	/* number of minors */
+
+#define LOOP_SET_FD		0x4C00	/* attach a file */
+#define LOOP_CLR_FD		0x4C01	/* detach the file */
+#define LOOP_SET_STATUS		0x4C02	/* set the offset and flags */
+#define LOOP_GET_STATUS		0x4C03	/* get the current status */
+
+#define LO_FLAGS_READ_ONLY	1
+#define LO_NAME_SIZE		64
+
+/* same layout as the 'struct loop_info' of Linux */
+struct loop_info {
+	int lo_number;
+	unsigned short int lo_device;
+	unsigned long int lo_inode;
+	unsigned short int lo_rdevice;
+	int lo_offset;
+	int lo_encrypt_type;
+	int lo_encrypt_key_size;
+	int lo_flags;
+	char lo_name[LO_NAME_SIZE];
+	unsigned char lo_encrypt_key[32];
+	unsigned long int lo_init[2];
+	char reserved[4];
+};
+
+struct loop {
+	struct inode *inode;	/* backing file (NULL if unused) */
+	__off_t offset;		/* where the data starts in the file */
+	int flags;
+	int count;		/* number of opens */
+	char name[LO_NAME_SIZE];
+};
+
+int loop_open(struct inode *, struct fd *);
+int loop_close(struct inode *, struct fd *);
+int loop_read(__dev_t, __blk_t, char *, int);
+int loop_write(__dev_t, __blk_t, char *, int);
+int loop_ioctl(struct inode *, int, unsigned long int);
+int loop_lseek(struct inode *, __off_t);
+
+void loop_init(void);
+
+#endif /* _FIWIX_LOOP_H */
@@ -0,0 +1,17 @@
+/*
+ * fiwix/include/fiwix/lz4.h
+ *
+ * Copyright 2021, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#ifndef _FIWIX_LZ4_H
+#define _FIWIX_LZ4_H
+
+#define LZ4_HASH_BITS	10
+#define LZ4_HASH_SIZE	(1 << LZ4_HASH_BITS)	/* entries of the hash table */
+
+int lz4_compress(const char *, int, char *, int, unsigned short int *);
+int lz4_decompress(const char *, int, char *, int);
+
+#endif /* _FIWIX_LZ4_H */
@@ -46,12 +46,14 @@ int zero_lseek(struct inode *, __off_t);
 
 int urandom_open(struct inode *, struct fd *);
 int urandom_close(struct inode *, struct fd *);
+int random_read(struct inode *, struct fd *, char *, __size_t);
 int urandom_read(struct inode *, struct fd *, char *, __size_t);
 int urandom_write(struct inode *, struct fd *, const char *, __size_t);
 int urandom_lseek(struct inode *, __off_t);
 
 int memdev_open(struct inode *, struct fd *);
 int mem_mmap(struct inode *, struct vma *);
+int zero_mmap(struct inode *, struct vma *);
 void memdev_init(void);
 
 #endif /* _FIWIX_MEMDEV_H */
@@ -76,12 +76,16 @@ extern unsigned int *kpage_table;
 /* alloc.c */
 unsigned int kmalloc(void);
 void kfree(unsigned int);
+unsigned int kmalloc_pages(int);
+void kfree_pages(unsigned int, int);
 
 /* page.c */
 void page_lock(struct page *);
 void page_unlock(struct page *);
 struct page * get_free_page(void);
+struct page * get_free_page_run(int);
 struct page * search_page_hash(struct inode *, __off_t);
+void invalidate_page(__dev_t, __ino_t, __off_t);
 void release_page(int);
 int is_valid_page(int);
 void update_page_cache(struct inode *, __off_t, const char *, int);
@@ -52,6 +52,7 @@ void show_vma_regions(struct proc *);
 void release_binary(void);
 struct vma * find_vma_region(unsigned int);
 int expand_heap(unsigned int);
+int map_shared_anon(struct vma *);
 int do_mmap(struct inode *, unsigned int, unsigned int, unsigned int, unsigned int, unsigned int, char, char);
 int do_munmap(unsigned int, __size_t);
 int do_mprotect(struct vma *, unsigned int, __size_t, int);
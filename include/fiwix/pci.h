@@ -0,0 +1,84 @@
+/*
+ * fiwix/include/fiwix/pci.h
+ *
+ * Copyright 2021, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#ifndef _FIWIX_PCI_H
+#define _FIWIX_PCI_H
+
+#define PCI_ADDRESS		0xCF8	/* configuration address port */
+#define PCI_DATA		0xCFC	/* configuration data port */
+#define PCI_ENABLE		0x80000000
+
+#define NR_PCI_DEVICES		32	/* max. devices remembered */
+#define NR_PCI_BUSES		256
+#define NR_PCI_SLOTS		32
+#define NR_PCI_FUNCS		8
+#define NR_PCI_BARS		6
+
+/* configuration space registers */
+#define PCI_VENDOR_ID		0x00
+#define PCI_DEVICE_ID		0x02
+#define PCI_COMMAND		0x04
+#define PCI_STATUS		0x06
+#define PCI_REVISION_ID		0x08
+#define PCI_PROG_IF		0x09
+#define PCI_SUBCLASS		0x0A
+#define PCI_CLASS		0x0B
+#define PCI_HEADER_TYPE		0x0E
+#define PCI_BAR0		0x10
+#define PCI_INTERRUPT_LINE	0x3C
+#define PCI_INTERRUPT_PIN	0x3D
+
+/* command register bits */
+#define PCI_COMMAND_IO		0x01	/* respond to I/O space accesses */
+#define PCI_COMMAND_MEMORY	0x02	/* respond to memory space accesses */
+#define PCI_COMMAND_MASTER	0x04	/* enable bus mastering */
+
+#define PCI_HEADER_MULTIFUNC	0x80	/* device has multiple functions */
+
+/* base address registers */
+#define PCI_BAR_IO		0x01	/* I/O space BAR */
+#define PCI_BAR_IO_MASK		0xFFFFFFFC
+#define PCI_BAR_MEM_MASK	0xFFFFFFF0
+#define PCI_BAR_MEM_64		0x04	/* 64-bit memory BAR */
+#define PCI_BAR_MMIO_MAX	0x100000	/* max. size of the BARs mapped */
+
+/* class codes */
+#define PCI_CLASS_STORAGE	0x01
+#define PCI_SUBCLASS_IDE	0x01
+#define PCI_SUBCLASS_SATA	0x06
+
+#define PCI_NO_VENDOR		0xFFFF	/* no device in this slot */
+
+struct pci_device {
+	unsigned char bus;
+	unsigned char slot;
+	unsigned char func;
+	unsigned short int vendor_id;
+	unsigned short int device_id;
+	unsigned char class;
+	unsigned char subclass;
+	unsigned char prog_if;		/* programming interface */
+	unsigned char rev;
+	unsigned char irq;		/* interrupt line (0 if none) */
+	unsigned int bar[NR_PCI_BARS];
+	unsigned int size[NR_PCI_BARS];	/* size of the BARs (0 if unused) */
+};
+
+unsigned int pci_read_long(struct pci_device *, int);
+unsigned short int pci_read_short(struct pci_device *, int);
+unsigned char pci_read_char(struct pci_device *, int);
+void pci_write_long(struct pci_device *, int, unsigned int);
+void pci_write_short(struct pci_device *, int, unsigned short int);
+void pci_write_char(struct pci_device *, int, unsigned char);
+
+struct pci_device * pci_next_device(struct pci_device *);
+struct pci_device * pci_find_class(unsigned char, unsigned char, struct pci_device *);
+struct pci_device * pci_find_device(unsigned short int, unsigned short int, struct pci_device *);
+void pci_enable_device(struct pci_device *, unsigned short int);
+void pci_init(void);
+
+#endif /* _FIWIX_PCI_H */
@@ -0,0 +1,35 @@
+/*
+ * fiwix/include/fiwix/pty.h
+ *
+ * Copyright 2021, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#ifndef _FIWIX_PTY_H
+#define _FIWIX_PTY_H
+
+#include <fiwix/fs.h>
+
+#define PTY_MASTER_MAJOR	2	/* major number for /dev/ptyp[0-f] */
+#define PTY_SLAVE_MAJOR		3	/* major number for /dev/ttyp[0-f] */
+#define NR_PTYS			16	/* number of pseudo-terminal pairs */
+
+/* pty flags */
+#define PTY_MASTER_OPEN		0x01
+#define PTY_SLAVE_OPENED	0x02	/* the slave has been opened */
+#define PTY_STOPPED		0x04	/* output stopped (^S) */
+
+struct pty {
+	int flags;
+	struct tty *tty;	/* the slave side */
+};
+
+int pty_master_open(struct inode *, struct fd *);
+int pty_master_close(struct inode *, struct fd *);
+int pty_master_read(struct inode *, struct fd *, char *, __size_t);
+int pty_master_write(struct inode *, struct fd *, const char *, __size_t);
+int pty_master_ioctl(struct inode *, int, unsigned long int);
+int pty_master_select(struct inode *, int);
+void pty_init(void);
+
+#endif /* _FIWIX_PTY_H */
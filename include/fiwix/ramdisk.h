@@ -25,6 +25,7 @@ int ramdisk_open(struct inode *, struct fd *);
 int ramdisk_close(struct inode *, struct fd *);
 int ramdisk_read(__dev_t, __blk_t, char *, int);
 int ramdisk_write(__dev_t, __blk_t, char *, int);
+char * ramdisk_map_block(__dev_t, __blk_t, int);
 int ramdisk_ioctl(struct inode *, int, unsigned long int);
 int ramdisk_lseek(struct inode *, __off_t);
 
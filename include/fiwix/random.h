@@ -0,0 +1,31 @@
+/*
+ * fiwix/include/fiwix/random.h
+ *
+ * Copyright 2021, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#ifndef _FIWIX_RANDOM_H
+#define _FIWIX_RANDOM_H
+
+#include <fiwix/timer.h>
+
+/* getrandom() flags */
+#define GRND_NONBLOCK	0x0001
+#define GRND_RANDOM	0x0002
+
+#define RANDOM_POOL_WORDS	32	/* size of the entropy pool */
+#define RANDOM_POOL_BITS	(RANDOM_POOL_WORDS * 32)
+#define RANDOM_SEED_BITS	128	/* entropy needed for the first seed */
+#define RANDOM_RESEED_BITS	256	/* entropy needed for the next ones */
+#define RANDOM_RESEED_INTERVAL	(300 * HZ)	/* minimum time between reseeds */
+
+#define CHACHA_BLOCK_SIZE	64	/* bytes produced in each block */
+
+void add_irq_randomness(int);
+void add_randomness(const void *, int);
+int random_wait(int);
+int get_random_bytes(char *, int);
+void random_init(void);
+
+#endif /* _FIWIX_RANDOM_H */
@@ -54,6 +54,9 @@
 #define UART_FCR_CXMTR	0x04	/* clear transmitter */
 #define UART_FCR_DMA	0x08	/* DMA mode select */
 #define UART_FCR_FIFO64	0x20	/* enable 64 byte FIFO (16750 only) */
+#define UART_FCR_FIFO1	0x00	/* set to 1 byte 'trigger level' FIFO */
+#define UART_FCR_FIFO4	0x40	/* set to 4 bytes 'trigger level' FIFO */
+#define UART_FCR_FIFO8	0x80	/* set to 8 bytes 'trigger level' FIFO */
 #define UART_FCR_FIFO14	0xC0	/* set to 14 bytes 'trigger level' FIFO */
 
 /* Line Control Register */
@@ -84,6 +87,13 @@
 #define UART_LSR_EDHR	0x40	/* Empty Data Holding Registers TD and SH */
 #define UART_LSR_EFIFO	0x80	/* Error in Received FIFO */
 
+/* Modem Status Register */
+#define UART_MSR_DCTS	0x01	/* Delta Clear To Send */
+#define UART_MSR_CTS	0x10	/* Clear To Send */
+#define UART_MSR_DSR	0x20	/* Data Set Ready */
+#define UART_MSR_RI	0x40	/* Ring Indicator */
+#define UART_MSR_DCD	0x80	/* Data Carrier Detect */
+
 
 #define UART_FIFO_SIZE	16	/* 16 bytes */
 #define UART_HAS_FIFO	0x02	/* has FIFO working */
@@ -91,6 +101,25 @@
 #define UART_IS_16450	0x08	/* is a 16450 chip */
 #define UART_IS_16550	0x10	/* is a 16550 chip */
 #define UART_IS_16550A	0x20	/* is a 16550A chip */
+#define UART_RTSCTS	0x40	/* hardware flow control (CRTSCTS) */
+#define UART_THROTTLED	0x80	/* RTS dropped until the input is read */
+
+#define UART_BAUD_BASE	115200	/* 1.8432MHz clock */
+
+/* RTS is dropped when the room for input goes below this */
+#define UART_RTS_LOW	(UART_FIFO_SIZE * 4)
+#define UART_RTS_HIGH	(UART_RTS_LOW * 2)
+
+struct serial_stats {
+	unsigned int rx;		/* characters received */
+	unsigned int tx;		/* characters sent */
+	unsigned int interrupts;
+	unsigned int overrun;		/* characters lost in the UART */
+	unsigned int dropped;		/* characters lost with the queue full */
+	unsigned int parity;
+	unsigned int frame;
+	unsigned int brk;
+};
 
 struct serial {
 	short int addr;		/* port I/O address */
@@ -101,8 +130,15 @@ struct serial {
 	int flags;
 	struct tty *tty;
 	struct serial *next;
+	int baud_base;		/* highest rate (divisor 1) */
+	unsigned char ier;	/* interrupts enabled */
+	unsigned char mcr;	/* modem control flags */
+	struct serial_stats stats;
 };
 
+extern struct serial serial_table[NR_SERIAL];
+extern char *serial_chip[];
+
 int serial_open(struct tty *);
 int serial_close(struct tty *);
 int serial_ioctl(struct tty *, int, unsigned long int);
@@ -8,7 +8,18 @@
 #ifndef _INCLUDE_STDIO_H
 #define _INCLUDE_STDIO_H
 
+/* log levels, to be put at the beginning of the message */
+#define KERN_EMERG	"<0>"	/* system is unusable */
+#define KERN_ALERT	"<1>"	/* action must be taken immediately */
+#define KERN_CRIT	"<2>"	/* critical conditions */
+#define KERN_ERR	"<3>"	/* error conditions */
+#define KERN_WARNING	"<4>"	/* warning conditions */
+#define KERN_NOTICE	"<5>"	/* normal but significant condition */
+#define KERN_INFO	"<6>"	/* informational */
+#define KERN_DEBUG	"<7>"	/* debug-level messages */
+
 void register_console(void (*fn)(char *, unsigned int));
+void flush_log_buf(void);
 void printk(const char *, ...);
 int sprintk(char *, const char *, ...);
 
@@ -115,6 +115,7 @@ int sys_statfs(const char *, struct statfs *);
 int sys_fstatfs(unsigned int, struct statfs *);
 int sys_ioperm(unsigned long int, unsigned long int, int);
 int sys_socketcall(int, unsigned long int *);
+int sys_syslog(int, char *, int);
 int sys_setitimer(int, const struct itimerval *, struct itimerval *);
 int sys_getitimer(int, struct itimerval *);
 int sys_newstat(const char *, struct new_stat *);
@@ -143,5 +144,6 @@ int sys_getsid(__pid_t);
 int sys_fdatasync(int);
 int sys_nanosleep(const struct timespec *, struct timespec *);
 int sys_getcwd(char *, __size_t);
+int sys_getrandom(char *, __size_t, unsigned int);
 
 #endif /* _FIWIX_SYSCALLS_H */
@@ -0,0 +1,30 @@
+/*
+ * fiwix/include/fiwix/syslog.h
+ *
+ * Copyright 2021, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#ifndef _FIWIX_SYSLOG_H
+#define _FIWIX_SYSLOG_H
+
+/* actions of syslog() (same as in Linux) */
+#define SYSLOG_ACTION_CLOSE		0
+#define SYSLOG_ACTION_OPEN		1
+#define SYSLOG_ACTION_READ		2	/* wait and read (destructive) */
+#define SYSLOG_ACTION_READ_ALL		3	/* read the last messages */
+#define SYSLOG_ACTION_READ_CLEAR	4
+#define SYSLOG_ACTION_CLEAR		5
+#define SYSLOG_ACTION_CONSOLE_OFF	6
+#define SYSLOG_ACTION_CONSOLE_ON	7
+#define SYSLOG_ACTION_CONSOLE_LEVEL	8
+#define SYSLOG_ACTION_SIZE_UNREAD	9
+#define SYSLOG_ACTION_SIZE_BUFFER	10
+
+#define DEFAULT_MESSAGE_LOGLEVEL	4	/* KERN_WARNING */
+#define MINIMUM_CONSOLE_LOGLEVEL	1	/* only KERN_EMERG */
+#define DEFAULT_CONSOLE_LOGLEVEL	7	/* all but KERN_DEBUG */
+
+int do_syslog(int, char *, int);
+
+#endif /* _FIWIX_SYSLOG_H */
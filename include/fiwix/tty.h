@@ -12,12 +12,13 @@
 #include <fiwix/fs.h>
 #include <fiwix/console.h>
 #include <fiwix/serial.h>
+#include <fiwix/pty.h>
 
-#define NR_TTYS		NR_VCONSOLES + NR_SERIAL
+#define NR_TTYS		NR_VCONSOLES + NR_SERIAL + NR_PTYS
 
 #define CBSIZE		32	/* number of characters in cblock */
 #define NR_CB_QUEUE	8	/* number of cblocks per queue */
-#define CB_POOL_SIZE	128	/* number of cblocks in the central pool */
+#define CB_POOL_SIZE	512	/* number of cblocks in the central pool */
 
 #define TAB_SIZE	8
 #define MAX_TAB_COLS	132	/* maximum number of tab stops */
@@ -69,6 +70,7 @@ struct tty {
 	int (*open)(struct tty *);
 	int (*close)(struct tty *);
 	void (*set_termios)(struct tty *);
+	void (*unthrottle)(struct tty *);
 };
 extern struct tty tty_table[];
 
@@ -77,6 +79,7 @@ struct tty * get_tty(__dev_t);
 void disassociate_ctty(struct tty *);
 void termios_reset(struct tty *);
 void do_cook(struct tty *);
+void tty_deltab(struct tty *);
 int tty_putchar(struct tty *, unsigned char);
 int tty_open(struct inode *, struct fd *);
 int tty_close(struct inode *, struct fd *);
@@ -90,6 +93,8 @@ void tty_init(void);
 int tty_queue_putchar(struct tty *, struct clist *, unsigned char);
 int tty_queue_unputchar(struct clist *);
 unsigned char tty_queue_getchar(struct clist *);
+int tty_queue_write(struct clist *, const unsigned char *, int);
+int tty_queue_read(struct clist *, unsigned char *, int);
 void tty_queue_flush(struct clist *);
 int tty_queue_room(struct clist *q);
 void tty_queue_init(void);
@@ -14,6 +14,7 @@ typedef __signed__ short int __s16;
 typedef unsigned short int __u16;
 typedef __signed__ int __s32;
 typedef unsigned int __u32;
+typedef unsigned long long int __u64;
 
 typedef __u16 __uid_t;
 typedef __u16 __gid_t;
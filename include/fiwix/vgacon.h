@@ -46,6 +46,7 @@ void vgacon_screen_on(struct vconsole *);
 void vgacon_screen_off(unsigned int);
 void vgacon_buf_scroll(struct vconsole *, int);
 void vgacon_cursor_blink(unsigned int);
+void vgacon_update_screen(struct vconsole *, int, int, int, int);
 void vgacon_init(void);
 
 #endif /* _FIWIX_VGACON_H */
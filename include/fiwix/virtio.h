@@ -0,0 +1,72 @@
+/*
+ * fiwix/include/fiwix/virtio.h
+ *
+ * Copyright 2021, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#ifndef _FIWIX_VIRTIO_H
+#define _FIWIX_VIRTIO_H
+
+#include <fiwix/types.h>
+
+#define VIRTIO_PCI_VENDOR	0x1AF4
+
+/* registers of the legacy PCI transport (I/O space of the BAR0) */
+#define VIRTIO_PCI_HOST_FEATURES	0x00	/* features of the device */
+#define VIRTIO_PCI_GUEST_FEATURES	0x04	/* features accepted */
+#define VIRTIO_PCI_QUEUE_PFN		0x08	/* page number of the queue */
+#define VIRTIO_PCI_QUEUE_SIZE		0x0C
+#define VIRTIO_PCI_QUEUE_SEL		0x0E
+#define VIRTIO_PCI_QUEUE_NOTIFY		0x10
+#define VIRTIO_PCI_STATUS		0x12
+#define VIRTIO_PCI_ISR			0x13	/* reading clears the interrupt */
+#define VIRTIO_PCI_CONFIG		0x14	/* device configuration (no MSI-X) */
+
+/* device status */
+#define VIRTIO_STATUS_ACK		0x01	/* the device has been seen */
+#define VIRTIO_STATUS_DRIVER		0x02	/* a driver is available */
+#define VIRTIO_STATUS_DRIVER_OK		0x04	/* the driver is ready */
+#define VIRTIO_STATUS_FAILED		0x80
+
+#define VIRTIO_ISR_QUEUE		0x01	/* a queue has been used */
+
+#define VIRTIO_QUEUE_ALIGN		4096	/* alignment of the used ring */
+
+/* descriptor flags */
+#define VRING_DESC_F_NEXT		0x01	/* the chain continues in 'next' */
+#define VRING_DESC_F_WRITE		0x02	/* written by the device */
+
+#define VRING_AVAIL_F_NO_INTERRUPT	0x01
+#define VRING_USED_F_NO_NOTIFY		0x01	/* the device doesn't need a kick */
+
+struct vring_desc {
+	__u64 addr;		/* physical address of the buffer */
+	__u32 len;
+	__u16 flags;
+	__u16 next;
+};
+
+struct vring_avail {
+	__u16 flags;
+	__u16 idx;		/* where the next entry will go */
+	__u16 ring[0];
+};
+
+struct vring_used_elem {
+	__u32 id;		/* head of the descriptor chain */
+	__u32 len;		/* bytes written by the device */
+};
+
+struct vring_used {
+	__u16 flags;
+	__u16 idx;
+	struct vring_used_elem ring[0];
+};
+
+/* size of the memory needed by a queue of 'num' descriptors */
+#define VRING_AVAIL_OFFSET(num)	((num) * sizeof(struct vring_desc))
+#define VRING_USED_OFFSET(num)	((VRING_AVAIL_OFFSET(num) + ((3 + (num)) * sizeof(__u16)) + VIRTIO_QUEUE_ALIGN - 1) & ~(VIRTIO_QUEUE_ALIGN - 1))
+#define VRING_SIZE(num)		((VRING_USED_OFFSET(num) + ((3 * sizeof(__u16)) + ((num) * sizeof(struct vring_used_elem))) + VIRTIO_QUEUE_ALIGN - 1) & ~(VIRTIO_QUEUE_ALIGN - 1))
+
+#endif /* _FIWIX_VIRTIO_H */
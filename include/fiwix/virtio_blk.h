@@ -0,0 +1,87 @@
+/*
+ * fiwix/include/fiwix/virtio_blk.h
+ *
+ * Copyright 2021, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#ifndef _FIWIX_VIRTIO_BLK_H
+#define _FIWIX_VIRTIO_BLK_H
+
+#include <fiwix/fs.h>
+#include <fiwix/part.h>
+#include <fiwix/pci.h>
+#include <fiwix/pic.h>
+#include <fiwix/virtio.h>
+
+#define VIRTIO_BLK_MAJOR	120	/* virtio disks major number */
+#define VIRTIO_BLK_MINORS	16	/* minors per disk (vda, vda1, ...) */
+#define NR_VIRTIO_BLK		4
+#define VIRTIO_BLK_SECTSIZE	512	/* sector size (in bytes) */
+
+#define VIRTIO_PCI_DEV_BLK	0x1001	/* legacy block device */
+#define VIRTIO_BLK_QUEUE_MAX	256	/* largest queue supported */
+
+/* features */
+#define VIRTIO_BLK_F_SEG_MAX	(1 << 2)	/* 'seg_max' is valid */
+#define VIRTIO_BLK_F_RO		(1 << 5)	/* read-only device */
+
+/* device configuration */
+#define VIRTIO_BLK_CAPACITY	(VIRTIO_PCI_CONFIG + 0x00)	/* in sectors */
+#define VIRTIO_BLK_SEG_MAX	(VIRTIO_PCI_CONFIG + 0x0C)	/* segments in a request */
+
+/* request types */
+#define VIRTIO_BLK_T_IN		0	/* read */
+#define VIRTIO_BLK_T_OUT	1	/* write */
+
+/* request status */
+#define VIRTIO_BLK_S_OK		0
+#define VIRTIO_BLK_S_IOERR	1
+#define VIRTIO_BLK_S_UNSUPP	2
+
+/* virtio_blk flags */
+#define VIRTIO_BLK_RDONLY	0x01
+
+struct virtio_blk_outhdr {
+	__u32 type;
+	__u32 ioprio;
+	__u64 sector;
+};
+
+/* a request, indexed by the head of its descriptor chain */
+struct virtio_blk_req {
+	struct virtio_blk_outhdr hdr;
+	volatile unsigned char status;	/* written by the device */
+	volatile char done;
+};
+
+struct virtio_blk {
+	struct pci_device *pci;
+	int base;			/* I/O address of the registers */
+	char dev_name[4];
+	int flags;
+	int num;			/* descriptors in the queue */
+	int seg_max;			/* data descriptors in a request */
+	unsigned int nr_sects;
+	volatile struct vring_desc *desc;
+	volatile struct vring_avail *avail;
+	volatile struct vring_used *used;
+	int free_head;			/* list of free descriptors */
+	int nfree;
+	__u16 last_used;		/* next used entry to process */
+	struct virtio_blk_req req[VIRTIO_BLK_QUEUE_MAX];
+	struct partition part_table[NR_PARTITIONS];
+	struct interrupt irq;
+};
+
+int virtio_blk_open(struct inode *, struct fd *);
+int virtio_blk_close(struct inode *, struct fd *);
+int virtio_blk_read(__dev_t, __blk_t, char *, int);
+int virtio_blk_write(__dev_t, __blk_t, char *, int);
+int virtio_blk_rw_blocks(__dev_t, __blk_t, char **, int, int, int);
+int virtio_blk_ioctl(struct inode *, int, unsigned long int);
+
+void irq_virtio_blk(int, struct sigcontext *);
+void virtio_blk_init(void);
+
+#endif /* _FIWIX_VIRTIO_BLK_H */
@@ -0,0 +1,70 @@
+/*
+ * fiwix/include/fiwix/zram.h
+ *
+ * Copyright 2021, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#ifndef _FIWIX_ZRAM_H
+#define _FIWIX_ZRAM_H
+
+#include <fiwix/fs.h>
+#include <fiwix/mm.h>
+
+#define ZRAM_MAJOR	121	/* compressed ramdisk major number */
+#define ZRAM_MINORS	1	/* number of minors */
+#define ZRAM_SIZE	32768	/* default zram size in KBs */
+#define ZRAM_BLKSIZE	BLKSIZE_1K	/* blocks are compressed one by one */
+
+/* blocks whose compressed size is greater than this are stored as is */
+#define ZRAM_MAX_COMPR	(ZRAM_BLKSIZE * 3 / 4)
+
+#define ZRAM_SLOT	64	/* granularity of the compressed data */
+#define ZRAM_CLASSES	(ZRAM_BLKSIZE / ZRAM_SLOT)
+
+#define ZRAM_ENTRIES	(PAGE_SIZE / sizeof(struct zram_entry))
+#define ZRAM_MAXSIZE	((PAGE_SIZE / sizeof(unsigned int)) * ZRAM_ENTRIES * (ZRAM_BLKSIZE / 1024))
+
+/* zram_entry flags */
+#define ZRAM_ZERO	0x01	/* block filled with zeros (no data) */
+
+/* location of the data of a block */
+struct zram_entry {
+	char *addr;
+	unsigned short int size;	/* compressed size */
+	unsigned short int flags;
+};
+
+/*
+ * A page holds compressed data of the same class (size rounded up to a
+ * multiple of ZRAM_SLOT), and starts with this header.
+ */
+struct zram_page {
+	struct zram_page *prev;
+	struct zram_page *next;
+	char *free;			/* list of free slots */
+	int used;			/* slots in use */
+};
+
+struct zram {
+	unsigned int nr_blocks;
+	struct zram_entry **table;	/* directory of pages of entries */
+	struct zram_page *partial[ZRAM_CLASSES];	/* pages with free slots */
+	unsigned int stored;		/* blocks with data */
+	unsigned int zero;		/* blocks filled with zeros */
+	unsigned int compr_size;	/* size of the data (in bytes) */
+	unsigned int pages;		/* pages used (data and entries) */
+};
+
+extern struct zram zram_table[ZRAM_MINORS];
+
+int zram_open(struct inode *, struct fd *);
+int zram_close(struct inode *, struct fd *);
+int zram_read(__dev_t, __blk_t, char *, int);
+int zram_write(__dev_t, __blk_t, char *, int);
+int zram_ioctl(struct inode *, int, unsigned long int);
+int zram_lseek(struct inode *, __off_t);
+
+void zram_init(void);
+
+#endif /* _FIWIX_ZRAM_H */
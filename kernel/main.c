@@ -25,6 +25,7 @@
 #include <fiwix/keyboard.h>
 #include <fiwix/sched.h>
 #include <fiwix/mm.h>
+#include <fiwix/pci.h>
 
 unsigned int _last_data_addr;
 int _memsize;
@@ -32,6 +33,10 @@ int _extmemsize;
 int _rootdev;
 int _noramdisk;
 int _ramdisksize;
+int _zramsize;
+int _serialbase;
+int _serialtrigger;
+int _screenslog;
 char _rootfstype[10];
 char _rootdevname[DEVNAME_MAX + 1];
 char _initrd[DEVNAME_MAX + 1];
@@ -78,6 +83,7 @@ void start_kernel(unsigned long magic, unsigned long info, unsigned int stack)
 
 	cpu_init();
 	multiboot(magic, info);
+	pci_init();	/* mem_init() maps the registers of the devices */
 	mem_init();
 	video_init();
 	console_init();
@@ -127,6 +133,7 @@ void stop_kernel(void)
 	printk("**    Safe to Power Off    **\n");
 	printk("            -or-\n");
 	printk("** Press Any Key to Reboot **\n");
+	flush_log_buf();
 	any_key_to_reboot = 1;
 
 	/* put all processes to sleep and reset all pending signals */
@@ -14,6 +14,7 @@
 #include <fiwix/kparms.h>
 #include <fiwix/i386elf.h>
 #include <fiwix/ramdisk.h>
+#include <fiwix/zram.h>
 #include <fiwix/mm.h>
 #include <fiwix/bios.h>
 #include <fiwix/vgacon.h>
@@ -51,6 +52,44 @@ static int check_parm(struct kparms *parm, const char *value)
 		}
 		return 0;
 	}
+	if(!strcmp(parm->name, "zramsize=")) {
+		int size = atoi(value);
+		if(!size || size > ZRAM_MAXSIZE) {
+			printk("WARNING: 'zramsize' value is out of limits, defaulting to %dKB.\n", ZRAM_SIZE);
+			_zramsize = 0;
+		} else {
+			_zramsize = size;
+		}
+		return 0;
+	}
+	if(!strcmp(parm->name, "screenslog=")) {
+		int screens = atoi(value);
+		if(screens < 1 || screens > SCREENS_LOG_MAX) {
+			printk("WARNING: 'screenslog' value is out of limits, defaulting to %d.\n", SCREENS_LOG);
+			_screenslog = 0;
+		} else {
+			_screenslog = screens;
+		}
+		return 0;
+	}
+	if(!strcmp(parm->name, "serialbase=")) {
+		for(n = 0; parm->value[n]; n++) {
+			if(!strcmp(parm->value[n], value)) {
+				_serialbase = parm->sysval[n];
+				return 0;
+			}
+		}
+		return 1;
+	}
+	if(!strcmp(parm->name, "serialtrigger=")) {
+		for(n = 0; parm->value[n]; n++) {
+			if(!strcmp(parm->value[n], value)) {
+				_serialtrigger = parm->sysval[n];
+				return 0;
+			}
+		}
+		return 1;
+	}
 	if(!strcmp(parm->name, "initrd=")) {
 		if(value[0]) {
 			strncpy(_initrd, value, DEVNAME_MAX);
@@ -288,7 +327,7 @@ void multiboot(unsigned long magic, unsigned long info)
 		video.fb_char_width = vbem->x_char_size;
 		video.fb_char_height = vbem->y_char_size;
 		video.fb_bpp = vbem->bits_per_pixel;
-		video.fb_pixelwidth = vbem->bits_per_pixel / 8;
+		video.fb_pixelwidth = (vbem->bits_per_pixel + 7) / 8;
 		video.fb_pitch = vbem->bytes_per_scanline;
 		video.fb_linesize = video.fb_pitch * video.fb_char_height;
 		video.fb_size = vbem->x_resolution * vbem->y_resolution * video.fb_pixelwidth;
@@ -0,0 +1,257 @@
+/*
+ * fiwix/kernel/pci.c
+ *
+ * Copyright 2021, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#include <fiwix/asm.h>
+#include <fiwix/pci.h>
+#include <fiwix/stdio.h>
+#include <fiwix/string.h>
+
+/*
+ * The configuration space is accessed through the mechanism #1, which is the
+ * only one still found in the machines that have a PCI bus. The devices are
+ * discovered once at boot time and kept in a table, so the drivers can later
+ * look for their hardware without probing the bus again.
+ */
+
+static struct pci_device pci_table[NR_PCI_DEVICES];
+static int pci_devices = 0;
+
+static unsigned int get_address(int bus, int slot, int func, int reg)
+{
+	return PCI_ENABLE | (bus << 16) | (slot << 11) | (func << 8) | (reg & 0xFC);
+}
+
+static unsigned int read_long(int bus, int slot, int func, int reg)
+{
+	unsigned long int flags;
+	unsigned int value;
+
+	SAVE_FLAGS(flags); CLI();
+	outport_l(PCI_ADDRESS, get_address(bus, slot, func, reg));
+	value = inport_l(PCI_DATA);
+	RESTORE_FLAGS(flags);
+	return value;
+}
+
+unsigned int pci_read_long(struct pci_device *pci, int reg)
+{
+	return read_long(pci->bus, pci->slot, pci->func, reg);
+}
+
+unsigned short int pci_read_short(struct pci_device *pci, int reg)
+{
+	unsigned long int flags;
+	unsigned short int value;
+
+	SAVE_FLAGS(flags); CLI();
+	outport_l(PCI_ADDRESS, get_address(pci->bus, pci->slot, pci->func, reg));
+	value = inport_w(PCI_DATA + (reg & 2));
+	RESTORE_FLAGS(flags);
+	return value;
+}
+
+unsigned char pci_read_char(struct pci_device *pci, int reg)
+{
+	unsigned long int flags;
+	unsigned char value;
+
+	SAVE_FLAGS(flags); CLI();
+	outport_l(PCI_ADDRESS, get_address(pci->bus, pci->slot, pci->func, reg));
+	value = inport_b(PCI_DATA + (reg & 3));
+	RESTORE_FLAGS(flags);
+	return value;
+}
+
+void pci_write_long(struct pci_device *pci, int reg, unsigned int value)
+{
+	unsigned long int flags;
+
+	SAVE_FLAGS(flags); CLI();
+	outport_l(PCI_ADDRESS, get_address(pci->bus, pci->slot, pci->func, reg));
+	outport_l(PCI_DATA, value);
+	RESTORE_FLAGS(flags);
+}
+
+void pci_write_short(struct pci_device *pci, int reg, unsigned short int value)
+{
+	unsigned long int flags;
+
+	SAVE_FLAGS(flags); CLI();
+	outport_l(PCI_ADDRESS, get_address(pci->bus, pci->slot, pci->func, reg));
+	outport_w(PCI_DATA + (reg & 2), value);
+	RESTORE_FLAGS(flags);
+}
+
+void pci_write_char(struct pci_device *pci, int reg, unsigned char value)
+{
+	unsigned long int flags;
+
+	SAVE_FLAGS(flags); CLI();
+	outport_l(PCI_ADDRESS, get_address(pci->bus, pci->slot, pci->func, reg));
+	outport_b(PCI_DATA + (reg & 3), value);
+	RESTORE_FLAGS(flags);
+}
+
+/* returns the next device found after 'from' */
+struct pci_device * pci_next_device(struct pci_device *from)
+{
+	struct pci_device *pci;
+
+	pci = from ? from + 1 : &pci_table[0];
+	if(pci < &pci_table[pci_devices]) {
+		return pci;
+	}
+	return NULL;
+}
+
+/* returns the next device of the class and subclass specified after 'from' */
+struct pci_device * pci_find_class(unsigned char class, unsigned char subclass, struct pci_device *from)
+{
+	struct pci_device *pci;
+
+	pci = from ? from + 1 : &pci_table[0];
+	for(; pci < &pci_table[pci_devices]; pci++) {
+		if(pci->class == class && pci->subclass == subclass) {
+			return pci;
+		}
+	}
+	return NULL;
+}
+
+/* returns the next device with the vendor and device id specified after 'from' */
+struct pci_device * pci_find_device(unsigned short int vendor_id, unsigned short int device_id, struct pci_device *from)
+{
+	struct pci_device *pci;
+
+	pci = from ? from + 1 : &pci_table[0];
+	for(; pci < &pci_table[pci_devices]; pci++) {
+		if(pci->vendor_id == vendor_id && pci->device_id == device_id) {
+			return pci;
+		}
+	}
+	return NULL;
+}
+
+/* enables the bits specified in the command register of the device */
+void pci_enable_device(struct pci_device *pci, unsigned short int bits)
+{
+	unsigned short int cmd;
+
+	cmd = pci_read_short(pci, PCI_COMMAND);
+	if((cmd & bits) != bits) {
+		pci_write_short(pci, PCI_COMMAND, cmd | bits);
+	}
+}
+
+/*
+ * The size of a BAR is known by writing all ones to it and reading back the
+ * bits that the device lets change. The decoding is disabled meanwhile so
+ * the device doesn't answer at the temporary address.
+ */
+static void get_bar_sizes(struct pci_device *pci)
+{
+	unsigned short int cmd;
+	unsigned int size;
+	int n;
+
+	cmd = pci_read_short(pci, PCI_COMMAND);
+	pci_write_short(pci, PCI_COMMAND, cmd & ~(PCI_COMMAND_IO | PCI_COMMAND_MEMORY));
+	for(n = 0; n < NR_PCI_BARS; n++) {
+		if(!pci->bar[n]) {
+			continue;
+		}
+		pci_write_long(pci, PCI_BAR0 + (n * 4), 0xFFFFFFFF);
+		size = pci_read_long(pci, PCI_BAR0 + (n * 4));
+		pci_write_long(pci, PCI_BAR0 + (n * 4), pci->bar[n]);
+		if(pci->bar[n] & PCI_BAR_IO) {
+			pci->size[n] = (~(size & PCI_BAR_IO_MASK) + 1) & 0xFFFF;
+		} else {
+			pci->size[n] = ~(size & PCI_BAR_MEM_MASK) + 1;
+			if(pci->bar[n] & PCI_BAR_MEM_64) {
+				/* the next BAR holds the upper half of the address */
+				if(n + 1 < NR_PCI_BARS && pci->bar[n + 1]) {
+					pci->size[n] = 0;	/* above 4GB */
+				}
+				n++;
+			}
+		}
+	}
+	pci_write_short(pci, PCI_COMMAND, cmd);
+}
+
+static void add_device(int bus, int slot, int func, unsigned int id)
+{
+	struct pci_device *pci;
+	unsigned int class;
+	int n;
+
+	if(pci_devices >= NR_PCI_DEVICES) {
+		printk("WARNING: %s(): too many PCI devices, %d:%d.%d ignored.\n", __FUNCTION__, bus, slot, func);
+		return;
+	}
+	pci = &pci_table[pci_devices++];
+	memset_b(pci, NULL, sizeof(struct pci_device));
+	pci->bus = bus;
+	pci->slot = slot;
+	pci->func = func;
+	pci->vendor_id = id & 0xFFFF;
+	pci->device_id = id >> 16;
+	class = pci_read_long(pci, PCI_REVISION_ID);
+	pci->rev = class & 0xFF;
+	pci->prog_if = (class >> 8) & 0xFF;
+	pci->subclass = (class >> 16) & 0xFF;
+	pci->class = class >> 24;
+	/* only the ordinary devices (header type 0) have six BARs */
+	if(!(pci_read_char(pci, PCI_HEADER_TYPE) & ~PCI_HEADER_MULTIFUNC)) {
+		for(n = 0; n < NR_PCI_BARS; n++) {
+			pci->bar[n] = pci_read_long(pci, PCI_BAR0 + (n * 4));
+		}
+		get_bar_sizes(pci);
+	}
+	if(pci_read_char(pci, PCI_INTERRUPT_PIN)) {
+		pci->irq = pci_read_char(pci, PCI_INTERRUPT_LINE);
+		if(pci->irq == 0xFF) {
+			pci->irq = 0;	/* not connected */
+		}
+	}
+
+	printk("pci       %02d:%02d.%d", bus, slot, func);
+	if(pci->irq) {
+		printk("         %2d    ", pci->irq);
+	} else {
+		printk("          -    ");
+	}
+	printk("vendor=0x%04X device=0x%04X class=0x%02X%02X\n", pci->vendor_id, pci->device_id, pci->class, pci->subclass);
+}
+
+void pci_init(void)
+{
+	int bus, slot, func, nfuncs;
+	unsigned int id;
+
+	/* check that the mechanism #1 is present */
+	outport_l(PCI_ADDRESS, PCI_ENABLE);
+	if(inport_l(PCI_ADDRESS) != PCI_ENABLE) {
+		return;
+	}
+
+	for(bus = 0; bus < NR_PCI_BUSES; bus++) {
+		for(slot = 0; slot < NR_PCI_SLOTS; slot++) {
+			nfuncs = 1;
+			for(func = 0; func < nfuncs; func++) {
+				id = read_long(bus, slot, func, PCI_VENDOR_ID);
+				if((id & 0xFFFF) == PCI_NO_VENDOR) {
+					continue;
+				}
+				if(!func && (read_long(bus, slot, func, PCI_HEADER_TYPE) >> 16) & PCI_HEADER_MULTIFUNC) {
+					nfuncs = NR_PCI_FUNCS;
+				}
+				add_device(bus, slot, func, id);
+			}
+		}
+	}
+}
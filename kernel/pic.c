@@ -11,6 +11,7 @@
 #include <fiwix/limits.h>
 #include <fiwix/errno.h>
 #include <fiwix/pic.h>
+#include <fiwix/random.h>
 #include <fiwix/stdio.h>
 #include <fiwix/string.h>
 #include <fiwix/sigcontext.h>
@@ -178,6 +179,7 @@ void irq_handler(int num, struct sigcontext sc)
 		irq->handler(num, &sc);
 		irq = irq->next;
 	} while(irq);
+	add_irq_randomness(num);
 }
 
 /* do bottom halves (interrupts are enabled) */
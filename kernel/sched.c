@@ -13,6 +13,7 @@
 #include <fiwix/segments.h>
 #include <fiwix/timer.h>
 #include <fiwix/pic.h>
+#include <fiwix/random.h>
 #include <fiwix/stdio.h>
 #include <fiwix/string.h>
 
@@ -84,7 +85,5 @@ void do_sched(void)
 void sched_init(void)
 {
 	get_system_time();
-
-	/* this should be more unpredictable */
-	kstat.random_seed = CURRENT_TIME;
+	random_init();
 }
@@ -285,7 +285,7 @@ void *syscall_table[] = {
 	sys_fstatfs,			/* 100 */
 	sys_ioperm,
 	sys_socketcall,	// sys_socketcall XXX
-	NULL,	// sys_syslog
+	sys_syslog,
 	sys_setitimer,
 	sys_getitimer,			/* 105 */
 	sys_newstat,
@@ -374,6 +374,171 @@ void *syscall_table[] = {
 	NULL,
 	NULL,
 	sys_fork,			/* 190 (sys_vfork) */
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,				/* 200 */
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,				/* 210 */
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,				/* 220 */
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,				/* 230 */
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,				/* 240 */
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,				/* 250 */
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,				/* 260 */
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,				/* 270 */
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,				/* 280 */
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,				/* 290 */
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,				/* 300 */
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,				/* 310 */
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,				/* 320 */
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,				/* 330 */
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,				/* 340 */
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,				/* 350 */
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	sys_getrandom,			/* 355 */
 };
 
 static void do_bad_syscall(unsigned int num)
@@ -393,7 +558,7 @@ int do_syscall(unsigned int num, int arg1, int arg2, int arg3, int arg4, int arg
 {
 	int (*sys_func)(int, ...);
 
-	if(num > NR_SYSCALLS) {
+	if(num >= NR_SYSCALLS) {
 		do_bad_syscall(num);
 		return -ENOSYS;
 	}
@@ -23,11 +23,16 @@ int sys_close(unsigned int ufd)
 	fd = current->fd[ufd];
 	release_user_fd(ufd);
 
+	/* closing any descriptor of a file releases the POSIX locks */
+	i = fd_table[fd].inode;
+	flock_release_inode(i, FL_POSIX);
+
 	if(--fd_table[fd].count) {
 		return 0;
 	}
-	i = fd_table[fd].inode;
-	flock_release_inode(i);
+
+	/* flock() locks go away only on the last close of the open file */
+	flock_release_inode(i, FL_FLOCK);
 	if(i->fsop && i->fsop->close) {
 		i->fsop->close(i, &fd_table[fd]);
 		release_fd(fd);
@@ -238,6 +238,7 @@ static int do_execve(const char *filename, char *argv[], char *envp[], struct si
 	__blk_t block;
 	struct buffer *buf;
 	struct inode *i;
+	struct fd fd_table;
 	struct binargs barg;
 	char *data, *tmp_name;
 	int errno;
@@ -284,26 +285,42 @@ loop:
 		return -EACCES;
 	}
 
-	if((block = bmap(i, 0, FOR_READING)) < 0) {
-		iput(i);
-		free_barg_pages(&barg);
-		kfree((unsigned int)data);
-		return block;
-	}
-	if(!(buf = bread(i->dev, block, i->sb->s_blocksize))) {
-		iput(i);
-		free_barg_pages(&barg);
-		kfree((unsigned int)data);
-		return -EIO;
-	}
+	if(!i->fsop->bmap) {
+		/* filesystems without blocks (i.e. tmpfs) */
+		memset_b(data, 0, PAGE_SIZE);
+		fd_table.inode = i;
+		fd_table.flags = 0;
+		fd_table.count = 0;
+		fd_table.offset = 0;
+		if(!i->fsop->read || i->fsop->read(i, &fd_table, data, PAGE_SIZE) < 0) {
+			iput(i);
+			free_barg_pages(&barg);
+			kfree((unsigned int)data);
+			return -EIO;
+		}
+	} else {
+		if((block = bmap(i, 0, FOR_READING)) < 0) {
+			iput(i);
+			free_barg_pages(&barg);
+			kfree((unsigned int)data);
+			return block;
+		}
+		if(!(buf = bread(i->dev, block, i->sb->s_blocksize))) {
+			iput(i);
+			free_barg_pages(&barg);
+			kfree((unsigned int)data);
+			return -EIO;
+		}
 
-	/*
-	 * The contents of the buffer is copied and then freed immediately to
-	 * make sure that it won't conflict while zeroing the BSS fractional
-	 * page, in case that the same block is requested during the page fault.
-	 */
-	memcpy_b(data, buf->data, i->sb->s_blocksize);
-	brelse(buf);
+		/*
+		 * The contents of the buffer is copied and then freed
+		 * immediately to make sure that it won't conflict while
+		 * zeroing the BSS fractional page, in case that the same
+		 * block is requested during the page fault.
+		 */
+		memcpy_b(data, buf->data, i->sb->s_blocksize);
+		brelse(buf);
+	}
 
 	errno = elf_load(i, &barg, sc, data);
 	if(errno == -ENOEXEC) {
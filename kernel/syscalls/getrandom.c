@@ -0,0 +1,38 @@
+/*
+ * fiwix/kernel/syscalls/getrandom.c
+ *
+ * Copyright 2021, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#include <fiwix/types.h>
+#include <fiwix/fs.h>
+#include <fiwix/random.h>
+#include <fiwix/errno.h>
+
+#ifdef __DEBUG__
+#include <fiwix/stdio.h>
+#include <fiwix/process.h>
+#endif /*__DEBUG__ */
+
+int sys_getrandom(char *buf, __size_t count, unsigned int flags)
+{
+	int errno;
+
+#ifdef __DEBUG__
+	printk("(pid %d) sys_getrandom(0x%08x, %d, 0x%x)\n", current->pid, (unsigned int)buf, count, flags);
+#endif /*__DEBUG__ */
+
+	if(flags & ~(GRND_NONBLOCK | GRND_RANDOM)) {
+		return -EINVAL;
+	}
+	if((errno = check_user_area(VERIFY_WRITE, buf, count))) {
+		return errno;
+	}
+
+	/* GRND_RANDOM is the same as /dev/random */
+	if((errno = random_wait(flags & GRND_NONBLOCK))) {
+		return errno;
+	}
+	return get_random_bytes(buf, count);
+}
@@ -185,8 +185,8 @@ int sys_mount(const char *source, const char *target, const char *fstype, unsign
 	mt->sb.flags = flags;
 	if(fs->fsop && fs->fsop->read_superblock) {
 		if((errno = fs->fsop->read_superblock(dev, &mt->sb))) {
-			i_source->fsop->close(i_source, NULL);
 			if(fs->fsop->flags == FSOP_REQUIRES_DEV) {
+				i_source->fsop->close(i_source, NULL);
 				iput(i_source);
 			}
 			iput(i_target);
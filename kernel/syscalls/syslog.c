@@ -0,0 +1,44 @@
+/*
+ * fiwix/kernel/syscalls/syslog.c
+ *
+ * Copyright 2021, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#include <fiwix/types.h>
+#include <fiwix/fs.h>
+#include <fiwix/syslog.h>
+#include <fiwix/process.h>
+#include <fiwix/errno.h>
+
+#ifdef __DEBUG__
+#include <fiwix/stdio.h>
+#endif /*__DEBUG__ */
+
+int sys_syslog(int type, char *buf, int len)
+{
+	int errno;
+
+#ifdef __DEBUG__
+	printk("(pid %d) sys_syslog(%d, 0x%08x, %d)\n", current->pid, type, (unsigned int)buf, len);
+#endif /*__DEBUG__ */
+
+	if(type != SYSLOG_ACTION_READ_ALL && type != SYSLOG_ACTION_SIZE_BUFFER) {
+		if(!IS_SUPERUSER) {
+			return -EPERM;
+		}
+	}
+	switch(type) {
+		case SYSLOG_ACTION_READ:
+		case SYSLOG_ACTION_READ_ALL:
+		case SYSLOG_ACTION_READ_CLEAR:
+			if(len < 0) {
+				return -EINVAL;
+			}
+			if((errno = check_user_area(VERIFY_WRITE, buf, len))) {
+				return errno;
+			}
+			break;
+	}
+	return do_syslog(type, buf, len);
+}
@@ -0,0 +1,425 @@
+/*
+ * fiwix/lib/inflate.c
+ *
+ * Copyright 2021, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ *
+ * This is a modified version of puff.c from the zlib distribution
+ * (contrib/puff). It was adapted to the kernel: the output goes to an
+ * array of pages, the errors are returned as errno values and the 'zlib'
+ * wrapper is also decoded. The original copyright notice follows.
+ */
+
+/*
+ * puff.c
+ * Copyright (C) 2002-2013 Mark Adler, all rights reserved
+ * version 2.3, 21 Jan 2013
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the author be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ * Mark Adler    madler@alumni.caltech.edu
+ */
+
+/*
+ * Decompressor for the 'deflate' format (RFC 1951) and its 'zlib' wrapper
+ * (RFC 1950). It follows the canonical Huffman decoding scheme, which needs
+ * very little memory and no tables built at compile time.
+ */
+
+#include <fiwix/types.h>
+#include <fiwix/errno.h>
+#include <fiwix/mm.h>
+#include <fiwix/inflate.h>
+#include <fiwix/string.h>
+
+#define OUTBYTE(s, pos)	((s)->out[(pos) >> PAGE_SHIFT][(pos) & (PAGE_SIZE - 1)])
+
+struct huffman {
+	short *count;		/* number of symbols of each length */
+	short *symbol;		/* canonically ordered symbols */
+};
+
+static const short lbase[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const short lext[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const short dbase[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+	8193, 12289, 16385, 24577
+};
+static const short dext[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+static const short order[19] = {
+	16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+static int getbyte(struct inflate_stream *s)
+{
+	if(!s->in_len) {
+		if(s->fill(s) || !s->in_len) {
+			s->error = 1;
+			return -1;
+		}
+	}
+	s->in_len--;
+	return *s->in++;
+}
+
+static int bits(struct inflate_stream *s, int need)
+{
+	unsigned int val;
+	int c;
+
+	val = s->bitbuf;
+	while(s->bitcnt < need) {
+		if((c = getbyte(s)) < 0) {
+			return 0;
+		}
+		val |= (unsigned int)c << s->bitcnt;
+		s->bitcnt += 8;
+	}
+	s->bitbuf = val >> need;
+	s->bitcnt -= need;
+	return val & ((1 << need) - 1);
+}
+
+static int put(struct inflate_stream *s, int c)
+{
+	if(s->out_pos >= s->out_size) {
+		return 1;
+	}
+	OUTBYTE(s, s->out_pos) = c;
+	s->out_pos++;
+	return 0;
+}
+
+/* decodes a symbol using the bits left in the buffer plus the next bytes */
+static int decode(struct inflate_stream *s, struct huffman *h)
+{
+	int len, code, first, count, index, left, c;
+	unsigned int bitbuf;
+	short *next;
+
+	bitbuf = s->bitbuf;
+	left = s->bitcnt;
+	code = first = index = 0;
+	len = 1;
+	next = h->count + 1;
+	for(;;) {
+		while(left--) {
+			code |= bitbuf & 1;
+			bitbuf >>= 1;
+			count = *next++;
+			if(code - count < first) {
+				s->bitbuf = bitbuf;
+				s->bitcnt = (s->bitcnt - len) & 7;
+				return h->symbol[index + (code - first)];
+			}
+			index += count;
+			first += count;
+			first <<= 1;
+			code <<= 1;
+			len++;
+		}
+		left = (INFLATE_MAXBITS + 1) - len;
+		if(!left) {
+			break;
+		}
+		if((c = getbyte(s)) < 0) {
+			return -1;
+		}
+		bitbuf = c;
+		if(left > 8) {
+			left = 8;
+		}
+	}
+	return -1;	/* ran out of codes */
+}
+
+/*
+ * Builds the decoding tables from the code lengths. It returns zero for a
+ * complete code, a negative value for an over-subscribed code, and a
+ * positive value for an incomplete code.
+ */
+static int construct(struct huffman *h, short *length, int n)
+{
+	short offs[INFLATE_MAXBITS + 1];
+	int symbol, len, left;
+
+	for(len = 0; len <= INFLATE_MAXBITS; len++) {
+		h->count[len] = 0;
+	}
+	for(symbol = 0; symbol < n; symbol++) {
+		h->count[length[symbol]]++;
+	}
+	if(h->count[0] == n) {
+		return 0;	/* no codes, complete but decoding will fail */
+	}
+
+	left = 1;
+	for(len = 1; len <= INFLATE_MAXBITS; len++) {
+		left <<= 1;
+		left -= h->count[len];
+		if(left < 0) {
+			return left;
+		}
+	}
+
+	offs[1] = 0;
+	for(len = 1; len < INFLATE_MAXBITS; len++) {
+		offs[len + 1] = offs[len] + h->count[len];
+	}
+	for(symbol = 0; symbol < n; symbol++) {
+		if(length[symbol]) {
+			h->symbol[offs[length[symbol]]++] = symbol;
+		}
+	}
+	return left;
+}
+
+static int stored(struct inflate_stream *s)
+{
+	unsigned int len, nlen;
+	int c;
+
+	/* discard the bits left of the current byte */
+	s->bitbuf = 0;
+	s->bitcnt = 0;
+
+	len = getbyte(s);
+	len |= getbyte(s) << 8;
+	nlen = getbyte(s);
+	nlen |= getbyte(s) << 8;
+	if(s->error || len != (~nlen & 0xFFFF)) {
+		return 1;
+	}
+
+	while(len--) {
+		if((c = getbyte(s)) < 0 || put(s, c)) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int codes(struct inflate_stream *s, struct huffman *lencode, struct huffman *distcode)
+{
+	unsigned int dist, from;
+	int symbol, len;
+
+	do {
+		if((symbol = decode(s, lencode)) < 0) {
+			return 1;
+		}
+		if(symbol < 256) {
+			if(put(s, symbol)) {
+				return 1;
+			}
+		} else if(symbol > 256) {
+			symbol -= 257;
+			if(symbol >= 29) {
+				return 1;
+			}
+			len = lbase[symbol] + bits(s, lext[symbol]);
+			if((symbol = decode(s, distcode)) < 0 || symbol >= 30) {
+				return 1;
+			}
+			dist = dbase[symbol] + bits(s, dext[symbol]);
+			if(s->error || dist > s->out_pos || s->out_pos + len > s->out_size) {
+				return 1;
+			}
+			from = s->out_pos - dist;
+			while(len--) {
+				OUTBYTE(s, s->out_pos) = OUTBYTE(s, from);
+				s->out_pos++;
+				from++;
+			}
+		}
+	} while(symbol != 256);
+
+	return 0;
+}
+
+static int fixed(struct inflate_stream *s)
+{
+	struct huffman lencode, distcode;
+	int symbol;
+
+	lencode.count = s->lencnt;
+	lencode.symbol = s->lensym;
+	distcode.count = s->distcnt;
+	distcode.symbol = s->distsym;
+
+	for(symbol = 0; symbol < 144; symbol++) {
+		s->lengths[symbol] = 8;
+	}
+	for(; symbol < 256; symbol++) {
+		s->lengths[symbol] = 9;
+	}
+	for(; symbol < 280; symbol++) {
+		s->lengths[symbol] = 7;
+	}
+	for(; symbol < INFLATE_FIXLCODES; symbol++) {
+		s->lengths[symbol] = 8;
+	}
+	construct(&lencode, s->lengths, INFLATE_FIXLCODES);
+
+	for(symbol = 0; symbol < INFLATE_MAXDCODES; symbol++) {
+		s->lengths[symbol] = 5;
+	}
+	construct(&distcode, s->lengths, INFLATE_MAXDCODES);
+
+	return codes(s, &lencode, &distcode);
+}
+
+static int dynamic(struct inflate_stream *s)
+{
+	struct huffman lencode, distcode;
+	int nlen, ndist, ncode;
+	int index, symbol, len, err;
+
+	lencode.count = s->lencnt;
+	lencode.symbol = s->lensym;
+	distcode.count = s->distcnt;
+	distcode.symbol = s->distsym;
+
+	nlen = bits(s, 5) + 257;
+	ndist = bits(s, 5) + 1;
+	ncode = bits(s, 4) + 4;
+	if(s->error || nlen > INFLATE_MAXLCODES || ndist > INFLATE_MAXDCODES) {
+		return 1;
+	}
+
+	/* code lengths for the code length alphabet */
+	for(index = 0; index < ncode; index++) {
+		s->lengths[order[index]] = bits(s, 3);
+	}
+	for(; index < 19; index++) {
+		s->lengths[order[index]] = 0;
+	}
+	if(s->error || construct(&lencode, s->lengths, 19)) {
+		return 1;
+	}
+
+	/* code lengths for the literal/length and distance codes */
+	index = 0;
+	while(index < nlen + ndist) {
+		if((symbol = decode(s, &lencode)) < 0) {
+			return 1;
+		}
+		if(symbol < 16) {
+			s->lengths[index++] = symbol;
+			continue;
+		}
+		len = 0;
+		if(symbol == 16) {
+			if(!index) {
+				return 1;
+			}
+			len = s->lengths[index - 1];
+			symbol = 3 + bits(s, 2);
+		} else if(symbol == 17) {
+			symbol = 3 + bits(s, 3);
+		} else {
+			symbol = 11 + bits(s, 7);
+		}
+		if(s->error || index + symbol > nlen + ndist) {
+			return 1;
+		}
+		while(symbol--) {
+			s->lengths[index++] = len;
+		}
+	}
+
+	/* there must be an end-of-block code */
+	if(!s->lengths[256]) {
+		return 1;
+	}
+
+	/* only a single code of length 1 is allowed to be incomplete */
+	err = construct(&lencode, s->lengths, nlen);
+	if(err && (err < 0 || nlen != lencode.count[0] + lencode.count[1])) {
+		return 1;
+	}
+	err = construct(&distcode, s->lengths + nlen, ndist);
+	if(err && (err < 0 || ndist != distcode.count[0] + distcode.count[1])) {
+		return 1;
+	}
+
+	return codes(s, &lencode, &distcode);
+}
+
+/* returns the number of bytes decompressed or a negative error number */
+int inflate(struct inflate_stream *s)
+{
+	int last, type, err;
+
+	s->bitbuf = 0;
+	s->bitcnt = 0;
+	s->error = 0;
+
+	do {
+		last = bits(s, 1);
+		type = bits(s, 2);
+		if(s->error) {
+			return -EIO;
+		}
+		switch(type) {
+			case 0:
+				err = stored(s);
+				break;
+			case 1:
+				err = fixed(s);
+				break;
+			case 2:
+				err = dynamic(s);
+				break;
+			default:
+				err = 1;
+				break;
+		}
+		if(err) {
+			return -EIO;
+		}
+	} while(!last);
+
+	return s->out_pos;
+}
+
+/* skips the zlib header and inflates the stream (the checksum is ignored) */
+int zlib_inflate(struct inflate_stream *s)
+{
+	int cmf, flg;
+
+	s->error = 0;
+	cmf = getbyte(s);
+	flg = getbyte(s);
+	if(s->error) {
+		return -EIO;
+	}
+	if((cmf & 0x0F) != 8 || ((cmf << 8) | flg) % 31 || (flg & 0x20)) {
+		return -EINVAL;
+	}
+	return inflate(s);
+}
@@ -0,0 +1,185 @@
+/*
+ * fiwix/lib/lz4.c
+ *
+ * Copyright 2021, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#include <fiwix/lz4.h>
+#include <fiwix/string.h>
+
+/*
+ * This is a compressor for the LZ4 block format, aimed at small inputs (up
+ * to 64KB) like the blocks of a filesystem. A sequence starts with a token,
+ * whose high nibble is the number of literals and the low nibble is the
+ * length of the match minus 4, followed by the literals and the offset (2
+ * bytes) of the match. A nibble of 15 is continued by bytes of 255 up to a
+ * byte smaller than that. The last sequence has only literals.
+ */
+
+#define MINMATCH	4
+#define LASTLITERALS	5	/* the last bytes are always literals */
+#define MFLIMIT		12	/* no match starts within the last bytes */
+#define MAX_OFFSET	65535
+
+#define READ32(p)	((p)[0] | ((p)[1] << 8) | ((p)[2] << 16) | ((unsigned int)(p)[3] << 24))
+#define HASH(v)		(((v) * 2654435761U) >> (32 - LZ4_HASH_BITS))
+
+/* writes the remainder of a length that didn't fit in its nibble */
+static int put_length(unsigned char *op, int len)
+{
+	int n;
+
+	for(n = 0; len >= 255; len -= 255) {
+		op[n++] = 255;
+	}
+	op[n++] = len;
+	return n;
+}
+
+static int put_sequence(unsigned char *dst, int op, int dstlen, const unsigned char *lit, int litlen, int offset, int matchlen)
+{
+	int token;
+
+	/* worst case size of the sequence */
+	if(op + 1 + (litlen / 255) + 1 + litlen + 2 + (matchlen / 255) + 1 > dstlen) {
+		return -1;
+	}
+
+	token = op++;
+	if(litlen >= 15) {
+		dst[token] = 15 << 4;
+		op += put_length(dst + op, litlen - 15);
+	} else {
+		dst[token] = litlen << 4;
+	}
+	memcpy_b(dst + op, (void *)lit, litlen);
+	op += litlen;
+
+	/* the last sequence has no match */
+	if(!matchlen) {
+		return op;
+	}
+
+	dst[op++] = offset & 0xFF;
+	dst[op++] = offset >> 8;
+	matchlen -= MINMATCH;
+	if(matchlen >= 15) {
+		dst[token] |= 15;
+		op += put_length(dst + op, matchlen - 15);
+	} else {
+		dst[token] |= matchlen;
+	}
+	return op;
+}
+
+/*
+ * Compresses 'srclen' bytes into 'dst' using 'hash' (LZ4_HASH_SIZE entries)
+ * as work area. Returns the compressed size or 0 if it doesn't fit.
+ */
+int lz4_compress(const char *source, int srclen, char *dest, int dstlen, unsigned short int *hash)
+{
+	const unsigned char *src;
+	unsigned char *dst;
+	unsigned int seq;
+	int ip, ref, anchor, op, len, h;
+
+	src = (const unsigned char *)source;
+	dst = (unsigned char *)dest;
+	memset_b(hash, 0, LZ4_HASH_SIZE * sizeof(unsigned short int));
+	ip = anchor = op = 0;
+
+	while(ip < srclen - MFLIMIT) {
+		seq = READ32(src + ip);
+		h = HASH(seq);
+		ref = hash[h];
+		hash[h] = ip;
+		if(ref >= ip || ip - ref > MAX_OFFSET || READ32(src + ref) != seq) {
+			ip++;
+			continue;
+		}
+
+		for(len = MINMATCH; ip + len < srclen - LASTLITERALS; len++) {
+			if(src[ref + len] != src[ip + len]) {
+				break;
+			}
+		}
+		if((op = put_sequence(dst, op, dstlen, src + anchor, ip - anchor, ip - ref, len)) < 0) {
+			return 0;
+		}
+		ip += len;
+		anchor = ip;
+	}
+
+	if((op = put_sequence(dst, op, dstlen, src + anchor, srclen - anchor, 0, 0)) < 0) {
+		return 0;
+	}
+	return op;
+}
+
+/*
+ * Decompresses 'srclen' bytes into 'dst'. Returns the decompressed size or
+ * -1 if the data is malformed or it doesn't fit in 'dstlen' bytes.
+ */
+int lz4_decompress(const char *source, int srclen, char *dest, int dstlen)
+{
+	const unsigned char *src;
+	unsigned char *dst;
+	int ip, op, token, len, offset, b;
+
+	src = (const unsigned char *)source;
+	dst = (unsigned char *)dest;
+	ip = op = 0;
+
+	while(ip < srclen) {
+		token = src[ip++];
+
+		len = token >> 4;
+		if(len == 15) {
+			do {
+				if(ip >= srclen) {
+					return -1;
+				}
+				b = src[ip++];
+				len += b;
+			} while(b == 255);
+		}
+		if(ip + len > srclen || op + len > dstlen) {
+			return -1;
+		}
+		memcpy_b(dst + op, (void *)(src + ip), len);
+		ip += len;
+		op += len;
+		if(ip == srclen) {
+			break;		/* last sequence */
+		}
+
+		if(ip + 2 > srclen) {
+			return -1;
+		}
+		offset = src[ip] | (src[ip + 1] << 8);
+		ip += 2;
+		if(!offset || offset > op) {
+			return -1;
+		}
+		len = token & 15;
+		if(len == 15) {
+			do {
+				if(ip >= srclen) {
+					return -1;
+				}
+				b = src[ip++];
+				len += b;
+			} while(b == 255);
+		}
+		len += MINMATCH;
+		if(op + len > dstlen) {
+			return -1;
+		}
+		/* the match may overlap the bytes being written */
+		for(; len; len--, op++) {
+			dst[op] = dst[op - offset];
+		}
+	}
+	return op;
+}
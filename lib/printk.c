@@ -6,39 +6,131 @@
  */
 
 #include <fiwix/kernel.h>
-#include <fiwix/tty.h>
+#include <fiwix/asm.h>
+#include <fiwix/pic.h>
+#include <fiwix/sched.h>
+#include <fiwix/sleep.h>
+#include <fiwix/syslog.h>
+#include <fiwix/errno.h>
 #include <fiwix/stdio.h>
 #include <fiwix/string.h>
 #include <fiwix/stdarg.h>
 
-#define LOG_BUF_LEN	4096
+#define LOG_BUF_LEN	16384	/* must be a power of 2 */
+#define LOG_BUF_MASK	(LOG_BUF_LEN - 1)
+#define LOG_CHUNK	256	/* bytes sent to the console at once */
 #define MAX_BUF		1024	/* printk() and sprintk() size limit */
 
+/*
+ * The messages are kept in a ring buffer with a log level "<n>" at the
+ * beginning of each line. The positions below are sequence numbers (they
+ * never go back), so the bytes between any of them and 'log_end' are the
+ * ones still pending. A message is stored with the interrupts disabled
+ * just while it's copied into the buffer. Once the bottom halves are
+ * running, the console is updated from there in chunks, instead of within
+ * the code that called printk().
+ */
 static char log_buf[LOG_BUF_LEN];
-static unsigned int log_count;
+static unsigned int log_start;		/* next byte for syslog() */
+static unsigned int con_start;		/* next byte for the console */
+static unsigned int log_end;		/* next byte to be written */
+static unsigned int logged_chars;	/* bytes for SYSLOG_ACTION_READ_ALL */
+static int log_new_line = 1;
+
+static int con_level = -1;		/* -1 = start of line, -2 = skip line */
+static int console_loglevel = DEFAULT_CONSOLE_LOGLEVEL;
+static void (*console_write)(char *, unsigned int) = NULL;
 
-static void puts(char *buffer)
+static void log_bh_fn(void);
+static struct bh log_bh = { 0, &log_bh_fn, NULL };
+static int log_deferred = 0;
+
+static void emit_log_char(char c)
 {
-	struct tty *tty;
-	unsigned short int count;
-	char *b;
+	log_buf[log_end & LOG_BUF_MASK] = c;
+	log_end++;
+	if(log_end - log_start > LOG_BUF_LEN) {
+		log_start = log_end - LOG_BUF_LEN;
+	}
+	if(log_end - con_start > LOG_BUF_LEN) {
+		/* the console lost the oldest bytes, resync at the next line */
+		con_start = log_end - LOG_BUF_LEN;
+		con_level = -2;
+	}
+	if(logged_chars < LOG_BUF_LEN) {
+		logged_chars++;
+	}
+}
 
-	tty = get_tty(_syscondev);
-	count = strlen(buffer);
-	b = buffer;
+static void log_store(char *buffer)
+{
+	unsigned long int flags;
+	char *p;
 
-	while(count--) {
-		if(!tty) {
-			if(log_count < LOG_BUF_LEN) {
-		 		log_buf[log_count++] = *(b++);
+	SAVE_FLAGS(flags); CLI();
+	for(p = buffer; *p; p++) {
+		if(log_new_line) {
+			if(p[0] != '<' || p[1] < '0' || p[1] > '7' || p[2] != '>') {
+				emit_log_char('<');
+				emit_log_char('0' + DEFAULT_MESSAGE_LOGLEVEL);
+				emit_log_char('>');
 			}
-		} else {
-		 	tty_queue_putchar(tty, &tty->write_q, *(b++));
+			log_new_line = 0;
+		}
+		emit_log_char(*p);
+		if(*p == '\n') {
+			log_new_line = 1;
+		}
+	}
+	RESTORE_FLAGS(flags);
+}
+
+/* sends the pending messages (below the console log level) to the console */
+void flush_log_buf(void)
+{
+	static int flushing = 0;
+	unsigned long int flags;
+	char buf[LOG_CHUNK];
+	int n;
+	char c;
 
-			/* kernel messages must be shown immediately */
-			tty->output(tty);
+	if(!console_write || flushing) {
+		return;
+	}
+	flushing = 1;
+	for(;;) {
+		n = 0;
+		SAVE_FLAGS(flags); CLI();
+		while(con_start != log_end && n < LOG_CHUNK) {
+			c = log_buf[con_start & LOG_BUF_MASK];
+			if(con_level == -1) {
+				con_level = log_buf[(con_start + 1) & LOG_BUF_MASK] - '0';
+				con_start += 3;
+				continue;
+			}
+			con_start++;
+			if(con_level >= 0 && con_level < console_loglevel) {
+				buf[n++] = c;
+			}
+			if(c == '\n') {
+				con_level = -1;
+			}
 		}
+		RESTORE_FLAGS(flags);
+		if(!n) {
+			break;
+		}
+		console_write(buf, n);
 	}
+	flushing = 0;
+}
+
+static void log_bh_fn(void)
+{
+	/* from now on the console is updated only from here */
+	log_deferred = 1;
+	flush_log_buf();
+	wakeup(&do_syslog);
 }
 
 /*
@@ -335,7 +427,79 @@ static void do_printk(char *buffer, const char *format, va_list args)
 
 void register_console(void (*fn)(char *, unsigned int))
 {
-	(*fn)(log_buf, log_count);
+	console_write = fn;
+	flush_log_buf();
+	add_bh(&log_bh);
+}
+
+/* reads and controls the kernel log (used by syslog() and /proc/kmsg) */
+int do_syslog(int type, char *buffer, int len)
+{
+	unsigned long int flags;
+	unsigned int start;
+	int n, count;
+	char c;
+
+	switch(type) {
+		case SYSLOG_ACTION_CLOSE:
+		case SYSLOG_ACTION_OPEN:
+			return 0;
+		case SYSLOG_ACTION_READ:
+			if(!buffer || len < 0) {
+				return -EINVAL;
+			}
+			while(log_start == log_end) {
+				if(sleep(&do_syslog, PROC_INTERRUPTIBLE)) {
+					return -EINTR;
+				}
+			}
+			for(n = 0; n < len; n++) {
+				SAVE_FLAGS(flags); CLI();
+				if(log_start == log_end) {
+					RESTORE_FLAGS(flags);
+					break;
+				}
+				c = log_buf[log_start & LOG_BUF_MASK];
+				log_start++;
+				RESTORE_FLAGS(flags);
+				buffer[n] = c;
+			}
+			return n;
+		case SYSLOG_ACTION_READ_ALL:
+		case SYSLOG_ACTION_READ_CLEAR:
+			if(!buffer || len < 0) {
+				return -EINVAL;
+			}
+			count = MIN(len, logged_chars);
+			start = log_end - count;
+			for(n = 0; n < count; n++) {
+				buffer[n] = log_buf[(start + n) & LOG_BUF_MASK];
+			}
+			if(type == SYSLOG_ACTION_READ_CLEAR) {
+				logged_chars = 0;
+			}
+			return count;
+		case SYSLOG_ACTION_CLEAR:
+			logged_chars = 0;
+			return 0;
+		case SYSLOG_ACTION_CONSOLE_OFF:
+			console_loglevel = MINIMUM_CONSOLE_LOGLEVEL;
+			return 0;
+		case SYSLOG_ACTION_CONSOLE_ON:
+			console_loglevel = DEFAULT_CONSOLE_LOGLEVEL;
+			return 0;
+		case SYSLOG_ACTION_CONSOLE_LEVEL:
+			if(len < 1 || len > 8) {
+				return -EINVAL;
+			}
+			console_loglevel = MAX(len, MINIMUM_CONSOLE_LOGLEVEL);
+			return 0;
+		case SYSLOG_ACTION_SIZE_UNREAD:
+			return log_end - log_start;
+		case SYSLOG_ACTION_SIZE_BUFFER:
+			return LOG_BUF_LEN;
+	}
+	return -EINVAL;
 }
 
 void printk(const char *format, ...)
@@ -345,8 +509,14 @@ void printk(const char *format, ...)
 
 	va_start(args, format);
 	do_printk(buffer, format, args);
-	puts(buffer);
+	log_store(buffer);
 	va_end(args);
+
+	if(log_deferred) {
+		log_bh.flags |= BH_ACTIVE;
+	} else {
+		flush_log_buf();
+	}
 }
 
 int sprintk(char *buffer, const char *format, ...)
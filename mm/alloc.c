@@ -33,3 +33,24 @@ void kfree(unsigned int addr)
 	addr = V2P(addr);
 	release_page(addr >> PAGE_SHIFT);
 }
+
+/* allocates 'count' pages contiguous in memory (it doesn't wait for them) */
+unsigned int kmalloc_pages(int count)
+{
+	struct page *pg;
+	unsigned int addr;
+
+	if((pg = get_free_page_run(count))) {
+		addr = pg->page << PAGE_SHIFT;
+		return P2V(addr);
+	}
+	return 0;
+}
+
+void kfree_pages(unsigned int addr, int count)
+{
+	while(count--) {
+		kfree(addr);
+		addr += PAGE_SIZE;
+	}
+}
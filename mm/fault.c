@@ -147,7 +147,7 @@ static int page_not_present(struct vma *vma, unsigned int cr2, struct sigcontext
 				return 1;
 			}
 		}
-		memset_b((void *)(addr & PAGE_MASK), NULL, PAGE_SIZE);
+		memset_l((void *)(addr & PAGE_MASK), NULL, PAGE_SIZE / sizeof(unsigned int));
 	}
 
 	return 0;
@@ -9,12 +9,14 @@
 #include <fiwix/asm.h>
 #include <fiwix/mm.h>
 #include <fiwix/mman.h>
+#include <fiwix/stat.h>
 #include <fiwix/bios.h>
 #include <fiwix/ramdisk.h>
 #include <fiwix/process.h>
 #include <fiwix/buffer.h>
 #include <fiwix/fs.h>
 #include <fiwix/filesystems.h>
+#include <fiwix/pci.h>
 #include <fiwix/stdio.h>
 #include <fiwix/string.h>
 
@@ -139,10 +141,11 @@ int clone_pages(struct proc *child)
 	vma = current->vma;
 
 	for(n = 0, pages = 0; n < VMA_REGIONS && vma->start; n++, vma++) {
+		/* the pages of shared files are found in the page cache */
+		if((vma->flags & MAP_SHARED) && vma->inode && !S_ISCHR(vma->inode->i_mode)) {
+			continue;
+		}
 		for(n2 = vma->start; n2 < vma->end; n2 += PAGE_SIZE) {
-			if(vma->flags & MAP_SHARED) {
-				continue;
-			}
 			pde = GET_PGDIR(n2);
 			pte = GET_PGTBL(n2);
 			if(src_pgdir[pde] & PAGE_PRESENT) {
@@ -160,6 +163,15 @@ int clone_pages(struct proc *child)
 				dst_pgtbl = (unsigned int *)P2V((dst_pgdir[pde] & PAGE_MASK));
 				if(src_pgtbl[pte] & PAGE_PRESENT) {
 					p_addr = src_pgtbl[pte] >> PAGE_SHIFT;
+
+					/* shared memory (and devices) is mapped as is */
+					if(vma->flags & MAP_SHARED) {
+						dst_pgtbl[pte] = src_pgtbl[pte];
+						if(is_valid_page(p_addr) && !(page_table[p_addr].flags & PAGE_RESERVED)) {
+							page_table[p_addr].count++;
+						}
+						continue;
+					}
 					pg = &page_table[p_addr];
 					if(pg->flags & PAGE_RESERVED) {
 						continue;
@@ -260,6 +272,34 @@ int unmap_page(unsigned int vaddr)
 	return 0;
 }
 
+/*
+ * The registers of the PCI devices are mapped at their physical addresses,
+ * which are above the memory seen by the kernel. This is done before paging
+ * is enabled so every process inherits the mapping from the kernel Page
+ * Directory. Large BARs (framebuffers) are left to their own drivers.
+ */
+static void map_pci_bars(unsigned int physical_memory)
+{
+	struct pci_device *pci;
+	unsigned int addr;
+	int n;
+
+	for(pci = pci_next_device(NULL); pci; pci = pci_next_device(pci)) {
+		for(n = 0; n < NR_PCI_BARS; n++) {
+			if(!pci->size[n] || pci->size[n] > PCI_BAR_MMIO_MAX || (pci->bar[n] & PCI_BAR_IO)) {
+				continue;
+			}
+			addr = pci->bar[n] & PCI_BAR_MEM_MASK;
+			if(addr < KERNEL_BASE_ADDR + physical_memory) {
+				printk("WARNING: %s(): PCI %02d:%02d.%d BAR%d at 0x%08x overlaps the kernel space.\n", __FUNCTION__, pci->bus, pci->slot, pci->func, n, addr);
+				pci->size[n] = 0;
+				continue;
+			}
+			map_kaddr(addr & PAGE_MASK, PAGE_ALIGN(addr + pci->size[n]), PAGE_PRESENT | PAGE_RW);
+		}
+	}
+}
+
 void mem_init(void)
 {
 	unsigned int sizek;
@@ -303,6 +343,7 @@ void mem_init(void)
 	if(video.flags & VPF_VESAFB) {
 		map_kaddr((unsigned int)video.address, (unsigned int)video.address + video.memsize, PAGE_PRESENT | PAGE_RW);
 	}
+	map_pci_bars(physical_memory);
 /*	printk("_last_data_addr = 0x%08x-0x%08x (kernel)\n", KERNEL_ENTRY_ADDR, _last_data_addr); */
 	activate_kpage_dir();
 
@@ -423,20 +464,16 @@ void mem_init(void)
 	}
 
 	/*
-	 * FIXME: this is ugly!
-	 * It should go in console_init() once we have a proper kernel memory/page management.
+	 * The framebuffer console draws on a copy of the screen in RAM, so it
+	 * can scroll without reading from the video memory, which is slow.
 	 */
-	#include <fiwix/console.h>
-	for(n = 1; n <= NR_VCONSOLES; n++) {
-		vc_screen[n] = (short int *)_last_data_addr;
-		_last_data_addr += (video.columns * video.lines * 2);
+	if(video.flags & VPF_VESAFB) {
+		_last_data_addr = PAGE_ALIGN(_last_data_addr);
+		if(addr_in_bios_map(V2P(_last_data_addr) + video.fb_vsize)) {
+			video.fb_shadow = (unsigned char *)_last_data_addr;
+			_last_data_addr += video.fb_vsize;
+		}
 	}
-	/*
-	 * FIXME: this is ugly!
-	 * It should go in console_init() once we have a proper kernel memory/page management.
-	 */
-	vcbuf = (short int *)_last_data_addr;
-	_last_data_addr += (video.columns * video.lines * SCREENS_LOG * 2 * sizeof(short int));
 
 
 	/* the last one must be the page_table structure */
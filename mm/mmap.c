@@ -224,20 +224,20 @@ static void free_vma_pages(unsigned int start, __size_t length, struct vma *vma)
 		if(pgdir[pde] & PAGE_PRESENT) {
 			pgtbl = (unsigned int *)P2V((pgdir[pde] & PAGE_MASK));
 			if(pgtbl[pte] & PAGE_PRESENT) {
-				/* make sure to not free reserved pages */
+				/*
+				 * Reserved pages and device memory (i.e. from
+				 * /dev/mem) are only unmapped, never freed.
+				 */
 				page = pgtbl[pte] >> PAGE_SHIFT;
-				pg = &page_table[page];
-				if(pg->flags & PAGE_RESERVED) {
-					continue;
-				}
-
-				if(vma->prot & PROT_WRITE && vma->flags & MAP_SHARED) {
-					addr = start - vma->start + vma->offset;
-					write_page(pg, vma->inode, addr, length);
+				pg = is_valid_page(page) ? &page_table[page] : NULL;
+				if(pg && !(pg->flags & PAGE_RESERVED)) {
+					if(vma->prot & PROT_WRITE && vma->flags & MAP_SHARED && vma->inode) {
+						addr = start - vma->start + vma->offset;
+						write_page(pg, vma->inode, addr, length);
+					}
+					kfree(P2V(pgtbl[pte]) & PAGE_MASK);
+					current->rss--;
 				}
-
-				kfree(P2V(pgtbl[pte]) & PAGE_MASK);
-				current->rss--;
 				pgtbl[pte] = NULL;
 
 				/* check if a page table can be freed */
@@ -350,10 +350,46 @@ int expand_heap(unsigned int new)
 	return 1;
 }
 
+/*
+ * Shared anonymous memory has no object where the pages could be looked up
+ * by the other processes, so all of them are allocated now and they are
+ * inherited by the children in clone_pages().
+ */
+int map_shared_anon(struct vma *vma)
+{
+	unsigned int addr, page;
+	unsigned int *pgdir, *pgtbl;
+	int n;
+
+	pgdir = (unsigned int *)P2V(current->tss.cr3);
+	for(addr = vma->start; addr < vma->end; addr += PAGE_SIZE) {
+		/* a MAP_FIXED mapping replaces the pages already there */
+		if(pgdir[GET_PGDIR(addr)] & PAGE_PRESENT) {
+			pgtbl = (unsigned int *)P2V((pgdir[GET_PGDIR(addr)] & PAGE_MASK));
+			if(pgtbl[GET_PGTBL(addr)] & PAGE_PRESENT) {
+				n = pgtbl[GET_PGTBL(addr)] >> PAGE_SHIFT;
+				if(is_valid_page(n) && !(page_table[n].flags & PAGE_RESERVED)) {
+					unmap_page(addr);
+				} else {
+					pgtbl[GET_PGTBL(addr)] = NULL;
+				}
+			}
+		}
+		if(!(page = map_page(current, addr, 0, vma->prot))) {
+			free_vma_pages(vma->start, addr - vma->start, vma);
+			invalidate_tlb();
+			return -ENOMEM;
+		}
+		memset_l((void *)page, NULL, PAGE_SIZE / sizeof(unsigned int));
+	}
+	invalidate_tlb();
+	return 0;
+}
+
 int do_mmap(struct inode *i, unsigned int start, unsigned int length, unsigned int prot, unsigned int flags, unsigned int offset, char type, char mode)
 {
 	struct vma *vma;
-	int errno;
+	int errno, errno2;
 
 	if(!(length = PAGE_ALIGN(length))) {
 		return start;
@@ -394,8 +430,12 @@ int do_mmap(struct inode *i, unsigned int start, unsigned int length, unsigned i
 
 	/* anonymous mapping */
 	} else {
-		if((flags & MAP_TYPE) != MAP_PRIVATE) {
-			return -EINVAL;
+		switch(flags & MAP_TYPE) {
+			case MAP_SHARED:
+			case MAP_PRIVATE:
+				break;
+			default:
+				return -EINVAL;
 		}
 
 		/* anonymous objects must be filled with zeros */
@@ -428,19 +468,21 @@ int do_mmap(struct inode *i, unsigned int start, unsigned int length, unsigned i
 	vma->inode = i;
 	vma->o_mode = mode;
 
+	errno = 0;
 	if(i && i->fsop->mmap) {
-		if((errno = i->fsop->mmap(i, vma))) {
-			int errno2;
-
-			if((errno2 = free_vma_region(vma, start, length))) {
-				return errno2;
-			}
-			sort_vma();
-			if((errno2 = optimize_vma())) {
-				return errno2;
-			}
-			return errno;
+		errno = i->fsop->mmap(i, vma);
+	} else if(!i && (flags & MAP_TYPE) == MAP_SHARED) {
+		errno = map_shared_anon(vma);
+	}
+	if(errno) {
+		if((errno2 = free_vma_region(vma, start, length))) {
+			return errno2;
+		}
+		sort_vma();
+		if((errno2 = optimize_vma())) {
+			return errno2;
 		}
+		return errno;
 	}
 
 	sort_vma();
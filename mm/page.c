@@ -185,6 +185,49 @@ struct page * get_free_page(void)
 	return pg;
 }
 
+/*
+ * Takes 'count' free pages which are contiguous in memory, or returns NULL
+ * if there aren't. This doesn't wait for kswapd, so it can be used with the
+ * interrupts disabled.
+ */
+struct page * get_free_page_run(int count)
+{
+	unsigned long int flags;
+	struct page *pg;
+	int n, run;
+
+	SAVE_FLAGS(flags); CLI();
+	if(kstat.free_pages < count) {
+		RESTORE_FLAGS(flags);
+		return NULL;
+	}
+	/* the entries past the physical memory are not pages */
+	for(n = 0, run = 0; n < kstat.physical_pages && run < count; n++) {
+		pg = &page_table[n];
+		if(pg->count || (pg->flags & PAGE_RESERVED) || !pg->data) {
+			run = 0;
+			continue;
+		}
+		run++;
+	}
+	if(run < count) {
+		RESTORE_FLAGS(flags);
+		return NULL;
+	}
+
+	for(n -= count; run; n++, run--) {
+		pg = &page_table[n];
+		remove_from_free_list(pg);
+		remove_from_hash(pg);
+		pg->count = 1;
+		pg->inode = 0;
+		pg->offset = 0;
+		pg->dev = 0;
+	}
+	RESTORE_FLAGS(flags);
+	return &page_table[n - count];
+}
+
 struct page * search_page_hash(struct inode *inode, __off_t offset)
 {
 	struct page *pg;
@@ -207,6 +250,27 @@ struct page * search_page_hash(struct inode *inode, __off_t offset)
 	return NULL;
 }
 
+/* removes a page from the cache, so the next read will get it from the file */
+void invalidate_page(__dev_t dev, __ino_t inode, __off_t offset)
+{
+	unsigned long int flags;
+	struct page *pg;
+
+	SAVE_FLAGS(flags); CLI();
+	pg = page_hash_table[PAGE_HASH(inode, offset)];
+	while(pg) {
+		if(pg->inode == inode && pg->offset == offset && pg->dev == dev) {
+			remove_from_hash(pg);
+			pg->inode = 0;
+			pg->offset = 0;
+			pg->dev = 0;
+			break;
+		}
+		pg = pg->next_hash;
+	}
+	RESTORE_FLAGS(flags);
+}
+
 void release_page(int page)
 {
 	unsigned long int flags;
@@ -297,29 +361,47 @@ int write_page(struct page *pg, struct inode *i, __off_t offset, unsigned int le
 
 int bread_page(struct page *pg, struct inode *i, __off_t offset, char prot, char flags)
 {
-	__blk_t block;
-	__off_t size_read;
-	int blksize;
-	struct buffer *buf;
-
-	blksize = i->sb->s_blocksize;
-	size_read = 0;
+	__blk_t blocks[PAGE_SIZE / BPS];
+	int n, n2, run, nblocks, blksize;
+	struct buffer *bufs[PAGE_SIZE / BPS];
+	struct fd fd_table;
 
-	while(size_read < PAGE_SIZE) {
-		if((block = bmap(i, offset + size_read, FOR_READING)) < 0) {
+	/* filesystems without blocks (i.e. tmpfs) read the page themselves */
+	if(!i->fsop->bmap) {
+		memset_b(pg->data, 0, PAGE_SIZE);
+		fd_table.inode = i;
+		fd_table.flags = 0;
+		fd_table.count = 0;
+		fd_table.offset = offset;
+		if(!i->fsop->read || i->fsop->read(i, &fd_table, pg->data, PAGE_SIZE) < 0) {
 			return 1;
 		}
-		if(block) {
-			if(!(buf = bread(i->dev, block, blksize))) {
+	} else {
+		blksize = i->sb->s_blocksize;
+		nblocks = PAGE_SIZE / blksize;
+		for(n = 0; n < nblocks; n++) {
+			if((blocks[n] = bmap(i, offset + (n * blksize), FOR_READING)) < 0) {
 				return 1;
 			}
-			memcpy_b(pg->data + size_read, buf->data, blksize);
-			brelse(buf);
-		} else {
-			/* fill the hole with zeros */
-			memset_b(pg->data + size_read, 0, blksize);
 		}
-		size_read += blksize;
+
+		for(n = 0; n < nblocks; n += run) {
+			if(!blocks[n]) {
+				/* fill the hole with zeros */
+				memset_b(pg->data + (n * blksize), 0, blksize);
+				run = 1;
+				continue;
+			}
+			/* the blocks that are consecutive on disk are read at once */
+			for(run = 1; n + run < nblocks && blocks[n + run] == blocks[n] + run; run++);
+			if(bread_blocks(i->dev, blocks[n], blksize, bufs, run)) {
+				return 1;
+			}
+			for(n2 = 0; n2 < run; n2++) {
+				memcpy_b(pg->data + ((n + n2) * blksize), bufs[n2]->data, blksize);
+				brelse(bufs[n2]);
+			}
+		}
 	}
 
 	/* cache any read-only or public (shared) pages */
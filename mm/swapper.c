@@ -15,9 +15,14 @@
 #include <fiwix/memdev.h>
 #include <fiwix/serial.h>
 #include <fiwix/lp.h>
+#include <fiwix/pty.h>
 #include <fiwix/ramdisk.h>
+#include <fiwix/zram.h>
+#include <fiwix/loop.h>
 #include <fiwix/floppy.h>
 #include <fiwix/ide.h>
+#include <fiwix/ahci.h>
+#include <fiwix/virtio_blk.h>
 #include <fiwix/buffer.h>
 #include <fiwix/mm.h>
 #include <fiwix/fs.h>
@@ -34,11 +39,16 @@ int kswapd(void)
 	memdev_init();
 	serial_init();
 	lp_init();
+	pty_init();
 
 	/* block devices */
 	ramdisk_init();
+	loop_init();
+	zram_init();
 	floppy_init();
 	ide_init();
+	ahci_init();
+	virtio_blk_init();
 
 	/* data structures */
 	sleep_init();